@@ -40,9 +40,128 @@ typedef struct {
 /* Reading/writing at most 32 sectors at once seems safe on most BIOSes. */
 #define SAFE_INT13_SIZE_MAX            32
 
+/*
+ * A single real-mode transfer must fit in one 64KB segment. The offset part of
+ * the far pointers returned by virtual_to_real() is at most 15.
+ */
+#define INT13_TRANSFER_SIZE_MAX        (0x10000 - 0x10)
+
+#define EDD_VERSION_1_1                0x21
+#define EDD_FIXED_DISK_ACCESS          (1 << 0)
+
 #define int13(_iregs_, _oregs_)        (disk_int13((_iregs_), (_oregs_), false))
 #define safe_int13(_iregs_, _oregs_)   (disk_int13((_iregs_), (_oregs_), true))
 
+/* Conventional memory transfer buffer, used instead of the COM32 bounce one */
+static struct {
+   void *buffer;
+   size_t size;
+} int13_bounce;
+
+/* Max number of sectors per EDD transfer, for each BIOS drive (0 = unknown) */
+static uint8_t edd_max_sectors[256];
+
+/*-- disk_get_bounce_buffer ----------------------------------------------------
+ *
+ *      Get the transfer buffer to be used for INT 13h reads and writes. This is
+ *      the large conventional memory buffer if one could be allocated, or the
+ *      COM32 bounce buffer otherwise.
+ *
+ * Parameters
+ *      OUT size: the buffer size, in bytes
+ *
+ * Results
+ *      A pointer to the transfer buffer.
+ *----------------------------------------------------------------------------*/
+static void *disk_get_bounce_buffer(size_t *size)
+{
+   if (int13_bounce.buffer != NULL) {
+      *size = int13_bounce.size;
+      return int13_bounce.buffer;
+   }
+
+   *size = get_bounce_buffer_size();
+   return get_bounce_buffer();
+}
+
+/*-- disk_bounce_buffer_init ---------------------------------------------------
+ *
+ *      Try to allocate a conventional memory transfer buffer that is large
+ *      enough for the biggest transfer that an EDD read/write can do at once
+ *      (one sector for the device address packet, plus the data). The COM32
+ *      bounce buffer keeps being used if it is already large enough, or if
+ *      there is not enough free low memory.
+ *
+ * Parameters
+ *      IN bytes_per_sector: sector size, in bytes
+ *----------------------------------------------------------------------------*/
+static void disk_bounce_buffer_init(uint16_t bytes_per_sector)
+{
+   size_t max_size, size;
+   void *buffer;
+
+   if (int13_bounce.buffer != NULL || bytes_per_sector == 0) {
+      return;
+   }
+
+   max_size = MIN((size_t)EXTENDED_INT13_READ_SIZE_MAX * bytes_per_sector,
+                  (size_t)INT13_TRANSFER_SIZE_MAX / bytes_per_sector *
+                  bytes_per_sector);
+   max_size += bytes_per_sector;
+
+   if (max_size <= get_bounce_buffer_size()) {
+      return;
+   }
+
+   buffer = lowmem_malloc(get_bounce_buffer_size() + bytes_per_sector,
+                          max_size, &size);
+   if (buffer == NULL) {
+      Log(LOG_DEBUG, "Using the %zu-byte COM32 bounce buffer for disk I/O",
+          get_bounce_buffer_size());
+      return;
+   }
+
+   int13_bounce.buffer = buffer;
+   int13_bounce.size = size;
+
+   Log(LOG_DEBUG, "Using a %zu-byte low memory buffer for disk I/O at %p",
+       size, buffer);
+}
+
+/*-- edd_negotiate_max_sectors -------------------------------------------------
+ *
+ *      Determine the maximum number of sectors to transfer at once with the
+ *      EDD read/write functions. Drives reporting EDD 1.1 or later with the
+ *      fixed disk access subset get the largest transfer size that the EDD
+ *      specification allows. Others are limited to a conservative size.
+ *
+ *      The limit negotiated here is optimistic: it is lowered back to the
+ *      conservative size if a large transfer ever fails.
+ *
+ * Parameters
+ *      IN version:          EDD version
+ *      IN flags:            EDD feature flags
+ *      IN bytes_per_sector: sector size, in bytes
+ *
+ * Results
+ *      The maximum number of sectors per transfer.
+ *----------------------------------------------------------------------------*/
+static uint8_t edd_negotiate_max_sectors(uint8_t version, uint16_t flags,
+                                         uint16_t bytes_per_sector)
+{
+   size_t sectors;
+
+   if (version < EDD_VERSION_1_1 || !(flags & EDD_FIXED_DISK_ACCESS) ||
+       bytes_per_sector == 0) {
+      return SAFE_INT13_SIZE_MAX;
+   }
+
+   sectors = MIN((size_t)EXTENDED_INT13_READ_SIZE_MAX,
+                 (size_t)INT13_TRANSFER_SIZE_MAX / bytes_per_sector);
+
+   return (uint8_t)MAX(sectors, 1);
+}
+
 /*-- lba_to_chs ----------------------------------------------------------------
  *
  *      LBA to CHS conversion. The conversion algorithm is deduced from the
@@ -272,6 +391,7 @@ static int legacy_int13_rw_sectors(uint8_t drive, uint16_t cylinder,
 {
    com32sys_t iregs, oregs;
    farptr_t fptr;
+   size_t bufsize;
    void *buf;
    int status;
 
@@ -279,13 +399,13 @@ static int legacy_int13_rw_sectors(uint8_t drive, uint16_t cylinder,
       return ERR_SUCCESS;
    }
 
+   buf = disk_get_bounce_buffer(&bufsize);
+
    if (sector == 0 || sector > 63 || cylinder > 1023 ||
-       ((size_t)count * LEGACY_BYTES_PER_SECTOR > get_bounce_buffer_size())) {
+       ((size_t)count * LEGACY_BYTES_PER_SECTOR > bufsize)) {
       return ERR_INVALID_PARAMETER;
    }
 
-   buf = get_bounce_buffer();
-
    if (!read) {
       memcpy(buf, buffer, count * LEGACY_BYTES_PER_SECTOR);
    }
@@ -337,6 +457,7 @@ static int extended_int13_rw_sectors(uint8_t drive, uint16_t bytes_per_sector,
    device_address_packet_t *dap;
    com32sys_t iregs, oregs;
    farptr_t fptr;
+   size_t bufsize;
    int status;
    void *buf;
 
@@ -344,12 +465,13 @@ static int extended_int13_rw_sectors(uint8_t drive, uint16_t bytes_per_sector,
       return ERR_SUCCESS;
    }
 
+   dap = disk_get_bounce_buffer(&bufsize);
+
    if (count > EXTENDED_INT13_READ_SIZE_MAX ||
-       ((size_t)count + 1) * bytes_per_sector > get_bounce_buffer_size()) {
+       ((size_t)count + 1) * bytes_per_sector > bufsize ||
+       (size_t)count * bytes_per_sector > (size_t)INT13_TRANSFER_SIZE_MAX) {
       return ERR_INVALID_PARAMETER;
    }
-
-   dap = get_bounce_buffer();
    buf = (char *)dap + bytes_per_sector;
 
    if (!read) {
@@ -398,30 +520,52 @@ static int extended_int13_rw_sectors(uint8_t drive, uint16_t bytes_per_sector,
  *----------------------------------------------------------------------------*/
 static INLINE size_t get_max_numsectors(const disk_t *disk, size_t sectors)
 {
+   size_t bufsize, max;
+
    if (sectors == 0) {
       return 0;
    }
 
-   sectors = MIN(sectors, SAFE_INT13_SIZE_MAX);
-   sectors = MIN(sectors, get_bounce_buffer_size() / disk->bytes_per_sector);
+   disk_get_bounce_buffer(&bufsize);
+
+   if (disk->use_edd) {
+      max = edd_max_sectors[disk->firmware_id & 0xff];
+      if (max == 0) {
+         max = SAFE_INT13_SIZE_MAX;
+      }
+      /* The first sector of the bounce buffer holds the address packet */
+      bufsize = (bufsize > disk->bytes_per_sector) ?
+         bufsize - disk->bytes_per_sector : 0;
+      bufsize = MIN(bufsize, (size_t)INT13_TRANSFER_SIZE_MAX);
+   } else {
+      max = SAFE_INT13_SIZE_MAX;
+   }
+
+   sectors = MIN(sectors, max);
+   sectors = MIN(sectors, bufsize / disk->bytes_per_sector);
 
    return MAX(sectors, 1);
 }
 
-/*-- disk_read -----------------------------------------------------------------
+/*-- disk_rw -------------------------------------------------------------------
  *
- *      Read sectors from a disk. All sectors are read, or an error is returned.
+ *      Read/write sectors from/to a disk, splitting the transfer into as few
+ *      INT 13h calls as possible. If an EDD transfer larger than the
+ *      conservative size fails, the drive maximum transfer size is lowered and
+ *      the transfer is retried.
  *
  * Parameters
  *      IN disk:   pointer to the disk info structure
- *      IN buffer: pointer to the output buffer
- *      IN lba:    first sector LBA to read from
- *      IN count:  number of sectors to read
+ *      IN buffer: pointer to the data buffer
+ *      IN lba:    first sector LBA to transfer
+ *      IN count:  number of sectors to transfer
+ *      IN read:   true = read, false = write
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
-int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
+static int disk_rw(const disk_t *disk, void *buffer, uint64_t lba,
+                   size_t count, bool read)
 {
    char *current_buffer;
    size_t offset, numsectors;
@@ -436,13 +580,24 @@ int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
       if (disk->use_edd) {
          status = extended_int13_rw_sectors(disk->firmware_id,
                                             disk->bytes_per_sector,
-                                            lba + offset, true, current_buffer,
+                                            lba + offset, read, current_buffer,
                                             numsectors);
+         if (status != ERR_SUCCESS && numsectors > SAFE_INT13_SIZE_MAX) {
+            Log(LOG_DEBUG, "INT13 transfer of %zu sectors failed, "
+                "limiting transfers to %u sectors", numsectors,
+                SAFE_INT13_SIZE_MAX);
+            edd_max_sectors[disk->firmware_id & 0xff] = SAFE_INT13_SIZE_MAX;
+            numsectors = get_max_numsectors(disk, count - offset);
+            status = extended_int13_rw_sectors(disk->firmware_id,
+                                               disk->bytes_per_sector,
+                                               lba + offset, read,
+                                               current_buffer, numsectors);
+         }
       } else {
          status = lba_to_chs(disk, lba + offset, &cylinder, &head, &sector);
          if (status == ERR_SUCCESS) {
             status = legacy_int13_rw_sectors(disk->firmware_id, cylinder, head,
-                                             sector, true, current_buffer,
+                                             sector, read, current_buffer,
                                              numsectors);
          }
       }
@@ -455,6 +610,24 @@ int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
    return ERR_SUCCESS;
 }
 
+/*-- disk_read -----------------------------------------------------------------
+ *
+ *      Read sectors from a disk. All sectors are read, or an error is returned.
+ *
+ * Parameters
+ *      IN disk:   pointer to the disk info structure
+ *      IN buffer: pointer to the output buffer
+ *      IN lba:    first sector LBA to read from
+ *      IN count:  number of sectors to read
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
+{
+   return disk_rw(disk, buffer, lba, count, true);
+}
+
 /*-- disk_write ----------------------------------------------------------------
  *
  *      Write sectors to a disk. All sectors are written, or an error is
@@ -471,10 +644,6 @@ int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
  *----------------------------------------------------------------------------*/
 int disk_write(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
 {
-   char *current_buffer;
-   size_t offset, numsectors;
-   uint8_t head, sector;
-   uint16_t cylinder;
    int status;
    void *buf;
 
@@ -482,27 +651,9 @@ int disk_write(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
       return ERR_SUCCESS;
    }
 
-   for (offset = 0; offset < count; offset += numsectors) {
-      numsectors = get_max_numsectors(disk, count - offset);
-      current_buffer = (char*)buffer + offset * disk->bytes_per_sector;
-
-      if (disk->use_edd) {
-         status = extended_int13_rw_sectors(disk->firmware_id,
-                                            disk->bytes_per_sector,
-                                            lba + offset, false, current_buffer,
-                                            numsectors);
-      } else {
-         status = lba_to_chs(disk, lba + offset, &cylinder, &head, &sector);
-         if (status == ERR_SUCCESS) {
-            status = legacy_int13_rw_sectors(disk->firmware_id, cylinder, head,
-                                             sector, false, current_buffer,
-                                             numsectors);
-         }
-      }
-
-      if (status != ERR_SUCCESS) {
-         return status;
-      }
+   status = disk_rw(disk, buffer, lba, count, false);
+   if (status != ERR_SUCCESS) {
+      return status;
    }
 
    buf = sys_malloc(count * disk->bytes_per_sector);
@@ -580,5 +731,11 @@ int get_disk_info(uint8_t drive, disk_t *disk)
    disk->sectors_per_track = s;
    disk->bytes_per_sector = bytes_per_sector;
 
+   if (edd_present) {
+      edd_max_sectors[drive] = edd_negotiate_max_sectors(version, flags,
+                                                         bytes_per_sector);
+      disk_bounce_buffer_init(bytes_per_sector);
+   }
+
    return ERR_SUCCESS;
 }
@@ -13,13 +13,26 @@
 
 #define COM32_READ_BLOCK_SIZE_MAX   (16 * 1024)
 #define COM32_READ_BLOCK_COUNT_MAX  UINT16_MAX
-#define REALLOC_CHUNK_SIZE          READ_CHUNK_SIZE
+#define RECV_CHUNK_SIZE_MIN         READ_CHUNK_SIZE
+#define RECV_CHUNK_SIZE_MAX         (32 * READ_CHUNK_SIZE)
 
 #define BYTES_TO_BLOCKS(_bytes_, _blksize_) \
    (((_bytes_) + (_blksize_) - 1) / (_blksize_))
 
 #define IS_POWER_OF_TWO(x)          (((x) & ((x) - 1)) == 0)
 
+/*
+ * Segment of a file being received without knowing its size in advance. The
+ * segment data immediately follows this header.
+ */
+typedef struct recv_chunk {
+   struct recv_chunk *next;
+   size_t size;                     /* Data capacity, in bytes */
+   size_t len;                      /* Data actually received, in bytes */
+} recv_chunk_t;
+
+#define RECV_CHUNK_DATA(_chunk_)    ((char *)((_chunk_) + 1))
+
 /*-- com32_is_valid_file_block_size --------------------------------------------
  *
  *      COM32 block size sanity checks. The Syslinux file system is block-
@@ -288,28 +301,74 @@ int firmware_file_get_size_hint(const char *filepath, size_t *filesize)
    return ERR_SUCCESS;
 }
 
+/*-- recv_chunks_free ----------------------------------------------------------
+ *
+ *      Free a list of receive segments.
+ *
+ * Parameters
+ *      IN chunks: pointer to the first segment of the list
+ *----------------------------------------------------------------------------*/
+static void recv_chunks_free(recv_chunk_t *chunks)
+{
+   recv_chunk_t *next;
+
+   while (chunks != NULL) {
+      next = chunks->next;
+      sys_free(chunks);
+      chunks = next;
+   }
+}
+
+/*-- recv_chunks_linearize -----------------------------------------------------
+ *
+ *      Gather a list of receive segments into a single buffer. Each segment is
+ *      freed as soon as its data has been copied, so that the peak memory
+ *      usage stays close to twice the file size.
+ *
+ * Parameters
+ *      IN  chunks: pointer to the first segment of the list
+ *      IN  size:   total number of bytes stored in the list
+ *      OUT buffer: pointer to the freshly allocated output buffer
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status. The list is always freed.
+ *----------------------------------------------------------------------------*/
+static int recv_chunks_linearize(recv_chunk_t *chunks, size_t size,
+                                 void **buffer)
+{
+   recv_chunk_t *next;
+   size_t offset;
+   char *buf;
+
+   buf = sys_malloc(MAX(size, 1));
+   if (buf == NULL) {
+      recv_chunks_free(chunks);
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   for (offset = 0; chunks != NULL; chunks = next) {
+      next = chunks->next;
+      memcpy(buf + offset, RECV_CHUNK_DATA(chunks), chunks->len);
+      offset += chunks->len;
+      sys_free(chunks);
+   }
+
+   *buffer = buf;
+
+   return ERR_SUCCESS;
+}
+
 /*-- file_load_unbounded -------------------------------------------------------
  *
  *      Read a file whose size is unknown. This is useful for loading files via
  *      gPXE (which downloads the whole file for determining its size), or via
  *      PXE with old servers which do not support the 'tsize' PXE option.
  *
- *      Initialization
- *        1. max_blocks = Maximum blocks that can be read in a single operation
- *        2. n = 0
- *
- *      Main loop
- *        3. Do we have enough space for reading max_blocks?
- *           - yes -> jumps to step (4)
- *           - no  -> allocate ++n more MB
- *        4. Reads max_blocks
- *        5. EOF?
- *            - Yes -> We're done loading.
- *            - No  -> jump back to step (3)
- *
- *      Growing the buffer by (n * 1MB) limits the number of realloc()
- *      iterations, and also avoids wasting too much memory as if we were
- *      doubling the buffer size at every iteration.
+ *      The file is received into a list of segments. Each new segment is twice
+ *      as large as the previous one (up to RECV_CHUNK_SIZE_MAX), so only a few
+ *      allocations are needed for large files. Once EOF is reached, the
+ *      segments are copied into a single buffer of the exact file size. Each
+ *      byte is copied only once, instead of once per reallocation.
  *
  * Parameters
  *      IN  fd:       file descriptor
@@ -324,32 +383,43 @@ int firmware_file_get_size_hint(const char *filepath, size_t *filesize)
 static int file_load_unbounded(uint16_t *fd, size_t blk_size, bool is_gpxe,
                                size_t *filesize, void **buffer)
 {
-   size_t blocks, buf_size, grow_size, len, offset, max_blocks;
-   char *buf, *tmp;
+   size_t blocks, chunk_size, len, offset, max_blocks;
+   recv_chunk_t *chunks, *chunk, *tmp;
    int status;
 
-   buf = NULL;
-   grow_size = 0;
+   chunks = NULL;
+   chunk = NULL;
    offset = 0;
-   buf_size = 0;
    max_blocks = com32_read_max_blocks(blk_size);
+   chunk_size = MAX(RECV_CHUNK_SIZE_MIN, max_blocks * blk_size);
 
    while (*fd != 0) {
-      if (buf_size - offset < max_blocks * blk_size) {
-         grow_size += REALLOC_CHUNK_SIZE;
-         tmp = sys_realloc(buf, buf_size, buf_size + grow_size);
+      if (chunk == NULL || chunk->size - chunk->len < blk_size) {
+         tmp = sys_malloc(sizeof (recv_chunk_t) + chunk_size);
          if (tmp == NULL) {
             status = ERR_OUT_OF_RESOURCES;
             goto error;
          }
-         buf = tmp;
-         buf_size += grow_size;
+
+         tmp->next = NULL;
+         tmp->size = chunk_size;
+         tmp->len = 0;
+
+         if (chunk == NULL) {
+            chunks = tmp;
+         } else {
+            chunk->next = tmp;
+         }
+         chunk = tmp;
+
+         chunk_size = MIN(2 * chunk_size, RECV_CHUNK_SIZE_MAX);
       }
 
-      blocks = MIN(max_blocks, (buf_size - offset) / blk_size);
+      blocks = MIN(max_blocks, (chunk->size - chunk->len) / blk_size);
       len = blocks * blk_size;
 
-      status = com32_fread(fd, blk_size, blocks, is_gpxe, buf + offset, &len);
+      status = com32_fread(fd, blk_size, blocks, is_gpxe,
+                           RECV_CHUNK_DATA(chunk) + chunk->len, &len);
       if (status != ERR_SUCCESS) {
          goto error;
       }
@@ -363,22 +433,21 @@ static int file_load_unbounded(uint16_t *fd, size_t blk_size, bool is_gpxe,
          *fd = 0;
       }
 
+      chunk->len += len;
       offset += len;
    }
 
-   tmp = sys_realloc(buf, buf_size, offset);
-   if (tmp == NULL) {
-      status = ERR_OUT_OF_RESOURCES;
-      goto error;
+   status = recv_chunks_linearize(chunks, offset, buffer);
+   if (status != ERR_SUCCESS) {
+      return status;
    }
 
-   *buffer = tmp;
    *filesize = offset;
 
    return ERR_SUCCESS;
 
  error:
-   sys_free(buf);
+   recv_chunks_free(chunks);
    return status;
 }
 
@@ -469,6 +538,57 @@ static int file_load_bounded(uint16_t *fd, size_t blk_size, bool is_gpxe,
    return ERR_SUCCESS;
 }
 
+/*-- firmware_file_prefetch ----------------------------------------------------
+ *
+ *      Start reading a file in the background.  COM32 file reads are
+ *      synchronous, so this is not supported.
+ *
+ * Parameters
+ *      IN filepath: absolute path of the file
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_file_prefetch(UNUSED_PARAM(const char *filepath))
+{
+   return ERR_UNSUPPORTED;
+}
+
+/*-- firmware_file_get_etag ----------------------------------------------------
+ *
+ *      Get the entity tag of a file.  COM32 does not report it.
+ *
+ * Parameters
+ *      IN  filepath: absolute path of the file
+ *      OUT etag:     unused
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_file_get_etag(UNUSED_PARAM(const char *filepath),
+                           UNUSED_PARAM(char **etag))
+{
+   return ERR_UNSUPPORTED;
+}
+
+/*-- firmware_file_check_etag --------------------------------------------------
+ *
+ *      Check the entity tag of a file.  COM32 cannot send conditional
+ *      requests.
+ *
+ * Parameters
+ *      IN filepath: absolute path of the file
+ *      IN etag:     unused
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_file_check_etag(UNUSED_PARAM(const char *filepath),
+                             UNUSED_PARAM(const char *etag))
+{
+   return ERR_UNSUPPORTED;
+}
+
 /*-- firmware_file_read --------------------------------------------------------
  *
  *      Read an entire file.
@@ -538,3 +658,63 @@ int firmware_file_write(UNUSED_PARAM(const char *filepath),
 {
    return ERR_UNSUPPORTED;
 }
+
+/*-- firmware_local_file_read --------------------------------------------------
+ *
+ *      Read a file from a local volume.  There is no such volume with COM32,
+ *      whose firmware only gives access to the boot volume.
+ *
+ * Parameters
+ *      IN  filepath: absolute path of the file
+ *      IN  callback: routine to be called periodically while the file is being
+ *                    loaded
+ *      OUT buffer:   pointer to where the file was loaded
+ *      OUT buflen:   number of bytes that have been written into buffer
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_read(UNUSED_PARAM(const char *filepath),
+                             UNUSED_PARAM(int (*callback)(size_t)),
+                             UNUSED_PARAM(void **buffer),
+                             UNUSED_PARAM(size_t *buflen))
+{
+   return ERR_UNSUPPORTED;
+}
+
+/*-- firmware_local_file_write -------------------------------------------------
+ *
+ *      Write a file to a local volume.  Not supported with COM32.
+ *
+ * Parameters
+ *      IN filepath: absolute path of the file
+ *      IN callback: routine to be called periodically while the file is being
+ *                   written
+ *      IN buffer:   pointer to buffer being written
+ *      IN bufsize:  number of bytes to write
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_write(UNUSED_PARAM(const char *filepath),
+                              UNUSED_PARAM(int (*callback)(size_t)),
+                              UNUSED_PARAM(void *buffer),
+                              UNUSED_PARAM(size_t bufsize))
+{
+   return ERR_UNSUPPORTED;
+}
+
+/*-- firmware_local_file_delete ------------------------------------------------
+ *
+ *      Delete a file from a local volume.  Not supported with COM32.
+ *
+ * Parameters
+ *      IN filepath: absolute path of the file
+ *
+ * Results
+ *      ERR_UNSUPPORTED
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_delete(UNUSED_PARAM(const char *filepath))
+{
+   return ERR_UNSUPPORTED;
+}
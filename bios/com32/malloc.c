@@ -242,6 +242,64 @@ void *sys_malloc(size_t size)
    return NULL;
 }
 
+/*-- lowmem_malloc -------------------------------------------------------------
+ *
+ *      Allocate a buffer that lies entirely within conventional memory, so
+ *      that it can be handed to real-mode BIOS services. The largest free low
+ *      memory block is used, up to the requested maximum size.
+ *
+ * Parameters
+ *      IN  min_size: minimum acceptable buffer size, in bytes
+ *      IN  max_size: maximum useful buffer size, in bytes
+ *      OUT size:     actual size of the allocated buffer, in bytes
+ *
+ * Results
+ *      A pointer to the allocated buffer, or NULL if no block in conventional
+ *      memory is large enough.
+ *----------------------------------------------------------------------------*/
+void *lowmem_malloc(size_t min_size, size_t max_size, size_t *size)
+{
+   struct free_arena_header *fp, *best;
+   size_t avail, best_avail, alloc_size;
+   uintptr_t start, end;
+
+   if (min_size == 0 || max_size < min_size) {
+      return NULL;
+   }
+
+   best = NULL;
+   best_avail = 0;
+
+   for (fp = __malloc_head.next_free; fp->a.type != ARENA_TYPE_HEAD;
+        fp = fp->next_free) {
+      start = (uintptr_t)fp;
+      if (start >= LOWMEM_LIMIT) {
+         continue;
+      }
+
+      end = MIN(start + fp->a.size, LOWMEM_LIMIT);
+      avail = (end - start) & ARENA_SIZE_MASK;
+      if (avail > best_avail) {
+         best = fp;
+         best_avail = avail;
+      }
+   }
+
+   /* Add the obligatory arena header, and round up */
+   alloc_size = (max_size + 2 * sizeof(struct arena_header) - 1) &
+      ARENA_SIZE_MASK;
+   alloc_size = MIN(alloc_size, best_avail);
+
+   if (best == NULL ||
+       alloc_size < min_size + sizeof(struct arena_header)) {
+      return NULL;
+   }
+
+   *size = alloc_size - sizeof(struct arena_header);
+
+   return __malloc_from_block(best, alloc_size);
+}
+
 void sys_free(void *ptr)
 {
    struct free_arena_header *ah;
@@ -21,9 +21,21 @@ typedef struct {
    partition_t *partition;
 } volume_t;
 
+/*
+ * The last FAT volume that was opened is kept mounted, along with an index of
+ * its root directory, so that loading many files from the same volume does not
+ * rescan the directory for every file.
+ */
+typedef struct {
+   int volid;
+   struct libfat_filesystem *fs;
+   struct libfat_dirindex *rootdir;
+} fat_mount_t;
+
 static disk_t disk_info;
 static partition_t part_info;
 static volume_t dfd;
+static fat_mount_t fat_mount;
 
 /*-- partition_read_handler ----------------------------------------------------
  *
@@ -170,32 +182,43 @@ void fat_get_shortname(const char *name, char *shortname)
    }
 }
 
-/*-- fat_file_open -------------------------------------------------------------
+/*-- fat_unmount ---------------------------------------------------------------
  *
- *      Open a file on a FAT filesystem.
+ *      Close the currently mounted FAT volume, if any.
+ *----------------------------------------------------------------------------*/
+static void fat_unmount(void)
+{
+   if (fat_mount.fs != NULL) {
+      libfat_dirindex_free(fat_mount.rootdir);
+      libfat_close(fat_mount.fs);
+   }
+
+   memset(&fat_mount, 0, sizeof (fat_mount));
+}
+
+/*-- fat_mount_volume ----------------------------------------------------------
+ *
+ *      Mount a FAT volume, and index its root directory. Nothing is done if the
+ *      volume is already mounted. If the root directory cannot be indexed, file
+ *      lookups fall back to scanning the directory.
  *
  * Parameters
- *      IN  volid:    MBR/GPT partition number of the volume to load from
- *      IN  filename: absolute path to the file
- *      OUT fsinfo:   newly created FAT filesystem info
- *      OUT sector:   starting sector number of the file
- *      OUT size:     the size of the file in bytes
+ *      IN volid: MBR/GPT partition number of the volume to mount
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
-int fat_file_open(int volid, const char *filename,
-                  struct libfat_filesystem **fsinfo, libfat_sector_t *sector,
-                  size_t *size)
+static int fat_mount_volume(int volid)
 {
-   char shortname[FAT_SHORT_NAME_LEN];
    struct libfat_filesystem *fs;
-   struct libfat_direntry dentry;
-   struct fat_dirent *entry;
-   libfat_sector_t sector_offset;
-   int cluster;
    int status;
 
+   if (fat_mount.fs != NULL && fat_mount.volid == volid) {
+      return ERR_SUCCESS;
+   }
+
+   fat_unmount();
+
    status = get_boot_disk(&disk_info);
    if (status != ERR_SUCCESS) {
       return status;
@@ -216,20 +239,70 @@ int fat_file_open(int volid, const char *filename,
       return ERR_NOT_FOUND;
    }
 
+   fat_mount.volid = volid;
+   fat_mount.fs = fs;
+   fat_mount.rootdir = libfat_dirindex_build(fs, 0);
+   if (fat_mount.rootdir == NULL) {
+      Log(LOG_DEBUG, "Could not index the root directory of volume %d", volid);
+   }
+
+   return ERR_SUCCESS;
+}
+
+/*-- fat_file_open -------------------------------------------------------------
+ *
+ *      Open a file on a FAT filesystem. The returned filesystem info belongs to
+ *      the mounted volume, and must not be closed by the caller.
+ *
+ * Parameters
+ *      IN  volid:    MBR/GPT partition number of the volume to load from
+ *      IN  filename: absolute path to the file
+ *      OUT fsinfo:   FAT filesystem info
+ *      OUT sector:   starting sector number of the file
+ *      OUT size:     the size of the file in bytes
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int fat_file_open(int volid, const char *filename,
+                  struct libfat_filesystem **fsinfo, libfat_sector_t *sector,
+                  size_t *size)
+{
+   char shortname[FAT_SHORT_NAME_LEN];
+   struct libfat_filesystem *fs;
+   struct libfat_direntry dentry;
+   struct fat_dirent *entry;
+   libfat_sector_t sector_offset;
+   int cluster;
+   int status;
+
+   status = fat_mount_volume(volid);
+   if (status != ERR_SUCCESS) {
+      return status;
+   }
+
+   fs = fat_mount.fs;
+
    fat_get_shortname(filename, shortname);
 
-   cluster = libfat_searchdir(fs, 0, shortname, &dentry);
+   if (fat_mount.rootdir != NULL) {
+      while (*filename == '/') {
+         filename++;
+      }
+      cluster = libfat_dirindex_lookup(fat_mount.rootdir, filename, shortname,
+                                       &dentry);
+   } else {
+      cluster = libfat_searchdir(fs, 0, shortname, &dentry);
+   }
+
    if (cluster == -1) {
-      libfat_close(fs);
       return ERR_DEVICE_ERROR;
    } else if (cluster == -2) {
-      libfat_close(fs);
       return ERR_NOT_FOUND;
    }
 
    sector_offset = libfat_clustertosector(fs, cluster);
    if (sector_offset == (libfat_sector_t)(-1)) {
-      libfat_close(fs);
       return ERR_VOLUME_CORRUPTED;
    }
 
@@ -282,7 +355,6 @@ static int fat_file_load(int volid, const char *filename,
 
    data = sys_malloc(count * disk.bytes_per_sector);
    if (data == NULL) {
-      libfat_close(fs);
       return ERR_OUT_OF_RESOURCES;
    }
 
@@ -306,8 +378,6 @@ static int fat_file_load(int volid, const char *filename,
       }
    }
 
-   libfat_close(fs);
-
    if (status != ERR_SUCCESS) {
       sys_free(data);
    } else {
@@ -343,8 +413,6 @@ static int fat_file_get_size(int volid, const char *filename,
       return status;
    }
 
-   libfat_close(fs);
-
    *filesize = size;
 
    return status;
@@ -397,9 +465,11 @@ int file_get_size_hint(int volid, const char *filename, size_t *filesize)
  *      IN  volid:            MBR/GPT partition number of the volume to load
  *                            from setting this parameter to zero indicates
  *                            that we want to load a file from the boot volume.
- *                            A parameter other than zero indicates that the
- *                            file should be loaded from a FAT filesystem on
- *                            the given partition
+ *                            FIRMWARE_LOCAL_VOLUME selects the local file
+ *                            system that the firmware can write to.  Any
+ *                            other parameter indicates that the file should be
+ *                            loaded from a FAT filesystem on the given
+ *                            partition
  *      IN  filepath:         absolute path to the file
  *      IN  callback:         routine to be called periodically while the file
  *                            is being loaded
@@ -412,7 +482,9 @@ int file_load(int volid, const char *filename, int (*callback)(size_t),
               void **buffer, size_t *bufsize)
 {
    int status;
-   if (volid != FIRMWARE_BOOT_VOLUME) {
+   if (volid == FIRMWARE_LOCAL_VOLUME) {
+      status = firmware_local_file_read(filename, callback, buffer, bufsize);
+   } else if (volid != FIRMWARE_BOOT_VOLUME) {
       status = fat_file_load(volid, filename, callback, buffer, bufsize);
    } else {
       status = firmware_file_read(filename, callback, buffer, bufsize);
@@ -422,6 +494,81 @@ int file_load(int volid, const char *filename, int (*callback)(size_t),
    return status;
 }
 
+/*-- file_prefetch -------------------------------------------------------------
+ *
+ *      Start loading a file in the background, so that a subsequent
+ *      file_load() of the same file completes sooner.  This is only supported
+ *      for some firmware file access methods (e.g. native UEFI HTTP), and
+ *      never for files on a FAT partition.
+ *
+ * Parameters
+ *      IN  volid:    MBR/GPT partition number of the volume to load from
+ *                    (see file_load())
+ *      IN  filepath: absolute path to the file
+ *
+ * Results
+ *      ERR_SUCCESS if the file is being loaded in the background,
+ *      ERR_OUT_OF_RESOURCES if too many files are already being loaded,
+ *      ERR_UNSUPPORTED, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int file_prefetch(int volid, const char *filename)
+{
+   if (volid != FIRMWARE_BOOT_VOLUME) {
+      return ERR_UNSUPPORTED;
+   }
+
+   return firmware_file_prefetch(filename);
+}
+
+/*-- file_get_etag -------------------------------------------------------------
+ *
+ *      Get the entity tag (e.g. HTTP ETag) that the server sent with a file
+ *      that has just been loaded with file_load().  This is only supported
+ *      for some firmware file access methods (e.g. native UEFI HTTP).
+ *
+ * Parameters
+ *      IN  volid:    MBR/GPT partition number of the volume the file was
+ *                    loaded from (see file_load())
+ *      IN  filepath: absolute path to the file
+ *      OUT etag:     the entity tag (to be freed by the caller)
+ *
+ * Results
+ *      ERR_SUCCESS, ERR_NOT_FOUND if the server did not send one,
+ *      ERR_UNSUPPORTED, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int file_get_etag(int volid, const char *filename, char **etag)
+{
+   if (volid != FIRMWARE_BOOT_VOLUME) {
+      return ERR_UNSUPPORTED;
+   }
+
+   return firmware_file_get_etag(filename, etag);
+}
+
+/*-- file_check_etag -----------------------------------------------------------
+ *
+ *      Ask the server whether a file still has the given entity tag, without
+ *      transferring it.  This is only supported where file_get_etag() is.
+ *
+ * Parameters
+ *      IN  volid:    MBR/GPT partition number of the volume to load from
+ *                    (see file_load())
+ *      IN  filepath: absolute path to the file
+ *      IN  etag:     entity tag of the copy at hand, or NULL if not known
+ *
+ * Results
+ *      ERR_SUCCESS if the file is unchanged, ERR_NOT_FOUND if it changed or
+ *      etag is NULL, ERR_UNSUPPORTED, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int file_check_etag(int volid, const char *filename, const char *etag)
+{
+   if (volid != FIRMWARE_BOOT_VOLUME) {
+      return ERR_UNSUPPORTED;
+   }
+
+   return firmware_file_check_etag(filename, etag);
+}
+
 /*-- file_save -----------------------------------------------------------------
  *
  *      Save a file from a memory buffer, overwriting the file if it exists.
@@ -429,10 +576,12 @@ int file_load(int volid, const char *filename, int (*callback)(size_t),
  * Parameters
  *      IN  volid:            MBR/GPT partition number of the volume to save to.
  *                            Setting this parameter to zero indicates that we
- *                            want to save the file to the boot volume. A
- *                            parameter other than zero indicates that the file
- *                            should be saved to a FAT filesystem on the given
- *                            partition (but that is not currently supported).
+ *                            want to save the file to the boot volume, and
+ *                            FIRMWARE_LOCAL_VOLUME to the local file system
+ *                            (see file_load()). Any other parameter indicates
+ *                            that the file should be saved to a FAT filesystem
+ *                            on the given partition (but that is not currently
+ *                            supported).
  *      IN  filepath:         absolute path to the file
  *      IN  callback:         routine to be called periodically while the file
  *                            is being saved
@@ -445,15 +594,48 @@ int file_save(int volid, const char *filename, int (*callback)(size_t),
               void *buffer, size_t bufsize)
 {
    int status;
-   if (volid != FIRMWARE_BOOT_VOLUME) {
+   if (volid != FIRMWARE_BOOT_VOLUME && volid != FIRMWARE_LOCAL_VOLUME) {
       return ERR_UNSUPPORTED;
    }
 
-   status = firmware_file_write(filename, callback, buffer, bufsize);
+   /*
+    * The firmware may be writing to the mounted FAT volume, which would make
+    * our cached view of its root directory stale.
+    */
+   fat_unmount();
+
+   if (volid == FIRMWARE_LOCAL_VOLUME) {
+      status = firmware_local_file_write(filename, callback, buffer, bufsize);
+   } else {
+      status = firmware_file_write(filename, callback, buffer, bufsize);
+   }
    firmware_reset_watchdog();
    return status;
 }
 
+/*-- file_delete ---------------------------------------------------------------
+ *
+ *      Delete a file.  This is only supported on the local file system (see
+ *      file_load()).
+ *
+ * Parameters
+ *      IN volid:    FIRMWARE_LOCAL_VOLUME
+ *      IN filepath: absolute path to the file
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int file_delete(int volid, const char *filename)
+{
+   if (volid != FIRMWARE_LOCAL_VOLUME) {
+      return ERR_UNSUPPORTED;
+   }
+
+   fat_unmount();
+
+   return firmware_local_file_delete(filename);
+}
+
 /*-- file_overwrite ------------------------------------------------------------
  *
  *      Overwrite a file which already exists with the new data contained in the
@@ -497,7 +679,6 @@ int file_overwrite(int volid, const char *filepath, void *buffer, size_t buflen)
    sectorbuf = sys_malloc(disk.bytes_per_sector);
    if (sectorbuf == NULL) {
       Log(LOG_DEBUG, "file_overwrite: sys_malloc failed");
-      libfat_close(fs);
       return ERR_OUT_OF_RESOURCES;
    }
 
@@ -514,8 +695,6 @@ int file_overwrite(int volid, const char *filepath, void *buffer, size_t buflen)
       }
    }
 
-   libfat_close(fs);
-
    sys_free(sectorbuf);
    firmware_reset_watchdog();
    return status;
@@ -22,6 +22,13 @@
 #define GZIP_FLAG_COMMENT      0x10 /* bit 4 set: file comment present */
 #define GZIP_FLAG_RESERVED     0xE0 /* bits 5..7: reserved */
 
+/*
+ * Output is produced in steps of this size, so that each step can be
+ * checksummed (and handed over to the consumer, if any) while it is still in
+ * the processor caches.
+ */
+#define GZIP_OUTPUT_STEP       (256 * 1024)
+
 /*-- error_zlib_to_generic -----------------------------------------------------
  *
  *      Convert a Zlib error number to a generic status code.
@@ -172,7 +179,9 @@ static int gzip_get_info(const void *buffer, size_t filesize, size_t hdrsize,
 
 /*-- gunzip_buffer -------------------------------------------------------------
  *
- *      Buffer to buffer extraction.
+ *      Buffer to buffer extraction.  The output is produced GZIP_OUTPUT_STEP
+ *      bytes at a time; the CRC is updated and the consumer is called after
+ *      each step.
  *
  * Parameters
  *      IN  source:    pointer to the compressed data
@@ -181,20 +190,30 @@ static int gzip_get_info(const void *buffer, size_t filesize, size_t hdrsize,
  *      IN  destLen:   size of the destination buffer
  *      OUT destLen:   number of bytes that have been written into the
  *                     destination buffer
+ *      OUT crc:       CRC-32 of the extracted data
+ *      IN  consume:   if not NULL, called with each newly extracted part of
+ *                     the destination buffer
+ *      IN  arg:       argument for consume
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
 static int gunzip_buffer(const void *source, size_t sourceLen, void *dest,
-                         size_t *destLen)
+                         size_t *destLen, uint32_t *crc,
+                         void (*consume)(const void *, size_t, void *),
+                         void *arg)
 {
    z_stream stream;
+   Bytef *out, *end;
+   size_t len;
    int err;
 
+   *crc = crc32(0, Z_NULL, 0);
+
    stream.next_in = (Bytef *)source;
    stream.avail_in = (uInt)sourceLen;
    stream.next_out = dest;
-   stream.avail_out = (uInt)*destLen;
+   stream.avail_out = 0;
    stream.zalloc = Z_NULL;
    stream.zfree = Z_NULL;
    stream.opaque = Z_NULL;
@@ -204,7 +223,19 @@ static int gunzip_buffer(const void *source, size_t sourceLen, void *dest,
       return error_zlib_to_generic(err);
    }
 
-   err = inflate(&stream, Z_FINISH);
+   end = (Bytef *)dest + *destLen;
+   do {
+      out = stream.next_out;
+      stream.avail_out = (uInt)MIN((size_t)(end - out), GZIP_OUTPUT_STEP);
+      err = inflate(&stream, Z_NO_FLUSH);
+      len = stream.next_out - out;
+      if (len > 0) {
+         *crc = crc32(*crc, out, len);
+         if (consume != NULL) {
+            consume(out, len, arg);
+         }
+      }
+   } while (err == Z_OK);
    inflateEnd(&stream);
    if (err != Z_STREAM_END) {
       return error_zlib_to_generic(err);
@@ -215,23 +246,33 @@ static int gunzip_buffer(const void *source, size_t sourceLen, void *dest,
    return ERR_SUCCESS;
 }
 
-/*-- gzip_extract --------------------------------------------------------------
+/*-- gzip_extract_stream -------------------------------------------------------
  *
  *      Buffer to buffer gzip extraction. The output buffer is dynamically
  *      allocated, or points to the input buffer if the input data are not a
  *      gzip archive.
  *
+ *      While the data is being extracted, the consumer is called with each
+ *      newly extracted part of the output buffer, in order, so that it can
+ *      process the data before it is evicted from the processor caches.  The
+ *      parts are contiguous: each one starts where the previous one ended.
+ *      The consumer must not modify the data.
+ *
  * Parameters
  *      IN  ibuffer: pointer to the gzip'ed data
  *      IN  isize:   size of the gzip'ed data
  *      OUT obuffer: pointer to the freshly allocated extracted data
  *      OUT osize:   size of the extracted data
+ *      IN  consume: if not NULL, routine to be called as data is extracted
+ *      IN  arg:     argument for consume
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
-int gzip_extract(const void *ibuffer, size_t isize,
-                 void **obuffer, size_t *osize)
+int gzip_extract_stream(const void *ibuffer, size_t isize,
+                        void **obuffer, size_t *osize,
+                        void (*consume)(const void *, size_t, void *),
+                        void *arg)
 {
    void *output;
    size_t header_len;
@@ -282,7 +323,8 @@ int gzip_extract(const void *ibuffer, size_t isize,
       return ERR_OUT_OF_RESOURCES;
    }
 
-   status = gunzip_buffer(ibuffer, isize, output, &size);
+   status = gunzip_buffer(ibuffer, isize, output, &size, &calculated_crc,
+                          consume, arg);
    if (status != ERR_SUCCESS) {
       sys_free(output);
       Log(LOG_ERR, "Error %d (%s) while decompressing data\n",
@@ -291,8 +333,6 @@ int gzip_extract(const void *ibuffer, size_t isize,
       return status;
    }
 
-   calculated_crc = crc32(0, output, size);
-
    if (received_crc != calculated_crc) {
       *obuffer = NULL;
       *osize = 0;
@@ -309,6 +349,27 @@ int gzip_extract(const void *ibuffer, size_t isize,
    return ERR_SUCCESS;
 }
 
+/*-- gzip_extract --------------------------------------------------------------
+ *
+ *      Buffer to buffer gzip extraction. The output buffer is dynamically
+ *      allocated, or points to the input buffer if the input data are not a
+ *      gzip archive.
+ *
+ * Parameters
+ *      IN  ibuffer: pointer to the gzip'ed data
+ *      IN  isize:   size of the gzip'ed data
+ *      OUT obuffer: pointer to the freshly allocated extracted data
+ *      OUT osize:   size of the extracted data
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int gzip_extract(const void *ibuffer, size_t isize,
+                 void **obuffer, size_t *osize)
+{
+   return gzip_extract_stream(ibuffer, isize, obuffer, osize, NULL, NULL);
+}
+
 /*-- is_gzip -------------------------------------------------------------------
  *
  *      Check whether the given buffer contains a gzip archive.
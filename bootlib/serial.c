@@ -13,6 +13,11 @@
 #include <bootlib.h>
 #include <uart.h>
 
+/*
+ * Characters gathered by serial_log before they are handed to the UART.
+ */
+#define SERIAL_LOG_BUFSIZE 128
+
 static uart_t serial_dev;
 static bool   serial_valid;
 
@@ -37,7 +42,8 @@ uart_t *serial_get_uart(void)
 
 /*-- serial_log ----------------------------------------------------------------
  *
- *      Write a string to the serial console.
+ *      Write a string to the serial console.  The characters are gathered in
+ *      a small buffer, so that the UART can send them in bursts.
  *
  * Parameters
  *      IN msg: pointer to the string to be written
@@ -47,11 +53,14 @@ uart_t *serial_get_uart(void)
  *----------------------------------------------------------------------------*/
 static int serial_log(const char *msg)
 {
+   char buf[SERIAL_LOG_BUFSIZE];
+   size_t used;
    int len, level;
    bool newline;
 
    newline = true;
    len = 0;
+   used = 0;
 
    if ((uart_flags(&serial_dev) & UART_USE_AFTER_EXIT_BOOT_SERVICES) != 0 &&
        in_boot_services()) {
@@ -71,18 +80,26 @@ static int serial_log(const char *msg)
          }
       }
 
+      /* Room for "\r\n" */
+      if (used > sizeof (buf) - 2) {
+         uart_write(&serial_dev, buf, used);
+         used = 0;
+      }
+
       if (*msg == '\n') {
-         uart_putc(&serial_dev, '\r');
+         buf[used++] = '\r';
          len++;
          newline = true;
       } else {
          newline = false;
       }
 
-      uart_putc(&serial_dev, *msg);
+      buf[used++] = *msg;
       len++;
    }
 
+   uart_write(&serial_dev, buf, used);
+
    return len;
 }
 
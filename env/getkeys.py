@@ -15,6 +15,7 @@
 # }
 
 import base64
+import io
 import json
 import os
 import re
@@ -87,10 +88,49 @@ def get_cert(pem_file):
     return bytearray(base64.b64decode(''.join(crt)))
 
 
-def process_key(output, key):
+def format_limbs(name, value, limb_bits, count):
+    """\
+    Format a number as a static array of mbedtls_mpi_uint limbs, least
+    significant limb first, like mbedtls_mpi stores them.
+    """
+    mask = (1 << limb_bits) - 1
+    suffix = 'ULL' if limb_bits == 64 else 'U'
+    per_row = 3 if limb_bits == 64 else 6
+    limbs = ['0x%0*x%s' % (limb_bits // 4, (value >> (i * limb_bits)) & mask,
+                           suffix)
+             for i in range(count)]
+    rows = ['   %s,' % ', '.join(limbs[i:i + per_row])
+            for i in range(0, len(limbs), per_row)]
+    return 'static mbedtls_mpi_uint %s[] = {\n%s\n};\n' % (name,
+                                                           '\n'.join(rows))
+
+
+def format_mpis(ident, modulus, exponent):
+    """\
+    Precompute the mbedtls_mpi limbs of the modulus N, of the exponent E,
+    and of R^2 mod N, the constant that mbedtls_mpi_exp_mod() otherwise
+    computes on the first use of the key (R = 2^(limb bits * N limbs)).
+    Limbs are 64-bit or 32-bit depending on the target.
+    """
+    out = []
+    for limb_bits, cond in ((64, '#if defined(MBEDTLS_HAVE_INT64)'),
+                            (32, '#else')):
+        limb_bytes = limb_bits // 8
+        n_limbs = -(-((modulus.bit_length() + 7) // 8) // limb_bytes)
+        e_limbs = max(1, -(-((exponent.bit_length() + 7) // 8) // limb_bytes))
+        rr = pow(2, 2 * n_limbs * limb_bits, modulus)
+        out.append(cond + '\n')
+        out.append(format_limbs('%s_N' % ident, modulus, limb_bits, n_limbs))
+        out.append(format_limbs('%s_E' % ident, exponent, limb_bits, e_limbs))
+        out.append(format_limbs('%s_RR' % ident, rr, limb_bits, n_limbs))
+    out.append('#endif\n')
+    return ''.join(out)
+
+
+def process_key(output, mpis, key):
     """\
     Extract a public key from a certificate, and format it as
-    RawRSAKey structure.
+    RawRSAKey structure.  The precomputed key limbs are written to mpis.
     """
     pem_file = get_pem(key)
     if pem_file is None:
@@ -163,6 +203,16 @@ def process_key(output, key):
         raise ValueError('RSA modulus does not have %s valid bits' %
                          (modulus_length - 1) * 8)
 
+    ident = 'key_' + re.sub(r'\W', '_', key)
+    modulus = int(''.join(['%02x' % x for x in
+                           der[modulus_offset:
+                               modulus_offset + modulus_length]]), 16)
+    exponent = int(''.join(['%02x' % x for x in
+                            der[exponent_offset:
+                                exponent_offset + exponent_length]]), 16)
+    mpis.write(format_mpis(ident, modulus, exponent))
+    args['ident'] = ident
+
     args['certLength'] = len(der)
     args['modulusStart'] = modulus_offset
     args['modulusLength'] = modulus_length
@@ -185,6 +235,9 @@ def process_key(output, key):
       %(modulusStart)s, %(modulusLength)s,
       %(exponentStart)s, %(exponentLength)s,
       MBEDTLS_MD_%(hash)s,
+      MPI_LIMBS(%(ident)s_N),
+      MPI_LIMBS(%(ident)s_E),
+      MPI_LIMBS(%(ident)s_RR),
       false,
       false,
       { 0 }
@@ -216,14 +269,30 @@ def main(inputFile, output):
 
 #include "cert.h"
 
-RawRSACert certs[] = {
+#define MPI_LIMBS(limbs) { limbs, sizeof (limbs) / sizeof (limbs)[0] }
+
 ''' % args)
     # Sort reverse, so 'test' is before 'official', like in original code
-    for condition, keys in sorted(signinfo.items(), reverse=True):
+    groups = sorted(signinfo.items(), reverse=True)
+    tables = []
+    for condition, keys in groups:
+        mpis = io.StringIO()
+        table = io.StringIO()
+        for key in keys:
+            process_key(table, mpis, key)
+        tables.append((condition, mpis.getvalue(), table.getvalue()))
+    for condition, mpis, _ in tables:
         if condition:
             output.write('#if defined(%s)\n' % condition)
-        for key in keys:
-            process_key(output, key)
+        output.write(mpis)
+        if condition:
+            output.write('#endif /* defined(%s) */\n' % condition)
+        output.write('\n')
+    output.write('RawRSACert certs[] = {\n')
+    for condition, _, table in tables:
+        if condition:
+            output.write('#if defined(%s)\n' % condition)
+        output.write(table)
         if condition:
             output.write('#endif /* defined(%s) */\n' % condition)
     output.write('''\
@@ -233,6 +302,9 @@ RawRSACert certs[] = {
       0, 0,
       0, 0,
       MBEDTLS_MD_NONE,
+      { NULL, 0 },
+      { NULL, 0 },
+      { NULL, 0 },
       false,
       false,
       { 0 }
@@ -91,8 +91,18 @@ EXTERN int get_boot_dir(char **buffer);
 EXTERN int firmware_file_get_size_hint(const char *filepath, size_t *size);
 EXTERN int firmware_file_read(const char *filepath, int (*callback)(size_t),
                               void **buffer, size_t *buflen);
+EXTERN int firmware_file_prefetch(const char *filepath);
+EXTERN int firmware_file_get_etag(const char *filepath, char **etag);
+EXTERN int firmware_file_check_etag(const char *filepath, const char *etag);
 EXTERN int firmware_file_write(const char *filepath, int (*callback)(size_t),
                                void *buffer, size_t buflen);
+EXTERN int firmware_local_file_read(const char *filepath,
+                                    int (*callback)(size_t),
+                                    void **buffer, size_t *buflen);
+EXTERN int firmware_local_file_write(const char *filepath,
+                                     int (*callback)(size_t),
+                                     void *buffer, size_t buflen);
+EXTERN int firmware_local_file_delete(const char *filepath);
 EXTERN int firmware_file_exec(const char *filepath, const char *options);
 
 /*
@@ -186,18 +196,57 @@ tpm_get_event_log(tpm_event_log_t *log)
 EXTERN int tpm_get_event_log(tpm_event_log_t *log);
 #endif
 
+/*
+ * Hash algorithms of the TPM PCR banks that can be extended with digests
+ * computed by the boot loader, see tpm_set_hash_provider().
+ */
+typedef enum {
+   TPM_HASH_SHA1,
+   TPM_HASH_SHA256,
+   TPM_HASH_SHA384,
+   TPM_HASH_SHA512,
+   TPM_HASH_COUNT
+} tpm_hash_alg_t;
+
+#define TPM_DIGEST_MAX_SIZE 64
+
+typedef struct {
+   uint32_t algs;             /* Bitmap of the (1 << tpm_hash_alg_t) digests
+                                 computed below */
+   uint8_t digest[TPM_HASH_COUNT][TPM_DIGEST_MAX_SIZE];
+} tpm_digests_t;
+
+/*
+ * Compute the digests of data for every algorithm in the algs bitmap.
+ * Returns ERR_UNSUPPORTED if any of them is not implemented.
+ */
+typedef int (*tpm_hash_provider_t)(uint32_t algs, const void *data,
+                                   size_t size, tpm_digests_t *digests);
+
+#ifdef __COM32__
+static INLINE void
+tpm_set_hash_provider(tpm_hash_provider_t hash)
+{
+   (void)hash;
+}
+#else
+EXTERN void tpm_set_hash_provider(tpm_hash_provider_t hash);
+#endif
+
 #ifdef __COM32__
 static INLINE int
-tpm_extend_module(const char *filename, const void *addr, size_t size)
+tpm_extend_module(const char *filename, const void *addr, size_t size,
+                  tpm_digests_t *digests)
 {
    (void)filename;
    (void)addr;
    (void)size;
+   (void)digests;
    return ERR_SUCCESS; // No-op
 }
 #else
 EXTERN int tpm_extend_module(const char *filename, const void *addr,
-                             size_t size);
+                             size_t size, tpm_digests_t *digests);
 #endif
 
 #ifdef __COM32__
@@ -235,6 +284,23 @@ tpm_extend_asset_tag(void)
 EXTERN int tpm_extend_asset_tag(void);
 #endif
 
+#ifdef __COM32__
+static INLINE bool
+tpm_poll(void)
+{
+   return false;
+}
+
+static INLINE int
+tpm_flush(void)
+{
+   return ERR_SUCCESS; // No-op
+}
+#else
+EXTERN bool tpm_poll(void);
+EXTERN int tpm_flush(void);
+#endif
+
 /*
  * runtime_watchdog.c
  */
@@ -351,8 +417,10 @@ typedef enum {
 #ifdef __COM32__
 #   define set_http_criteria(mode)
 #   define tftp_set_block_size(size)
+#   define set_http_recv_size(size)
 #else
 EXTERN void set_http_criteria(http_criteria_t mode);
+EXTERN void set_http_recv_size(size_t size);
 EXTERN void tftp_set_block_size(size_t blksize);
 #endif
 
@@ -142,6 +142,10 @@ EXTERN int delete_char(char *str, size_t n);
 EXTERN bool is_gzip(const void *buffer, size_t size, int *status);
 EXTERN int gzip_extract(const void *src, size_t src_size, void **dest,
                         size_t *dest_size);
+EXTERN int gzip_extract_stream(const void *src, size_t src_size, void **dest,
+                               size_t *dest_size,
+                               void (*consume)(const void *, size_t, void *),
+                               void *arg);
 
 /*
  * file.c
@@ -152,10 +156,14 @@ EXTERN int file_get_size_hint(int volid, const char *filename,
                               size_t *filesize);
 EXTERN int file_load(int volid, const char *filename, int (*callback)(size_t),
                      void **buffer, size_t *bufsize);
+EXTERN int file_prefetch(int volid, const char *filename);
+EXTERN int file_get_etag(int volid, const char *filename, char **etag);
+EXTERN int file_check_etag(int volid, const char *filename, const char *etag);
 EXTERN int file_save(int volid, const char *filename, int (*callback)(size_t),
                      void *buffer, size_t bufsize);
 EXTERN int file_overwrite(int volid, const char *filepath, void *buffer,
                           size_t size);
+EXTERN int file_delete(int volid, const char *filename);
 EXTERN int file_sanitize_path(char *filepath);
 
 /*
@@ -167,6 +175,7 @@ EXTERN int get_mac_address(const char **mac);
  * volume.c
  */
 #define FIRMWARE_BOOT_VOLUME 0
+#define FIRMWARE_LOCAL_VOLUME (-1)  /* EFI System Partition file system */
 EXTERN int get_max_volume(disk_t *disk, int *max);
 EXTERN int get_volume_info(disk_t *disk, int part_id, partition_t *partition);
 EXTERN int volume_read(disk_t *disk, partition_t *partition,
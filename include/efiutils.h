@@ -148,6 +148,7 @@ EXTERN void log_handle_devpath(int level, const char *prefix,
  * volume.c
  */
 EXTERN EFI_STATUS get_boot_volume(EFI_HANDLE *Volume);
+EXTERN EFI_STATUS get_local_volume(EFI_HANDLE *Volume);
 EXTERN EFI_STATUS get_boot_device(EFI_HANDLE *device);
 
 /*
@@ -158,6 +159,13 @@ EXTERN VOID *efi_calloc(UINTN nmemb, UINTN size);
 EXTERN VOID *efi_realloc(VOID *ptr, UINTN oldsize, UINTN newsize);
 EXTERN VOID efi_free(VOID *ptr);
 
+/*
+ * mp.c
+ */
+typedef void (*mp_job_t)(void *arg, unsigned int index);
+
+EXTERN unsigned int mp_run_jobs(mp_job_t job, void *arg, unsigned int count);
+
 /*
  * simplefile.c
  */
@@ -169,6 +177,8 @@ EXTERN EFI_STATUS simple_file_load(EFI_HANDLE Volume, const char *filepath,
 EXTERN EFI_STATUS simple_file_save(EFI_HANDLE Volume, const char *filepath,
                                    int (*callback)(size_t), VOID *Buffer,
                                    UINTN BufSize);
+EXTERN EFI_STATUS simple_file_delete(EFI_HANDLE Volume, const char *filepath);
+EXTERN EFI_STATUS simple_file_mkdir(EFI_HANDLE Volume, const char *dirpath);
 
 /*
  * gpxefile.c
@@ -199,6 +209,11 @@ EXTERN EFI_STATUS http_file_load(EFI_HANDLE Volume, const char *filepath,
                                  UINTN *BufSize);
 EXTERN EFI_STATUS http_file_get_size(EFI_HANDLE Volume, const char *filepath,
                                      UINTN *FileSize);
+EXTERN EFI_STATUS http_file_prefetch(EFI_HANDLE Volume, const char *filepath);
+EXTERN EFI_STATUS http_file_get_etag(EFI_HANDLE Volume, const char *filepath,
+                                     char **etag);
+EXTERN EFI_STATUS http_file_check_etag(EFI_HANDLE Volume, const char *filepath,
+                                       const char *etag);
 EXTERN void http_cleanup(void);
 
 /*
@@ -232,6 +247,7 @@ EXTERN bool is_pxe_boot(EFI_PXE_BASE_CODE **Pxe);
 EXTERN EFI_STATUS filepath_unix_to_efi(const char *unix_path,
                                        CHAR16 **uefi_path);
 EXTERN bool last_file_read_via_http(void);
+EXTERN void file_access_reset(void);
 EXTERN int firmware_image_load(const char *filepath, const char *options,
                                void *image, size_t imgsize,
                                EFI_HANDLE *ChildHandle);
@@ -18,6 +18,11 @@ typedef struct uart_t {
    uint32_t baudrate;
    io_channel_t io;
    void (*putc)(const struct uart_t *dev, char c);
+   /*
+    * Optional: write a buffer, filling the TX FIFO in bursts.
+    */
+   void (*write)(const struct uart_t *dev, const char *buf, size_t len);
+   unsigned int tx_fifo_size; /* Bytes that fit in an empty TX FIFO */
    serial_type_t type;
    /*
     * uart_putc should not be used until firmware is quiesced.
@@ -28,6 +33,7 @@ typedef struct uart_t {
 
 int  uart_init(const uart_t *dev);
 void uart_putc(const uart_t *dev, char c);
+void uart_write(const uart_t *dev, const char *buf, size_t len);
 uint32_t uart_flags(const uart_t *dev);
 
 #endif /* !UART_H_ */
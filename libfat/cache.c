@@ -28,12 +28,15 @@ void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n)
 {
     struct libfat_sector *ls;
 
+    fs->cache_lookups++;
+
     for (ls = fs->sectors; ls; ls = ls->next) {
 	if (ls->n == n)
 	    return ls->data;	/* Found in cache */
     }
 
     /* Not found in cache */
+    fs->cache_misses++;
     ls = malloc(sizeof(struct libfat_sector));
     if (!ls) {
 	libfat_flush(fs);
@@ -72,6 +75,7 @@ void libfat_flush(struct libfat_filesystem *fs)
 
     for (ls = lsnext; ls; ls = lsnext) {
 	lsnext = ls->next;
+	free(ls->data);
 	free(ls);
     }
 }
@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * dirindex.c
+ *
+ * In-memory index of a FAT directory.  The directory is scanned once,
+ * and both the short (8.3) names and the VFAT long names of its entries
+ * are hashed, so that subsequent lookups do not need any disk I/O.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "libfatint.h"
+
+#define DIRINDEX_BUCKETS	256	/* Must be a power of two */
+
+#define ATTR_VOLUME_ID		0x08
+#define ATTR_VFAT		0x0f
+
+#define VFAT_LAST_SLOT		0x40
+#define VFAT_SEQ_MASK		0x1f
+#define VFAT_CHARS_PER_SLOT	13
+#define VFAT_NAME_MAX		255
+
+#define DELETED_ENTRY		0xe5
+
+struct dirindex_entry {
+    struct dirindex_entry *next;	/* All entries, for freeing */
+    struct dirindex_entry *short_next;	/* Short name hash chain */
+    struct dirindex_entry *long_next;	/* Long name hash chain */
+    char *long_name;			/* Upper-cased, or NULL */
+    struct libfat_direntry direntry;
+};
+
+struct libfat_dirindex {
+    struct dirindex_entry *entries;
+    struct dirindex_entry *short_hash[DIRINDEX_BUCKETS];
+    struct dirindex_entry *long_hash[DIRINDEX_BUCKETS];
+};
+
+/* VFAT long name being assembled from continuation slots */
+struct vfat_name {
+    int slots;			/* Slots still expected, or -1 if invalid */
+    uint8_t csum;		/* Short name checksum of the whole sequence */
+    char name[VFAT_NAME_MAX + 1];
+};
+
+/* FNV-1a, on upper-cased characters */
+static unsigned int dirindex_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    while (len-- > 0) {
+	h ^= (uint8_t) toupper(*s++);
+	h *= 16777619u;
+    }
+
+    return h & (DIRINDEX_BUCKETS - 1);
+}
+
+static uint8_t shortname_csum(const uint8_t *name)
+{
+    uint8_t csum = 0;
+    int i;
+
+    for (i = 0; i < 11; i++)
+	csum = ((csum & 1) << 7) + (csum >> 1) + name[i];
+
+    return csum;
+}
+
+static int32_t direntry_cluster(struct libfat_direntry *direntry)
+{
+    struct fat_dirent *dep = (struct fat_dirent *)direntry->entry;
+
+    if (read32(&dep->size) == 0)
+	return 0;		/* An empty file has no clusters */
+
+    return read16(&dep->clustlo) + (read16(&dep->clusthi) << 16);
+}
+
+static void vfat_put_chars(struct vfat_name *lfn, int pos, le16_t *src,
+			   int count)
+{
+    uint16_t c;
+
+    for (; count > 0; count--, pos++, src++) {
+	c = read16(src);
+	if (c == 0x0000 || c == 0xffff)
+	    c = '\0';
+	else if (c > 0x7f)
+	    c = '?';		/* Only ASCII names can be looked up */
+	lfn->name[pos] = (char)toupper(c);
+    }
+}
+
+/*
+ * Accumulate a VFAT continuation slot.  Slots are stored in reverse
+ * order, the first one on disk carrying the VFAT_LAST_SLOT flag.
+ */
+static void vfat_add_slot(struct vfat_name *lfn, struct fat_vfat_slot *slot)
+{
+    int seq = read8(&slot->id) & VFAT_SEQ_MASK;
+    int pos;
+
+    if (read8(&slot->id) & VFAT_LAST_SLOT) {
+	if (seq == 0 || seq * VFAT_CHARS_PER_SLOT > VFAT_NAME_MAX + 1) {
+	    lfn->slots = -1;
+	    return;
+	}
+	memset(lfn->name, 0, sizeof(lfn->name));
+	lfn->slots = seq;
+	lfn->csum = read8(&slot->alias_csum);
+    } else if (lfn->slots != seq || lfn->csum != read8(&slot->alias_csum)) {
+	lfn->slots = -1;
+	return;
+    }
+
+    pos = (seq - 1) * VFAT_CHARS_PER_SLOT;
+    vfat_put_chars(lfn, pos, slot->name0, 5);
+    vfat_put_chars(lfn, pos + 5, slot->name5, 6);
+    vfat_put_chars(lfn, pos + 11, slot->name11, 2);
+
+    lfn->slots--;
+}
+
+static int dirindex_insert(struct libfat_dirindex *di,
+			   struct fat_dirent *dep, const char *long_name,
+			   libfat_sector_t s, int offset)
+{
+    struct dirindex_entry *e;
+    unsigned int h;
+
+    e = malloc(sizeof(struct dirindex_entry));
+    if (!e)
+	return -1;
+
+    memcpy(e->direntry.entry, dep, sizeof(*dep));
+    e->direntry.sector = s;
+    e->direntry.offset = offset;
+    e->long_name = NULL;
+    e->short_next = NULL;
+    e->long_next = NULL;
+
+    e->next = di->entries;
+    di->entries = e;
+
+    /* Keep the first of any duplicate names, as libfat_searchdir() does */
+    if (libfat_dirindex_lookup(di, NULL, dep->name, NULL) == -2) {
+	h = dirindex_hash((const char *)dep->name, 11);
+	e->short_next = di->short_hash[h];
+	di->short_hash[h] = e;
+    }
+
+    if (long_name && long_name[0] != '\0' &&
+	libfat_dirindex_lookup(di, long_name, NULL, NULL) == -2) {
+	e->long_name = strdup(long_name);
+	if (!e->long_name)
+	    return -1;
+	h = dirindex_hash(long_name, strlen(long_name));
+	e->long_next = di->long_hash[h];
+	di->long_hash[h] = e;
+    }
+
+    return 0;
+}
+
+struct libfat_dirindex *libfat_dirindex_build(struct libfat_filesystem *fs,
+					      int32_t dirclust)
+{
+    struct libfat_dirindex *di;
+    struct fat_dirent *dep;
+    struct vfat_name lfn;
+    uint32_t nent;
+    uint8_t attr;
+    const char *long_name;
+
+    libfat_sector_t s = libfat_clustertosector(fs, dirclust);
+
+    di = malloc(sizeof(struct libfat_dirindex));
+    if (!di)
+	return NULL;
+    memset(di, 0, sizeof(*di));
+
+    lfn.slots = -1;
+
+    while (1) {
+	if (s == 0)
+	    return di;		/* End of directory */
+	else if (s == (libfat_sector_t) - 1)
+	    goto barf;		/* Error */
+
+	dep = libfat_get_sector(fs, s);
+	if (!dep)
+	    goto barf;		/* Read error */
+
+	for (nent = 0; nent < fs->bytes_per_sector;
+	     nent += sizeof(struct fat_dirent), dep++) {
+	    if (dep->name[0] == 0)
+		return di;	/* Hit high water mark */
+
+	    attr = read8(&dep->attribute);
+
+	    if (dep->name[0] == DELETED_ENTRY) {
+		lfn.slots = -1;
+		continue;
+	    }
+
+	    if (attr == ATTR_VFAT) {
+		vfat_add_slot(&lfn, (struct fat_vfat_slot *)dep);
+		continue;
+	    }
+
+	    long_name = NULL;
+	    if (lfn.slots == 0 && lfn.csum == shortname_csum(dep->name))
+		long_name = lfn.name;
+	    lfn.slots = -1;
+
+	    if (attr & ATTR_VOLUME_ID)
+		continue;
+
+	    if (dirindex_insert(di, dep, long_name, s, nent) != 0)
+		goto barf;
+	}
+
+	s = libfat_nextsector(fs, s);
+    }
+
+barf:
+    libfat_dirindex_free(di);
+    return NULL;
+}
+
+void libfat_dirindex_free(struct libfat_dirindex *di)
+{
+    struct dirindex_entry *e, *enext;
+
+    if (!di)
+	return;
+
+    for (e = di->entries; e; e = enext) {
+	enext = e->next;
+	free(e->long_name);
+	free(e);
+    }
+
+    free(di);
+}
+
+int32_t libfat_dirindex_lookup(const struct libfat_dirindex *di,
+			       const char *name, const void *shortname,
+			       struct libfat_direntry *direntry)
+{
+    struct dirindex_entry *e = NULL;
+    unsigned int h;
+    size_t i, len;
+
+    if (shortname) {
+	h = dirindex_hash(shortname, 11);
+	for (e = di->short_hash[h]; e; e = e->short_next) {
+	    if (!memcmp(e->direntry.entry, shortname, 11))
+		break;
+	}
+    }
+
+    if (!e && name) {
+	len = strlen(name);
+	h = dirindex_hash(name, len);
+	for (e = di->long_hash[h]; e; e = e->long_next) {
+	    if (strlen(e->long_name) != len)
+		continue;
+	    for (i = 0; i < len; i++) {
+		if (toupper(name[i]) != e->long_name[i])
+		    break;
+	    }
+	    if (i == len)
+		break;
+	}
+    }
+
+    if (!e)
+	return -2;		/* Not found */
+
+    if (direntry)
+	memcpy(direntry, &e->direntry, sizeof(*direntry));
+
+    return direntry_cluster(&e->direntry);
+}
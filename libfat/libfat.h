@@ -87,4 +87,25 @@ void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n);
 int32_t libfat_searchdir(struct libfat_filesystem *fs, int32_t dirclust,
 			 const void *name, struct libfat_direntry *direntry);
 
+/*
+ * Build an in-memory index of a FAT directory, mapping both the short
+ * names and the VFAT long names of its entries to their directory
+ * entries.  Returns NULL on failure.
+ */
+struct libfat_dirindex;
+
+struct libfat_dirindex *libfat_dirindex_build(struct libfat_filesystem *fs,
+					      int32_t dirclust);
+
+void libfat_dirindex_free(struct libfat_dirindex *di);
+
+/*
+ * Search a directory index for a pre-mangled short name and/or a long
+ * name (case insensitive); either may be NULL.  The short name has
+ * precedence.  Same return values as libfat_searchdir().
+ */
+int32_t libfat_dirindex_lookup(const struct libfat_dirindex *di,
+			       const char *name, const void *shortname,
+			       struct libfat_direntry *direntry);
+
 #endif /* LIBFAT_H */
@@ -56,6 +56,10 @@ struct libfat_filesystem {
     libfat_sector_t end;	/* End of filesystem */
 
     struct libfat_sector *sectors;
+
+    /* Sector cache statistics */
+    uint32_t cache_lookups;
+    uint32_t cache_misses;
 };
 
 #endif /* LIBFATINT_H */
@@ -41,6 +41,8 @@ libfat_open(int (*readfunc) (intptr_t, void *, size_t, libfat_sector_t),
 	goto barf;
 
     fs->sectors = NULL;
+    fs->cache_lookups = 0;
+    fs->cache_misses = 0;
     fs->read = readfunc;
     fs->readptr = readptr;
     fs->bytes_per_sector = bytes_per_sector;
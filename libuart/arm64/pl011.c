@@ -62,6 +62,44 @@ static void pl011_putc(const uart_t *dev, char c)
    }
 }
 
+/*-- pl011_write_buf -----------------------------------------------------------
+ *
+ *      Write a buffer on a serial port.  When the TX FIFO is empty, it is
+ *      refilled with a burst of characters after a single FR read; otherwise
+ *      characters are written one at a time while the FIFO is not full.
+ *
+ * Parameters
+ *      IN dev: pointer to a UART descriptor
+ *      IN buf: characters to be written
+ *      IN len: number of characters
+ *----------------------------------------------------------------------------*/
+static void pl011_write_buf(const uart_t *dev, const char *buf, size_t len)
+{
+   uint16_t timeout;
+   uint32_t fr;
+   size_t burst;
+
+   timeout = 0xffff;
+   while (len > 0) {
+      fr = pl011_read(dev, PL011_FR);
+      if ((fr & PL011_FR_TXFE) != 0) {
+         burst = MIN(len, dev->tx_fifo_size);
+      } else if ((fr & PL011_FR_TXFF) == 0) {
+         burst = 1;
+      } else if (--timeout == 0) {
+         return;
+      } else {
+         continue;
+      }
+
+      len -= burst;
+      while (burst-- > 0) {
+         pl011_write(dev, PL011_DR, *buf++);
+      }
+      timeout = 0xffff;
+   }
+}
+
 /*-- pl011_init --------------------------------------------------------------
  *
  *      Initialize a UART device with the given baudrate.
@@ -91,6 +129,9 @@ int pl011_init(uart_t *dev)
       return ERR_UNSUPPORTED;
    }
 
+   dev->tx_fifo_size = ((pl011_read(dev, PL011_LCRH) & PL011_LCRH_FEN) != 0) ?
+                       PL011_TX_FIFO_SIZE : 1;
    dev->putc = pl011_putc;
+   dev->write = pl011_write_buf;
    return ERR_SUCCESS;
 }
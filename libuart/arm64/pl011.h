@@ -36,6 +36,8 @@
 #define PL011_FR_BUSY              0x08
 #define PL011_FR_TMSK              (PL011_FR_TXFF + PL011_FR_BUSY)
 
+#define PL011_TX_FIFO_SIZE         16   /* Up to r1p4; r1p5 has 32 entries */
+
 #define PL011_IS_OE                (1 << 10)
 #define PL011_IS_BE                (1 << 9)
 #define PL011_IS_PE                (1 << 8)
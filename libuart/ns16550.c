@@ -62,6 +62,43 @@ static void ns16550_putc(const uart_t *dev, char c)
    }
 }
 
+/*-- ns16550_write_buf ---------------------------------------------------------
+ *
+ *      Write a buffer on a serial port.  Once THRE is set the whole TX FIFO
+ *      is empty, so it is refilled with a burst of characters after a single
+ *      LSR read.  If THRE does not get set in time, that burst is dropped,
+ *      as ns16550_putc drops a character.
+ *
+ * Parameters
+ *      IN dev: pointer to a UART descriptor
+ *      IN buf: characters to be written
+ *      IN len: number of characters
+ *----------------------------------------------------------------------------*/
+static void ns16550_write_buf(const uart_t *dev, const char *buf, size_t len)
+{
+   uint16_t timeout;
+   size_t burst;
+
+   while (len > 0) {
+      for (timeout = 0xffff; timeout > 0; timeout--) {
+         if ((ns16550_read(dev, NS16550_LSR) & NS16550_LSR_THRE) != 0) {
+            break;
+         }
+      }
+
+      burst = MIN(len, dev->tx_fifo_size);
+      len -= burst;
+      if (timeout == 0) {
+         buf += burst;
+         continue;
+      }
+
+      while (burst-- > 0) {
+         ns16550_write(dev, NS16550_TX, *buf++);
+      }
+   }
+}
+
 /*-- ns16550_init --------------------------------------------------------------
  *
  *      Initialize a UART device with the given baudrate.
@@ -130,13 +167,20 @@ int ns16550_init(uart_t *dev)
    }
 #endif
 
-   /* Try to enable the FIFO (trigger on 1 bytes) */
+   /*
+    * Try to enable the FIFO (trigger on 1 bytes).  FCR is write-only: the
+    * same offset reads back IIR, whose top two bits are both set once the
+    * FIFO is enabled (16550A and later).
+    */
    ns16550_write(dev, NS16550_FCR, NS16550_FCR_ENABLE_FIFO);
-   c = ns16550_read(dev, NS16550_FCR);
-   if (c == NS16550_FCR_ENABLE_FIFO) {
-      c |= NS16550_FCR_CLEAR_RCVR | NS16550_FCR_CLEAR_XMIT | NS16550_FCR_TRIGGER_1;
+   c = ns16550_read(dev, NS16550_IIR);
+   if ((c & NS16550_IIR_FIFO_MASK) == NS16550_IIR_FIFO_MASK) {
+      c = NS16550_FCR_ENABLE_FIFO | NS16550_FCR_CLEAR_RCVR |
+          NS16550_FCR_CLEAR_XMIT | NS16550_FCR_TRIGGER_1;
+      dev->tx_fifo_size = NS16550_TX_FIFO_SIZE;
    } else {
       c = 0;
+      dev->tx_fifo_size = 1;
    }
    ns16550_write(dev, NS16550_FCR, c);
 
@@ -144,5 +188,6 @@ int ns16550_init(uart_t *dev)
    c = ns16550_read(dev, NS16550_LSR);
 
    dev->putc = ns16550_putc;
+   dev->write = ns16550_write_buf;
    return ERR_SUCCESS;
 }
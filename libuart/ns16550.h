@@ -15,6 +15,7 @@
 #define NS16550_DLL              0         /* Out: Divisor Latch Low (DLAB=1) */
 #define NS16550_DLM              1         /* Out: Divisor Latch High (DLAB=1) */
 #define NS16550_IER              1         /* Out: Interrupt Enable Register */
+#define NS16550_IIR              2         /* In:  Interrupt ID Register */
 #define NS16550_FCR              2         /* Out: FIFO Control Register */
 #define NS16550_LCR              3         /* Out: Line Control Register */
 #define NS16550_MCR              4         /* Out: Modem Control Register */
@@ -26,6 +27,8 @@
 #define NS16550_FCR_CLEAR_XMIT   (1 << 2)  /* Clear the XMIT FIFO */
 #define NS16550_FCR_TRIGGER_1    0x00      /* Mask for trigger set at 1 */
 
+#define NS16550_IIR_FIFO_MASK    0xc0      /* Both set: FIFO enabled */
+
 #define NS16550_LCR_WLEN8        0x03      /* Word length: 8 bits */
 #define NS16550_LCR_SBC          (1 << 6)  /* Set break control */
 #define NS16550_LCR_DLAB         (1 << 7)  /* Divisor latch access bit */
@@ -39,4 +42,6 @@
 
 #define NS16550_LSR_THRE         (1 << 5)  /* Transmit-hold-register empty */
 
+#define NS16550_TX_FIFO_SIZE     16        /* 16550A transmit FIFO depth */
+
 #endif /* NS16550_H */
@@ -26,6 +26,28 @@ void uart_putc(const uart_t *dev, char c)
   }
 }
 
+/*-- uart_write ----------------------------------------------------------------
+ *
+ *      Write a buffer on a serial port.  UARTs that know the depth of their
+ *      TX FIFO fill it in bursts, instead of polling before every character.
+ *
+ * Parameters
+ *      IN dev: pointer to a UART descriptor
+ *      IN buf: characters to be written
+ *      IN len: number of characters
+ *----------------------------------------------------------------------------*/
+void uart_write(const uart_t *dev, const char *buf, size_t len)
+{
+   if (dev->write != NULL) {
+      dev->write(dev, buf, len);
+      return;
+   }
+
+   while (len-- > 0) {
+      uart_putc(dev, *buf++);
+   }
+}
+
 /*-- uart_flags ----------------------------------------------------------------
  *
  *      Return UART flags to be used by upper layers.
@@ -2032,6 +2032,28 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A,
 
     MBEDTLS_MPI_CHK( mpi_montmul( &W[1], &RR, N, mm, &T ) );
 
+    /*
+     * VMware note: RSA public exponents are nearly always of the form
+     * E = 2^k + 1 (65537, or 3 for older keys).  X = W[1]^(2^k) * W[1]
+     * then takes k squarings and one multiplication, with no window
+     * bookkeeping and no initial X = R mod N reduction.
+     */
+    i = mbedtls_mpi_bitlen( E );
+    if( i > 1 && i <= biL && ( E->p[0] & 1 ) != 0 &&
+        ( ( E->p[0] - 1 ) & ( E->p[0] - 2 ) ) == 0 )
+    {
+        j = i - 1;
+
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &W[1] ) );
+
+        for( i = 0; i < j; i++ )
+            MBEDTLS_MPI_CHK( mpi_montmul( X, X, N, mm, &T ) );
+
+        MBEDTLS_MPI_CHK( mpi_montmul( X, &W[1], N, mm, &T ) );
+
+        goto reduce;
+    }
+
     /*
      * X = R^2 * R^-1 mod N = R mod N
      */
@@ -2140,6 +2162,7 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A,
             MBEDTLS_MPI_CHK( mpi_montmul( X, &W[1], N, mm, &T ) );
     }
 
+reduce:
     /*
      * X = A^E * R * R^-1 mod N = A^E mod N
      */
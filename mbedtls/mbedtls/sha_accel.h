@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * sha_accel.h -- CPU-specific SHA-256/SHA-512 block functions
+ *
+ *      VMware note: not part of mbed TLS. sha256.c and sha512.c hand all
+ *      whole blocks to sha_accel_sha256()/sha_accel_sha512(), which run
+ *      them through the fastest backend the CPU supports. Callers of the
+ *      regular mbed TLS API get the acceleration transparently.
+ */
+
+#ifndef MBEDTLS_SHA_ACCEL_H
+#define MBEDTLS_SHA_ACCEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sha256.h"
+#include "sha512.h"
+
+typedef enum {
+   SHA_BACKEND_GENERIC,    /* Portable mbed TLS code (always available). */
+   SHA_BACKEND_SHANI,      /* x86 SHA extensions (SHA-256 only). */
+   SHA_BACKEND_ARMV8,      /* ARMv8 SHA2 and ARMv8.2 SHA512 instructions. */
+   SHA_BACKEND_COUNT
+} sha_backend_t;
+
+typedef enum {
+   SHA_ACCEL_SHA256,
+   SHA_ACCEL_SHA512
+} sha_accel_alg_t;
+
+void sha_accel_init(void);
+bool sha_accel_supported(sha_accel_alg_t alg, sha_backend_t backend);
+bool sha_accel_select(sha_accel_alg_t alg, sha_backend_t backend);
+sha_backend_t sha_accel_selected(sha_accel_alg_t alg);
+sha_backend_t sha_accel_best(sha_accel_alg_t alg);
+const char *sha_accel_name(sha_backend_t backend);
+
+int sha_accel_sha256(mbedtls_sha256_context *ctx, const unsigned char *data,
+                     size_t blocks);
+int sha_accel_sha512(mbedtls_sha512_context *ctx, const unsigned char *data,
+                     size_t blocks);
+
+/*
+ * The portable block functions, renamed from
+ * mbedtls_internal_sha{256,512}_process().
+ */
+int mbedtls_sha256_process_generic(mbedtls_sha256_context *ctx,
+                                   const unsigned char data[64]);
+int mbedtls_sha512_process_generic(mbedtls_sha512_context *ctx,
+                                   const unsigned char data[128]);
+
+#endif /* !MBEDTLS_SHA_ACCEL_H */
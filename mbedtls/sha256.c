@@ -35,6 +35,7 @@
 #if defined(MBEDTLS_SHA256_C)
 
 #include "mbedtls/sha256.h"
+#include "mbedtls/sha_accel.h"
 #include "mbedtls/platform_util.h"
 
 #include <string.h>
@@ -200,7 +201,11 @@ static const uint32_t K[] =
         (d) += temp1; (h) = temp1 + temp2;              \
     } while( 0 )
 
-int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
+/*
+ * VMware note: this is the portable block function. The mbed TLS entry
+ * point below dispatches to it or to a CPU-specific one (sha_accel.c).
+ */
+int mbedtls_sha256_process_generic( mbedtls_sha256_context *ctx,
                                 const unsigned char data[64] )
 {
     uint32_t temp1, temp2, W[64];
@@ -261,6 +266,12 @@ int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
     return( 0 );
 }
 
+int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
+                                const unsigned char data[64] )
+{
+    return( sha_accel_sha256( ctx, data, 1 ) );
+}
+
 #if !defined(MBEDTLS_DEPRECATED_REMOVED)
 void mbedtls_sha256_process( mbedtls_sha256_context *ctx,
                              const unsigned char data[64] )
@@ -308,13 +319,19 @@ int mbedtls_sha256_update_ret( mbedtls_sha256_context *ctx,
         left = 0;
     }
 
-    while( ilen >= 64 )
+    /*
+     * VMware note: hand all whole blocks over at once, so that the
+     * accelerated backends can keep their state in registers.
+     */
+    if( ilen >= 64 )
     {
-        if( ( ret = mbedtls_internal_sha256_process( ctx, input ) ) != 0 )
+        size_t blocks = ilen / 64;
+
+        if( ( ret = sha_accel_sha256( ctx, input, blocks ) ) != 0 )
             return( ret );
 
-        input += 64;
-        ilen  -= 64;
+        input += blocks * 64;
+        ilen  -= blocks * 64;
     }
 
     if( ilen > 0 )
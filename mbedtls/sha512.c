@@ -35,6 +35,7 @@
 #if defined(MBEDTLS_SHA512_C)
 
 #include "mbedtls/sha512.h"
+#include "mbedtls/sha_accel.h"
 #include "mbedtls/platform_util.h"
 
 #if defined(_MSC_VER) || defined(__WATCOMC__)
@@ -216,7 +217,11 @@ static const uint64_t K[80] =
     UL64(0x5FCB6FAB3AD6FAEC),  UL64(0x6C44198C4A475817)
 };
 
-int mbedtls_internal_sha512_process( mbedtls_sha512_context *ctx,
+/*
+ * VMware note: this is the portable block function. The mbed TLS entry
+ * point below dispatches to it or to a CPU-specific one (sha_accel.c).
+ */
+int mbedtls_sha512_process_generic( mbedtls_sha512_context *ctx,
                                      const unsigned char data[128] )
 {
     int i;
@@ -292,6 +297,12 @@ int mbedtls_internal_sha512_process( mbedtls_sha512_context *ctx,
     return( 0 );
 }
 
+int mbedtls_internal_sha512_process( mbedtls_sha512_context *ctx,
+                                     const unsigned char data[128] )
+{
+    return( sha_accel_sha512( ctx, data, 1 ) );
+}
+
 #if !defined(MBEDTLS_DEPRECATED_REMOVED)
 void mbedtls_sha512_process( mbedtls_sha512_context *ctx,
                              const unsigned char data[128] )
@@ -338,13 +349,19 @@ int mbedtls_sha512_update_ret( mbedtls_sha512_context *ctx,
         left = 0;
     }
 
-    while( ilen >= 128 )
+    /*
+     * VMware note: hand all whole blocks over at once, so that the
+     * accelerated backends can keep their state in registers.
+     */
+    if( ilen >= 128 )
     {
-        if( ( ret = mbedtls_internal_sha512_process( ctx, input ) ) != 0 )
+        size_t blocks = ilen / 128;
+
+        if( ( ret = sha_accel_sha512( ctx, input, blocks ) ) != 0 )
             return( ret );
 
-        input += 128;
-        ilen  -= 128;
+        input += blocks * 128;
+        ilen  -= blocks * 128;
     }
 
     if( ilen > 0 )
@@ -0,0 +1,396 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * sha_accel.c -- SHA-256/SHA-512 backend selection
+ *
+ *      VMware note: not part of mbed TLS. The block functions in sha256.c and
+ *      sha512.c are routed through here so that the CPU's SHA instructions are
+ *      used when available. The instruction-based backends live in
+ *      $(IARCH)/sha_accel.S and preserve the SIMD registers they use, since
+ *      the rest of the loader is built without them.
+ *
+ *      Backends are detected once, from CPUID on x86 and ID_AA64ISAR0_EL1 on
+ *      AArch64, and each one is checked against the portable code before it
+ *      can be selected.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "mbedtls/sha_accel.h"
+
+#if defined(only_em64t) || defined(only_arm64)
+#include <cpu.h>
+#endif
+
+#define SHA256_BLOCK_SIZE  64
+#define SHA512_BLOCK_SIZE  128
+#define SELF_TEST_BLOCKS   2
+
+#if defined(only_em64t)
+#define CPUID1_ECX_SSSE3   (1 << 9)
+#define CPUID1_ECX_SSE41   (1 << 19)
+#define CPUID7_EBX_SHA     (1 << 29)
+
+void sha256_blocks_shani(uint32_t state[8], const unsigned char *data,
+                         size_t blocks);
+#endif
+
+#if defined(only_arm64)
+#define ID_AA64ISAR0_SHA2_SHIFT    12
+#define ID_AA64ISAR0_SHA2_MASK     0xf
+#define ID_AA64ISAR0_SHA2_SHA256   1
+#define ID_AA64ISAR0_SHA2_SHA512   2
+
+void sha256_blocks_armv8(uint32_t state[8], const unsigned char *data,
+                         size_t blocks);
+void sha512_blocks_armv8(uint64_t state[8], const unsigned char *data,
+                         size_t blocks);
+#endif
+
+static bool initialized = false;
+static unsigned int supported[2];
+static sha_backend_t selected[2];
+
+static const char *backend_names[SHA_BACKEND_COUNT] = {
+   "generic",
+   "sha-ni",
+   "armv8"
+};
+
+/*-- sha256_blocks -------------------------------------------------------------
+ *
+ *      Run the SHA-256 compression function of the given backend.
+ *
+ * Parameters
+ *      IN backend: the backend to use
+ *      IN ctx:     the SHA-256 context
+ *      IN data:    the input blocks
+ *      IN blocks:  number of 64-byte blocks to process
+ *
+ * Results
+ *      0 on success, or a negative mbed TLS error code.
+ *----------------------------------------------------------------------------*/
+static int sha256_blocks(sha_backend_t backend, mbedtls_sha256_context *ctx,
+                         const unsigned char *data, size_t blocks)
+{
+   int ret;
+
+   switch (backend) {
+#if defined(only_em64t)
+      case SHA_BACKEND_SHANI:
+         sha256_blocks_shani(ctx->state, data, blocks);
+         return 0;
+#endif
+#if defined(only_arm64)
+      case SHA_BACKEND_ARMV8:
+         sha256_blocks_armv8(ctx->state, data, blocks);
+         return 0;
+#endif
+      default:
+         for (; blocks > 0; blocks--, data += SHA256_BLOCK_SIZE) {
+            ret = mbedtls_sha256_process_generic(ctx, data);
+            if (ret != 0) {
+               return ret;
+            }
+         }
+         return 0;
+   }
+}
+
+/*-- sha512_blocks -------------------------------------------------------------
+ *
+ *      Run the SHA-512 compression function of the given backend.
+ *
+ * Parameters
+ *      IN backend: the backend to use
+ *      IN ctx:     the SHA-512 context
+ *      IN data:    the input blocks
+ *      IN blocks:  number of 128-byte blocks to process
+ *
+ * Results
+ *      0 on success, or a negative mbed TLS error code.
+ *----------------------------------------------------------------------------*/
+static int sha512_blocks(sha_backend_t backend, mbedtls_sha512_context *ctx,
+                         const unsigned char *data, size_t blocks)
+{
+   int ret;
+
+   switch (backend) {
+#if defined(only_arm64)
+      case SHA_BACKEND_ARMV8:
+         sha512_blocks_armv8(ctx->state, data, blocks);
+         return 0;
+#endif
+      default:
+         for (; blocks > 0; blocks--, data += SHA512_BLOCK_SIZE) {
+            ret = mbedtls_sha512_process_generic(ctx, data);
+            if (ret != 0) {
+               return ret;
+            }
+         }
+         return 0;
+   }
+}
+
+/*-- sha_accel_probe -----------------------------------------------------------
+ *
+ *      Find out which backends the CPU can run.
+ *
+ * Results
+ *      supported[] is filled in.
+ *----------------------------------------------------------------------------*/
+static void sha_accel_probe(void)
+{
+#if defined(only_em64t)
+   CPUIDRegs regs;
+#endif
+#if defined(only_arm64)
+   uint64_t isar0;
+   unsigned int sha2;
+#endif
+
+   supported[SHA_ACCEL_SHA256] = 1 << SHA_BACKEND_GENERIC;
+   supported[SHA_ACCEL_SHA512] = 1 << SHA_BACKEND_GENERIC;
+
+#if defined(only_em64t)
+   if (__GET_CPUID(1, &regs) && (regs.ecx & CPUID1_ECX_SSSE3) != 0 &&
+       (regs.ecx & CPUID1_ECX_SSE41) != 0 && __GET_CPUID2(7, 0, &regs) &&
+       (regs.ebx & CPUID7_EBX_SHA) != 0) {
+      supported[SHA_ACCEL_SHA256] |= 1 << SHA_BACKEND_SHANI;
+   }
+#endif
+
+#if defined(only_arm64)
+   MRS(isar0, id_aa64isar0_el1);
+   sha2 = (isar0 >> ID_AA64ISAR0_SHA2_SHIFT) & ID_AA64ISAR0_SHA2_MASK;
+   if (sha2 >= ID_AA64ISAR0_SHA2_SHA256) {
+      supported[SHA_ACCEL_SHA256] |= 1 << SHA_BACKEND_ARMV8;
+   }
+   if (sha2 >= ID_AA64ISAR0_SHA2_SHA512) {
+      supported[SHA_ACCEL_SHA512] |= 1 << SHA_BACKEND_ARMV8;
+   }
+#endif
+}
+
+/*-- sha_accel_check -----------------------------------------------------------
+ *
+ *      Check every non-generic backend against the portable code, and drop
+ *      the ones that disagree with it.
+ *
+ * Results
+ *      supported[] only lists backends that produced the expected state.
+ *----------------------------------------------------------------------------*/
+static void sha_accel_check(void)
+{
+   unsigned char data[SELF_TEST_BLOCKS * SHA512_BLOCK_SIZE];
+   mbedtls_sha256_context ref256, ctx256;
+   mbedtls_sha512_context ref512, ctx512;
+   sha_backend_t backend;
+   unsigned int i;
+
+   for (i = 0; i < sizeof (data); i++) {
+      data[i] = (unsigned char)(i * 0x9d + 0x3b);
+   }
+
+   mbedtls_sha256_init(&ref256);
+   mbedtls_sha256_starts_ret(&ref256, 0);
+   sha256_blocks(SHA_BACKEND_GENERIC, &ref256, data, SELF_TEST_BLOCKS);
+
+   mbedtls_sha512_init(&ref512);
+   mbedtls_sha512_starts_ret(&ref512, 0);
+   sha512_blocks(SHA_BACKEND_GENERIC, &ref512, data, SELF_TEST_BLOCKS);
+
+   for (backend = SHA_BACKEND_GENERIC + 1; backend < SHA_BACKEND_COUNT;
+        backend++) {
+      if ((supported[SHA_ACCEL_SHA256] & (1 << backend)) != 0) {
+         mbedtls_sha256_init(&ctx256);
+         mbedtls_sha256_starts_ret(&ctx256, 0);
+         if (sha256_blocks(backend, &ctx256, data, SELF_TEST_BLOCKS) != 0 ||
+             memcmp(ctx256.state, ref256.state, sizeof (ref256.state)) != 0) {
+            supported[SHA_ACCEL_SHA256] &= ~(1 << backend);
+         }
+      }
+
+      if ((supported[SHA_ACCEL_SHA512] & (1 << backend)) != 0) {
+         mbedtls_sha512_init(&ctx512);
+         mbedtls_sha512_starts_ret(&ctx512, 0);
+         if (sha512_blocks(backend, &ctx512, data, SELF_TEST_BLOCKS) != 0 ||
+             memcmp(ctx512.state, ref512.state, sizeof (ref512.state)) != 0) {
+            supported[SHA_ACCEL_SHA512] &= ~(1 << backend);
+         }
+      }
+   }
+}
+
+/*-- sha_accel_init ------------------------------------------------------------
+ *
+ *      Detect and check the available backends, and select the fastest one
+ *      for each algorithm. This is done automatically on first use, and is
+ *      only exported so that callers can control when the probing happens.
+ *----------------------------------------------------------------------------*/
+void sha_accel_init(void)
+{
+   if (initialized) {
+      return;
+   }
+
+   /* Set first, as sha_accel_best() calls back into this function. */
+   initialized = true;
+   selected[SHA_ACCEL_SHA256] = SHA_BACKEND_GENERIC;
+   selected[SHA_ACCEL_SHA512] = SHA_BACKEND_GENERIC;
+
+   sha_accel_probe();
+   sha_accel_check();
+
+   selected[SHA_ACCEL_SHA256] = sha_accel_best(SHA_ACCEL_SHA256);
+   selected[SHA_ACCEL_SHA512] = sha_accel_best(SHA_ACCEL_SHA512);
+}
+
+/*-- sha_accel_supported -------------------------------------------------------
+ *
+ *      Check whether a backend can be used on this CPU.
+ *
+ * Parameters
+ *      IN alg:     the hash algorithm
+ *      IN backend: the backend
+ *
+ * Results
+ *      true if the backend is available and passed its check.
+ *----------------------------------------------------------------------------*/
+bool sha_accel_supported(sha_accel_alg_t alg, sha_backend_t backend)
+{
+   sha_accel_init();
+
+   return backend < SHA_BACKEND_COUNT &&
+          (supported[alg] & (1 << backend)) != 0;
+}
+
+/*-- sha_accel_best ------------------------------------------------------------
+ *
+ *      Get the fastest supported backend for an algorithm.
+ *
+ * Parameters
+ *      IN alg: the hash algorithm
+ *
+ * Results
+ *      The backend.
+ *----------------------------------------------------------------------------*/
+sha_backend_t sha_accel_best(sha_accel_alg_t alg)
+{
+   sha_backend_t backend;
+
+   sha_accel_init();
+
+   /* Backends are listed in order of increasing speed. */
+   for (backend = SHA_BACKEND_COUNT - 1; backend > SHA_BACKEND_GENERIC;
+        backend--) {
+      if ((supported[alg] & (1 << backend)) != 0) {
+         return backend;
+      }
+   }
+
+   return SHA_BACKEND_GENERIC;
+}
+
+/*-- sha_accel_select ----------------------------------------------------------
+ *
+ *      Force the use of a specific backend, e.g. to test it.
+ *
+ * Parameters
+ *      IN alg:     the hash algorithm
+ *      IN backend: the backend
+ *
+ * Results
+ *      true on success, false if the backend is not supported.
+ *----------------------------------------------------------------------------*/
+bool sha_accel_select(sha_accel_alg_t alg, sha_backend_t backend)
+{
+   if (!sha_accel_supported(alg, backend)) {
+      return false;
+   }
+
+   selected[alg] = backend;
+   return true;
+}
+
+/*-- sha_accel_selected --------------------------------------------------------
+ *
+ *      Get the backend currently in use for an algorithm.
+ *
+ * Parameters
+ *      IN alg: the hash algorithm
+ *
+ * Results
+ *      The backend.
+ *----------------------------------------------------------------------------*/
+sha_backend_t sha_accel_selected(sha_accel_alg_t alg)
+{
+   sha_accel_init();
+
+   return selected[alg];
+}
+
+/*-- sha_accel_name ------------------------------------------------------------
+ *
+ *      Get the printable name of a backend.
+ *
+ * Parameters
+ *      IN backend: the backend
+ *
+ * Results
+ *      The name.
+ *----------------------------------------------------------------------------*/
+const char *sha_accel_name(sha_backend_t backend)
+{
+   return backend < SHA_BACKEND_COUNT ? backend_names[backend] : "unknown";
+}
+
+/*-- sha_accel_sha256 ----------------------------------------------------------
+ *
+ *      Process whole SHA-256 blocks with the selected backend.
+ *
+ * Parameters
+ *      IN ctx:    the SHA-256 context
+ *      IN data:   the input blocks
+ *      IN blocks: number of 64-byte blocks to process
+ *
+ * Results
+ *      0 on success, or a negative mbed TLS error code.
+ *----------------------------------------------------------------------------*/
+int sha_accel_sha256(mbedtls_sha256_context *ctx, const unsigned char *data,
+                     size_t blocks)
+{
+   sha_accel_init();
+
+   return sha256_blocks(selected[SHA_ACCEL_SHA256], ctx, data, blocks);
+}
+
+/*-- sha_accel_sha512 ----------------------------------------------------------
+ *
+ *      Process whole SHA-512 blocks with the selected backend.
+ *
+ * Parameters
+ *      IN ctx:    the SHA-512 context
+ *      IN data:   the input blocks
+ *      IN blocks: number of 128-byte blocks to process
+ *
+ * Results
+ *      0 on success, or a negative mbed TLS error code.
+ *----------------------------------------------------------------------------*/
+int sha_accel_sha512(mbedtls_sha512_context *ctx, const unsigned char *data,
+                     size_t blocks)
+{
+   sha_accel_init();
+
+   return sha512_blocks(selected[SHA_ACCEL_SHA512], ctx, data, blocks);
+}
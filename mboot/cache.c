@@ -0,0 +1,846 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * cache.c -- Local cache of network boot modules
+ *
+ *      When a cache directory is given with the -C option and mboot boots
+ *      over the network, the boot modules are saved on the EFI System
+ *      Partition (see FIRMWARE_LOCAL_VOLUME), so that the next boot from an
+ *      unchanged configuration can load them from the local disk instead of
+ *      fetching them again.  Without an EFI System Partition, the cache is
+ *      not used.
+ *
+ *      Each module is stored under the hex SHA-256 of its content, and the
+ *      directory contains an index with one line per module:
+ *
+ *         mboot-cache 2 <manifest>
+ *         <sha256> <size> <etag> <module path>
+ *         ...
+ *
+ *      The manifest is the SHA-256 of the configuration file path and
+ *      content.  The ETag is the one the server sent with the module, or "-"
+ *      if there was none.  The index is only trusted if its manifest matches
+ *      the configuration being booted, and a cached module is only used if
+ *      its size and SHA-256 still match the index.
+ *
+ *      The first time a cached module is looked up, the server is asked
+ *      whether it changed, with an If-None-Match request for its ETag; the
+ *      cached copy is only used if the server answers 304 Not Modified.  So a
+ *      module without an ETag is never used from the cache over HTTP.  Over
+ *      protocols without conditional requests (e.g. TFTP), a cached module is
+ *      only dropped if the boot volume reports a different size for it
+ *      without transferring it (e.g. the TFTP tsize option), so a module
+ *      that changed on the server but kept its size is not detected.  Any
+ *      other problem simply causes the module to be fetched from the network
+ *      as usual.  Cached modules are otherwise handled exactly as downloaded
+ *      ones; in particular, their signatures are checked the same way.
+ *
+ *      The index is only rewritten once all the modules have been loaded and
+ *      checked, and blobs which are no longer referenced are then deleted.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <sha256.h>
+#include <boot_services.h>
+#include "mboot.h"
+
+#define CACHE_INDEX_NAME     "index"
+#define CACHE_INDEX_MAGIC    "mboot-cache 2"
+
+#define SHA256_DIGEST_LENGTH (256 / 8)
+#define SHA256_STRING_LEN    (2 * SHA256_DIGEST_LENGTH + 1)
+
+typedef struct {
+   char *filepath;                  /* Module path on the boot volume */
+   char digest[SHA256_STRING_LEN];  /* SHA-256 of the module, in hex */
+   char *etag;                      /* ETag sent by the server, or NULL */
+   size_t size;                     /* Module size, in bytes */
+   bool saved;                      /* Saved to the cache during this boot */
+   bool checked;                    /* Checked against the boot volume */
+} cache_entry_t;
+
+static struct {
+   bool enabled;                    /* Is the cache in use? */
+   bool valid;                      /* Does the index match the config? */
+   bool dirty;                      /* Must the index be rewritten? */
+   char manifest[SHA256_STRING_LEN];
+   cache_entry_t *index;            /* Entries read from the index file */
+   unsigned int index_nr;
+   cache_entry_t *modules;          /* Entries for this boot, by module id */
+   unsigned int modules_nr;
+} cache;
+
+/*-- sha256_to_str -------------------------------------------------------------
+ *
+ *      Convert a SHA-256 digest to a hex string.
+ *
+ * Parameters
+ *      IN  digest: the digest
+ *      OUT str:    the string, SHA256_STRING_LEN bytes long
+ *----------------------------------------------------------------------------*/
+static void sha256_to_str(const unsigned char *digest, char *str)
+{
+   static const char hex[] = "0123456789abcdef";
+   int i;
+
+   for (i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+      str[2 * i] = hex[digest[i] >> 4];
+      str[2 * i + 1] = hex[digest[i] & 0xf];
+   }
+   str[2 * i] = '\0';
+}
+
+/*-- cache_digest --------------------------------------------------------------
+ *
+ *      Compute the SHA-256 of one or two buffers, as a hex string.
+ *
+ * Parameters
+ *      IN  buf1, size1: first buffer
+ *      IN  buf2, size2: second buffer, may be NULL
+ *      OUT str:         the digest, SHA256_STRING_LEN bytes long
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int cache_digest(const void *buf1, size_t size1, const void *buf2,
+                        size_t size2, char *str)
+{
+   unsigned char digest[SHA256_DIGEST_LENGTH];
+   mbedtls_sha256_context ctx;
+   int ret;
+
+   mbedtls_sha256_init(&ctx);
+
+   ret = mbedtls_sha256_starts_ret(&ctx, 0);
+   if (ret == 0) {
+      ret = mbedtls_sha256_update_ret(&ctx, buf1, size1);
+   }
+   if (ret == 0 && buf2 != NULL) {
+      ret = mbedtls_sha256_update_ret(&ctx, buf2, size2);
+   }
+   if (ret == 0) {
+      ret = mbedtls_sha256_finish_ret(&ctx, digest);
+   }
+
+   mbedtls_sha256_free(&ctx);
+
+   if (ret != 0) {
+      return ERR_UNKNOWN;
+   }
+
+   sha256_to_str(digest, str);
+
+   return ERR_SUCCESS;
+}
+
+/*-- cache_path ----------------------------------------------------------------
+ *
+ *      Build the path of a file in the cache directory.
+ *
+ * Parameters
+ *      IN  name: file name
+ *
+ * Results
+ *      The path (to be freed by the caller), or NULL if out of resources.
+ *----------------------------------------------------------------------------*/
+static char *cache_path(const char *name)
+{
+   char *path;
+
+   if (asprintf(&path, "%s/%s", boot.cache_dir, name) == -1) {
+      return NULL;
+   }
+
+   return path;
+}
+
+/*-- cache_find ----------------------------------------------------------------
+ *
+ *      Look up the index entry of a module.
+ *
+ * Parameters
+ *      IN filepath: module path on the boot volume
+ *
+ * Results
+ *      The entry, or NULL if the module is not in the index.
+ *----------------------------------------------------------------------------*/
+static cache_entry_t *cache_find(const char *filepath)
+{
+   unsigned int i;
+
+   for (i = 0; i < cache.index_nr; i++) {
+      if (cache.index[i].digest[0] != '\0' &&
+          strcmp(cache.index[i].filepath, filepath) == 0) {
+         return &cache.index[i];
+      }
+   }
+
+   return NULL;
+}
+
+/*-- cache_has_blob ------------------------------------------------------------
+ *
+ *      Check whether a blob is referenced by the index, or by a module of the
+ *      current boot.
+ *
+ * Parameters
+ *      IN digest:     blob digest
+ *      IN from_index: look in the index
+ *      IN skip:       id of a module to ignore, or boot.modules_nr
+ *
+ * Results
+ *      True if the blob is referenced, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool cache_has_blob(const char *digest, bool from_index,
+                           unsigned int skip)
+{
+   unsigned int i;
+
+   if (from_index) {
+      for (i = 0; i < cache.index_nr; i++) {
+         if (strcmp(cache.index[i].digest, digest) == 0) {
+            return true;
+         }
+      }
+   }
+
+   for (i = 0; i < cache.modules_nr; i++) {
+      if (i != skip && strcmp(cache.modules[i].digest, digest) == 0) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/*-- cache_etag_ok -------------------------------------------------------------
+ *
+ *      Check whether an ETag can be stored in the index.  ETags never contain
+ *      white space (RFC 7232, section 2.3), but one that does would break the
+ *      index format.
+ *
+ * Parameters
+ *      IN etag: the ETag
+ *
+ * Results
+ *      True if the ETag can be stored, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool cache_etag_ok(const char *etag)
+{
+   const char *p;
+
+   if (etag[0] == '\0' || strcmp(etag, "-") == 0) {
+      return false;
+   }
+
+   for (p = etag; *p != '\0'; p++) {
+      if (isspace((unsigned char)*p)) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*-- cache_parse_index ---------------------------------------------------------
+ *
+ *      Parse the index file.  Malformed lines are ignored, and the index is
+ *      only valid if its manifest matches the current configuration.
+ *
+ * Parameters
+ *      IN buf:  index file content, NUL-terminated
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int cache_parse_index(char *buf)
+{
+   char *line, *next, *digest, *etag, *path, *p;
+   cache_entry_t *e;
+   unsigned int n;
+   size_t size, len;
+
+   n = 0;
+   for (p = buf; *p != '\0'; p++) {
+      if (*p == '\n') {
+         n++;
+      }
+   }
+
+   cache.index = sys_malloc((n + 1) * sizeof (cache_entry_t));
+   if (cache.index == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   for (line = buf; line != NULL && *line != '\0'; line = next) {
+      next = strchr(line, '\n');
+      if (next != NULL) {
+         *next++ = '\0';
+      }
+
+      if (line == buf) {
+         len = strlen(CACHE_INDEX_MAGIC " ");
+         if (strncmp(line, CACHE_INDEX_MAGIC " ", len) != 0 ||
+             strlen(line + len) != SHA256_STRING_LEN - 1) {
+            Log(LOG_DEBUG, "Cache index: bad header");
+            return ERR_BAD_HEADER;
+         }
+         cache.valid = (strcmp(line + len, cache.manifest) == 0);
+         continue;
+      }
+
+      digest = line;
+      for (p = digest; isxdigit((unsigned char)*p); p++) {
+         ;
+      }
+      if (*p != ' ' || p - digest != SHA256_STRING_LEN - 1) {
+         continue;
+      }
+      *p++ = '\0';
+
+      if (!isdigit((unsigned char)*p)) {
+         continue;
+      }
+      size = strtoul(p, &etag, 10);
+      if (*etag != ' ' || etag[1] == '\0') {
+         continue;
+      }
+      etag++;
+
+      path = strchr(etag, ' ');
+      if (path == NULL || path == etag || path[1] == '\0') {
+         continue;
+      }
+      *path++ = '\0';
+
+      e = &cache.index[cache.index_nr];
+      e->etag = NULL;
+      if (strcmp(etag, "-") != 0) {
+         e->etag = strdup(etag);
+         if (e->etag == NULL) {
+            return ERR_OUT_OF_RESOURCES;
+         }
+      }
+      e->filepath = strdup(path);
+      if (e->filepath == NULL) {
+         sys_free(e->etag);
+         return ERR_OUT_OF_RESOURCES;
+      }
+      memcpy(e->digest, digest, SHA256_STRING_LEN);
+      e->size = size;
+      e->saved = false;
+      e->checked = false;
+      cache.index_nr++;
+   }
+
+   return ERR_SUCCESS;
+}
+
+/*-- cache_load_index ----------------------------------------------------------
+ *
+ *      Load the index file from the cache directory.
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int cache_load_index(void)
+{
+   char *path, *buf;
+   void *data;
+   size_t size;
+   int status;
+
+   path = cache_path(CACHE_INDEX_NAME);
+   if (path == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   status = file_load(FIRMWARE_LOCAL_VOLUME, path, NULL, &data, &size);
+   sys_free(path);
+   if (status != ERR_SUCCESS) {
+      return status;
+   }
+
+   buf = sys_realloc(data, size, size + 1);
+   if (buf == NULL) {
+      sys_free(data);
+      return ERR_OUT_OF_RESOURCES;
+   }
+   buf[size] = '\0';
+
+   status = cache_parse_index(buf);
+   sys_free(buf);
+
+   return status;
+}
+
+/*-- cache_write_index ---------------------------------------------------------
+ *
+ *      Write the index for the modules of the current boot.
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int cache_write_index(void)
+{
+   char *path, *buf, *p;
+   unsigned int i;
+   size_t size;
+   int status;
+
+   size = strlen(CACHE_INDEX_MAGIC) + SHA256_STRING_LEN + 2;
+   for (i = 0; i < cache.modules_nr; i++) {
+      size += SHA256_STRING_LEN + 22 + strlen(boot.modules[i].filename) + 1;
+      if (cache.modules[i].etag != NULL) {
+         size += strlen(cache.modules[i].etag) + 1;
+      } else {
+         size += 2;
+      }
+   }
+
+   buf = sys_malloc(size);
+   if (buf == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   p = buf;
+   p += snprintf(p, size, "%s %s\n", CACHE_INDEX_MAGIC, cache.manifest);
+   for (i = 0; i < cache.modules_nr; i++) {
+      if (cache.modules[i].digest[0] == '\0') {
+         /* Not read from the network or the cache, e.g. a duplicate. */
+         continue;
+      }
+      p += snprintf(p, size - (p - buf), "%s %zu %s %s\n",
+                    cache.modules[i].digest, cache.modules[i].size,
+                    cache.modules[i].etag != NULL ? cache.modules[i].etag : "-",
+                    boot.modules[i].filename);
+   }
+
+   path = cache_path(CACHE_INDEX_NAME);
+   if (path == NULL) {
+      sys_free(buf);
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   /* Quietly replace the previous index, if any. */
+   file_delete(FIRMWARE_LOCAL_VOLUME, path);
+   status = file_save(FIRMWARE_LOCAL_VOLUME, path, NULL, buf, p - buf);
+
+   sys_free(path);
+   sys_free(buf);
+
+   return status;
+}
+
+/*-- cache_delete_blob ---------------------------------------------------------
+ *
+ *      Delete a module from the cache directory.
+ *
+ * Parameters
+ *      IN digest: module digest
+ *----------------------------------------------------------------------------*/
+static void cache_delete_blob(const char *digest)
+{
+   char *path;
+   int status;
+
+   path = cache_path(digest);
+   if (path == NULL) {
+      return;
+   }
+
+   status = file_delete(FIRMWARE_LOCAL_VOLUME, path);
+   if (status != ERR_SUCCESS && status != ERR_NOT_FOUND) {
+      Log(LOG_DEBUG, "Cache: could not delete %s: %s", path,
+          error_str[status]);
+   }
+
+   sys_free(path);
+}
+
+/*-- cache_module --------------------------------------------------------------
+ *
+ *      Get the cache entry for a module of the current boot.
+ *
+ * Parameters
+ *      IN n: module id
+ *
+ * Results
+ *      The entry, or NULL if the cache is not in use.
+ *----------------------------------------------------------------------------*/
+static cache_entry_t *cache_module(unsigned int n)
+{
+   if (!cache.enabled || n >= boot.modules_nr) {
+      return NULL;
+   }
+
+   if (cache.modules == NULL) {
+      cache.modules = calloc(boot.modules_nr, sizeof (cache_entry_t));
+      if (cache.modules == NULL) {
+         cache.enabled = false;
+         return NULL;
+      }
+      cache.modules_nr = boot.modules_nr;
+   }
+
+   return &cache.modules[n];
+}
+
+/*-- cache_open ----------------------------------------------------------------
+ *
+ *      Enable the module cache, if a cache directory was given and the boot
+ *      modules are to be loaded from the network.  Failures are not fatal:
+ *      they just leave the cache disabled.
+ *
+ * Parameters
+ *      IN cfgpath: path to the configuration file on the boot volume
+ *----------------------------------------------------------------------------*/
+void cache_open(const char *cfgpath)
+{
+   void *cfg;
+   size_t size;
+   int status;
+
+   if (boot.cache_dir == NULL) {
+      return;
+   }
+
+   if (boot.volid != FIRMWARE_BOOT_VOLUME || !is_network_boot()) {
+      Log(LOG_DEBUG, "Cache: not a network boot, cache not used");
+      return;
+   }
+
+   /*
+    * The configuration file has already been parsed, but its raw content is
+    * needed to compute the manifest.
+    */
+   status = file_load(boot.volid, cfgpath, NULL, &cfg, &size);
+   if (status != ERR_SUCCESS) {
+      Log(LOG_DEBUG, "Cache: could not reload %s: %s", cfgpath,
+          error_str[status]);
+      return;
+   }
+
+   status = cache_digest(cfgpath, strlen(cfgpath) + 1, cfg, size,
+                         cache.manifest);
+   sys_free(cfg);
+   if (status != ERR_SUCCESS) {
+      return;
+   }
+
+   /* ERR_NO_MEDIA: there is no EFI System Partition to keep the cache on. */
+   status = cache_load_index();
+   if (status != ERR_SUCCESS && status != ERR_NOT_FOUND &&
+       status != ERR_BAD_HEADER) {
+      Log(LOG_WARNING, "Module cache %s is not usable: %s", boot.cache_dir,
+          error_str[status]);
+      cache_close(false);
+      return;
+   }
+
+   Log(LOG_DEBUG, "Cache: %s, %u entries, %s", boot.cache_dir, cache.index_nr,
+       cache.valid ? "up to date" : "stale");
+
+   cache.enabled = true;
+}
+
+/*-- cache_check ---------------------------------------------------------------
+ *
+ *      Find out whether the cached copy of a module is still current: ask the
+ *      server with its ETag, or if the boot volume does not support that,
+ *      compare its size with the one that the boot volume reports.
+ *
+ * Parameters
+ *      IN e: index entry of the module
+ *
+ * Results
+ *      True if the cached copy can be used, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool cache_check(const cache_entry_t *e)
+{
+   size_t filesize;
+   int status;
+
+   status = file_check_etag(boot.volid, e->filepath, e->etag);
+   if (status == ERR_SUCCESS) {
+      return true;
+   }
+
+   if (status == ERR_UNSUPPORTED) {
+      if (file_get_size_hint(boot.volid, e->filepath, &filesize) ==
+          ERR_SUCCESS && filesize != e->size) {
+         Log(LOG_INFO, "%s changed on the server (%zu bytes, cached %zu), "
+             "not using the cached copy", e->filepath, filesize, e->size);
+         return false;
+      }
+      return true;
+   }
+
+   if (e->etag == NULL) {
+      Log(LOG_DEBUG, "Cache: %s has no ETag, not using the cached copy",
+          e->filepath);
+   } else if (status == ERR_NOT_FOUND) {
+      Log(LOG_INFO, "%s changed on the server, not using the cached copy",
+          e->filepath);
+   } else {
+      Log(LOG_INFO, "Could not check whether %s changed on the server (%s), "
+          "not using the cached copy", e->filepath, error_str[status]);
+   }
+
+   return false;
+}
+
+/*-- cache_lookup --------------------------------------------------------------
+ *
+ *      Check whether a module can be loaded from the cache.  The first time a
+ *      module is looked up, its cached copy is dropped if it may have changed
+ *      on the server (see cache_check).
+ *
+ * Parameters
+ *      IN  n:    module id
+ *      OUT size: the module size, in bytes
+ *
+ * Results
+ *      True if the module is in the cache, false otherwise.
+ *----------------------------------------------------------------------------*/
+bool cache_lookup(unsigned int n, size_t *size)
+{
+   char digest[SHA256_STRING_LEN];
+   cache_entry_t *e;
+
+   if (!cache.enabled || !cache.valid || n >= boot.modules_nr) {
+      return false;
+   }
+
+   e = cache_find(boot.modules[n].filename);
+   if (e == NULL) {
+      return false;
+   }
+
+   if (!e->checked) {
+      e->checked = true;
+      if (!cache_check(e)) {
+         memcpy(digest, e->digest, SHA256_STRING_LEN);
+         e->digest[0] = '\0';
+         cache.dirty = true;
+         if (!cache_has_blob(digest, true, boot.modules_nr)) {
+            cache_delete_blob(digest);
+         }
+         return false;
+      }
+   }
+
+   *size = e->size;
+
+   return true;
+}
+
+/*-- cache_load ----------------------------------------------------------------
+ *
+ *      Load a module from the cache.  A cached module whose size or digest
+ *      does not match the index is discarded.
+ *
+ * Parameters
+ *      IN  n:        module id
+ *      IN  callback: routine to be called with the module size once it has
+ *                    been loaded
+ *      OUT buffer:   pointer to where the module was loaded
+ *      OUT size:     the module size, in bytes
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int cache_load(unsigned int n, int (*callback)(size_t), void **buffer,
+               size_t *size)
+{
+   char digest[SHA256_STRING_LEN];
+   cache_entry_t *e, *m;
+   size_t len;
+   void *data;
+   char *path;
+   int status;
+
+   if (!cache_lookup(n, &len) || (m = cache_module(n)) == NULL) {
+      return ERR_NOT_FOUND;
+   }
+
+   e = cache_find(boot.modules[n].filename);
+
+   path = cache_path(e->digest);
+   if (path == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   status = file_load(FIRMWARE_LOCAL_VOLUME, path, NULL, &data, &len);
+   if (status == ERR_SUCCESS) {
+      if (len != e->size) {
+         status = ERR_INCONSISTENT_DATA;
+      } else {
+         status = cache_digest(data, len, NULL, 0, digest);
+         if (status == ERR_SUCCESS && strcmp(digest, e->digest) != 0) {
+            status = ERR_INCONSISTENT_DATA;
+         }
+      }
+      if (status != ERR_SUCCESS) {
+         sys_free(data);
+      }
+   }
+
+   if (status != ERR_SUCCESS) {
+      Log(LOG_WARNING, "Cached copy of %s is not usable: %s",
+          boot.modules[n].filename, error_str[status]);
+      if (status != ERR_NOT_FOUND) {
+         file_delete(FIRMWARE_LOCAL_VOLUME, path);
+      }
+      sys_free(path);
+      e->digest[0] = '\0';
+      cache.dirty = true;
+      return status;
+   }
+
+   sys_free(path);
+
+   Log(LOG_DEBUG, "%s: loaded from cache", boot.modules[n].filename);
+
+   memcpy(m->digest, e->digest, SHA256_STRING_LEN);
+   m->size = len;
+   sys_free(m->etag);
+   m->etag = e->etag != NULL ? strdup(e->etag) : NULL;
+
+   if (callback != NULL) {
+      status = callback(len);
+      if (status != ERR_SUCCESS) {
+         sys_free(data);
+         return status;
+      }
+   }
+
+   *buffer = data;
+   *size = len;
+
+   return ERR_SUCCESS;
+}
+
+/*-- cache_store ---------------------------------------------------------------
+ *
+ *      Save a module that has been loaded from the network to the cache,
+ *      unless a module with the same content is already there.  The cache is
+ *      disabled if the module cannot be saved.
+ *
+ * Parameters
+ *      IN n:      module id
+ *      IN buffer: the module
+ *      IN size:   the module size, in bytes
+ *----------------------------------------------------------------------------*/
+void cache_store(unsigned int n, void *buffer, size_t size)
+{
+   cache_entry_t *m;
+   char *path;
+   int status;
+
+   m = cache_module(n);
+   if (m == NULL) {
+      return;
+   }
+
+   status = cache_digest(buffer, size, NULL, 0, m->digest);
+   if (status != ERR_SUCCESS) {
+      cache_close(false);
+      return;
+   }
+   m->size = size;
+   cache.dirty = true;
+
+   /* Without an ETag, the module will not be used from the cache over HTTP. */
+   sys_free(m->etag);
+   m->etag = NULL;
+   if (file_get_etag(boot.volid, boot.modules[n].filename, &m->etag) ==
+       ERR_SUCCESS && !cache_etag_ok(m->etag)) {
+      sys_free(m->etag);
+      m->etag = NULL;
+   }
+
+   if (cache_has_blob(m->digest, true, n)) {
+      return;
+   }
+
+   path = cache_path(m->digest);
+   if (path == NULL) {
+      cache_close(false);
+      return;
+   }
+
+   status = file_save(FIRMWARE_LOCAL_VOLUME, path, NULL, buffer, size);
+   sys_free(path);
+
+   if (status != ERR_SUCCESS) {
+      Log(LOG_WARNING, "Could not save %s to the module cache: %s",
+          boot.modules[n].filename, error_str[status]);
+      /* Not indexed nor marked saved: nothing else would delete it. */
+      cache_delete_blob(m->digest);
+      cache_close(false);
+      return;
+   }
+
+   m->saved = true;
+}
+
+/*-- cache_close ---------------------------------------------------------------
+ *
+ *      Stop using the cache.  If the boot modules have all been loaded and
+ *      checked, the index is updated to describe them, and modules that are
+ *      no longer referenced are deleted.  Otherwise, the modules saved during
+ *      this boot are deleted and the index is left as it was.
+ *
+ * Parameters
+ *      IN commit: true if the boot modules have been successfully loaded
+ *----------------------------------------------------------------------------*/
+void cache_close(bool commit)
+{
+   unsigned int i;
+   int status;
+
+   if (cache.enabled && commit && (cache.dirty || !cache.valid)) {
+      status = cache_write_index();
+      if (status == ERR_SUCCESS) {
+         for (i = 0; i < cache.index_nr; i++) {
+            if (cache.index[i].digest[0] != '\0' &&
+                !cache_has_blob(cache.index[i].digest, false,
+                                cache.modules_nr)) {
+               cache_delete_blob(cache.index[i].digest);
+            }
+         }
+         for (i = 0; i < cache.modules_nr; i++) {
+            cache.modules[i].saved = false;
+         }
+         Log(LOG_DEBUG, "Cache: index updated");
+      } else {
+         Log(LOG_WARNING, "Could not update the module cache index: %s",
+             error_str[status]);
+      }
+   }
+
+   for (i = 0; i < cache.modules_nr; i++) {
+      if (cache.modules[i].saved) {
+         cache_delete_blob(cache.modules[i].digest);
+      }
+   }
+
+   for (i = 0; i < cache.index_nr; i++) {
+      sys_free(cache.index[i].filepath);
+      sys_free(cache.index[i].etag);
+   }
+   for (i = 0; i < cache.modules_nr; i++) {
+      sys_free(cache.modules[i].etag);
+   }
+   sys_free(cache.index);
+   sys_free(cache.modules);
+
+   memset(&cache, 0, sizeof (cache));
+}
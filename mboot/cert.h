@@ -12,6 +12,14 @@
 #include <rsa.h>
 #include <stdbool.h>
 
+/*
+ * Big number, as an array of mbedtls_mpi limbs (least significant first).
+ */
+typedef struct {
+   mbedtls_mpi_uint *p;
+   size_t n;
+} RawMpi;
+
 /*
  * RSA public key information.
  */
@@ -30,6 +38,13 @@ typedef struct {
     * Message digest algorithm to be used in signatures with this key.
     */
    mbedtls_md_type_t digest;
+   /*
+    * Modulus, exponent and R^2 mod N (the Montgomery constant of
+    * mbedtls_mpi_exp_mod), precomputed at build time by getkeys.py.
+    */
+   RawMpi N;
+   RawMpi E;
+   RawMpi RR;
    /*
     * Parsed form; valid if parsed = TRUE.
     */
@@ -67,6 +67,19 @@
  *    When a fatal error occurs: if SECONDS >= 0, exit with error status after
  *    SECONDS, or immediately if in headless mode; if SECONDS < 0, hang.
  *    Default: -1 if skip=0, 5 if skip=1.
+ * httprecvsize=<BYTES>
+ *    For native UEFI HTTP transfers, receive response bodies at most BYTES
+ *    at a time (minimum 4096).  Default: 0, the whole rest of the body at
+ *    once.  UEFI only.
+ * tpmfirmwarehash=<0|1>
+ *    If tpmfirmwarehash=0, mboot hashes the data measured into the TPM and
+ *    extends the PCRs directly, unless a PCR bank uses an algorithm that
+ *    mboot does not implement.  Default: 1, the firmware hashes it.  UEFI
+ *    only.
+ * manifest=<FILEPATH>
+ *    Signed manifest of the early module digests, checked instead of the
+ *    signatures of the individual modules in Secure Boot (see secure.c).
+ *    Relative to the prefix directory if not absolute.  Optional.
  */
 static option_t mboot_options[] = {
    {"kernel", "=", {NULL}, OPT_STRING, {0}},
@@ -86,6 +99,9 @@ static option_t mboot_options[] = {
    {"runtimewdtimeout", "=", {.integer = 0}, OPT_INTEGER, {0}},
    {"skip", "=", {.integer = 0}, OPT_INTEGER, {0}},
    {"errtimeout", "=", {.integer = -1}, OPT_INTEGER, {0}},
+   {"httprecvsize", "=", {.integer = 0}, OPT_INTEGER, {0}},
+   {"tpmfirmwarehash", "=", {.integer = 1}, OPT_INTEGER, {0}},
+   {"manifest", "=", {NULL}, OPT_STRING, {0}},
    {NULL, NULL, {NULL}, OPT_INVAL, {0}}
 };
 
@@ -685,6 +701,11 @@ int parse_config(const char *filename)
        mboot_options[16].default_value.integer) {
       boot.err_timeout = mboot_options[16].value.integer;
    }
+   if (mboot_options[17].value.integer > 0) {
+      set_http_recv_size(mboot_options[17].value.integer);
+   }
+   boot.tpm_firmware_hash = mboot_options[18].value.integer != 0;
+   boot.manifest = mboot_options[19].value.str;
 
    if (skip && boot.err_timeout == -1) {
       boot.err_timeout = 5;
@@ -707,6 +728,9 @@ int parse_config(const char *filename)
       goto error;
    }
 
+   /* Must be before path is stripped below. */
+   cache_open(path);
+
    if (prefix == NULL) {
       prefix = path;
       status = strip_basename(prefix);
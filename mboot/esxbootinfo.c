@@ -1121,6 +1121,10 @@ int esxbootinfo_register(void)
    if (boot.modules_nr > 0) {
       for (i = 1; i < boot.modules_nr; i++) {
          mod = &boot.modules[i];
+         if (mod->same_as != 0) {
+            /* Image already registered by the module it is shared with */
+            continue;
+         }
          status = add_module_object(mod->addr, mod->size);
          if (status != ERR_SUCCESS) {
             Log(LOG_ERR, "Module registration error.\n");
@@ -104,7 +104,9 @@ static unsigned int gui_draw_header(gui_render_t rendering)
    if (boot.modules == 0) {
       progress = 0;
    } else if (boot.load_size > 0) {
-      progress = (unsigned int)((boot.load_offset * w) / boot.load_size);
+      /* The total may be an estimate that the loaded data overruns. */
+      progress = (unsigned int)MIN((boot.load_offset * w) / boot.load_size,
+                                   w);
    } else {
       for (i = 0; i < boot.modules_nr; i++) {
          if (!boot.modules[i].is_loaded) {
@@ -117,7 +119,8 @@ static unsigned int gui_draw_header(gui_render_t rendering)
    h = MAX(1, w / 115);
    y += font_height(1) + MARGIN;
 
-   if (rendering == RENDER_ALL || boot.modules_nr == 0) {
+   if (rendering == RENDER_ALL || boot.modules_nr == 0 ||
+       progress < old_progress) {
       fb_draw_rect(fb, x + progress, y, w - progress, h, COLOR_BGPROGRESS);
    }
    if (progress != old_progress) {
@@ -68,6 +68,10 @@ static void load_sanity_check(void)
  *      Increment the load offset with a given amount of freshly loaded memory.
  *      This function is a callback for the file_load() function.
  *
+ *      It may be called from within the network stack's receive path (e.g.
+ *      for each TFTP block), so it must not do anything slow, such as
+ *      submitting TPM measurements (see load_boot_modules).
+ *
  * Parameters
  *      IN chunk_size: amount of loaded memory, in bytes, since the last call to
  *                     this function
@@ -89,7 +93,8 @@ static int load_callback(size_t chunk_size)
  *
  *      In some circumstances, it is not possible to determine the full size of
  *      a file without loading it. If that is the case, then this function
- *      will return ERR_UNSUPPORTED.
+ *      will return ERR_UNSUPPORTED, or ERR_NOT_READY if the size may become
+ *      known once the file starts being loaded.
  *
  * Parameters
  *      IN  n:    module id
@@ -106,9 +111,16 @@ static int get_module_size(unsigned int n, size_t *size)
 
   filepath = boot.modules[n].filename;
 
+   if (cache_lookup(n, size)) {
+      return ERR_SUCCESS;
+   }
+
    status = file_get_size_hint(boot.volid, filepath, &filesize);
    if (status != ERR_SUCCESS) {
-      Log(LOG_DEBUG, "No size hint for %s: %s", filepath, error_str[status]);
+      if (status != ERR_NOT_READY) {
+         Log(LOG_DEBUG, "No size hint for %s: %s", filepath,
+             error_str[status]);
+      }
       return status;
    }
 
@@ -122,32 +134,80 @@ static int get_module_size(unsigned int n, size_t *size)
  *      Get the total size of the data to be loaded.
  *
  *      In some circumstances, it is not possible to determine the full size of
- *      a file without loading it. If that is the case, then this function
- *      will return ERR_UNSUPPORTED.
+ *      a file without loading it. If that is the case for all the modules,
+ *      then this function will return ERR_UNSUPPORTED.
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
 int get_load_size_hint(void)
 {
+   unsigned int i;
+
+   for (i = 0; i < boot.modules_nr; i++) {
+      boot.modules[i].size_hint = 0;
+      boot.modules[i].size_hint_pending = true;
+   }
+
+   return update_load_size_hint();
+}
+
+/*-- update_load_size_hint -----------------------------------------------------
+ *
+ *      Refresh the estimate of the total size of the data to be loaded.
+ *
+ *      Sizes that the file access method could not report yet (e.g. over
+ *      HTTP, where they are learned from the response headers as each
+ *      transfer starts) are asked for again, and the modules that are
+ *      already loaded count for their actual size.  Modules whose size is
+ *      still unknown are assumed to have the average size of the others.
+ *
+ * Results
+ *      ERR_SUCCESS, or ERR_UNSUPPORTED if no module size is known.
+ *----------------------------------------------------------------------------*/
+int update_load_size_hint(void)
+{
+   module_t *mod;
    size_t filesize = 0;
    uint64_t bytes;
-   unsigned int i;
+   unsigned int i, known, unknown;
    int status;
 
-   boot.load_size = 0;
    bytes = 0;
+   known = 0;
+   unknown = 0;
 
    for (i = 0; i < boot.modules_nr; i++) {
-      status = get_module_size(i, &filesize);
-      if (status != ERR_SUCCESS) {
-         return status;
+      mod = &boot.modules[i];
+
+      if (mod->is_loaded) {
+         bytes += mod->load_size;
+         known++;
+         continue;
+      }
+
+      if (mod->size_hint == 0 && mod->size_hint_pending) {
+         status = get_module_size(i, &filesize);
+         mod->size_hint_pending = (status == ERR_NOT_READY);
+         if (status == ERR_SUCCESS) {
+            mod->size_hint = filesize;
+         }
+      }
+
+      if (mod->size_hint > 0) {
+         bytes += mod->size_hint;
+         known++;
+      } else {
+         unknown++;
       }
+   }
 
-      bytes += filesize;
+   if (known == 0) {
+      boot.load_size = 0;
+      return ERR_UNSUPPORTED;
    }
 
-   boot.load_size = bytes;
+   boot.load_size = bytes + unknown * (bytes / known);
 
    return ERR_SUCCESS;
 }
@@ -162,15 +222,31 @@ int get_load_size_hint(void)
 void unload_boot_modules(void)
 {
    unsigned int i;
+   int status;
+
+   /*
+    * Queued TPM measurements may still reference the module images.  A
+    * failure stays reported by tpm_flush(), so that no later boot attempt
+    * goes on with a PCR that misses an extend.
+    */
+   status = tpm_flush();
+   if (status != ERR_SUCCESS) {
+      Log(LOG_ERR, "Failed to complete TPM measurements: %s",
+          error_str[status]);
+   }
 
    memset(&boot.kernel, 0, sizeof (kernel_t));
 
    for (i = 0; i < boot.modules_nr; i++) {
-      sys_free(boot.modules[i].addr);
+      if (boot.modules[i].same_as == 0) {
+         sys_free(boot.modules[i].addr);
+      }
       boot.modules[i].addr = NULL;
+      boot.modules[i].same_as = 0;
       boot.modules[i].load_size = 0;
       boot.modules[i].size = 0;
       boot.modules[i].is_loaded = false;
+      boot.modules[i].tpm_digests.algs = 0;
    }
 }
 
@@ -244,6 +320,26 @@ static uint64_t get_transfer_bandwidth(uint64_t size, uint64_t time,
    return bandwidth;
 }
 
+/*-- module_md5_str -----------------------------------------------------------
+ *
+ *      Format one of the MD5 sums of a module for logging.
+ *
+ * Parameters
+ *      IN  mod:  the module
+ *      IN  md5:  the MD5 sum, within mod
+ *      OUT str:  the formatted MD5 sum
+ *      IN  size: size of str, at least MD5_STRING_LEN bytes
+ *----------------------------------------------------------------------------*/
+static void module_md5_str(const module_t *mod, const md5_t *md5, char *str,
+                           size_t size)
+{
+   if (mod->md5_valid) {
+      md5_to_str(md5, str, size);
+   } else {
+      snprintf(str, size, "not computed");
+   }
+}
+
 /*-- log_module_transfer_stats ------------------------------------------------
  *
  *      Log module transfer statistics.
@@ -270,7 +366,7 @@ static void log_module_transfer_stats(unsigned int n)
    pretty_size = load_size;
    pretty_unit = modify_size_units(&pretty_size);
    pretty_unit_str = size_unit_to_str(pretty_unit);
-   md5_to_str(&mod->md5_compressed, md5str, sizeof(md5str));
+   module_md5_str(mod, &mod->md5_compressed, md5str, sizeof(md5str));
 
    seconds = MILLISEC_TO_SEC_SIGNIFICAND(mod->load_time);
    tenths_of_second = MILLISEC_TO_SEC_FRACTIONAL(mod->load_time);
@@ -317,7 +413,7 @@ static void log_module_transfer_stats(unsigned int n)
    pretty_size = extracted_size;
    pretty_unit = modify_size_units(&pretty_size);
    pretty_unit_str = size_unit_to_str(pretty_unit);
-   md5_to_str(&mod->md5_uncompressed, md5str, sizeof(md5str));
+   module_md5_str(mod, &mod->md5_uncompressed, md5str, sizeof(md5str));
 
    if (pretty_unit > BYTES) {
       Log(LOG_DEBUG, "%s (MD5: %s): extracted %"PRIu64"%s (%"PRIu64" bytes)\n",
@@ -332,9 +428,17 @@ static void log_module_transfer_stats(unsigned int n)
 
 /*-- extract_cksum_module ------------------------------------------------------
  *
- *      Extract and calculate md5 checksums for incoming compressed module
+ *      Extract an incoming compressed module.  On secure boot builds, the
+ *      digests for the module's signature are also computed as the data is
+ *      extracted.
+ *
+ *      The MD5 sums of the module are only computed with -D or -M, since they
+ *      are merely used for logging.  When the module is not compressed or
+ *      fails to extract, the MD5 sum of the compressed buffer is computed
+ *      anyway, before it is freed, to help diagnosing the failure.
  *
  * Parameters
+ *      IN     n:                module id
  *      IN     modulename:       name of the compressed module
  *      IN/OUT buffer:           incoming compressed buffer is replaced with
  *                               newly allocated outgoing uncompressed buffer.
@@ -343,33 +447,52 @@ static void log_module_transfer_stats(unsigned int n)
  *                               with newly allocated uncompressed size.
  *      OUT    md5_compressed:   MD5 sum of compressed buffer.
  *      OUT    md5_uncompressed: MD5 sum of uncompressed buffer.
+ *      OUT    md5_valid:        whether both MD5 sums have been computed.
  *
  * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
-static int extract_cksum_module(const char *modname, void **buffer,
-                                size_t *bufsize, md5_t *md5_compressed,
-                                md5_t *md5_uncompressed)
+static int extract_cksum_module(unsigned int n, const char *modname,
+                                void **buffer, size_t *bufsize,
+                                md5_t *md5_compressed, md5_t *md5_uncompressed,
+                                bool *md5_valid)
 {
    void *data = NULL;
+   void *stream;
    size_t size = *bufsize;
+   bool md5_sums = boot.debug || boot.md5_sums;
    int status;
 
-   md5_compute(*buffer, size, md5_compressed);
+   *md5_valid = false;
 
    if (!is_gzip(*buffer, size, &status)) {
+      md5_compute(*buffer, size, md5_compressed);
       return status;
    }
 
-   status = gzip_extract(*buffer, size, &data, &size);
-   sys_free(*buffer);
+   if (md5_sums) {
+      md5_compute(*buffer, size, md5_compressed);
+   }
+
+   stream = secure_boot_stream_open(n);
+   status = gzip_extract_stream(*buffer, size, &data, &size,
+                                secure_boot_stream_update, stream);
+   secure_boot_stream_close(stream, status == ERR_SUCCESS ? data : NULL, size);
    if (status != ERR_SUCCESS) {
+      if (!md5_sums) {
+         md5_compute(*buffer, *bufsize, md5_compressed);
+      }
+      sys_free(*buffer);
       Log(LOG_ERR, "gzip_extract failed for %s (size %zu): %s\n",
           modname, size, error_str[status]);
       return status;
    }
+   sys_free(*buffer);
 
-   md5_compute(data, size, md5_uncompressed);
+   if (md5_sums) {
+      md5_compute(data, size, md5_uncompressed);
+      *md5_valid = true;
+   }
 
    *bufsize = size;
    *buffer = data;
@@ -377,36 +500,100 @@ static int extract_cksum_module(const char *modname, void **buffer,
    return status;
 }
 
-/*-- load_module --------------------------------------------------------------
+/*-- find_module_by_path -------------------------------------------------------
  *
- *      Load a boot module.
+ *      Look for a module that is listed before a given one, with the same path.
+ *      The kernel is never shared with a module.
  *
  * Parameters
  *      IN n: module id
  *
  * Results
+ *      The id of the module, or 0 if none was found.
+ *----------------------------------------------------------------------------*/
+static unsigned int find_module_by_path(unsigned int n)
+{
+   const module_t *mod;
+   unsigned int i;
+
+   for (i = 1; i < n; i++) {
+      mod = &boot.modules[i];
+      if (strcmp(mod->filename, boot.modules[n].filename) == 0) {
+         return i;
+      }
+   }
+
+   return 0;
+}
+
+/*-- find_module_by_content ----------------------------------------------------
+ *
+ *      Look for a module that has already been loaded, and has the same
+ *      content as a newly loaded one.  The sizes are compared first, so the
+ *      contents only get compared when they are very likely identical.
+ *
+ * Parameters
+ *      IN n:         module id
+ *      IN addr:      the newly loaded module
+ *      IN load_size: its compressed size, in bytes
+ *      IN size:      its decompressed size, in bytes
+ *
+ * Results
+ *      The id of the module, or 0 if none was found.
+ *----------------------------------------------------------------------------*/
+static unsigned int find_module_by_content(unsigned int n, const void *addr,
+                                           size_t load_size, size_t size)
+{
+   const module_t *mod;
+   unsigned int i;
+
+   for (i = 1; i < n; i++) {
+      mod = &boot.modules[i];
+      if (mod->is_loaded && mod->same_as == 0 &&
+          mod->load_size == load_size && mod->size == size &&
+          memcmp(mod->addr, addr, size) == 0) {
+         return i;
+      }
+   }
+
+   return 0;
+}
+
+/*-- read_module ---------------------------------------------------------------
+ *
+ *      Read a boot module from the boot volume (or from the module cache), and
+ *      decompress it.
+ *
+ * Parameters
+ *      IN  n:         module id
+ *      OUT addr:      the decompressed module
+ *      OUT load_size: the compressed module size, in bytes
+ *      OUT size:      the decompressed module size, in bytes
+ *
+ * Results
  *      ERR_SUCCESS, or a generic error status.
  *----------------------------------------------------------------------------*/
-static int load_module(unsigned int n)
+static int read_module(unsigned int n, void **addr, size_t *load_size,
+                       size_t *size)
 {
    const char *filepath;
-   size_t load_size, size;
-   void *addr;
    int status;
    uint64_t start_time, end_time;
    bool show_bandwidth = boot.is_network_boot || boot.debug;
 
    filepath = boot.modules[n].filename;
-   Log(LOG_INFO, "Loading %s\n", filepath);
 
    if (show_bandwidth) {
       start_time = firmware_get_time_ms(false);
    }
-   status = file_load(boot.volid, filepath,
-                      (boot.load_size > 0) ? load_callback : NULL,
-                      &addr, &load_size);
+   status = cache_load(n, load_callback, addr, load_size);
    if (status != ERR_SUCCESS) {
-      return status;
+      status = file_load(boot.volid, filepath, load_callback, addr,
+                         load_size);
+      if (status != ERR_SUCCESS) {
+         return status;
+      }
+      cache_store(n, *addr, *load_size);
    }
 
    if (show_bandwidth) {
@@ -414,10 +601,11 @@ static int load_module(unsigned int n)
    }
 
    /* Boot modules should be in compressed(gzip) format. */
-   size = load_size;
-   status = extract_cksum_module(filepath, &addr, &size,
+   *size = *load_size;
+   status = extract_cksum_module(n, filepath, addr, size,
                                  &boot.modules[n].md5_compressed,
-                                 &boot.modules[n].md5_uncompressed);
+                                 &boot.modules[n].md5_uncompressed,
+                                 &boot.modules[n].md5_valid);
 
    if (status != ERR_SUCCESS) {
       const module_t *mod = &boot.modules[n];
@@ -433,13 +621,11 @@ static int load_module(unsigned int n)
           * and contains garbage.
           */
          Log(LOG_WARNING, "Warning: uncompressed module %s\n", filepath);
-         Log(LOG_WARNING, "MD5: %s, size %zu\n", md5str, load_size);
+         Log(LOG_WARNING, "MD5: %s, size %zu\n", md5str, *load_size);
       } else {
          Log(LOG_ERR, "Error %d (%s) while loading module: %s\n",
              status, error_str[status], filepath);
          Log(LOG_ERR, "Compressed MD5: %s\n", md5str);
-         md5_to_str(&mod->md5_uncompressed, md5str, sizeof(md5str));
-         Log(LOG_ERR, "Decompressed MD5: %s\n", md5str);
          return status;
       }
    }
@@ -450,6 +636,66 @@ static int load_module(unsigned int n)
       boot.load_time += boot.modules[n].load_time;
    }
 
+   return ERR_SUCCESS;
+}
+
+/*-- load_module --------------------------------------------------------------
+ *
+ *      Load a boot module.
+ *
+ *      A module that is listed more than once, either under the same path or
+ *      under different paths with identical contents, is only kept once in
+ *      memory.  The copies share the image of the first one (see same_as in
+ *      module_t), and are relocated together with it.
+ *
+ * Parameters
+ *      IN n: module id
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int load_module(unsigned int n)
+{
+   const char *filepath;
+   size_t load_size, size;
+   unsigned int same_as;
+   void *addr;
+   int status;
+
+   filepath = boot.modules[n].filename;
+   Log(LOG_INFO, "Loading %s\n", filepath);
+
+   same_as = find_module_by_path(n);
+   if (same_as != 0) {
+      const module_t *mod = &boot.modules[same_as];
+
+      addr = mod->addr;
+      load_size = mod->load_size;
+      size = mod->size;
+      memcpy(&boot.modules[n].md5_compressed, &mod->md5_compressed,
+             sizeof (md5_t));
+      memcpy(&boot.modules[n].md5_uncompressed, &mod->md5_uncompressed,
+             sizeof (md5_t));
+      boot.modules[n].md5_valid = mod->md5_valid;
+      load_callback(load_size);
+   } else {
+      status = read_module(n, &addr, &load_size, &size);
+      if (status != ERR_SUCCESS) {
+         return status;
+      }
+
+      same_as = find_module_by_content(n, addr, load_size, size);
+      if (same_as != 0) {
+         sys_free(addr);
+         addr = boot.modules[same_as].addr;
+      }
+   }
+
+   if (same_as != 0) {
+      Log(LOG_DEBUG, "%s: same as %s, sharing its image\n", filepath,
+          boot.modules[same_as].filename);
+   }
+
    if (n == 0) {
       /*
        * On x86, kernel can be Multiboot or ESXBootInfo.
@@ -470,7 +716,14 @@ static int load_module(unsigned int n)
    }
 
    if (boot.tpm_measure) {
-      status = tpm_extend_module(filepath, addr, size);
+      tpm_digests_t *digests = &boot.modules[n].tpm_digests;
+
+      /* A duplicate module reuses the digests of the image it shares. */
+      if (same_as != 0) {
+         digests = &boot.modules[same_as].tpm_digests;
+      }
+
+      status = tpm_extend_module(filepath, addr, size, digests);
       if (status != ERR_SUCCESS) {
          Log(LOG_ERR, "Failed to measure '%s' into TPM: %s", filepath,
              error_str[status]);
@@ -481,6 +734,7 @@ static int load_module(unsigned int n)
    boot.modules[n].addr = addr;
    boot.modules[n].load_size = load_size;
    boot.modules[n].size = size;
+   boot.modules[n].same_as = same_as;
    boot.modules[n].is_loaded = true;
 
    if (boot.load_size == 0) {
@@ -552,6 +806,35 @@ static void log_transfer_stats(unsigned int num_modules_loaded,
        pretty_size, pretty_unit_str, size_extracted);
 }
 
+/*-- prefetch_modules ----------------------------------------------------------
+ *
+ *      Start loading the next few modules in the background, if the boot
+ *      volume supports it, so that several transfers are in flight while the
+ *      current module is being loaded.  Modules are queued in order, and
+ *      queueing stops at the first one that cannot be prefetched; those that
+ *      are already queued are skipped by the firmware, and those that will be
+ *      loaded from the local cache or shared with another module are not
+ *      queued.
+ *
+ * Parameters
+ *      IN first: id of the first module to prefetch
+ *----------------------------------------------------------------------------*/
+static void prefetch_modules(unsigned int first)
+{
+   unsigned int n;
+   size_t size;
+
+   for (n = first; n < boot.modules_nr; n++) {
+      if (find_module_by_path(n) != 0 || cache_lookup(n, &size)) {
+         continue;
+      }
+      if (file_prefetch(boot.volid, boot.modules[n].filename) !=
+          ERR_SUCCESS) {
+         break;
+      }
+   }
+}
+
 /*-- load_boot_modules----------------------------------------------------------
  *
  *      Load kernel and modules into memory (do not relocate them).
@@ -583,10 +866,23 @@ int load_boot_modules(void)
    load_sanity_check();
 
    for ( ; i < boot.modules_nr; i++) {
+      prefetch_modules(i + 1);
+      update_load_size_hint();
+
       status = load_module(i);
       if (status != ERR_SUCCESS) {
          return status;
       }
+
+      /*
+       * Submit one queued TPM measurement per module, while the prefetched
+       * transfers go on in the background, rather than all of them at the
+       * end of the load.  This is not done from the transports' wait loops:
+       * without a hash provider, each event is a firmware HashLogExtendEvent
+       * of a whole module, which can take seconds.
+       */
+      tpm_poll();
+
       if (boot.modules[i].is_loaded) {
          num_modules_loaded++;
          size_transferred += boot.modules[i].load_size;
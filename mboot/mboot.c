@@ -7,7 +7,7 @@
 /*
  * mboot.c -- ESXBootInfo (and Multiboot) loader
  *
- *   mboot [aSstRpeVDQU] -c <FILEPATH> [KERNEL_OPTIONS]
+ *   mboot [aSstRpeVDMQU] -c <FILEPATH> [KERNEL_OPTIONS]
  *
  *      OPTIONS
  *         -a             Do not pass extended attributes in the Multiboot
@@ -34,6 +34,10 @@
  *                        initialized.  Without this option only LOG_INFO and
  *                        below are sent to the GUI.
  *         -D             Enable additional debug logging; see code for details.
+ *         -M             Compute the MD5 sums of the boot modules as they are
+ *                        loaded, and log them.  Implied by -D.  Without this
+ *                        option, the MD5 sums are only computed to diagnose a
+ *                        module that failed to load or to verify.
  *         -L             Final log expansion size can be configured with this
  *                        option [size in bytes].
  *         -H             Ignore graphical framebuffer and boot ESXi headless.
@@ -48,6 +52,17 @@
  *         -r             Enable the hardware runtime watchdog.
  *         -b <BLKSIZE>   For TFTP transfers, set the blksize option to the
  *                        given value, default 1468.  UEFI only.
+ *         -C <DIR>       When booting from the network, keep a copy of the boot
+ *                        modules in DIR on the EFI System Partition, and load
+ *                        them from there on the next boot if the configuration
+ *                        file has not changed.  Over HTTP, each cached
+ *                        module is revalidated with its ETag and refetched
+ *                        if the server does not answer 304 Not Modified.
+ *                        Over TFTP, changes to the modules on the server are
+ *                        NOT detected, except for a size change reported by
+ *                        tsize: a module replaced under the same name and
+ *                        size keeps being loaded from the cache until the
+ *                        configuration file changes.  UEFI only.
  *
  * Note: if you add more options that take arguments, be sure to update
  * safeboot.c so that safeboot can pass them through to mboot.
@@ -93,8 +108,10 @@ static int clean(int status)
       }
    }
 
+   cache_close(false);
    sys_free(kopts);
    sys_free(boot.cfgfile);
+   sys_free(boot.cache_dir);
    uninstall_acpi_tables();
    unload_boot_modules();
    config_clear();
@@ -140,7 +157,7 @@ static int mboot_init(int argc, char **argv)
    optind = 1;
 
    do {
-      opt = getopt(argc, argv, ":ac:R:p:S:s:t:VeDL:HQUN:rb:");
+      opt = getopt(argc, argv, ":ac:R:p:S:s:t:VeDML:HQUN:rb:C:");
       switch (opt) {
          case -1:
             break;
@@ -204,6 +221,9 @@ static int mboot_init(int argc, char **argv)
          case 'D':
             boot.debug = true;
             break;
+         case 'M':
+            boot.md5_sums = true;
+            break;
          case 'H':
             boot.headless = true;
             break;
@@ -230,6 +250,12 @@ static int mboot_init(int argc, char **argv)
             }
             tftp_set_block_size(atoi(optarg));
             break;
+         case 'C':
+            boot.cache_dir = strdup(optarg);
+            if (boot.cache_dir == NULL) {
+               return ERR_OUT_OF_RESOURCES;
+            }
+            break;
          case 'd':
             /*
              * XXX: 'drive number/signature' (To be implemented)
@@ -492,6 +518,7 @@ int main(int argc, char **argv)
    handoff_t *handoff;
    run_addr_t ebi;
    int status;
+   bool cache_ok = true;
 #ifdef SECURE_BOOT
    bool crypto_module = false;
 #endif
@@ -552,6 +579,8 @@ int main(int argc, char **argv)
       return clean(status);
    }
 
+   measure_init(boot.tpm_firmware_hash);
+
    if (boot.runtimewd) {
       Log(LOG_DEBUG, "Initializing hardware runtime watchdog...");
       status = start_runtimewd();
@@ -610,6 +639,7 @@ int main(int argc, char **argv)
       Log(LOG_WARNING, "Falling back to internal crypto suite");
    }
 #endif
+   secure_boot_stream_start(crypto_module);
 #endif
 
    status = install_acpi_tables();
@@ -625,6 +655,10 @@ int main(int argc, char **argv)
 #ifdef SECURE_BOOT
    status = secure_boot_check(crypto_module);
    if (status != ERR_SUCCESS) {
+      if (status != ERR_NOT_FOUND) {
+         /* Don't keep modules whose signatures did not check out. */
+         cache_ok = false;
+      }
       if (status == ERR_NOT_FOUND) {
          Log(LOG_INFO, "Boot modules are not signed");
       } else if (status == ERR_LOAD_ERROR) {
@@ -638,6 +672,13 @@ int main(int argc, char **argv)
    }
 #endif
 
+   /*
+    * Modules have been checked, they can now be kept for the next boot.
+    * Modules that failed the check are left out of the cache even when secure
+    * boot is off and the boot goes on with them.
+    */
+   cache_close(cache_ok);
+
    /* Must be before boot_init, where the event log is captured. */
    if (boot.tpm_measure) {
       status = measure_kernel_options();
@@ -651,6 +692,13 @@ int main(int argc, char **argv)
          Log(LOG_WARNING, "Failed to measure asset tag into TPM: %s",
              error_str[status]);
       }
+
+      status = tpm_flush();
+      if (status != ERR_SUCCESS) {
+         Log(LOG_ERR, "Failed to complete TPM measurements: %s",
+             error_str[status]);
+         return clean(status);
+      }
    }
 
    Log(LOG_DEBUG, "Initializing %s standard (boot magic 0x%x)...",
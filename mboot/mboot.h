@@ -20,6 +20,7 @@
 #include <error.h>
 #include <efi_info.h>
 #include <md5.h>
+#include <boot_services.h>
 
 /*
  * trampoline.s
@@ -124,11 +125,17 @@ typedef struct {
    char *options;             /* Module option string */
    md5_t md5_compressed;      /* md5sum compressed module */
    md5_t md5_uncompressed;    /* md5sum uncompressed module */
+   bool md5_valid;            /* True if the md5sums have been computed */
    void *addr;                /* Load address */
    size_t load_size;          /* Compressed module size (in bytes) */
    size_t size;               /* Decompressed module size (in bytes) */
    bool is_loaded;            /* True if the module has been entirely loaded */
    uint64_t load_time;        /* Time(ms) to load the module */
+   size_t size_hint;          /* Expected load_size, or 0 if not known */
+   bool size_hint_pending;    /* Size may become known later on */
+   unsigned int same_as;      /* If not 0, id of the module whose image is
+                                 shared by this one */
+   tpm_digests_t tpm_digests; /* Digests measured into the TPM */
 } module_t;
 
 typedef struct {
@@ -143,6 +150,8 @@ typedef struct {
    char *cfgfile;             /* Configuration filename */
    char *prefix;              /* Module path prefix */
    char *crypto;              /* Crypto module filename */
+   char *manifest;            /* Signed module manifest filename, or NULL */
+   char *cache_dir;           /* Local module cache directory, or NULL */
    int volid;                 /* Volume to load the kernel/modules from */
    kernel_t kernel;           /* Kernel information */
    unsigned int modules_nr;   /* Number of modules */
@@ -159,6 +168,7 @@ typedef struct {
    char *recovery_cmd;        /* Command to be executed on <SHIFT+R> */
    bool verbose;              /* Verbose mode (true = on, false = off) */
    bool debug;                /* Debug mode (true = on, false = off) */
+   bool md5_sums;             /* Compute module md5sums on every load */
    bool headless;             /* True if no video adapter is found */
    bool bootif;               /* Force BOOTIF= on the kernel command line */
    bool no_mem_attr;          /* Do not pass extended attr in Multiboot mmap */
@@ -167,6 +177,7 @@ typedef struct {
    bool no_rts;               /* Disable UEFI runtime services support */
    bool serial;               /* Is the serial log enabled? */
    bool tpm_measure;          /* Should TPM measurements be made? */
+   bool tpm_firmware_hash;    /* Should the firmware hash TPM measurements? */
    bool report_serial;        /* Should serial console be reported? */
    bool report_cpu_mode;      /* Should ESXBootInfo_CpuMode be reported? */
    bool runtimewd;            /* Is there a hardware runtime watchdog? */
@@ -228,9 +239,39 @@ static INLINE const char *size_unit_to_str(size_unit_t size_unit)
 }
 
 int get_load_size_hint(void);
+int update_load_size_hint(void);
 int load_boot_modules(void);
 void unload_boot_modules(void);
 
+/*
+ * cache.c
+ */
+void cache_open(const char *cfgpath);
+bool cache_lookup(unsigned int n, size_t *size);
+int cache_load(unsigned int n, int (*callback)(size_t), void **buffer,
+               size_t *size);
+void cache_store(unsigned int n, void *buffer, size_t size);
+void cache_close(bool commit);
+
+/*
+ * secure.c
+ */
+#ifdef SECURE_BOOT
+void secure_boot_stream_start(bool crypto_module);
+void *secure_boot_stream_open(unsigned int n);
+void secure_boot_stream_update(const void *data, size_t len, void *stream);
+void secure_boot_stream_close(void *stream, const void *buf, size_t size);
+#else
+#define secure_boot_stream_open(n) ((void)(n), NULL)
+#define secure_boot_stream_update NULL
+#define secure_boot_stream_close(stream, buf, size)
+#endif
+
+/*
+ * measure.c
+ */
+void measure_init(bool firmware_hash);
+
 /*
  * acpi.c
  */
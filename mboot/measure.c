@@ -0,0 +1,413 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * measure.c -- Digests of the TPM measurements
+ *
+ *      With the tpmfirmwarehash=0 boot option, the data measured into the
+ *      TPM is hashed by mboot rather than by the firmware, which is often
+ *      much slower at it: the digests are then extended into the PCRs with
+ *      TPM2_PCR_Extend, and the events are appended to the event log passed
+ *      to the kernel (see tpm_set_hash_provider).  The firmware hashes the
+ *      measurements by default, since that is what the event log consumers
+ *      have been validated against.
+ *
+ *      The PCR banks may use SHA-1, which mbedtls is not built with.  A
+ *      small SHA-1 implementation is provided here for that sole purpose,
+ *      and it is checked against the FIPS 180 test vectors before use.
+ */
+
+#include <string.h>
+#include <sha256.h>
+#include <sha512.h>
+#include <boot_services.h>
+#include "mboot.h"
+
+/*
+ * Every requested algorithm is run over a chunk of the data while it is
+ * still in the cache, before moving on to the next chunk.
+ */
+#define MEASURE_CHUNK_SIZE   (32 * 1024)
+
+#define MEASURE_ALGS         ((1 << TPM_HASH_SHA1) | (1 << TPM_HASH_SHA256) | \
+                              (1 << TPM_HASH_SHA384) | (1 << TPM_HASH_SHA512))
+
+#define SHA1_BLOCK_SIZE      64
+#define SHA1_DIGEST_LENGTH   20
+
+#define ROL32(x, n)          (((x) << (n)) | ((x) >> (32 - (n))))
+
+typedef struct {
+   uint32_t state[5];
+   uint64_t length;           /* Number of bytes hashed so far */
+   uint8_t block[SHA1_BLOCK_SIZE];
+} sha1_context_t;
+
+/*-- get_be32 ------------------------------------------------------------------
+ *
+ *      Read a big-endian 32-bit integer.
+ *
+ * Parameters
+ *      IN p: pointer to the integer
+ *
+ * Results
+ *      The integer value.
+ *----------------------------------------------------------------------------*/
+static INLINE uint32_t get_be32(const uint8_t *p)
+{
+   return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+          ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/*-- put_be32 ------------------------------------------------------------------
+ *
+ *      Write a big-endian 32-bit integer.
+ *
+ * Parameters
+ *      IN  value: the integer value
+ *      OUT p:     where to write the integer
+ *----------------------------------------------------------------------------*/
+static INLINE void put_be32(uint32_t value, uint8_t *p)
+{
+   p[0] = (uint8_t)(value >> 24);
+   p[1] = (uint8_t)(value >> 16);
+   p[2] = (uint8_t)(value >> 8);
+   p[3] = (uint8_t)value;
+}
+
+/*-- sha1_process --------------------------------------------------------------
+ *
+ *      Hash one 64-byte block (FIPS 180-4, section 6.1.2).
+ *
+ * Parameters
+ *      IN/OUT state: the SHA-1 state
+ *      IN     data:  the block
+ *----------------------------------------------------------------------------*/
+static void sha1_process(uint32_t state[5], const uint8_t *data)
+{
+   uint32_t w[16];
+   uint32_t a, b, c, d, e, f, k, t;
+   unsigned int i;
+
+   for (i = 0; i < 16; i++) {
+      w[i] = get_be32(data + 4 * i);
+   }
+
+   a = state[0];
+   b = state[1];
+   c = state[2];
+   d = state[3];
+   e = state[4];
+
+   for (i = 0; i < 80; i++) {
+      if (i >= 16) {
+         t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+         w[i & 15] = ROL32(t, 1);
+      }
+
+      if (i < 20) {
+         f = (b & c) | (~b & d);
+         k = 0x5a827999;
+      } else if (i < 40) {
+         f = b ^ c ^ d;
+         k = 0x6ed9eba1;
+      } else if (i < 60) {
+         f = (b & c) | (b & d) | (c & d);
+         k = 0x8f1bbcdc;
+      } else {
+         f = b ^ c ^ d;
+         k = 0xca62c1d6;
+      }
+
+      t = ROL32(a, 5) + f + e + k + w[i & 15];
+      e = d;
+      d = c;
+      c = ROL32(b, 30);
+      b = a;
+      a = t;
+   }
+
+   state[0] += a;
+   state[1] += b;
+   state[2] += c;
+   state[3] += d;
+   state[4] += e;
+}
+
+/*-- sha1_starts ---------------------------------------------------------------
+ *
+ *      Start a SHA-1 computation.
+ *
+ * Parameters
+ *      OUT ctx: the SHA-1 context
+ *----------------------------------------------------------------------------*/
+static void sha1_starts(sha1_context_t *ctx)
+{
+   ctx->state[0] = 0x67452301;
+   ctx->state[1] = 0xefcdab89;
+   ctx->state[2] = 0x98badcfe;
+   ctx->state[3] = 0x10325476;
+   ctx->state[4] = 0xc3d2e1f0;
+   ctx->length = 0;
+}
+
+/*-- sha1_update ---------------------------------------------------------------
+ *
+ *      Hash more data.
+ *
+ * Parameters
+ *      IN/OUT ctx:  the SHA-1 context
+ *      IN     data: the data
+ *      IN     size: the data size, in bytes
+ *----------------------------------------------------------------------------*/
+static void sha1_update(sha1_context_t *ctx, const uint8_t *data, size_t size)
+{
+   size_t used = ctx->length % SHA1_BLOCK_SIZE;
+   size_t fill;
+
+   ctx->length += size;
+
+   if (used > 0) {
+      fill = SHA1_BLOCK_SIZE - used;
+      if (size < fill) {
+         memcpy(ctx->block + used, data, size);
+         return;
+      }
+
+      memcpy(ctx->block + used, data, fill);
+      sha1_process(ctx->state, ctx->block);
+      data += fill;
+      size -= fill;
+   }
+
+   for (; size >= SHA1_BLOCK_SIZE; size -= SHA1_BLOCK_SIZE) {
+      sha1_process(ctx->state, data);
+      data += SHA1_BLOCK_SIZE;
+   }
+
+   memcpy(ctx->block, data, size);
+}
+
+/*-- sha1_finish ---------------------------------------------------------------
+ *
+ *      Pad the data and return the SHA-1 digest.
+ *
+ * Parameters
+ *      IN/OUT ctx:    the SHA-1 context
+ *      OUT    digest: the digest, SHA1_DIGEST_LENGTH bytes long
+ *----------------------------------------------------------------------------*/
+static void sha1_finish(sha1_context_t *ctx, uint8_t *digest)
+{
+   size_t used = ctx->length % SHA1_BLOCK_SIZE;
+   uint64_t bits = ctx->length * 8;
+   unsigned int i;
+
+   ctx->block[used++] = 0x80;
+   if (used > SHA1_BLOCK_SIZE - sizeof (bits)) {
+      memset(ctx->block + used, 0, SHA1_BLOCK_SIZE - used);
+      sha1_process(ctx->state, ctx->block);
+      used = 0;
+   }
+   memset(ctx->block + used, 0, SHA1_BLOCK_SIZE - sizeof (bits) - used);
+
+   put_be32((uint32_t)(bits >> 32), ctx->block + SHA1_BLOCK_SIZE - 8);
+   put_be32((uint32_t)bits, ctx->block + SHA1_BLOCK_SIZE - 4);
+   sha1_process(ctx->state, ctx->block);
+
+   for (i = 0; i < 5; i++) {
+      put_be32(ctx->state[i], digest + 4 * i);
+   }
+}
+
+/*-- measure_hash --------------------------------------------------------------
+ *
+ *      Hash provider for the TPM measurements (see tpm_hash_provider_t).
+ *
+ * Parameters
+ *      IN  algs:    bitmap of the (1 << tpm_hash_alg_t) digests to compute
+ *      IN  data:    the data to hash
+ *      IN  size:    the data size, in bytes
+ *      OUT digests: the digests
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+static int measure_hash(uint32_t algs, const void *data, size_t size,
+                        tpm_digests_t *digests)
+{
+   const uint8_t *next = data;
+   sha1_context_t sha1;
+   mbedtls_sha256_context sha256;
+   mbedtls_sha512_context sha384;
+   mbedtls_sha512_context sha512;
+   size_t len;
+   int ret = 0;
+
+   if ((algs & ~MEASURE_ALGS) != 0) {
+      return ERR_UNSUPPORTED;
+   }
+
+   mbedtls_sha256_init(&sha256);
+   mbedtls_sha512_init(&sha384);
+   mbedtls_sha512_init(&sha512);
+
+   if (algs & (1 << TPM_HASH_SHA1)) {
+      sha1_starts(&sha1);
+   }
+   if (algs & (1 << TPM_HASH_SHA256)) {
+      ret |= mbedtls_sha256_starts_ret(&sha256, 0);
+   }
+   if (algs & (1 << TPM_HASH_SHA384)) {
+      ret |= mbedtls_sha512_starts_ret(&sha384, 1);
+   }
+   if (algs & (1 << TPM_HASH_SHA512)) {
+      ret |= mbedtls_sha512_starts_ret(&sha512, 0);
+   }
+
+   for (; ret == 0 && size > 0; size -= len) {
+      len = MIN(size, MEASURE_CHUNK_SIZE);
+
+      if (algs & (1 << TPM_HASH_SHA1)) {
+         sha1_update(&sha1, next, len);
+      }
+      if (algs & (1 << TPM_HASH_SHA256)) {
+         ret |= mbedtls_sha256_update_ret(&sha256, next, len);
+      }
+      if (algs & (1 << TPM_HASH_SHA384)) {
+         ret |= mbedtls_sha512_update_ret(&sha384, next, len);
+      }
+      if (algs & (1 << TPM_HASH_SHA512)) {
+         ret |= mbedtls_sha512_update_ret(&sha512, next, len);
+      }
+
+      next += len;
+   }
+
+   if (ret == 0) {
+      if (algs & (1 << TPM_HASH_SHA1)) {
+         sha1_finish(&sha1, digests->digest[TPM_HASH_SHA1]);
+      }
+      if (algs & (1 << TPM_HASH_SHA256)) {
+         ret |= mbedtls_sha256_finish_ret(&sha256,
+                                          digests->digest[TPM_HASH_SHA256]);
+      }
+      if (algs & (1 << TPM_HASH_SHA384)) {
+         ret |= mbedtls_sha512_finish_ret(&sha384,
+                                          digests->digest[TPM_HASH_SHA384]);
+      }
+      if (algs & (1 << TPM_HASH_SHA512)) {
+         ret |= mbedtls_sha512_finish_ret(&sha512,
+                                          digests->digest[TPM_HASH_SHA512]);
+      }
+   }
+
+   mbedtls_sha256_free(&sha256);
+   mbedtls_sha512_free(&sha384);
+   mbedtls_sha512_free(&sha512);
+
+   if (ret != 0) {
+      digests->algs = 0;
+      return ERR_UNKNOWN;
+   }
+
+   digests->algs = algs;
+   return ERR_SUCCESS;
+}
+
+/*
+ * FIPS 180 SHA-1 known-answer tests (FIPS 180-2, appendix A).  The third
+ * message takes the padding into a second block.
+ */
+static const struct {
+   const char *message;
+   uint8_t digest[SHA1_DIGEST_LENGTH];
+} sha1_kat[] = {
+   { "abc",
+     { 0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+       0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d } },
+   { "",
+     { 0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d, 0x32, 0x55,
+       0xbf, 0xef, 0x95, 0x60, 0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09 } },
+   { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     { 0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+       0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1 } }
+};
+
+/* One million repetitions of 'a', hashed 1000 bytes at a time. */
+static const uint8_t sha1_kat_million_a[SHA1_DIGEST_LENGTH] = {
+   0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4, 0xf6, 0x1e,
+   0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31, 0x65, 0x34, 0x01, 0x6f
+};
+
+/*-- sha1_selftest -------------------------------------------------------------
+ *
+ *      Check the SHA-1 implementation against the FIPS 180 test vectors.
+ *      The short messages go through measure_hash(), like the measured
+ *      data; the long one goes through sha1_update() in pieces that are
+ *      not a multiple of the block size.
+ *
+ * Results
+ *      ERR_SUCCESS, or ERR_TEST_FAILURE if a digest does not match.
+ *----------------------------------------------------------------------------*/
+static int sha1_selftest(void)
+{
+   uint8_t block[1000];
+   uint8_t digest[SHA1_DIGEST_LENGTH];
+   tpm_digests_t digests;
+   sha1_context_t ctx;
+   unsigned int i;
+   int status;
+
+   for (i = 0; i < ARRAYSIZE(sha1_kat); i++) {
+      status = measure_hash(1 << TPM_HASH_SHA1, sha1_kat[i].message,
+                            strlen(sha1_kat[i].message), &digests);
+      if (status != ERR_SUCCESS) {
+         return status;
+      }
+      if (memcmp(digests.digest[TPM_HASH_SHA1], sha1_kat[i].digest,
+                 SHA1_DIGEST_LENGTH) != 0) {
+         return ERR_TEST_FAILURE;
+      }
+   }
+
+   memset(block, 'a', sizeof (block));
+   sha1_starts(&ctx);
+   for (i = 0; i < 1000; i++) {
+      sha1_update(&ctx, block, sizeof (block));
+   }
+   sha1_finish(&ctx, digest);
+   if (memcmp(digest, sha1_kat_million_a, SHA1_DIGEST_LENGTH) != 0) {
+      return ERR_TEST_FAILURE;
+   }
+
+   return ERR_SUCCESS;
+}
+
+/*-- measure_init --------------------------------------------------------------
+ *
+ *      Select who hashes the data measured into the TPM.  Must be called
+ *      before anything is measured.  mboot only hashes the measurements if
+ *      its SHA-1 implementation passes the known-answer tests; otherwise
+ *      the firmware keeps doing it.
+ *
+ * Parameters
+ *      IN firmware_hash: true to let the firmware hash the measurements
+ *----------------------------------------------------------------------------*/
+void measure_init(bool firmware_hash)
+{
+   int status;
+
+   if (!firmware_hash) {
+      status = sha1_selftest();
+      if (status != ERR_SUCCESS) {
+         Log(LOG_ERR, "SHA-1 self-test failed: %s. "
+             "Letting the firmware hash the TPM measurements.\n",
+             error_str[status]);
+         firmware_hash = true;
+      }
+   }
+
+   tpm_set_hash_provider(firmware_hash ? NULL : measure_hash);
+}
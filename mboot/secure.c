@@ -48,6 +48,30 @@
  *
  *      NOTE: Any future additions or changes to schema validation will also
  *            need to be made in the QuickBoot secure boot implementation.
+ *
+ *      When the internal crypto suite is used, the signed data of the early
+ *      modules is hashed while the modules are being extracted, so that
+ *      checking a signature only takes the final RSA operation.  As the
+ *      length of the signed data is only known once the trailer at the end of
+ *      the module has been extracted, the last SIG_TRAILER_MAX bytes are held
+ *      back from the hash until the end of the module is reached.  Modules for
+ *      which no such digest is available are hashed before the signatures
+ *      are checked, in parallel on the application processors when the
+ *      firmware provides the MP Services protocol.
+ *
+ *      Optionally, boot.cfg may name a signed manifest (manifest=) listing
+ *      the digests of the early modules.  The manifest is signed like a
+ *      module, with the same schema version as module 0, and its data is a
+ *      text file with one line per module:
+ *
+ *         <hex digest of the module's signed data> <module basename>
+ *
+ *      The digest type is the one of the certificate that signed the module.
+ *      Once the manifest signature has been verified, a module whose digest
+ *      matches its manifest entry needs no RSA operation of its own, so the
+ *      cost of the check hardly depends on the number of modules.  Modules
+ *      that are not listed, or do not match, still have their own signature
+ *      verified, and so does everything if the manifest cannot be used.
  */
 
 #include "mboot.h"
@@ -55,6 +79,8 @@
 #include "libgen.h"
 #include "cert.h"
 
+#include <stdlib.h>
+#include <ctype.h>
 #include <efiutils.h>
 #include <sha256.h>
 #include <sha512.h>
@@ -74,6 +100,74 @@
  */
 #define V1_KEYID_LEN 16
 
+/*
+ * Largest possible signature trailer: key id, RSA signature, signature length
+ * and magic number.
+ */
+#define SIG_TRAILER_MAX (V1_KEYID_LEN + MBEDTLS_MPI_MAX_SIZE + \
+                         2 * sizeof(uint32_t))
+
+#define STREAM_SHA256 (1 << 0)
+#define STREAM_SHA512 (1 << 1)
+
+/*
+ * Digests of the signed data of a module, computed while it was extracted.
+ */
+typedef struct {
+   unsigned digests;          /* STREAM_SHA* bits of the valid digests */
+   size_t dataLen;            /* Length of the data covered by the digests */
+   unsigned char sha256[SHA256_DIGEST_LENGTH];
+   unsigned char sha512[SHA512_DIGEST_LENGTH];
+} StreamDigest;
+
+/*
+ * Signature check of one module, between secure_boot_prepare_sig and
+ * secure_boot_verify_sig.
+ */
+typedef struct {
+   bool needsig;              /* Module must be signed */
+   RawRSACert *cert;          /* Certificate, or NULL if the check failed */
+   const void *data;          /* Signed data */
+   size_t dataLen;            /* Length of the signed data */
+   const uint8_t *sig;        /* RSA signature, after the key id */
+   bool hashed;               /* md holds the digest of the signed data */
+   unsigned mdLen;            /* Length of the digest */
+   unsigned char md[MAX_DIGEST_LENGTH];
+} SigCheck;
+
+static struct {
+   bool enabled;              /* Digests may be computed while extracting */
+   uint32_t schema;           /* Schema version of module 0, or 0 */
+   unsigned digests;          /* Digests needed for modules other than 0 */
+   unsigned nr;               /* Number of entries in results */
+   StreamDigest *results;     /* Digests, by module id */
+
+   /* Module being extracted */
+   unsigned n;
+   unsigned active;           /* STREAM_SHA* bits of the digests in progress */
+   bool needsig;              /* Module is known to need a signature */
+   const uint8_t *base;       /* Start of the extracted data */
+   size_t hashed;             /* Number of bytes hashed so far */
+   mbedtls_sha256_context sha256;
+   mbedtls_sha512_context sha512;
+} Stream;
+
+/*
+ * Entry of the signed module manifest.
+ */
+typedef struct {
+   const char *name;          /* Module basename, within the manifest data */
+   size_t nameLen;            /* Length of the basename */
+   unsigned mdLen;            /* Length of the digest */
+   unsigned char md[MAX_DIGEST_LENGTH];
+} ManifestEntry;
+
+static struct {
+   void *buf;                 /* Manifest file, or NULL */
+   unsigned nr;               /* Number of entries */
+   ManifestEntry *entries;    /* Entries, once the signature is verified */
+} Manifest;
+
 static VMW_MBEDTLS_PROTOCOL *mbedtls = NULL;
 
 static VMW_MBEDTLS_PROTOCOL InternalMbedTls = {
@@ -203,25 +297,23 @@ static int secure_boot_parse_module(void *addr,           //IN
 }
 
 
-/*-- find_named_module ---------------------------------------------------------
+/*-- lookup_named_module -------------------------------------------------------
  *
  *      Look for the basename (stripping directory name and extension) of the
- *      given name in a NamedModule list.  If found, increment its count.
+ *      given name in a NamedModule list.
  *
  * Parameters
  *      IN name:        module name
  *      IN list:        list of known names
  *
  * Results
- *      ERR_SUCCESS:         name is in the list and its count is now 1
- *      ERR_NOT_FOUND:       name is not in the list (not an error)
- *      ERR_ALREADY_STARTED: name is in the list and its count is now >1
+ *      The list entry, or NULL if the name is not in the list.
  *----------------------------------------------------------------------------*/
-int find_named_module(char *name, NamedModule *list)
+static NamedModule *lookup_named_module(const char *name, NamedModule *list)
 {
-   char *slash;
-   char *dot;
-   char *bn;
+   const char *slash;
+   const char *dot;
+   const char *bn;
    int len;
 
    slash = strrchr(name, '/');
@@ -239,38 +331,421 @@ int find_named_module(char *name, NamedModule *list)
 
    while (list->name != NULL) {
       if (strncmp(bn, list->name, len) == 0 && list->name[len] == '\0') {
-         list->found++;
-         if (list->found > 1) {
-            return ERR_ALREADY_STARTED;
-         } else {
-            return ERR_SUCCESS;
-         }
+         return list;
       }
       list++;
    }
-   return ERR_NOT_FOUND;
+   return NULL;
 }
 
 
-/*-- secure_boot_check_sig -----------------------------------------------------
+/*-- find_named_module ---------------------------------------------------------
  *
- *      Check one attached signature
+ *      Look for the basename (stripping directory name and extension) of the
+ *      given name in a NamedModule list.  If found, increment its count.
  *
  * Parameters
- *      IN schema:  schema version number (determines signature algorithm)
- *      IN data:    signed data
- *      IN dataLen: length of data in bytes
- *      IN sig:     signature
- *      IN sigLen   length of signature in bytes
+ *      IN name:        module name
+ *      IN list:        list of known names
  *
  * Results
- *      true if signature checks out; false if not.
+ *      ERR_SUCCESS:         name is in the list and its count is now 1
+ *      ERR_NOT_FOUND:       name is not in the list (not an error)
+ *      ERR_ALREADY_STARTED: name is in the list and its count is now >1
  *----------------------------------------------------------------------------*/
-static bool secure_boot_check_sig(uint32_t schema,
-                                  void *data, size_t dataLen,
-                                  void *sig, size_t sigLen)
+int find_named_module(char *name, NamedModule *list)
 {
-   unsigned char md[MAX_DIGEST_LENGTH];
+   NamedModule *entry;
+
+   entry = lookup_named_module(name, list);
+   if (entry == NULL) {
+      return ERR_NOT_FOUND;
+   }
+
+   entry->found++;
+   if (entry->found > 1) {
+      return ERR_ALREADY_STARTED;
+   } else {
+      return ERR_SUCCESS;
+   }
+}
+
+
+/*-- schema_named_modules ------------------------------------------------------
+ *
+ *      Get the list of early modules that are identified by name in a schema.
+ *
+ * Parameters
+ *      IN schema: schema version number
+ *
+ * Results
+ *      The list, or NULL if the schema version is unknown.
+ *----------------------------------------------------------------------------*/
+static NamedModule *schema_named_modules(uint32_t schema)
+{
+   switch (schema) {
+   case 1:
+      return v1Named;
+   case 2:
+   case 3:
+      return v2Named;
+   case 4:
+      return v4Named;
+   default:
+      return NULL;
+   }
+}
+
+
+/*-- find_cert -----------------------------------------------------------------
+ *
+ *      Look up the certificate for a key id.
+ *
+ * Parameters
+ *      IN keyid: key id, from the beginning of a signature
+ *
+ * Results
+ *      The certificate, or NULL if the key id is unknown.
+ *----------------------------------------------------------------------------*/
+static RawRSACert *find_cert(const char *keyid)
+{
+   RawRSACert *cert;
+
+   for (cert = certs; cert->keyid != NULL; ++cert) {
+      if (strcmp(keyid, cert->keyid) == 0) {
+         return cert;
+      }
+   }
+   return NULL;
+}
+
+
+/*-- digest_stream_bit ---------------------------------------------------------
+ *
+ *      Map a message digest type to its STREAM_SHA* bit.
+ *
+ * Parameters
+ *      IN md: message digest type
+ *
+ * Results
+ *      The bit, or 0 if the digest type is not supported.
+ *----------------------------------------------------------------------------*/
+static unsigned digest_stream_bit(mbedtls_md_type_t md)
+{
+   switch (md) {
+   case MBEDTLS_MD_SHA256:
+      return STREAM_SHA256;
+   case MBEDTLS_MD_SHA512:
+      return STREAM_SHA512;
+   default:
+      return 0;
+   }
+}
+
+
+/*-- secure_boot_stream_start --------------------------------------------------
+ *
+ *      Get ready to compute the digests of the signed modules while they are
+ *      being extracted.  Must be called before the modules are loaded.
+ *
+ *      The digests are only computed with the internal crypto suite; the
+ *      crypto module interface has no incremental hashing, so in that case
+ *      the modules are hashed by secure_boot_check.
+ *
+ * Parameters
+ *      IN crypto_module: the external crypto module will be used
+ *----------------------------------------------------------------------------*/
+void secure_boot_stream_start(bool crypto_module)
+{
+   sys_free(Stream.results);
+   memset(&Stream, 0, sizeof (Stream));
+
+   if (crypto_module || boot.modules_nr == 0) {
+      return;
+   }
+
+   Stream.results = calloc(boot.modules_nr, sizeof (StreamDigest));
+   if (Stream.results == NULL) {
+      return;
+   }
+   Stream.nr = boot.modules_nr;
+   Stream.enabled = true;
+}
+
+
+/*-- secure_boot_stream_end ----------------------------------------------------
+ *
+ *      Free the digests computed while extracting the modules.
+ *----------------------------------------------------------------------------*/
+static void secure_boot_stream_end(void)
+{
+   sys_free(Stream.results);
+   memset(&Stream, 0, sizeof (Stream));
+}
+
+
+/*-- stream_hash ---------------------------------------------------------------
+ *
+ *      Feed the extracted data of the current module to its digests, up to
+ *      the given offset.
+ *
+ * Parameters
+ *      IN end: offset in the module up to which the data is hashed
+ *----------------------------------------------------------------------------*/
+static void stream_hash(size_t end)
+{
+   const uint8_t *data = Stream.base + Stream.hashed;
+   size_t len = end - Stream.hashed;
+
+   if ((Stream.active & STREAM_SHA256) != 0) {
+      mbedtls_sha256_update_ret(&Stream.sha256, data, len);
+   }
+   if ((Stream.active & STREAM_SHA512) != 0) {
+      mbedtls_sha512_update_ret(&Stream.sha512, data, len);
+   }
+   Stream.hashed = end;
+}
+
+
+/*-- stream_abort --------------------------------------------------------------
+ *
+ *      Stop computing the digests of the current module.
+ *----------------------------------------------------------------------------*/
+static void stream_abort(void)
+{
+   if ((Stream.active & STREAM_SHA256) != 0) {
+      mbedtls_sha256_free(&Stream.sha256);
+   }
+   if ((Stream.active & STREAM_SHA512) != 0) {
+      mbedtls_sha512_free(&Stream.sha512);
+   }
+   Stream.active = 0;
+}
+
+
+/*-- secure_boot_stream_open ---------------------------------------------------
+ *
+ *      Start computing the digests of a module that is about to be extracted,
+ *      if it may need a signature.
+ *
+ *      Module 0 is hashed with every digest type in use by the certificates.
+ *      Its signature then tells which digest type the others should be hashed
+ *      with, and which schema (and so which named modules) applies.  Other
+ *      modules are only hashed if they are named by the schema, or turn out
+ *      to be ELF binaries.
+ *
+ * Parameters
+ *      IN n: module id
+ *
+ * Results
+ *      The stream to pass to secure_boot_stream_update and
+ *      secure_boot_stream_close, or NULL if the module is not to be hashed.
+ *----------------------------------------------------------------------------*/
+void *secure_boot_stream_open(unsigned int n)
+{
+   RawRSACert *cert;
+   NamedModule *named;
+   unsigned digests;
+
+   if (!Stream.enabled || n >= Stream.nr) {
+      return NULL;
+   }
+   memset(&Stream.results[n], 0, sizeof (StreamDigest));
+
+   if (n == 0) {
+      digests = 0;
+      for (cert = certs; cert->keyid != NULL; ++cert) {
+         digests |= digest_stream_bit(cert->digest);
+      }
+      Stream.needsig = true;
+   } else {
+      named = schema_named_modules(Stream.schema);
+      if (named == NULL) {
+         return NULL;
+      }
+      digests = Stream.digests;
+      Stream.needsig =
+         lookup_named_module(boot.modules[n].filename, named) != NULL;
+   }
+   if (digests == 0) {
+      return NULL;
+   }
+
+   Stream.n = n;
+   Stream.active = digests;
+   Stream.base = NULL;
+   Stream.hashed = 0;
+   if ((digests & STREAM_SHA256) != 0) {
+      mbedtls_sha256_init(&Stream.sha256);
+      mbedtls_sha256_starts_ret(&Stream.sha256, 0);
+   }
+   if ((digests & STREAM_SHA512) != 0) {
+      mbedtls_sha512_init(&Stream.sha512);
+      mbedtls_sha512_starts_ret(&Stream.sha512, 0);
+   }
+
+   return &Stream;
+}
+
+
+/*-- secure_boot_stream_update -------------------------------------------------
+ *
+ *      Hash newly extracted module data, except for what may turn out to be
+ *      the signature trailer.  Suitable as a gzip_extract_stream consumer.
+ *
+ * Parameters
+ *      IN data:   newly extracted data, following any previous data
+ *      IN len:    length of data
+ *      IN stream: stream from secure_boot_stream_open
+ *----------------------------------------------------------------------------*/
+void secure_boot_stream_update(const void *data, size_t len, void *stream)
+{
+   size_t end;
+
+   if (stream == NULL || Stream.active == 0) {
+      return;
+   }
+
+   if (Stream.base == NULL) {
+      Stream.base = data;
+      if (!Stream.needsig &&
+          (len < SELFMAG || memcmp(ELFMAG, data, SELFMAG) != 0)) {
+         stream_abort();
+         return;
+      }
+   }
+
+   end = (const uint8_t *)data + len - Stream.base;
+   if (end > SIG_TRAILER_MAX) {
+      stream_hash(end - SIG_TRAILER_MAX);
+   }
+}
+
+
+/*-- secure_boot_stream_close --------------------------------------------------
+ *
+ *      Finish computing the digests of a module, now that its signed data
+ *      length is known.  If the module could not be extracted, or its
+ *      signature trailer cannot be parsed, no digests are recorded and
+ *      secure_boot_check will deal with the module as usual.
+ *
+ * Parameters
+ *      IN stream: stream from secure_boot_stream_open, or NULL
+ *      IN buf:    extracted module, or NULL on error
+ *      IN size:   size of the extracted module
+ *----------------------------------------------------------------------------*/
+void secure_boot_stream_close(void *stream, const void *buf, size_t size)
+{
+   StreamDigest *result;
+   RawRSACert *cert;
+   char keyid[V1_KEYID_LEN + 1];
+   uint32_t schema;
+   size_t dataLen, sigLen;
+   void *sig;
+
+   if (stream == NULL || Stream.active == 0) {
+      return;
+   }
+
+   if (buf == NULL || buf != Stream.base ||
+       secure_boot_parse_module((void *)buf, size, &schema, NULL, &dataLen,
+                                &sig, &sigLen) != ERR_SUCCESS ||
+       dataLen < Stream.hashed) {
+      stream_abort();
+      return;
+   }
+
+   stream_hash(dataLen);
+
+   result = &Stream.results[Stream.n];
+   if ((Stream.active & STREAM_SHA256) != 0) {
+      mbedtls_sha256_finish_ret(&Stream.sha256, result->sha256);
+   }
+   if ((Stream.active & STREAM_SHA512) != 0) {
+      mbedtls_sha512_finish_ret(&Stream.sha512, result->sha512);
+   }
+   result->digests = Stream.active;
+   result->dataLen = dataLen;
+   stream_abort();
+
+   if (Stream.n == 0 && sigLen >= V1_KEYID_LEN) {
+      memcpy(keyid, sig, V1_KEYID_LEN);
+      keyid[V1_KEYID_LEN] = '\0';
+      cert = find_cert(keyid);
+      if (cert != NULL) {
+         Stream.schema = schema;
+         Stream.digests = digest_stream_bit(cert->digest);
+      }
+   }
+}
+
+
+/*-- streamed_digest -----------------------------------------------------------
+ *
+ *      Get the digest of a module's signed data that was computed while the
+ *      module was extracted.
+ *
+ * Parameters
+ *      IN streamed: digests of the module, or NULL
+ *      IN bit:      STREAM_SHA* bit of the digest type
+ *      IN dataLen:  length of the signed data
+ *
+ * Results
+ *      The digest, or NULL if it is not available.
+ *----------------------------------------------------------------------------*/
+static const unsigned char *streamed_digest(const StreamDigest *streamed,
+                                            unsigned bit, size_t dataLen)
+{
+   if (streamed == NULL || (streamed->digests & bit) == 0 ||
+       streamed->dataLen != dataLen) {
+      return NULL;
+   }
+   return bit == STREAM_SHA256 ? streamed->sha256 : streamed->sha512;
+}
+
+
+/*-- set_raw_mpi ---------------------------------------------------------------
+ *
+ *      Point an mbedtls big number to precomputed limbs.
+ *
+ * Parameters
+ *      OUT X:   the big number
+ *      IN  raw: the limbs
+ *----------------------------------------------------------------------------*/
+static void set_raw_mpi(mbedtls_mpi *X, const RawMpi *raw)
+{
+   X->s = 1;
+   X->n = raw->n;
+   X->p = raw->p;
+}
+
+
+/*-- secure_boot_prepare_sig -------------------------------------------------
+ *
+ *      Get ready to check one attached signature: find and set up its
+ *      certificate, and check the signature length.  The digest of the signed
+ *      data is taken from the digests computed while extracting the module if
+ *      possible; otherwise it is left for hash_job to compute.
+ *
+ * Parameters
+ *      IN schema:   schema version number (determines signature algorithm)
+ *      IN data:     signed data
+ *      IN dataLen:  length of data in bytes
+ *      IN sig:      signature
+ *      IN sigLen:   length of signature in bytes
+ *      IN streamed: digests computed while extracting the module, or NULL
+ *      OUT check:   the signature check
+ *
+ * Results
+ *      true if the signature can be checked; false if not.
+ *----------------------------------------------------------------------------*/
+static bool secure_boot_prepare_sig(uint32_t schema,
+                                    void *data, size_t dataLen,
+                                    void *sig, size_t sigLen,
+                                    const StreamDigest *streamed,
+                                    SigCheck *check)
+{
+   const unsigned char *digest;
    int errcode;
    char keyid[V1_KEYID_LEN + 1];
    RawRSACert *cert;
@@ -284,18 +759,14 @@ static bool secure_boot_check_sig(uint32_t schema,
    memcpy(keyid, sig, V1_KEYID_LEN);
    keyid[V1_KEYID_LEN] = '\0';
 
-   for (cert = certs; ; ++cert) {
-      if (cert->keyid == NULL) {
-         Log(LOG_WARNING, "Signature has unexpected keyid %s", keyid);
-         return false;
-      }
-      if (strcmp(keyid, cert->keyid) == 0) {
-         break;
-      }
+   cert = find_cert(keyid);
+   if (cert == NULL) {
+      Log(LOG_WARNING, "Signature has unexpected keyid %s", keyid);
+      return false;
    }
 
    if (!cert->parsed) {
-      Log(LOG_DEBUG, "Parsing keyid %s", cert->keyid);
+      Log(LOG_DEBUG, "Setting up keyid %s", cert->keyid);
       mbedtls->RsaInit(&cert->rsa, MBEDTLS_RSA_PKCS_V15, MBEDTLS_MD_NONE);
       /*
        * Modulus has always MSB bit set.  To ensure it is not treated as
@@ -307,19 +778,14 @@ static bool secure_boot_check_sig(uint32_t schema,
        * length in bytes.
        */
       cert->rsa.len = cert->modulusLength - 1;
-      errcode = mbedtls->MpiReadBinary(&cert->rsa.N,
-                                       cert->certData + cert->modulusStart,
-                                       cert->modulusLength);
-      if (!errcode) {
-         errcode = mbedtls->MpiReadBinary(&cert->rsa.E,
-                                          cert->certData + cert->exponentStart,
-                                          cert->exponentLength);
-      }
-      if (errcode) {
-         Log(LOG_WARNING, "Error parsing public key %s: -0x%x",
-             cert->keyid, -errcode);
-         return false;
-      }
+      /*
+       * N, E and R^2 mod N were converted to limbs at build time, so no
+       * big number needs to be parsed or computed here.  The limbs are
+       * used in place: the context is never freed.
+       */
+      set_raw_mpi(&cert->rsa.N, &cert->N);
+      set_raw_mpi(&cert->rsa.E, &cert->E);
+      set_raw_mpi(&cert->rsa.RN, &cert->RR);
       cert->parsed = true;
    }
 
@@ -342,25 +808,115 @@ static bool secure_boot_check_sig(uint32_t schema,
 
    switch (cert->digest) {
    case MBEDTLS_MD_SHA256:
-      mbedtls->Sha256Ret(data, dataLen, md, 0);
-      errcode = mbedtls->RsaPkcs1Verify(&cert->rsa, NULL, NULL,
-                                        MBEDTLS_RSA_PUBLIC, cert->digest,
-                                        SHA256_DIGEST_LENGTH, md,
-                                        (uint8_t*)sig + V1_KEYID_LEN);
+      check->mdLen = SHA256_DIGEST_LENGTH;
+      digest = streamed_digest(streamed, STREAM_SHA256, dataLen);
       break;
 
    case MBEDTLS_MD_SHA512:
-      mbedtls->Sha512Ret(data, dataLen, md, 0);
-      errcode = mbedtls->RsaPkcs1Verify(&cert->rsa, NULL, NULL,
-                                        MBEDTLS_RSA_PUBLIC, cert->digest,
-                                        SHA512_DIGEST_LENGTH, md,
-                                        (uint8_t*)sig + V1_KEYID_LEN);
+      check->mdLen = SHA512_DIGEST_LENGTH;
+      digest = streamed_digest(streamed, STREAM_SHA512, dataLen);
       break;
 
    default:
       NOT_REACHED();
    }
 
+   check->cert = cert;
+   check->data = data;
+   check->dataLen = dataLen;
+   check->sig = (uint8_t *)sig + V1_KEYID_LEN;
+   check->hashed = digest != NULL;
+   if (check->hashed) {
+      memcpy(check->md, digest, check->mdLen);
+   }
+
+   return true;
+}
+
+
+/*-- hash_job ------------------------------------------------------------------
+ *
+ *      Compute the digest of the signed data of one module (see mp_job_t).
+ *      May run on an AP: only the module's own SigCheck is touched, and the
+ *      hash functions neither allocate memory nor log.
+ *
+ * Parameters
+ *      IN arg:   the signature checks that need a digest
+ *      IN index: index of the signature check in arg
+ *----------------------------------------------------------------------------*/
+static void hash_job(void *arg, unsigned int index)
+{
+   SigCheck *check = ((SigCheck **)arg)[index];
+
+   if (check->cert->digest == MBEDTLS_MD_SHA256) {
+      mbedtls->Sha256Ret(check->data, check->dataLen, check->md, 0);
+   } else {
+      mbedtls->Sha512Ret(check->data, check->dataLen, check->md, 0);
+   }
+   check->hashed = true;
+}
+
+
+/*-- hash_modules --------------------------------------------------------------
+ *
+ *      Compute the digests that were not computed while extracting the
+ *      modules.  The modules are hashed in parallel on the application
+ *      processors when there are several of them.
+ *
+ * Parameters
+ *      IN/OUT checks: the signature checks
+ *      IN     nr:     number of signature checks
+ *----------------------------------------------------------------------------*/
+static void hash_modules(SigCheck *checks, unsigned nr)
+{
+   SigCheck **jobs;
+   unsigned count, cpus, i;
+
+   jobs = malloc(nr * sizeof (SigCheck *));
+   if (jobs == NULL) {
+      /* hashed stays false: secure_boot_verify_sig hashes the data itself */
+      return;
+   }
+
+   count = 0;
+   for (i = 0; i < nr; i++) {
+      if (checks[i].cert != NULL && !checks[i].hashed) {
+         jobs[count++] = &checks[i];
+      }
+   }
+
+   if (count > 0) {
+      cpus = mp_run_jobs(hash_job, jobs, count);
+      Log(LOG_DEBUG, "Hashed %u signed modules on %u processors",
+          count, cpus);
+   }
+
+   sys_free(jobs);
+}
+
+
+/*-- secure_boot_verify_sig ----------------------------------------------------
+ *
+ *      Verify one attached signature, once the digest of the signed data is
+ *      known.
+ *
+ * Parameters
+ *      IN check: the signature check
+ *
+ * Results
+ *      true if signature checks out; false if not.
+ *----------------------------------------------------------------------------*/
+static bool secure_boot_verify_sig(SigCheck *check)
+{
+   int errcode;
+
+   if (!check->hashed) {
+      hash_job(&check, 0);
+   }
+
+   errcode = mbedtls->RsaPkcs1Verify(&check->cert->rsa, NULL, NULL,
+                                     MBEDTLS_RSA_PUBLIC, check->cert->digest,
+                                     check->mdLen, check->md, check->sig);
    if (errcode) {
       Log(LOG_WARNING, "Error verifying signature: -0x%x", -errcode);
       return false;
@@ -370,30 +926,345 @@ static bool secure_boot_check_sig(uint32_t schema,
 }
 
 
-/*-- secure_boot_check ---------------------------------------------------------
+/*-- hex_value -----------------------------------------------------------------
+ *
+ *      Get the value of a hexadecimal digit.
+ *
+ * Parameters
+ *      IN c: the digit
+ *
+ * Results
+ *      The value, or -1 if c is not a hexadecimal digit.
+ *----------------------------------------------------------------------------*/
+static int hex_value(char c)
+{
+   if (c >= '0' && c <= '9') {
+      return c - '0';
+   }
+   if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+   }
+   if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+   }
+   return -1;
+}
+
+
+/*-- manifest_parse_line -------------------------------------------------------
+ *
+ *      Parse one line of the manifest data: a SHA-256 or SHA-512 digest in
+ *      hexadecimal, whitespace, and a module basename.
+ *
+ * Parameters
+ *      IN  line:  the line, without the line terminator
+ *      IN  len:   length of the line
+ *      OUT entry: the manifest entry
+ *
+ * Results
+ *      ERR_SUCCESS, or ERR_SYNTAX if the line is malformed.
+ *----------------------------------------------------------------------------*/
+static int manifest_parse_line(const char *line, size_t len,
+                               ManifestEntry *entry)
+{
+   size_t i;
+   int hi, lo;
+
+   for (i = 0; i < len && !isspace((unsigned char)line[i]); i++) {
+      ;
+   }
+   if (i != 2 * SHA256_DIGEST_LENGTH && i != 2 * SHA512_DIGEST_LENGTH) {
+      return ERR_SYNTAX;
+   }
+   entry->mdLen = i / 2;
+
+   for (i = 0; i < entry->mdLen; i++) {
+      hi = hex_value(line[2 * i]);
+      lo = hex_value(line[2 * i + 1]);
+      if (hi < 0 || lo < 0) {
+         return ERR_SYNTAX;
+      }
+      entry->md[i] = (unsigned char)((hi << 4) | lo);
+   }
+
+   for (i = 2 * entry->mdLen; i < len && isspace((unsigned char)line[i]);
+        i++) {
+      ;
+   }
+   while (len > i && isspace((unsigned char)line[len - 1])) {
+      len--;
+   }
+   if (i == len) {
+      return ERR_SYNTAX;
+   }
+
+   entry->name = line + i;
+   entry->nameLen = len - i;
+
+   return ERR_SUCCESS;
+}
+
+
+/*-- manifest_parse ------------------------------------------------------------
+ *
+ *      Parse the signed data of the manifest into Manifest.entries.  Blank
+ *      lines are ignored.
+ *
+ * Parameters
+ *      IN text: the manifest data
+ *      IN len:  length of the data
+ *
+ * Results
+ *      ERR_SUCCESS, ERR_SYNTAX or ERR_OUT_OF_RESOURCES.
+ *----------------------------------------------------------------------------*/
+static int manifest_parse(const char *text, size_t len)
+{
+   const char *line, *end, *eol;
+   unsigned lines;
+   int status;
+
+   end = text + len;
+   lines = 1;
+   for (line = text; line < end; line++) {
+      if (*line == '\n') {
+         lines++;
+      }
+   }
+
+   Manifest.entries = calloc(lines, sizeof (ManifestEntry));
+   if (Manifest.entries == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
+   for (line = text; line < end; line = eol + 1) {
+      eol = memchr(line, '\n', end - line);
+      if (eol == NULL) {
+         eol = end;
+      }
+      if (line == eol || (eol - line == 1 && *line == '\r')) {
+         continue;
+      }
+
+      status = manifest_parse_line(line, eol - line,
+                                   &Manifest.entries[Manifest.nr]);
+      if (status != ERR_SUCCESS) {
+         Log(LOG_WARNING, "Invalid manifest entry %u", Manifest.nr + 1);
+         return status;
+      }
+      Manifest.nr++;
+   }
+
+   return ERR_SUCCESS;
+}
+
+
+/*-- manifest_free -------------------------------------------------------------
+ *
+ *      Forget the manifest.
+ *----------------------------------------------------------------------------*/
+static void manifest_free(void)
+{
+   sys_free(Manifest.entries);
+   sys_free(Manifest.buf);
+   memset(&Manifest, 0, sizeof (Manifest));
+}
+
+
+/*-- manifest_load -------------------------------------------------------------
+ *
+ *      Load the manifest named by boot.cfg, if any, and verify its signature.
+ *      Any failure is logged and leaves the manifest unused, so that the
+ *      modules fall back to their own signatures.
+ *
+ * Parameters
+ *      IN schema0: schema version of module 0, that the manifest must match
+ *
+ * Results
+ *      true if the manifest can be used to check the modules.
+ *----------------------------------------------------------------------------*/
+static bool manifest_load(uint32_t schema0)
+{
+   char *path;
+   void *data, *sig;
+   size_t size, dataLen, sigLen;
+   uint32_t schema;
+   SigCheck check;
+   int status;
+
+   if (boot.manifest == NULL) {
+      return false;
+   }
+
+   status = make_path(boot.prefix, boot.manifest, &path);
+   if (status != ERR_SUCCESS) {
+      return false;
+   }
+
+   status = file_load(boot.volid, path, NULL, &Manifest.buf, &size);
+   if (status != ERR_SUCCESS) {
+      Log(LOG_WARNING, "Failed to load manifest %s: %s", path,
+          error_str[status]);
+      sys_free(path);
+      return false;
+   }
+
+   memset(&check, 0, sizeof (check));
+   status = secure_boot_parse_module(Manifest.buf, size, &schema,
+                                     &data, &dataLen, &sig, &sigLen);
+   if (status != ERR_SUCCESS) {
+      Log(LOG_WARNING, "Invalid manifest signature format");
+   } else if (schema != schema0) {
+      Log(LOG_WARNING, "Wrong manifest schema version (got %u; expected %u)",
+          schema, schema0);
+      status = ERR_SECURITY_VIOLATION;
+   } else if (sigLen < V1_KEYID_LEN ||
+              !secure_boot_prepare_sig(schema, data, dataLen, sig, sigLen,
+                                       NULL, &check) ||
+              !secure_boot_verify_sig(&check)) {
+      status = ERR_SECURITY_VIOLATION;
+   } else {
+      /* The signed data ends with the schema version. */
+      status = manifest_parse(data, dataLen - sizeof (schema));
+   }
+
+   if (status != ERR_SUCCESS) {
+      Log(LOG_WARNING, "Not using manifest %s", path);
+      manifest_free();
+   } else {
+      Log(LOG_DEBUG, "Manifest %s lists %u modules", path, Manifest.nr);
+   }
+
+   sys_free(path);
+
+   return status == ERR_SUCCESS;
+}
+
+
+/*-- digest_equal --------------------------------------------------------------
+ *
+ *      Compare two digests in constant time.
+ *
+ * Parameters
+ *      IN a:   first digest
+ *      IN b:   second digest
+ *      IN len: length of the digests
+ *
+ * Results
+ *      true if the digests are equal.
+ *----------------------------------------------------------------------------*/
+static bool digest_equal(const unsigned char *a, const unsigned char *b,
+                         size_t len)
+{
+   volatile unsigned char diff = 0;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      diff |= a[i] ^ b[i];
+   }
+
+   return diff == 0;
+}
+
+
+/*-- manifest_check ------------------------------------------------------------
+ *
+ *      Check the digest of a module's signed data against the manifest.
+ *
+ * Parameters
+ *      IN     filename: the module filename
+ *      IN/OUT check:    the signature check of the module
+ *
+ * Results
+ *      true if the manifest lists the module with this digest; false if the
+ *      module's own signature must be verified.
+ *----------------------------------------------------------------------------*/
+static bool manifest_check(const char *filename, SigCheck *check)
+{
+   const ManifestEntry *entry = NULL;
+   const char *name;
+   size_t nameLen;
+   unsigned i;
+
+   name = strrchr(filename, '/');
+   name = (name != NULL) ? name + 1 : filename;
+   nameLen = strlen(name);
+
+   for (i = 0; i < Manifest.nr; i++) {
+      entry = &Manifest.entries[i];
+      if (entry->nameLen == nameLen &&
+          memcmp(entry->name, name, nameLen) == 0) {
+         break;
+      }
+   }
+   if (i == Manifest.nr || entry->mdLen != check->mdLen) {
+      return false;
+   }
+
+   if (!check->hashed) {
+      hash_job(&check, 0);
+   }
+
+   if (!digest_equal(entry->md, check->md, check->mdLen)) {
+      Log(LOG_WARNING, "Digest of %s does not match the manifest", name);
+      return false;
+   }
+
+   return true;
+}
+
+
+/*-- log_module_md5 ------------------------------------------------------------
+ *
+ *      Log the MD5 sum of a module that failed to verify, computing it from
+ *      the loaded image if it was skipped at load time (see -M).
+ *
+ * Parameters
+ *      IN mod: the module
+ *----------------------------------------------------------------------------*/
+static void log_module_md5(const module_t *mod)
+{
+   char md5str[MD5_STRING_LEN];
+   md5_t md5;
+
+   if (mod->md5_valid) {
+      memcpy(&md5, &mod->md5_uncompressed, sizeof (md5_t));
+   } else {
+      md5_compute(mod->addr, mod->size, &md5);
+   }
+
+   md5_to_str(&md5, md5str, sizeof(md5str));
+   Log(LOG_WARNING, "Decompressed MD5: %s, size %zu", md5str, mod->size);
+}
+
+
+/*-- secure_boot_check_modules -------------------------------------------------
  *
  *      Determine the schema version in use, find the early modules, and check
  *      their signatures.
  *
- *      Logging strategy: LOG_DEBUG for non-error messages.  LOG_WARNING for
- *      detail about failures.  LOG_CRIT for security violation.
+ *      The signatures are checked in three passes: the modules that need a
+ *      signature are found and their signatures parsed, then the signed data
+ *      that was not hashed while extracting the modules is hashed (on all
+ *      processors), and finally the digests are checked against the
+ *      manifest, or else the RSA signatures are verified.  The outcome for
+ *      each module is logged in module order in the last pass.
  *
  * Parameters
  *      IN crypto_module: use external crypto module
  *
  * Results
- *      ERR_SUCCESS: signatures are valid
- *      ERR_NOT_FOUND: boot modules are unsigned (no logging)
- *      ERR_SECURITY_VIOLATION: signature validation failed
- *      ERR_LOAD_ERROR: crypto not available
+ *      See secure_boot_check.
  *----------------------------------------------------------------------------*/
-int secure_boot_check(bool crypto_module)
+static int secure_boot_check_modules(bool crypto_module)
 {
    int status;
    uint32_t schema0 = 0;
    unsigned i;
    unsigned errors;
+   unsigned manifested;
+   bool manifest;
    NamedModule *named;
+   SigCheck *checks;
 
    if (crypto_module) {
 #ifdef CRYPTO_MODULE
@@ -435,23 +1306,18 @@ int secure_boot_check(bool crypto_module)
       NOT_REACHED();
    }
 
-   switch (schema0) {
-   case 1:
-      named = v1Named;
-      break;
-   case 2:
-   case 3:
-      named = v2Named;
-      break;
-   case 4:
-      named = v4Named;
-      break;
-   default:
+   named = schema_named_modules(schema0);
+   if (named == NULL) {
       Log(LOG_CRIT, "Unknown schema version %u on module 0 (%s)",
           schema0, boot.modules[0].filename);
       return ERR_SECURITY_VIOLATION;
    }
 
+   checks = calloc(boot.modules_nr, sizeof (SigCheck));
+   if (checks == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+
    /*
     * In schema versions 1-4:
     * - All ELF modules must be signed.
@@ -461,8 +1327,8 @@ int secure_boot_check(bool crypto_module)
    errors = 0;
    for (i = 0; i < boot.modules_nr; i++) {
       module_t *mod = &boot.modules[i];
-      bool needsig = false;
-      bool ok;
+      unsigned image = mod->same_as != 0 ? mod->same_as : i;
+      const StreamDigest *streamed = NULL;
       void *data = NULL;
       size_t dataLen = -1;
       void *sig = NULL;
@@ -472,31 +1338,30 @@ int secure_boot_check(bool crypto_module)
       if (mod->size >= SELFMAG &&
           memcmp(ELFMAG, mod->addr, SELFMAG) == 0) {
 
-         needsig = true;
+         checks[i].needsig = true;
 
       } else {
          switch (find_named_module(mod->filename, named)) {
          case ERR_SUCCESS:
-            needsig = true;
+            checks[i].needsig = true;
             break;
          case ERR_NOT_FOUND:
-            needsig = false;
+            checks[i].needsig = false;
             break;
          case ERR_ALREADY_STARTED:
             Log(LOG_WARNING, "More than one module named %s", mod->filename);
             errors++;
-            needsig = true;
+            checks[i].needsig = true;
             break;
          default:
             NOT_REACHED();
          }
       }
 
-      if (!needsig) {
+      if (!checks[i].needsig) {
          continue;
       }
 
-      ok = false;
       status = secure_boot_parse_module(mod->addr, mod->size,
                                         &schema, &data, &dataLen,
                                         &sig, &sigLen);
@@ -512,22 +1377,88 @@ int secure_boot_check(bool crypto_module)
             Log(LOG_WARNING, "Wrong schema version (got %u; expected %u)",
                 schema, schema0);
          } else {
-            ok = secure_boot_check_sig(schema, data, dataLen, sig, sigLen);
+            if (image < Stream.nr) {
+               streamed = &Stream.results[image];
+            }
+            if (!secure_boot_prepare_sig(schema, data, dataLen, sig, sigLen,
+                                         streamed, &checks[i])) {
+               checks[i].cert = NULL;
+            }
          }
          break;
       default:
          NOT_REACHED();
       }
+   }
+
+   manifest = manifest_load(schema0);
+   manifested = 0;
+
+   hash_modules(checks, boot.modules_nr);
+
+   for (i = 0; i < boot.modules_nr; i++) {
+      bool ok;
+
+      if (!checks[i].needsig) {
+         continue;
+      }
+
+      if (checks[i].cert == NULL) {
+         ok = false;
+      } else if (manifest &&
+                 manifest_check(boot.modules[i].filename, &checks[i])) {
+         ok = true;
+         manifested++;
+      } else {
+         ok = secure_boot_verify_sig(&checks[i]);
+      }
 
       Log(ok ? LOG_DEBUG : LOG_CRIT, "Signature check %s on module %u (%s)",
-          ok ? "succeeded" : "failed", i, mod->filename);
+          ok ? "succeeded" : "failed", i, boot.modules[i].filename);
 
       if (!ok) {
+         log_module_md5(&boot.modules[i]);
          errors++;
       }
    }
 
+   if (manifest) {
+      Log(LOG_DEBUG, "%u modules checked against the manifest", manifested);
+      manifest_free();
+   }
+
+   sys_free(checks);
+
    return errors == 0 ? ERR_SUCCESS : ERR_SECURITY_VIOLATION;
 }
 
+
+/*-- secure_boot_check ---------------------------------------------------------
+ *
+ *      Determine the schema version in use, find the early modules, and check
+ *      their signatures.
+ *
+ *      Logging strategy: LOG_DEBUG for non-error messages.  LOG_WARNING for
+ *      detail about failures.  LOG_CRIT for security violation.
+ *
+ * Parameters
+ *      IN crypto_module: use external crypto module
+ *
+ * Results
+ *      ERR_SUCCESS: signatures are valid
+ *      ERR_NOT_FOUND: boot modules are unsigned (no logging)
+ *      ERR_SECURITY_VIOLATION: signature validation failed
+ *      ERR_LOAD_ERROR: crypto not available
+ *      ERR_OUT_OF_RESOURCES: out of memory
+ *----------------------------------------------------------------------------*/
+int secure_boot_check(bool crypto_module)
+{
+   int status;
+
+   status = secure_boot_check_modules(crypto_module);
+   secure_boot_stream_end();
+
+   return status;
+}
+
 #endif
@@ -657,6 +657,10 @@ int multiboot_register(void)
 
       for (i = 1; i < boot.modules_nr; i++) {
          mod = &boot.modules[i];
+         if (mod->same_as != 0) {
+            /* Image already registered by the module it is shared with */
+            continue;
+         }
          status = add_module_object(mod->addr, mod->size);
          if (status != ERR_SUCCESS) {
             Log(LOG_ERR, "Module registration error.\n");
@@ -73,7 +73,7 @@ static int safeboot_init(int argc, char **argv)
    if (argc > 1) {
       optind = 1;
       do {
-         opt = getopt(argc, argv, ":m:rs:S:Vc:t:R:p:E:fN:b:L:");
+         opt = getopt(argc, argv, ":m:rs:S:Vc:t:R:p:E:fN:b:L:C:");
          switch (opt) {
             case -1:
                break;
@@ -108,6 +108,7 @@ static int safeboot_init(int argc, char **argv)
             case 'N':
             case 'b':
             case 'L':
+            case 'C':
                /*
                 * Other mboot options that take an argument.  Pass
                 * through to mboot after the options that safeboot
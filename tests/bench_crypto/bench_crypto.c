@@ -0,0 +1,256 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * bench_crypto.c -- Host benchmark for the checksum, hash and signature
+ *                   verification primitives of the boot path
+ *
+ *   bench_crypto [-j] [-s <size>]... [-t <seconds>] [-v]
+ *
+ *      -j            Print the results as JSON
+ *      -s <size>     Hash buffers of this many bytes, with an optional K or M
+ *                    suffix; may be repeated (default 64K, 1M and 16M)
+ *      -t <seconds>  Repeat each measurement for at least this long
+ *                    (default 0.25)
+ *      -v            Print the boot loader log messages on stderr
+ *
+ *   Checksums and hashes are reported in TSC cycles per byte and MB/s, for
+ *   every SHA backend the CPU supports. RSA PKCS#1 v1.5 verifications are
+ *   reported in verifications per second, for the key sizes and exponents
+ *   used to sign boot modules. The crypto module power-on self-tests are
+ *   reported in microseconds per run; a failing test aborts the benchmark
+ *   with a non-zero exit status.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "bench_crypto.h"
+
+#define MAX_SIZES       8
+
+static bool verbose;
+static double min_time = 0.25;
+
+typedef struct {
+   unsigned long iterations;
+   double seconds;
+   uint64_t cycles;
+} measure_t;
+
+void bench_log(int level, const char *msg)
+{
+   if (verbose) {
+      fprintf(stderr, "<%d> %s\n", level, msg);
+   }
+}
+
+void bench_failure(const char *msg)
+{
+   fprintf(stderr, "Self-test failure: %s\n", msg);
+   exit(1);
+}
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *progname)
+{
+   fprintf(stderr, "Usage: %s [-j] [-s <size>]... [-t <seconds>] [-v]\n",
+           progname);
+   exit(1);
+}
+
+static size_t parse_size(const char *arg)
+{
+   char *end;
+   size_t size;
+
+   size = strtoul(arg, &end, 0);
+   if (*end == 'K' || *end == 'k') {
+      size *= 1024;
+      end++;
+   } else if (*end == 'M' || *end == 'm') {
+      size *= 1024 * 1024;
+      end++;
+   }
+
+   return *end == '\0' ? size : 0;
+}
+
+/*
+ * Repeat a benchmark step until min_time has elapsed. The step returns
+ * non-zero on failure.
+ */
+#define MEASURE(_m_, _step_)                                            \
+   do {                                                                 \
+      double _start = now();                                            \
+      uint64_t _tsc = __rdtsc();                                        \
+                                                                        \
+      (_m_)->iterations = 0;                                            \
+      do {                                                              \
+         if ((_step_) != 0) {                                           \
+            fprintf(stderr, "%s failed\n", #_step_);                    \
+            exit(1);                                                    \
+         }                                                              \
+         (_m_)->iterations++;                                           \
+         (_m_)->seconds = now() - _start;                               \
+      } while ((_m_)->seconds < min_time);                              \
+      (_m_)->cycles = __rdtsc() - _tsc;                                 \
+   } while (0)
+
+static int self_test_step(void)
+{
+   bench_self_test();
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   size_t sizes[MAX_SIZES] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+   unsigned int i, j, nsizes, nhashes, nrsa;
+   bool json, first;
+   uint8_t *buffer;
+   size_t max_size;
+   measure_t m;
+   int opt;
+
+   json = false;
+   nsizes = 0;
+
+   while ((opt = getopt(argc, argv, "js:t:v")) != -1) {
+      switch (opt) {
+         case 'j':
+            json = true;
+            break;
+         case 's':
+            if (nsizes == MAX_SIZES) {
+               usage(argv[0]);
+            }
+            sizes[nsizes] = parse_size(optarg);
+            if (sizes[nsizes] == 0) {
+               usage(argv[0]);
+            }
+            nsizes++;
+            break;
+         case 't':
+            min_time = atof(optarg);
+            break;
+         case 'v':
+            verbose = true;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+
+   if (argc != optind || min_time <= 0) {
+      usage(argv[0]);
+   }
+   if (nsizes == 0) {
+      nsizes = 3;
+   }
+
+   max_size = 0;
+   for (i = 0; i < nsizes; i++) {
+      if (sizes[i] > max_size) {
+         max_size = sizes[i];
+      }
+   }
+
+   buffer = malloc(max_size);
+   if (buffer == NULL) {
+      perror("malloc");
+      return 1;
+   }
+   for (i = 0; i < max_size; i++) {
+      buffer[i] = (uint8_t)(i * 2654435761u >> 13);
+   }
+
+   if (bench_init() != 0) {
+      fprintf(stderr, "Failed to set up the RSA test vectors\n");
+      return 1;
+   }
+   nhashes = bench_hash_count();
+   nrsa = bench_rsa_count();
+
+   if (json) {
+      printf("{\n  \"hashes\": [");
+   } else {
+      printf("%-24s %10s %12s %10s\n", "hash", "size", "cycles/byte",
+             "MB/s");
+   }
+
+   first = true;
+   for (i = 0; i < nhashes; i++) {
+      for (j = 0; j < nsizes; j++) {
+         MEASURE(&m, bench_hash(i, buffer, sizes[j]));
+
+         if (json) {
+            printf("%s\n    { \"name\": \"%s\", \"size\": %zu, "
+                   "\"iterations\": %lu, \"cycles_per_byte\": %.3f, "
+                   "\"mb_per_s\": %.1f }", first ? "" : ",",
+                   bench_hash_name(i), sizes[j], m.iterations,
+                   (double)m.cycles / m.iterations / sizes[j],
+                   (double)sizes[j] * m.iterations / m.seconds /
+                   (1024 * 1024));
+         } else {
+            printf("%-24s %10zu %12.3f %10.1f\n", bench_hash_name(i),
+                   sizes[j], (double)m.cycles / m.iterations / sizes[j],
+                   (double)sizes[j] * m.iterations / m.seconds /
+                   (1024 * 1024));
+         }
+         first = false;
+      }
+   }
+
+   if (json) {
+      printf("\n  ],\n  \"rsa\": [");
+   } else {
+      printf("\n%-24s %10s %12s\n", "rsa verify", "verify/s", "kcycles");
+   }
+
+   for (i = 0; i < nrsa; i++) {
+      MEASURE(&m, bench_rsa_verify(i));
+
+      if (json) {
+         printf("%s\n    { \"name\": \"%s\", \"iterations\": %lu, "
+                "\"verifies_per_s\": %.1f, \"cycles_per_verify\": %.0f }",
+                i == 0 ? "" : ",", bench_rsa_name(i), m.iterations,
+                m.iterations / m.seconds,
+                (double)m.cycles / m.iterations);
+      } else {
+         printf("%-24s %10.1f %12.1f\n", bench_rsa_name(i),
+                m.iterations / m.seconds,
+                (double)m.cycles / m.iterations / 1000);
+      }
+   }
+
+   MEASURE(&m, self_test_step());
+
+   if (json) {
+      printf("\n  ],\n  \"self_test\": { \"iterations\": %lu, "
+             "\"us_per_run\": %.1f }\n}\n", m.iterations,
+             m.seconds * 1e6 / m.iterations);
+   } else {
+      printf("\n%-24s %10.1f us\n", "self-test run", m.seconds * 1e6 /
+             m.iterations);
+   }
+
+   free(buffer);
+
+   return 0;
+}
@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * bench_crypto.h -- Interface between the host benchmark driver and the
+ *                   crypto module code it runs
+ *
+ *   crypto_shim.c is built against the boot loader headers, and
+ *   bench_crypto.c against the host C library. Only the plain C types below
+ *   cross between the two.
+ */
+
+#ifndef BENCH_CRYPTO_H_
+#define BENCH_CRYPTO_H_
+
+#include <stddef.h>
+
+/*
+ * bench_crypto.c
+ */
+void bench_log(int level, const char *msg);
+void bench_failure(const char *msg);
+
+/*
+ * crypto_shim.c
+ */
+int bench_init(void);
+unsigned int bench_hash_count(void);
+const char *bench_hash_name(unsigned int i);
+int bench_hash(unsigned int i, const void *data, size_t len);
+unsigned int bench_rsa_count(void);
+const char *bench_rsa_name(unsigned int i);
+int bench_rsa_verify(unsigned int i);
+void bench_self_test(void);
+
+#endif /* !BENCH_CRYPTO_H_ */
@@ -0,0 +1,186 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * bench_vectors.h -- RSA test vectors for bench_crypto
+ *
+ *   The keys have the sizes and public exponents of the keys mboot checks
+ *   module signatures with. The signatures are PKCS#1 v1.5 signatures of
+ *   BENCH_RSA_MESSAGE, made with throwaway private keys:
+ *
+ *      openssl genpkey -algorithm RSA -pkeyopt rsa_keygen_bits:<bits> \
+ *              -pkeyopt rsa_keygen_pubexp:<exponent> -out key.pem
+ *      openssl dgst -<digest> -sign key.pem -out sig.bin message
+ */
+
+#ifndef BENCH_VECTORS_H_
+#define BENCH_VECTORS_H_
+
+#define BENCH_RSA_MESSAGE "ESXboot bench_crypto RSA test vector"
+
+static const char rsa2048_e65537_modulus[] =
+   "afe70583c19e2fe88c9a5d71b229118cbdd0034c07e306497319c320fa1d7afc"
+   "36644fdac57bf738620f1239f327e2f84aea58e7fef760d5be6d856b635810ea"
+   "43431d92950c4af128d2ab2718e4bedcd049dc6779f70170487c706c957d43a2"
+   "65a068192eee758ba677a42686f233d493f9e7c22431a41d62137a01af401b78"
+   "0e36b4e693810da4fab1cac5af219e4aa4b50a03faa23402fc87a409b8d9c2e1"
+   "df426131bed2f01008a515ba2f8e1ba493d495a3cadbc268cf475780bec5c7b2"
+   "71c6a735fb2dbf01ee4ab3e51d7bb646973bd2cf6c4521cbe86eec62e1a3d575"
+   "43bd82c45dd4b7a1fda8f3691315d97922d31e91e7584c3341d603df31a0275b";
+
+static const uint8_t rsa2048_e65537_sig[] = {
+   0x7c, 0x93, 0xa8, 0x49, 0x5b, 0xac, 0x48, 0xe8, 0x67, 0xe6, 0xfb, 0x8e,
+   0x20, 0xa3, 0x7f, 0xf3, 0x36, 0xb6, 0xbe, 0x20, 0xb4, 0x83, 0x70, 0xb5,
+   0x21, 0xa3, 0x11, 0x84, 0x34, 0x90, 0x19, 0x4d, 0xaa, 0x58, 0x31, 0x6d,
+   0xcf, 0xbd, 0x73, 0x5a, 0x32, 0x6b, 0xc1, 0x4d, 0xda, 0x79, 0x95, 0x3d,
+   0x29, 0x7d, 0x2a, 0x59, 0xd7, 0x6b, 0x0c, 0x68, 0x9f, 0x1b, 0x7b, 0x29,
+   0xdd, 0x31, 0xa7, 0x29, 0x2d, 0x3a, 0xac, 0x32, 0x2a, 0x68, 0x18, 0x8e,
+   0x7e, 0x76, 0xd5, 0x6c, 0x35, 0xc2, 0x2b, 0x8d, 0x25, 0x4e, 0x91, 0xf7,
+   0x89, 0xfd, 0xfc, 0x35, 0x4e, 0x48, 0x88, 0xc1, 0x88, 0xa7, 0x20, 0xa5,
+   0x7e, 0xa1, 0x35, 0x7f, 0x91, 0x56, 0x63, 0xcd, 0x6a, 0xf2, 0x49, 0x28,
+   0xf4, 0x04, 0x14, 0x44, 0xaa, 0x09, 0x93, 0x95, 0xea, 0x40, 0xbf, 0x32,
+   0xd9, 0xbe, 0x1d, 0x44, 0xb6, 0x36, 0x91, 0xdd, 0x1e, 0x31, 0x5c, 0x30,
+   0x46, 0x62, 0x66, 0xe6, 0x59, 0x83, 0x31, 0xce, 0x92, 0xc6, 0xae, 0x67,
+   0x65, 0x65, 0x79, 0x6b, 0x8a, 0x34, 0x96, 0x99, 0xd7, 0xdc, 0x60, 0xfb,
+   0x14, 0xe9, 0x91, 0xef, 0x13, 0x33, 0x15, 0xc3, 0x59, 0x84, 0x19, 0x4a,
+   0xa6, 0xe4, 0x00, 0x99, 0xfb, 0xf5, 0x8a, 0xa3, 0xf0, 0x2b, 0xcb, 0x99,
+   0xf1, 0x22, 0x1a, 0xc8, 0x50, 0x1d, 0x5f, 0x5b, 0xae, 0x3c, 0x5c, 0xb0,
+   0x92, 0x50, 0xc3, 0xf3, 0x7a, 0xce, 0x82, 0xbb, 0x77, 0xf4, 0x3b, 0x0b,
+   0x22, 0x06, 0x47, 0x5c, 0x39, 0x2f, 0xaf, 0xf3, 0xfd, 0x8a, 0x2e, 0xda,
+   0x03, 0x58, 0xec, 0x4f, 0x2b, 0xd6, 0x1e, 0x23, 0x90, 0x27, 0x13, 0xbd,
+   0x44, 0x2b, 0x0c, 0xff, 0x03, 0x3c, 0xbf, 0x73, 0x67, 0x88, 0xaf, 0x00,
+   0xc3, 0xdf, 0x8f, 0x32, 0x22, 0xbc, 0x85, 0x84, 0xcf, 0xe7, 0x9e, 0x0e,
+   0x00, 0x26, 0xfe, 0x35
+};
+
+static const char rsa4096_e65537_modulus[] =
+   "a8c207072cc206dc2e31fcfdffbc8c4fbd77a1f9e848651ca006b0462e962ed4"
+   "1bb4343ab7cce2a82872d0201cec793bcc53ea4eacaf8f31bc5e0d8b1bc15785"
+   "a1e5c6f9614bc94001fde0b663de78c97421170dbc8c69f3684d970a7f8b1632"
+   "09794c735039e32ee1543bea25a2d0aa8c7dba6a4e6d77e21f2128ac4194e23a"
+   "fcca73cfdb5503bdfeef303560952005caa50bdd892e645f2e5cbed06999db3c"
+   "1df728ab33d61e77a8147e9ca56ff43f74d5560f51b05068670cc77d06e4b7aa"
+   "25ad1ef0812ca1028b30da08660447a8397994979f28507ea51e35f8e3d5c0b5"
+   "07dfbabda1b1ea74855a64d0911e324c3d5215d31569cc2dd98664f41f9bad1c"
+   "121becbc1271d3825a15d32491c739bdc1a2666f01a9c8925f35fdafd0755deb"
+   "469b032cea65177313fb49735eef8684473e634c3f6d79f1d578ee770937e61e"
+   "b607943a53638c97d594514858f707cafb1ce9a31fa96e602ff1d2199cfa5db5"
+   "d75448f58710ba147c26e5ebd319b4840e3d780a83cfa1adf7ff176f81f6b08b"
+   "a40cc9d2d44fe711dabed5bb4f2f0605a481272f74961ec10a060780672a1b3e"
+   "b6b871cfb88f708ca1d698d4e1bcaffa1d5e0f003768dadaf0c2f7d447c1b09e"
+   "bdaa223a3c0bcdf4d685e7ac1462aa3f615a3870522fbe54879864846a327cd0"
+   "bdc6452c534831ddf1896b48abcb3c775a7bd6a36f168ea10638750a1dc09219";
+
+static const uint8_t rsa4096_e65537_sig[] = {
+   0x7a, 0xe8, 0x86, 0x70, 0x50, 0x47, 0x9d, 0xb0, 0xff, 0x83, 0x6f, 0x02,
+   0x57, 0x97, 0xe6, 0x90, 0x9b, 0xbf, 0x35, 0x8e, 0x38, 0x3c, 0x5c, 0x60,
+   0x27, 0x57, 0xe7, 0xb3, 0x32, 0x60, 0x0c, 0x2f, 0x03, 0xcc, 0xb9, 0x2d,
+   0xa2, 0x97, 0x18, 0xed, 0x71, 0xb4, 0x36, 0x06, 0x65, 0xec, 0x34, 0x80,
+   0xc1, 0x16, 0x2b, 0x36, 0x7b, 0xa2, 0x5a, 0x10, 0xa7, 0x09, 0xf7, 0xbe,
+   0xf3, 0xc5, 0xf7, 0x3e, 0xf9, 0xdb, 0x68, 0xad, 0x13, 0x07, 0x7f, 0x94,
+   0x66, 0xc2, 0x5a, 0xd7, 0x61, 0x07, 0x6f, 0x8d, 0x74, 0x56, 0x48, 0x25,
+   0x8c, 0x3a, 0x54, 0xaf, 0x40, 0xe2, 0xd6, 0xd2, 0x07, 0x6c, 0xce, 0xbc,
+   0xeb, 0x1d, 0x74, 0xe2, 0x81, 0x16, 0x6e, 0x0d, 0x50, 0xe2, 0x2f, 0xef,
+   0xb4, 0x03, 0xaf, 0x76, 0xc8, 0x3d, 0xab, 0x44, 0xbe, 0x87, 0x09, 0xba,
+   0xc7, 0x6b, 0x9f, 0xb1, 0x76, 0xf7, 0xbc, 0x6f, 0xc1, 0x05, 0xf5, 0x84,
+   0xf3, 0xfd, 0xb4, 0x47, 0x51, 0xf5, 0x76, 0x4e, 0x7d, 0x2a, 0x16, 0xd8,
+   0x2a, 0x0a, 0x81, 0x30, 0x8b, 0x43, 0x2a, 0x6d, 0xa7, 0x7f, 0xd2, 0xbc,
+   0xa7, 0x4c, 0x74, 0x89, 0x51, 0x10, 0x09, 0x15, 0x22, 0xcd, 0x02, 0x3c,
+   0x2b, 0x33, 0xb0, 0x09, 0x6d, 0x66, 0x76, 0xce, 0xa7, 0x4d, 0xb0, 0x1d,
+   0x2d, 0xa1, 0x02, 0x35, 0x97, 0xfc, 0x0f, 0x9e, 0xda, 0x00, 0x83, 0xc2,
+   0x3a, 0x84, 0xbb, 0xf7, 0xfa, 0xbb, 0x51, 0x0f, 0xe0, 0xa3, 0x39, 0x35,
+   0x60, 0x67, 0xb7, 0x22, 0x12, 0xb5, 0x9a, 0x9b, 0x17, 0x86, 0x26, 0x18,
+   0x3e, 0x8f, 0x1e, 0x78, 0x06, 0x69, 0x27, 0xcd, 0xcc, 0xa0, 0x9c, 0x5a,
+   0xbc, 0x89, 0xe3, 0x15, 0xd4, 0x39, 0x13, 0x5d, 0xb6, 0x38, 0x72, 0x65,
+   0xf1, 0xdc, 0xb5, 0x1a, 0xdb, 0xa5, 0x1f, 0x51, 0xdb, 0xc9, 0x1b, 0x69,
+   0xdf, 0xce, 0x72, 0x73, 0x51, 0xe7, 0xc1, 0x25, 0x7a, 0x33, 0x14, 0x24,
+   0x9e, 0x20, 0x56, 0x88, 0x6c, 0x84, 0x64, 0x23, 0xff, 0x92, 0x68, 0x52,
+   0x97, 0xe3, 0xc5, 0x12, 0xe4, 0x8c, 0x0d, 0x9b, 0x26, 0x01, 0x9a, 0xfe,
+   0x83, 0xdc, 0xa3, 0x7e, 0xa6, 0xcb, 0x61, 0x58, 0x1a, 0xcb, 0xb7, 0x26,
+   0x11, 0xfa, 0x01, 0xae, 0x29, 0x1b, 0xf1, 0x92, 0xa9, 0xb9, 0x29, 0x93,
+   0x32, 0x9b, 0xd1, 0x71, 0xf3, 0x16, 0x1a, 0xc3, 0xf9, 0xef, 0x43, 0xed,
+   0xe7, 0x07, 0x85, 0xc1, 0x1f, 0x07, 0xbb, 0xad, 0x83, 0xd4, 0xbc, 0xb1,
+   0x24, 0x27, 0x7b, 0x12, 0xf6, 0x00, 0x9e, 0xf6, 0xe9, 0x56, 0x7d, 0x9c,
+   0x41, 0x48, 0xd6, 0xe0, 0x02, 0x71, 0x6f, 0x60, 0x1d, 0x4e, 0xea, 0xac,
+   0xd9, 0x0f, 0x35, 0x05, 0xdc, 0x58, 0xa4, 0x10, 0x07, 0x11, 0x4e, 0x43,
+   0x7e, 0x94, 0xfc, 0x50, 0x0d, 0x74, 0x4d, 0xc1, 0x4d, 0x6b, 0x9e, 0xa7,
+   0xa1, 0xf5, 0xd3, 0x04, 0xca, 0xe4, 0xc9, 0x76, 0x03, 0xff, 0x66, 0xd3,
+   0x61, 0x22, 0xff, 0x95, 0xe0, 0x71, 0x8d, 0x1b, 0x73, 0x96, 0xfe, 0x44,
+   0x3b, 0xd7, 0xda, 0xca, 0x59, 0x43, 0xcb, 0x7e, 0x8f, 0x92, 0xe4, 0xb3,
+   0x17, 0x0c, 0xf2, 0xe0, 0x91, 0x20, 0x22, 0xd1, 0x63, 0xf3, 0x21, 0x1b,
+   0x3b, 0x6c, 0x82, 0x25, 0xb0, 0x36, 0x75, 0x67, 0xaa, 0xc7, 0x5d, 0xc3,
+   0x7e, 0x07, 0xe8, 0x6f, 0xcc, 0x47, 0xdb, 0xda, 0x16, 0x9e, 0x3c, 0x97,
+   0x77, 0xd3, 0x00, 0xf3, 0xee, 0x4c, 0x12, 0xb0, 0xae, 0x43, 0x5b, 0x4c,
+   0x86, 0x25, 0x67, 0xe0, 0x27, 0x3c, 0x66, 0xb0, 0x06, 0x46, 0x28, 0xd7,
+   0x5c, 0x30, 0x6a, 0xde, 0xee, 0x68, 0xb1, 0xad, 0x03, 0xfa, 0x45, 0xce,
+   0xbc, 0x91, 0x03, 0x27, 0x49, 0x46, 0xc4, 0x0a, 0x5d, 0x6f, 0x99, 0x90,
+   0xc5, 0x77, 0xf3, 0x56, 0xbf, 0x26, 0x3f, 0xb8
+};
+
+static const char rsa4096_e3_modulus[] =
+   "b1cb47a8d0d2e8704f66b0dc8b436c5a6e7d9e4a010c364efd9ef21f36be9b7d"
+   "9f52d4b0c745607ebda87b19d5c1ef5bef309c07714f53109a050707ab4a9a87"
+   "63e679ea07adbb969120f9cae15cdc2645577d04f1636134a074cb3c807cd568"
+   "7c4cef0ac9a29cb3e607e543b87ddde0db58fe9bdb3e2aedf7f13c83045a3b0a"
+   "e661bbd6399d5fd2f3413197c6b1b235b75783c1b7222a27cff0e211b11ff6f1"
+   "7db2beb962210a7f6985427699df5f178e3aa39f68c8a03c5815dfe28a7588f9"
+   "03284cc58526217a1b50e0a3741010552f82ec5619cca48af427c8e9f97e542f"
+   "6bae580ab5eec8ef82a340ab76335010a4bf2969eae358d9fb1d92c6e8a2e852"
+   "c31387b32e86ece788b7a2dab7a05e9568eeee23650d663a3e473a558d9e324c"
+   "effaf229959d15b3d5064132c701d42490301f8e42560e71850c63b715e065b4"
+   "aa965c36b071199bde403523f95bfd824cc00ffa38213f21dc99dd6a8db5176c"
+   "47d2203f9518eda583358936397346cddc6a6631eb2b66ab67a447812141af4c"
+   "9fb4da83333f54d86afec8ef17f491834439357dc9a3ba29b26cc6fc2a4d3387"
+   "1158c9fe8ef2defc2644c2b196b5a3e77d3737fe8918d2abfba3b688c75d9d68"
+   "e4670e11d69e8be280080bf4b7bdca50389f5ff01caad2b50a94a380ffdc8768"
+   "6d4cb95239e2b40b5998c03b2ea140d07d0a059efcb0aab21d238018d63f7443";
+
+static const uint8_t rsa4096_e3_sig[] = {
+   0x36, 0x1b, 0x21, 0x5b, 0x87, 0x0d, 0x01, 0x6e, 0x03, 0x58, 0x87, 0xe1,
+   0xe0, 0x3c, 0x39, 0x53, 0xad, 0xfc, 0x47, 0x18, 0x36, 0xbe, 0x0a, 0xd1,
+   0xf0, 0x96, 0xa8, 0x7d, 0xd4, 0x73, 0x09, 0x9e, 0xb5, 0x69, 0xa7, 0xa1,
+   0x24, 0x95, 0x76, 0x83, 0x94, 0xbe, 0xf2, 0xc8, 0x1d, 0x48, 0xac, 0xde,
+   0x85, 0x32, 0xa7, 0xb7, 0x89, 0x9d, 0xac, 0x14, 0x32, 0xa4, 0xb9, 0xcf,
+   0xcb, 0x7b, 0xed, 0x10, 0x5f, 0xdf, 0x0f, 0x10, 0x09, 0x41, 0x97, 0x76,
+   0x95, 0xff, 0x28, 0x95, 0x5f, 0xbf, 0xb8, 0x8f, 0xbb, 0x6d, 0x95, 0x87,
+   0x9a, 0x85, 0x6b, 0x78, 0x50, 0x72, 0x00, 0xd0, 0xd0, 0xf6, 0x42, 0x83,
+   0xb1, 0x02, 0xd2, 0xf6, 0x2c, 0xe0, 0x91, 0xaf, 0x9f, 0x85, 0x77, 0x91,
+   0xd8, 0x0d, 0x08, 0xac, 0x1e, 0xdc, 0x3d, 0x0d, 0xc4, 0x66, 0x80, 0x78,
+   0x71, 0x75, 0xec, 0x9c, 0x05, 0xf1, 0x9a, 0xff, 0xc8, 0xca, 0xd9, 0x09,
+   0xb0, 0x10, 0x8c, 0x73, 0x94, 0x79, 0xcc, 0x47, 0x33, 0x39, 0x52, 0xc6,
+   0x67, 0x0d, 0x1a, 0x04, 0xe5, 0xd2, 0xac, 0xf4, 0x75, 0x05, 0x91, 0x0a,
+   0xe3, 0x60, 0x45, 0x99, 0x73, 0x3e, 0x55, 0x67, 0xf0, 0xe8, 0xe6, 0x90,
+   0x3f, 0x83, 0x3c, 0x81, 0x7e, 0x5e, 0x94, 0x35, 0xb8, 0x83, 0x97, 0x05,
+   0xb3, 0x31, 0xa8, 0x5a, 0xc1, 0x71, 0x95, 0xc9, 0xac, 0xdb, 0xd7, 0x16,
+   0xd7, 0x33, 0xd2, 0x50, 0x85, 0x9e, 0xa0, 0x12, 0x98, 0xf9, 0xee, 0x6b,
+   0x74, 0x74, 0xaf, 0xc3, 0x5f, 0x98, 0xc7, 0x7a, 0x09, 0xb1, 0x24, 0x46,
+   0xe7, 0xe5, 0x93, 0x00, 0xcc, 0x96, 0x00, 0x93, 0x19, 0xdb, 0x77, 0x5c,
+   0xef, 0x97, 0x6e, 0x90, 0x90, 0x34, 0xb1, 0x49, 0xfb, 0x8a, 0xa4, 0x8f,
+   0x3a, 0xc6, 0x22, 0x2e, 0x49, 0xb2, 0xb9, 0xec, 0xc4, 0x30, 0x93, 0x96,
+   0x39, 0x65, 0xe1, 0xc6, 0x6a, 0x1c, 0x50, 0x5c, 0x54, 0xb0, 0x63, 0x9d,
+   0x8f, 0xd3, 0xe3, 0xc2, 0xce, 0x15, 0x1b, 0x76, 0x8a, 0xcc, 0x6f, 0x54,
+   0x1f, 0x25, 0x26, 0x58, 0xd4, 0xcd, 0x0a, 0x9a, 0x44, 0x2d, 0xfc, 0xa1,
+   0xcd, 0x1d, 0x0d, 0xac, 0xff, 0x0f, 0x51, 0x04, 0x4a, 0xdd, 0xb4, 0xca,
+   0xbc, 0xa9, 0x3d, 0x4b, 0x29, 0x31, 0x04, 0x1b, 0xd8, 0xad, 0xde, 0xc9,
+   0x35, 0xce, 0xeb, 0x8b, 0xc8, 0x82, 0x40, 0x0e, 0x4d, 0x11, 0x7c, 0x84,
+   0x3c, 0xfb, 0x12, 0x02, 0x5d, 0x27, 0x38, 0x2f, 0x98, 0x46, 0x99, 0x67,
+   0x46, 0x2c, 0x81, 0x59, 0x2a, 0x87, 0x38, 0xca, 0xb8, 0x1a, 0xa9, 0xd0,
+   0x88, 0xe6, 0xbe, 0x22, 0xe9, 0xb2, 0x45, 0x2c, 0x27, 0x82, 0xd5, 0xae,
+   0x66, 0x7f, 0x64, 0x2e, 0x35, 0x74, 0x73, 0x18, 0x9a, 0xf1, 0x4c, 0x93,
+   0xe4, 0xbc, 0x73, 0x6e, 0x58, 0xb2, 0x5b, 0x99, 0x84, 0x54, 0xa1, 0xc2,
+   0x37, 0x9c, 0xf6, 0x82, 0x5e, 0x0d, 0xb2, 0x8e, 0x3b, 0x26, 0xc9, 0x3e,
+   0xf9, 0xb5, 0x39, 0x57, 0xe5, 0x7d, 0x6c, 0xaa, 0x2b, 0x6e, 0x25, 0xe3,
+   0xa2, 0x31, 0xfc, 0x30, 0xa1, 0x12, 0x7a, 0xdd, 0x62, 0x2b, 0x1f, 0x97,
+   0xfe, 0xa1, 0xd7, 0xc1, 0x69, 0x56, 0xbd, 0xad, 0xeb, 0xbe, 0x7e, 0x2f,
+   0x7d, 0x3c, 0x3c, 0xda, 0xff, 0xe7, 0x92, 0x0c, 0xbe, 0xcc, 0xda, 0xe4,
+   0xce, 0x3c, 0xfa, 0xea, 0x90, 0x7f, 0x8f, 0x9d, 0xa4, 0x7a, 0x46, 0xe7,
+   0x29, 0xed, 0x65, 0xdb, 0x5a, 0x2e, 0x78, 0x78, 0x4a, 0x7a, 0x0d, 0xef,
+   0x5a, 0xae, 0xa8, 0x0c, 0xb5, 0xcb, 0x23, 0xd6, 0xad, 0x7b, 0x7e, 0xfa,
+   0xd5, 0xf6, 0x01, 0x49, 0xa9, 0xa3, 0x84, 0x39, 0x57, 0xbe, 0x3b, 0x35,
+   0x86, 0x8c, 0x3f, 0xea, 0x30, 0xf3, 0xd6, 0x20, 0xbc, 0x6e, 0x6f, 0xa6,
+   0x4a, 0x6e, 0xaf, 0x84, 0x7f, 0x25, 0x36, 0x9c
+};
+
+#endif /* !BENCH_VECTORS_H_ */
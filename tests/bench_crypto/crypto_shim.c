@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * crypto_shim.c -- Boot loader side of bench_crypto
+ *
+ *   Runs the checksum and hash primitives used while loading modules, the
+ *   RSA signature verification used by secure boot, and the crypto module
+ *   power-on self-tests.
+ *
+ *   The protocol interface used by the self-tests points straight at mbedtls,
+ *   without the FIPS key length checks of uefi/crypto/crypto.c, which the
+ *   self-tests do not exercise. The integrity test needs a relocated UEFI
+ *   image, and is not run.
+ */
+
+#include <stdio.h>
+#include <bootlib.h>
+#include <efiutils.h>
+#include <crc.h>
+#include <md5.h>
+#include <sha_accel.h>
+#include <zlib.h>
+#include "../../uefi/crypto/crypto.h"
+#include "bench_crypto.h"
+#include "bench_vectors.h"
+
+#define BENCH_NAME_LEN  32
+
+typedef enum {
+   BENCH_MD5,
+   BENCH_CRC_32,
+   BENCH_ZLIB_CRC32,
+   BENCH_SHA256,
+   BENCH_SHA512
+} bench_hash_type_t;
+
+static struct {
+   char name[BENCH_NAME_LEN];
+   bench_hash_type_t type;
+   sha_backend_t backend;
+} hashes[3 + 2 * SHA_BACKEND_COUNT];
+
+static unsigned int hashes_nr;
+
+/* Keeps the checksums from being optimized away */
+static volatile uint32_t checksum;
+
+static const struct {
+   const char *name;
+   unsigned int bits;
+   const char *modulus;
+   int exponent;
+   mbedtls_md_type_t digest;
+   const uint8_t *sig;
+} rsaVectors[] = {
+   { "rsa2048-e65537-sha256", 2048, rsa2048_e65537_modulus, 65537,
+     MBEDTLS_MD_SHA256, rsa2048_e65537_sig },
+   { "rsa4096-e65537-sha512", 4096, rsa4096_e65537_modulus, 65537,
+     MBEDTLS_MD_SHA512, rsa4096_e65537_sig },
+   { "rsa4096-e3-sha256", 4096, rsa4096_e3_modulus, 3,
+     MBEDTLS_MD_SHA256, rsa4096_e3_sig },
+};
+
+static struct {
+   mbedtls_rsa_context rsa;
+   unsigned char md[MBEDTLS_MD_MAX_SIZE];
+   unsigned int mdLen;
+} rsaContexts[ARRAYSIZE(rsaVectors)];
+
+static int bench_hmac(const mbedtls_md_type_t md_type,
+                      const unsigned char *key, size_t keylen,
+                      const unsigned char *input, size_t ilen,
+                      unsigned char *output)
+{
+   return mbedtls_md_hmac(mbedtls_md_info_from_type(md_type), key, keylen,
+                          input, ilen, output);
+}
+
+static VMW_MBEDTLS_PROTOCOL BenchMbedTls = {
+   MBEDTLS_CURRENT_API_VERSION,
+   "ESXboot cryptographic module, host benchmark",
+   mbedtls_rsa_init,
+   mbedtls_rsa_pkcs1_verify,
+   mbedtls_mpi_lset,
+   mbedtls_mpi_read_binary,
+   mbedtls_mpi_read_string,
+   mbedtls_sha256_ret,
+   mbedtls_sha512_ret,
+   bench_hmac
+};
+
+VMW_MBEDTLS_PROTOCOL *mbedtls = &BenchMbedTls;
+
+void Log(int level, const char *fmt, ...)
+{
+   char msg[512];
+   va_list ap;
+
+   va_start(ap, fmt);
+   vsnprintf(msg, sizeof (msg), fmt, ap);
+   va_end(ap);
+
+   bench_log(level, msg);
+}
+
+void failure(const char *msg)
+{
+   bench_failure(msg);
+}
+
+static void add_hash(bench_hash_type_t type, sha_backend_t backend,
+                     const char *name)
+{
+   snprintf(hashes[hashes_nr].name, BENCH_NAME_LEN, "%s", name);
+   hashes[hashes_nr].type = type;
+   hashes[hashes_nr].backend = backend;
+   hashes_nr++;
+}
+
+int bench_init(void)
+{
+   char name[BENCH_NAME_LEN];
+   sha_backend_t backend;
+   unsigned int i;
+   int errcode;
+
+   add_hash(BENCH_MD5, SHA_BACKEND_GENERIC, "md5");
+   add_hash(BENCH_CRC_32, SHA_BACKEND_GENERIC, "crc_32");
+   add_hash(BENCH_ZLIB_CRC32, SHA_BACKEND_GENERIC, "zlib-crc32");
+
+   for (backend = 0; backend < SHA_BACKEND_COUNT; backend++) {
+      if (sha_accel_supported(SHA_ACCEL_SHA256, backend)) {
+         snprintf(name, sizeof (name), "sha256-%s", sha_accel_name(backend));
+         add_hash(BENCH_SHA256, backend, name);
+      }
+   }
+   for (backend = 0; backend < SHA_BACKEND_COUNT; backend++) {
+      if (sha_accel_supported(SHA_ACCEL_SHA512, backend)) {
+         snprintf(name, sizeof (name), "sha512-%s", sha_accel_name(backend));
+         add_hash(BENCH_SHA512, backend, name);
+      }
+   }
+
+   for (i = 0; i < ARRAYSIZE(rsaVectors); i++) {
+      mbedtls_rsa_init(&rsaContexts[i].rsa, MBEDTLS_RSA_PKCS_V15,
+                       MBEDTLS_MD_NONE);
+      rsaContexts[i].rsa.len = rsaVectors[i].bits / 8;
+      errcode = mbedtls_mpi_read_string(&rsaContexts[i].rsa.N, 16,
+                                        rsaVectors[i].modulus);
+      if (errcode == 0) {
+         errcode = mbedtls_mpi_lset(&rsaContexts[i].rsa.E,
+                                    rsaVectors[i].exponent);
+      }
+      if (errcode == 0) {
+         if (rsaVectors[i].digest == MBEDTLS_MD_SHA256) {
+            rsaContexts[i].mdLen = 32;
+            errcode = mbedtls_sha256_ret((const uint8_t *)BENCH_RSA_MESSAGE,
+                                         sizeof (BENCH_RSA_MESSAGE) - 1,
+                                         rsaContexts[i].md, 0);
+         } else {
+            rsaContexts[i].mdLen = 64;
+            errcode = mbedtls_sha512_ret((const uint8_t *)BENCH_RSA_MESSAGE,
+                                         sizeof (BENCH_RSA_MESSAGE) - 1,
+                                         rsaContexts[i].md, 0);
+         }
+      }
+      if (errcode == 0) {
+         /* Also checks the test vector */
+         errcode = bench_rsa_verify(i);
+      }
+      if (errcode != 0) {
+         return errcode;
+      }
+   }
+
+   return 0;
+}
+
+unsigned int bench_hash_count(void)
+{
+   return hashes_nr;
+}
+
+const char *bench_hash_name(unsigned int i)
+{
+   return hashes[i].name;
+}
+
+int bench_hash(unsigned int i, const void *data, size_t len)
+{
+   unsigned char md[MBEDTLS_MD_MAX_SIZE];
+   md5_t md5;
+
+   switch (hashes[i].type) {
+   case BENCH_MD5:
+      md5_compute((void *)data, len, &md5);
+      return 0;
+   case BENCH_CRC_32:
+      checksum = crc_32((void *)data, len);
+      return 0;
+   case BENCH_ZLIB_CRC32:
+      checksum = (uint32_t)crc32_z(0, data, len);
+      return 0;
+   case BENCH_SHA256:
+      sha_accel_select(SHA_ACCEL_SHA256, hashes[i].backend);
+      return mbedtls_sha256_ret(data, len, md, 0);
+   case BENCH_SHA512:
+      sha_accel_select(SHA_ACCEL_SHA512, hashes[i].backend);
+      return mbedtls_sha512_ret(data, len, md, 0);
+   }
+
+   return -1;
+}
+
+unsigned int bench_rsa_count(void)
+{
+   return ARRAYSIZE(rsaVectors);
+}
+
+const char *bench_rsa_name(unsigned int i)
+{
+   return rsaVectors[i].name;
+}
+
+int bench_rsa_verify(unsigned int i)
+{
+   return mbedtls_rsa_pkcs1_verify(&rsaContexts[i].rsa, NULL, NULL,
+                                   MBEDTLS_RSA_PUBLIC, rsaVectors[i].digest,
+                                   rsaContexts[i].mdLen, rsaContexts[i].md,
+                                   rsaVectors[i].sig);
+}
+
+void bench_self_test(void)
+{
+   self_test();
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * bench_fat.c -- Host benchmark for loading files from a FAT volume
+ *
+ *   bench_fat [-n <iterations>] [-v] <image> <file> [<file> ...]
+ *
+ *      -n <iterations>  Load the whole file list this many times (default 1)
+ *      -v               Print the boot loader log messages on stderr
+ *
+ *   The image is a FAT file system without a partition table, as created by
+ *   mkfs.vfat or mkbootbank.sh. The files are loaded with bootlib file_load(),
+ *   exactly as mboot does when booting with the -p option.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench_fat.h"
+
+static struct {
+   int fd;
+   uint64_t sectors;
+   bool verbose;
+} image;
+
+int bench_image_read(uint64_t offset, void *buffer, size_t len)
+{
+   if (pread(image.fd, buffer, len, (off_t)offset) != (ssize_t)len) {
+      return -1;
+   }
+
+   return 0;
+}
+
+uint64_t bench_image_sectors(void)
+{
+   return image.sectors;
+}
+
+void bench_log(int level, const char *msg)
+{
+   if (image.verbose) {
+      fprintf(stderr, "<%d> %s\n", level, msg);
+   }
+}
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *progname)
+{
+   fprintf(stderr, "Usage: %s [-n <iterations>] [-v] <image> <file>...\n",
+           progname);
+   exit(1);
+}
+
+int main(int argc, char **argv)
+{
+   uint64_t bytes_loaded, files_loaded;
+   int i, iterations, opt, status;
+   double start, elapsed;
+   bench_stats_t stats;
+   size_t size;
+   off_t len;
+
+   iterations = 1;
+
+   while ((opt = getopt(argc, argv, "n:v")) != -1) {
+      switch (opt) {
+         case 'n':
+            iterations = atoi(optarg);
+            break;
+         case 'v':
+            image.verbose = true;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+
+   if (argc - optind < 2 || iterations < 1) {
+      usage(argv[0]);
+   }
+
+   image.fd = open(argv[optind], O_RDONLY);
+   if (image.fd < 0) {
+      perror(argv[optind]);
+      return 1;
+   }
+
+   len = lseek(image.fd, 0, SEEK_END);
+   image.sectors = (uint64_t)len / BENCH_BYTES_PER_SECTOR;
+
+   bytes_loaded = 0;
+   files_loaded = 0;
+   start = now();
+
+   while (iterations-- > 0) {
+      for (i = optind + 1; i < argc; i++) {
+         status = bench_load_file(argv[i], &size);
+         if (status != 0) {
+            fprintf(stderr, "%s: error %d\n", argv[i], status);
+            return 1;
+         }
+
+         files_loaded++;
+         bytes_loaded += size;
+      }
+   }
+
+   elapsed = now() - start;
+
+   bench_get_stats(argv[optind + 1], &stats);
+
+   printf("files loaded:      %llu\n", (unsigned long long)files_loaded);
+   printf("bytes loaded:      %llu\n", (unsigned long long)bytes_loaded);
+   printf("elapsed:           %.3f s\n", elapsed);
+   printf("throughput:        %.1f MB/s\n", elapsed > 0 ?
+          (double)bytes_loaded / elapsed / (1024 * 1024) : 0.0);
+   printf("disk_read calls:   %llu\n", (unsigned long long)stats.disk_reads);
+   printf("avg request size:  %.1f KB\n", stats.disk_reads > 0 ?
+          (double)stats.sectors_read * BENCH_BYTES_PER_SECTOR /
+          stats.disk_reads / 1024 : 0.0);
+   printf("sector cache:      %u lookups, %.1f%% hits\n", stats.cache_lookups,
+          stats.cache_lookups > 0 ? 100.0 *
+          (stats.cache_lookups - stats.cache_misses) / stats.cache_lookups :
+          0.0);
+
+   close(image.fd);
+
+   return 0;
+}
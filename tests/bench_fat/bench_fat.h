@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * bench_fat.h -- Interface between the host benchmark driver and the boot
+ *                loader code it runs
+ *
+ *   fat_shim.c is built against the boot loader headers, and bench_fat.c
+ *   against the host C library. Only the plain C types below cross between
+ *   the two.
+ */
+
+#ifndef BENCH_FAT_H_
+#define BENCH_FAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BENCH_BYTES_PER_SECTOR   512
+
+typedef struct {
+   uint64_t disk_reads;         /* Number of disk_read() calls */
+   uint64_t sectors_read;       /* Sectors read by disk_read() */
+   uint32_t cache_lookups;      /* libfat sector cache lookups */
+   uint32_t cache_misses;       /* libfat sector cache misses */
+} bench_stats_t;
+
+/*
+ * bench_fat.c
+ */
+int bench_image_read(uint64_t offset, void *buffer, size_t len);
+uint64_t bench_image_sectors(void);
+void bench_log(int level, const char *msg);
+
+/*
+ * fat_shim.c
+ */
+int bench_load_file(const char *filepath, size_t *size);
+void bench_get_stats(const char *filepath, bench_stats_t *stats);
+
+#endif /* !BENCH_FAT_H_ */
@@ -0,0 +1,215 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * fat_shim.c -- Firmware services for running bootlib/file.c on the host
+ *
+ *   The boot disk is the FAT image opened by bench_fat.c. It has no partition
+ *   table, and the whole image is exposed as partition BENCH_VOLUME.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <boot_services.h>
+#include <bootlib.h>
+#include <libfat.h>
+#include <libfatint.h>
+#include "bench_fat.h"
+
+#define BENCH_VOLUME             1
+#define BENCH_DISK_ID            0xbe
+
+int fat_file_open(int volid, const char *filename,
+                  struct libfat_filesystem **fsinfo, libfat_sector_t *sector,
+                  size_t *size);
+
+static uint64_t disk_reads;
+static uint64_t sectors_read;
+
+void *sys_malloc(size_t size)
+{
+   return malloc(size);
+}
+
+void sys_free(void *ptr)
+{
+   free(ptr);
+}
+
+void Log(int level, const char *fmt, ...)
+{
+   char msg[512];
+   va_list ap;
+
+   va_start(ap, fmt);
+   vsnprintf(msg, sizeof (msg), fmt, ap);
+   va_end(ap);
+
+   bench_log(level, msg);
+}
+
+void firmware_reset_watchdog(void)
+{
+}
+
+int get_boot_disk(disk_t *disk)
+{
+   memset(disk, 0, sizeof (disk_t));
+   disk->firmware_id = BENCH_DISK_ID;
+   disk->bytes_per_sector = BENCH_BYTES_PER_SECTOR;
+
+   return ERR_SUCCESS;
+}
+
+int get_volume_info(disk_t *disk, int part_id, partition_t *partition)
+{
+   if (disk->firmware_id != BENCH_DISK_ID) {
+      return ERR_INVALID_PARAMETER;
+   }
+
+   if (part_id != BENCH_VOLUME) {
+      return ERR_NOT_FOUND;
+   }
+
+   memset(partition, 0, sizeof (partition_t));
+   partition->id = part_id;
+   partition->info.start_lba = 0;
+   partition->info.sectors_num = (uint32_t)bench_image_sectors();
+
+   return ERR_SUCCESS;
+}
+
+int disk_read(const disk_t *disk, void *buffer, uint64_t lba, size_t count)
+{
+   if (lba + count > bench_image_sectors()) {
+      return ERR_INVALID_PARAMETER;
+   }
+
+   if (bench_image_read(lba * disk->bytes_per_sector, buffer,
+                        count * disk->bytes_per_sector) != 0) {
+      return ERR_DEVICE_ERROR;
+   }
+
+   disk_reads++;
+   sectors_read += count;
+
+   return ERR_SUCCESS;
+}
+
+int disk_write(UNUSED_PARAM(const disk_t *disk), UNUSED_PARAM(void *buffer),
+               UNUSED_PARAM(uint64_t lba), UNUSED_PARAM(size_t count))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_get_size_hint(UNUSED_PARAM(const char *filepath),
+                                UNUSED_PARAM(size_t *size))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_read(UNUSED_PARAM(const char *filepath),
+                       UNUSED_PARAM(int (*callback)(size_t)),
+                       UNUSED_PARAM(void **buffer),
+                       UNUSED_PARAM(size_t *bufsize))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_prefetch(UNUSED_PARAM(const char *filepath))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_get_etag(UNUSED_PARAM(const char *filepath),
+                           UNUSED_PARAM(char **etag))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_check_etag(UNUSED_PARAM(const char *filepath),
+                             UNUSED_PARAM(const char *etag))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_file_write(UNUSED_PARAM(const char *filepath),
+                        UNUSED_PARAM(int (*callback)(size_t)),
+                        UNUSED_PARAM(void *buffer),
+                        UNUSED_PARAM(size_t bufsize))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_local_file_read(UNUSED_PARAM(const char *filepath),
+                             UNUSED_PARAM(int (*callback)(size_t)),
+                             UNUSED_PARAM(void **buffer),
+                             UNUSED_PARAM(size_t *bufsize))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_local_file_write(UNUSED_PARAM(const char *filepath),
+                              UNUSED_PARAM(int (*callback)(size_t)),
+                              UNUSED_PARAM(void *buffer),
+                              UNUSED_PARAM(size_t bufsize))
+{
+   return ERR_UNSUPPORTED;
+}
+
+int firmware_local_file_delete(UNUSED_PARAM(const char *filepath))
+{
+   return ERR_UNSUPPORTED;
+}
+
+/*-- bench_load_file -----------------------------------------------------------
+ *
+ *      Load a file from the FAT image, the same way mboot does, and free it.
+ *
+ * Parameters
+ *      IN  filepath: absolute path to the file
+ *      OUT size:     the file size, in bytes
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int bench_load_file(const char *filepath, size_t *size)
+{
+   void *buffer;
+   int status;
+
+   status = file_load(BENCH_VOLUME, filepath, NULL, &buffer, size);
+   if (status == ERR_SUCCESS) {
+      sys_free(buffer);
+   }
+
+   return status;
+}
+
+/*-- bench_get_stats -----------------------------------------------------------
+ *
+ *      Get the disk and libfat sector cache statistics.
+ *
+ * Parameters
+ *      IN  filepath: any file on the image, for reaching the mounted volume
+ *      OUT stats:    the statistics
+ *----------------------------------------------------------------------------*/
+void bench_get_stats(const char *filepath, bench_stats_t *stats)
+{
+   struct libfat_filesystem *fs;
+   libfat_sector_t sector;
+   size_t size;
+
+   memset(stats, 0, sizeof (bench_stats_t));
+   stats->disk_reads = disk_reads;
+   stats->sectors_read = sectors_read;
+
+   if (fat_file_open(BENCH_VOLUME, filepath, &fs, &sector,
+                     &size) == ERR_SUCCESS) {
+      stats->cache_lookups = fs->cache_lookups;
+      stats->cache_misses = fs->cache_misses;
+   }
+}
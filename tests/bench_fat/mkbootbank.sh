@@ -0,0 +1,53 @@
+#! /bin/sh
+#*******************************************************************************
+# Copyright (c) 2026 VMware, Inc.  All rights reserved.
+# SPDX-License-Identifier: GPL-2.0
+#*******************************************************************************
+
+#
+# Create a FAT image holding a synthetic bootbank, for bench_fat.
+#
+#   mkbootbank.sh <image> [<modules> [<module size in KB>]]
+#
+# The module names are printed on stdout, so that a benchmark can be run with:
+#
+#   bench_fat <image> $(mkbootbank.sh <image>)
+#
+# Requires mkfs.vfat (dosfstools) and mcopy (mtools).
+#
+
+set -e
+
+image=$1
+modules=${2:-100}
+module_kb=${3:-4096}
+
+if [ -z "$image" ]; then
+   echo "Usage: $0 <image> [<modules> [<module size in KB>]]" >&2
+   exit 1
+fi
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+# Leave 25% of free space, plus room for the file system metadata.
+image_kb=$((modules * module_kb * 5 / 4 + 8192))
+
+rm -f "$image"
+mkfs.vfat -C -n BOOTBANK "$image" $image_kb >/dev/null
+
+echo "kernel=/b.b00" > "$tmpdir/boot.cfg"
+mcopy -i "$image" "$tmpdir/boot.cfg" ::/boot.cfg
+names="boot.cfg"
+
+i=0
+while [ $i -lt "$modules" ]; do
+   name=$(printf "m%03d.v00" $i)
+   head -c $((module_kb * 1024)) /dev/urandom > "$tmpdir/$name"
+   mcopy -i "$image" "$tmpdir/$name" ::/$name
+   rm -f "$tmpdir/$name"
+   names="$names $name"
+   i=$((i + 1))
+done
+
+echo $names
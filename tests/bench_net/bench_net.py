@@ -0,0 +1,499 @@
+#! /usr/bin/python3
+
+#*******************************************************************************
+# Copyright (c) 2026 VMware, Inc.  All rights reserved.
+# SPDX-License-Identifier: GPL-2.0
+#*******************************************************************************
+
+# bench_net -- Loopback network boot benchmark
+#
+#   bench_net [options] <mboot.efi>
+#
+# Boots mboot under QEMU/OVMF over a user-mode network, against a synthetic
+# bootbank served from a temporary directory, and reports the time spent in
+# each boot phase together with the per-module transfer statistics printed by
+# mboot.  No real network, and no privileges, are needed for the default
+# configuration.
+#
+#   -p tftp   mboot.efi, boot.cfg and the modules are all fetched over TFTP.
+#   -p http   mboot.efi and boot.cfg are fetched over TFTP, and the modules
+#             over native UEFI HTTP (boot.cfg sets prefix= and nativehttp=3).
+#
+# The HTTP stand-in listens on the loopback interface, and injects the
+# requested latency (-d), bandwidth limit (-r) and loss (-l).  TCP hides
+# packet loss, so for HTTP a loss is emulated by cutting the response short,
+# which exercises the resume logic.
+#
+# The TFTP server built into QEMU cannot be slowed down.  With --tftp-standin
+# a TFTP stand-in is used instead, which delays and drops DATA packets as
+# requested.  The guest always talks to port 69, so this needs the privilege
+# to bind that port on the host.
+#
+# mboot must be built with DEBUG=1, so that it logs the transfer statistics
+# to the serial port.  The stub kernel (bench_net_kernel) exits QEMU as soon as
+# it is started, which ends the run.
+
+import argparse
+import gzip
+import heapq
+import http.server
+import json
+import os
+import random
+import re
+import shutil
+import socket
+import socketserver
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+GUEST_HOST_ADDR = '10.0.2.2'    # QEMU user-mode network alias for the host
+DEBUG_EXIT_STATUS = 67          # See kernel.S
+
+OVMF_PATHS = ['/usr/share/OVMF/OVMF.fd',
+              '/usr/share/ovmf/OVMF.fd',
+              '/usr/share/qemu/OVMF.fd',
+              '/usr/share/edk2/ovmf/OVMF.fd']
+
+#
+# Synthetic bootbank
+#
+
+def make_bootbank(root, args, http_port):
+   shutil.copy(args.mboot, os.path.join(root, 'mboot.efi'))
+   shutil.copy(args.kernel, os.path.join(root, 'b.b00'))
+
+   names = []
+   for i in range(args.modules):
+      name = 'm%03d.v00' % i
+      # Random data does not compress: the module keeps the requested size.
+      data = os.urandom(args.module_kb * 1024)
+      with open(os.path.join(root, name), 'wb') as f:
+         f.write(gzip.compress(data, compresslevel=1))
+      names.append(name)
+
+   with open(os.path.join(root, 'boot.cfg'), 'w') as f:
+      f.write('title=bench_net\n')
+      f.write('timeout=0\n')
+      f.write('kernel=b.b00\n')
+      f.write('kernelopt=\n')
+      f.write('modules=%s\n' % ' --- '.join(names))
+      if args.protocol == 'http':
+         f.write('prefix=http://%s:%u/\n' % (GUEST_HOST_ADDR, http_port))
+         f.write('nativehttp=3\n')
+
+#
+# Network impairments
+#
+
+class Impairment:
+   def __init__(self, args):
+      self.delay = args.delay / 1000.0
+      self.loss = args.loss / 100.0
+      self.rate = args.rate * 1024
+      self.rng = random.Random(args.seed)
+      self.lock = threading.Lock()
+
+   def lost(self):
+      with self.lock:
+         return self.rng.random() < self.loss
+
+class DelayLine(threading.Thread):
+   """Send datagrams after a fixed delay, without blocking the sender."""
+
+   def __init__(self, impairment):
+      threading.Thread.__init__(self, daemon=True)
+      self.impairment = impairment
+      self.queue = []
+      self.seq = 0
+      self.cond = threading.Condition()
+      self.start()
+
+   def send(self, sock, data, addr):
+      if self.impairment.lost():
+         return
+      with self.cond:
+         due = time.monotonic() + self.impairment.delay
+         heapq.heappush(self.queue, (due, self.seq, sock, data, addr))
+         self.seq += 1
+         self.cond.notify()
+
+   def run(self):
+      while True:
+         with self.cond:
+            while not self.queue:
+               self.cond.wait()
+            due, _, sock, data, addr = self.queue[0]
+            now = time.monotonic()
+            if due > now:
+               self.cond.wait(due - now)
+               continue
+            heapq.heappop(self.queue)
+         try:
+            sock.sendto(data, addr)
+         except OSError:
+            pass
+
+#
+# HTTP stand-in
+#
+
+class HttpHandler(http.server.SimpleHTTPRequestHandler):
+   protocol_version = 'HTTP/1.1'
+
+   def log_message(self, format, *args):
+      pass
+
+   def copyfile(self, source, outputfile):
+      imp = self.server.impairment
+      time.sleep(imp.delay)
+      chunk = 16 * 1024
+      sent = 0
+      start = time.monotonic()
+      while True:
+         data = source.read(chunk)
+         if not data:
+            break
+         if imp.loss > 0 and imp.lost():
+            # Cut the response short; the client has to resume.
+            self.close_connection = True
+            return
+         outputfile.write(data)
+         sent += len(data)
+         if imp.rate > 0:
+            ahead = sent / imp.rate - (time.monotonic() - start)
+            if ahead > 0:
+               time.sleep(ahead)
+
+   def send_head(self):
+      rng = self.headers.get('Range')
+      path = self.translate_path(self.path)
+      if rng is None or not os.path.isfile(path):
+         return http.server.SimpleHTTPRequestHandler.send_head(self)
+
+      m = re.match(r'bytes=(\d+)-(\d*)$', rng)
+      size = os.path.getsize(path)
+      if m is None or int(m.group(1)) >= size:
+         self.send_error(416)
+         return None
+      first = int(m.group(1))
+      last = int(m.group(2)) if m.group(2) else size - 1
+      last = min(last, size - 1)
+
+      f = open(path, 'rb')
+      f.seek(first)
+      self.send_response(206)
+      self.send_header('Content-Type', 'application/octet-stream')
+      self.send_header('Content-Range',
+                       'bytes %u-%u/%u' % (first, last, size))
+      self.send_header('Content-Length', str(last - first + 1))
+      self.end_headers()
+      return RangeFile(f, last - first + 1)
+
+class RangeFile:
+   def __init__(self, f, length):
+      self.f = f
+      self.left = length
+
+   def read(self, n):
+      data = self.f.read(min(n, self.left))
+      self.left -= len(data)
+      return data
+
+   def close(self):
+      self.f.close()
+
+class HttpServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+   daemon_threads = True
+   allow_reuse_address = True
+
+def start_http(root, impairment):
+   handler = lambda *a, **kw: HttpHandler(*a, directory=root, **kw)
+   server = HttpServer(('127.0.0.1', 0), handler)
+   server.impairment = impairment
+   threading.Thread(target=server.serve_forever, daemon=True).start()
+   return server
+
+#
+# TFTP stand-in (RFC 1350, with the blksize, tsize and windowsize options)
+#
+
+TFTP_RRQ, TFTP_WRQ, TFTP_DATA, TFTP_ACK, TFTP_ERROR, TFTP_OACK = range(1, 7)
+
+class TftpTransfer(threading.Thread):
+   def __init__(self, server, addr, filename, options):
+      threading.Thread.__init__(self, daemon=True)
+      self.server = server
+      self.addr = addr
+      self.filename = filename
+      self.options = options
+      self.start()
+
+   def error(self, sock, code, msg):
+      sock.sendto(struct.pack('!HH', TFTP_ERROR, code) + msg.encode() +
+                  b'\0', self.addr)
+
+   def run(self):
+      sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+      sock.bind(('0.0.0.0', 0))
+      try:
+         self.transfer(sock)
+      finally:
+         sock.close()
+
+   def transfer(self, sock):
+      path = os.path.normpath(os.path.join(self.server.root,
+                                           self.filename.lstrip('/')))
+      if not path.startswith(self.server.root) or not os.path.isfile(path):
+         self.error(sock, 1, 'File not found')
+         return
+      with open(path, 'rb') as f:
+         data = f.read()
+
+      blksize = 512
+      window = 1
+      oack = b''
+      if 'blksize' in self.options:
+         blksize = max(8, min(65464, int(self.options['blksize'])))
+         oack += b'blksize\0%u\0' % blksize
+      if 'windowsize' in self.options:
+         window = max(1, min(64, int(self.options['windowsize'])))
+         oack += b'windowsize\0%u\0' % window
+      if 'tsize' in self.options:
+         oack += b'tsize\0%u\0' % len(data)
+
+      line = self.server.delayline
+      sock.settimeout(1.0)
+      nblocks = len(data) // blksize + 1
+      acked = 0
+      retries = 0
+
+      if oack:
+         while True:
+            line.send(sock, struct.pack('!H', TFTP_OACK) + oack, self.addr)
+            pkt = self.receive(sock)
+            if pkt is None:
+               retries += 1
+               if retries > 5:
+                  return
+               continue
+            opcode, arg = pkt
+            if opcode == TFTP_ERROR:
+               return         # e.g. a size query
+            if opcode == TFTP_ACK and arg == 0:
+               break
+
+      retries = 0
+      while acked < nblocks:
+         last = min(acked + window, nblocks)
+         for block in range(acked + 1, last + 1):
+            chunk = data[(block - 1) * blksize:block * blksize]
+            line.send(sock, struct.pack('!HH', TFTP_DATA, block & 0xffff) +
+                      chunk, self.addr)
+         pkt = self.receive(sock)
+         if pkt is None:
+            retries += 1
+            if retries > 5:
+               return
+            continue
+         opcode, arg = pkt
+         if opcode == TFTP_ERROR:
+            return
+         if opcode != TFTP_ACK:
+            continue
+         # Block numbers wrap around; map the ACK into the current window.
+         delta = (arg - acked) & 0xffff
+         if delta <= last - acked:
+            acked += delta
+            retries = 0
+
+   def receive(self, sock):
+      while True:
+         try:
+            pkt, addr = sock.recvfrom(65536)
+         except socket.timeout:
+            return None
+         if addr == self.addr and len(pkt) >= 4:
+            return struct.unpack('!HH', pkt[:4])
+
+class TftpServer(threading.Thread):
+   def __init__(self, root, port, impairment):
+      threading.Thread.__init__(self, daemon=True)
+      self.root = os.path.realpath(root)
+      self.delayline = DelayLine(impairment)
+      self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+      self.sock.bind(('127.0.0.1', port))
+      self.start()
+
+   def run(self):
+      while True:
+         pkt, addr = self.sock.recvfrom(65536)
+         if len(pkt) < 4 or struct.unpack('!H', pkt[:2])[0] != TFTP_RRQ:
+            continue
+         fields = pkt[2:].split(b'\0')
+         filename = fields[0].decode(errors='replace')
+         options = {}
+         for i in range(2, len(fields) - 1, 2):
+            options[fields[i].decode().lower()] = fields[i + 1].decode()
+         TftpTransfer(self, addr, filename, options)
+
+#
+# Benchmark
+#
+
+MODULE_RE = re.compile(r'(\S+) \(MD5: \w+\): transferred .*\((\d+) bytes\)'
+                       r'(?: in (\d+)\.(\d+) seconds)?')
+MODULE_SMALL_RE = re.compile(r'(\S+) \(MD5: \w+\): transferred (\d+) bytes'
+                             r'(?: in (\d+)\.(\d+) seconds)?')
+
+PHASES = [('firmware', re.compile(r'Loading .*boot\.cfg')),
+          ('config', re.compile(r'Loading .*b\.b00')),
+          ('modules', re.compile(r'Total transferred')),
+          ('handoff', re.compile(r'Shutting down firmware services'))]
+
+def run_qemu(args, root):
+   netdev = 'user,id=n0,bootfile=mboot.efi'
+   if not args.tftp_standin:
+      netdev += ',tftp=' + root
+   cmd = [args.qemu, '-machine', 'q35', '-m', str(args.memory),
+          '-bios', args.ovmf,
+          '-netdev', netdev,
+          '-device', 'virtio-net-pci,netdev=n0,romfile=,bootindex=0',
+          '-device', 'isa-debug-exit,iobase=0xf4,iosize=0x04',
+          '-display', 'none', '-serial', 'stdio', '-no-reboot']
+   if args.kvm:
+      cmd += ['-enable-kvm', '-cpu', 'host']
+
+   marks = {}
+   modules = {}
+   start = time.monotonic()
+   proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                           stderr=subprocess.STDOUT, stdin=subprocess.DEVNULL)
+   timer = threading.Timer(args.timeout, proc.kill)
+   timer.start()
+   for raw in proc.stdout:
+      line = raw.decode(errors='replace').rstrip()
+      now = time.monotonic() - start
+      if args.verbose:
+         print('%8.3f %s' % (now, line), file=sys.stderr)
+      for name, regex in PHASES:
+         if name not in marks and regex.search(line):
+            marks[name] = now
+      m = MODULE_RE.search(line) or MODULE_SMALL_RE.search(line)
+      if m:
+         path = os.path.basename(m.group(1))
+         seconds = float('%s.%s' % (m.group(3), m.group(4))) \
+                   if m.group(3) is not None else 0.0
+         modules[path] = {'bytes': int(m.group(2)), 'seconds': seconds}
+   status = proc.wait()
+   timer.cancel()
+   end = time.monotonic() - start
+
+   if status != DEBUG_EXIT_STATUS:
+      raise RuntimeError('QEMU exited with status %d before the stub kernel '
+                         'ran (see -v)' % status)
+
+   phases = {}
+   prev = 0.0
+   for name, _ in PHASES:
+      if name not in marks:
+         raise RuntimeError('no "%s" phase in the log; is mboot built with '
+                            'DEBUG=1?' % name)
+      phases[name] = marks[name] - prev
+      prev = marks[name]
+   phases['kernel'] = end - prev
+   phases['total'] = end
+
+   return {'phases': phases, 'modules': modules}
+
+def report(args, runs):
+   print('protocol:          %s' % args.protocol)
+   print('modules:           %u x %u KB' % (args.modules, args.module_kb))
+   print('delay/loss/rate:   %u ms / %.1f%% / %s' %
+         (args.delay, args.loss,
+          '%u KB/s' % args.rate if args.rate else 'unlimited'))
+   for name in [p[0] for p in PHASES] + ['kernel', 'total']:
+      values = [r['phases'][name] for r in runs]
+      print('%-18s %.3f s (min %.3f, max %.3f)' %
+            (name + ':', sum(values) / len(values), min(values), max(values)))
+   total_bytes = sum(m['bytes'] for m in runs[-1]['modules'].values())
+   modules_time = sum(r['phases']['modules'] for r in runs) / len(runs)
+   if modules_time > 0:
+      print('throughput:        %.1f MB/s' %
+            (total_bytes / modules_time / (1024 * 1024)))
+
+def main():
+   parser = argparse.ArgumentParser(description='Loopback network boot '
+                                    'benchmark.')
+   parser.add_argument('mboot', help='mboot.efi, built with DEBUG=1')
+   parser.add_argument('-p', '--protocol', choices=['tftp', 'http'],
+                       default='tftp')
+   parser.add_argument('-m', '--modules', type=int, default=20)
+   parser.add_argument('-k', '--module-kb', type=int, default=4096)
+   parser.add_argument('-d', '--delay', type=int, default=0,
+                       help='one-way latency, in ms')
+   parser.add_argument('-l', '--loss', type=float, default=0.0,
+                       help='loss rate, in percent')
+   parser.add_argument('-r', '--rate', type=int, default=0,
+                       help='HTTP bandwidth limit, in KB/s')
+   parser.add_argument('-n', '--runs', type=int, default=1)
+   parser.add_argument('-s', '--seed', type=int, default=1,
+                       help='seed for the loss pattern')
+   parser.add_argument('-j', '--json', help='also write the results here')
+   parser.add_argument('-v', '--verbose', action='store_true',
+                       help='print the timestamped serial log on stderr')
+   parser.add_argument('--tftp-standin', action='store_true',
+                       help='serve TFTP from this script (binds port 69)')
+   parser.add_argument('--kernel',
+                       default=os.path.join(os.path.dirname(
+                          os.path.realpath(__file__)), 'bench_net_kernel'))
+   parser.add_argument('--ovmf')
+   parser.add_argument('--qemu', default='qemu-system-x86_64')
+   parser.add_argument('--memory', type=int, default=4096)
+   parser.add_argument('--timeout', type=int, default=600)
+   parser.add_argument('--kvm', action='store_true')
+   args = parser.parse_args()
+
+   if args.ovmf is None:
+      args.ovmf = next((p for p in OVMF_PATHS if os.path.exists(p)), None)
+      if args.ovmf is None:
+         parser.error('OVMF not found, use --ovmf')
+
+   if args.protocol == 'tftp' and not args.tftp_standin and \
+      (args.delay or args.loss):
+      print('warning: latency and loss need --tftp-standin for TFTP',
+            file=sys.stderr)
+
+   impairment = Impairment(args)
+   root = tempfile.mkdtemp(prefix='bench_net.')
+   try:
+      http = start_http(root, impairment)
+      if args.tftp_standin:
+         TftpServer(root, 69, impairment)
+      make_bootbank(root, args, http.server_address[1])
+
+      runs = []
+      for _ in range(args.runs):
+         runs.append(run_qemu(args, root))
+
+      report(args, runs)
+      if args.json:
+         with open(args.json, 'w') as f:
+            json.dump({'protocol': args.protocol, 'modules': args.modules,
+                       'module_kb': args.module_kb, 'delay_ms': args.delay,
+                       'loss_pct': args.loss, 'rate_kbps': args.rate,
+                       'runs': runs}, f, indent=3)
+   except RuntimeError as e:
+      print('bench_net: %s' % e, file=sys.stderr)
+      return 1
+   finally:
+      shutil.rmtree(root)
+
+   return 0
+
+if __name__ == '__main__':
+   sys.exit(main())
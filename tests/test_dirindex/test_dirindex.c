@@ -0,0 +1,508 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * test_dirindex.c -- Unit tests for the libfat directory index
+ *
+ *   The directory is built in memory, one 32-byte entry after the other,
+ *   and served to libfat_dirindex_build() by the sector functions below in
+ *   place of the libfat sector cache and FAT chain code.
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <bootlib.h>
+#include <libfat.h>
+#include <libfatint.h>
+#include "unittest.h"
+
+#define TESTS            \
+   TEST(valid)           \
+   TEST(truncated)       \
+   TEST(malformed)
+
+#define DIR_SECTOR_SIZE     512
+#define DIR_SECTORS         4
+#define DIR_ENTRIES         (DIR_SECTORS * DIR_SECTOR_SIZE / \
+                             sizeof (struct fat_dirent))
+
+#define ATTR_DIRECTORY      0x10
+#define ATTR_ARCHIVE        0x20
+#define ATTR_VOLUME_ID      0x08
+#define ATTR_VFAT           0x0f
+
+#define VFAT_LAST_SLOT      0x40
+#define VFAT_CHARS_PER_SLOT 13
+
+#define DELETED_ENTRY       0xe5
+
+static struct {
+   struct fat_dirent entries[DIR_ENTRIES];
+   unsigned int nr;                   /* Entries added so far */
+   libfat_sector_t bad_sector;        /* libfat_get_sector() fails on it */
+   libfat_sector_t end;               /* libfat_nextsector() at the end */
+} dir;
+
+static struct libfat_filesystem fs = {
+   .bytes_per_sector = DIR_SECTOR_SIZE
+};
+
+/*
+ * The directory starts at sector 1 (cluster 2), so that a sector number is
+ * never 0, which would mean the end of the directory.
+ */
+libfat_sector_t libfat_clustertosector(UNUSED_PARAM(const struct
+                                                    libfat_filesystem *fs),
+                                       int32_t cluster)
+{
+   return cluster == 2 ? 1 : (libfat_sector_t)-1;
+}
+
+libfat_sector_t libfat_nextsector(UNUSED_PARAM(struct libfat_filesystem *fs),
+                                  libfat_sector_t s)
+{
+   return s < DIR_SECTORS ? s + 1 : dir.end;
+}
+
+void *libfat_get_sector(UNUSED_PARAM(struct libfat_filesystem *fs),
+                        libfat_sector_t n)
+{
+   if (n == dir.bad_sector || n < 1 || n > DIR_SECTORS) {
+      return NULL;
+   }
+
+   return (char *)dir.entries + (n - 1) * DIR_SECTOR_SIZE;
+}
+
+/*-- dir_reset -----------------------------------------------------------------
+ *
+ *      Start a new, empty directory.
+ *----------------------------------------------------------------------------*/
+static void dir_reset(void)
+{
+   memset(&dir, 0, sizeof (dir));
+   dir.bad_sector = (libfat_sector_t)-1;
+   dir.end = 0;
+}
+
+/*-- shortname_csum ------------------------------------------------------------
+ *
+ *      Checksum of a short name, as stored in its VFAT slots.
+ *
+ * Parameters
+ *      IN name: the 11-character mangled name
+ *
+ * Results
+ *      The checksum.
+ *----------------------------------------------------------------------------*/
+static uint8_t shortname_csum(const char *name)
+{
+   uint8_t csum = 0;
+   int i;
+
+   for (i = 0; i < 11; i++) {
+      csum = ((csum & 1) << 7) + (csum >> 1) + (uint8_t)name[i];
+   }
+
+   return csum;
+}
+
+/*-- add_short -----------------------------------------------------------------
+ *
+ *      Append a short name entry to the directory.
+ *
+ * Parameters
+ *      IN name:    the 11-character mangled name
+ *      IN attr:    the entry attributes
+ *      IN cluster: the first cluster
+ *      IN size:    the file size
+ *
+ * Results
+ *      The entry index.
+ *----------------------------------------------------------------------------*/
+static unsigned int add_short(const char *name, uint8_t attr,
+                              uint32_t cluster, uint32_t size)
+{
+   struct fat_dirent *dep = &dir.entries[dir.nr];
+
+   memcpy(dep->name, name, 11);
+   write8(&dep->attribute, attr);
+   write16(&dep->clustlo, (uint16_t)cluster);
+   write16(&dep->clusthi, (uint16_t)(cluster >> 16));
+   write32(&dep->size, size);
+
+   return dir.nr++;
+}
+
+/*-- put_chars -----------------------------------------------------------------
+ *
+ *      Store part of a long name in a VFAT slot: the name characters, then a
+ *      NUL terminator, then 0xffff padding.
+ *----------------------------------------------------------------------------*/
+static void put_chars(le16_t *dst, int count, const char *name, size_t len,
+                      size_t pos)
+{
+   for (; count > 0; count--, dst++, pos++) {
+      if (pos < len) {
+         write16(dst, (uint8_t)name[pos]);
+      } else if (pos == len) {
+         write16(dst, 0x0000);
+      } else {
+         write16(dst, 0xffff);
+      }
+   }
+}
+
+/*-- add_slots -----------------------------------------------------------------
+ *
+ *      Append the VFAT slots of a long name to the directory, without the
+ *      short name entry that must follow them.
+ *
+ * Parameters
+ *      IN long_name: the long name
+ *      IN csum:      checksum of the short name
+ *
+ * Results
+ *      The index of the first slot (the one with the highest sequence
+ *      number).
+ *----------------------------------------------------------------------------*/
+static unsigned int add_slots(const char *long_name, uint8_t csum)
+{
+   size_t len = strlen(long_name);
+   unsigned int seq, nslots, first;
+   struct fat_vfat_slot *slot;
+   size_t pos;
+
+   nslots = (len + VFAT_CHARS_PER_SLOT - 1) / VFAT_CHARS_PER_SLOT;
+   first = dir.nr;
+
+   for (seq = nslots; seq > 0; seq--) {
+      slot = (struct fat_vfat_slot *)&dir.entries[dir.nr++];
+      pos = (seq - 1) * VFAT_CHARS_PER_SLOT;
+      write8(&slot->id, seq | (seq == nslots ? VFAT_LAST_SLOT : 0));
+      write8(&slot->attribute, ATTR_VFAT);
+      write8(&slot->alias_csum, csum);
+      put_chars(slot->name0, 5, long_name, len, pos);
+      put_chars(slot->name5, 6, long_name, len, pos + 5);
+      put_chars(slot->name11, 2, long_name, len, pos + 11);
+   }
+
+   return first;
+}
+
+/*-- add_long ------------------------------------------------------------------
+ *
+ *      Append a file with a long name to the directory.
+ *
+ * Parameters
+ *      IN long_name: the long name
+ *      IN name:      the 11-character mangled short name
+ *      IN cluster:   the first cluster
+ *
+ * Results
+ *      The index of the first slot.
+ *----------------------------------------------------------------------------*/
+static unsigned int add_long(const char *long_name, const char *name,
+                             uint32_t cluster)
+{
+   unsigned int first;
+
+   first = add_slots(long_name, shortname_csum(name));
+   add_short(name, ATTR_ARCHIVE, cluster, 1);
+
+   return first;
+}
+
+/*-- slot ----------------------------------------------------------------------
+ *
+ *      Get a VFAT slot of the directory, for corrupting it.
+ *----------------------------------------------------------------------------*/
+static struct fat_vfat_slot *slot(unsigned int index)
+{
+   return (struct fat_vfat_slot *)&dir.entries[index];
+}
+
+/*-- expect --------------------------------------------------------------------
+ *
+ *      Check the result of a directory index lookup.
+ *
+ * Parameters
+ *      IN di:        the directory index
+ *      IN name:      long name to look up, or NULL
+ *      IN shortname: short name to look up, or NULL
+ *      IN cluster:   expected result
+ *
+ * Results
+ *      True if the result is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect(const struct libfat_dirindex *di, const char *name,
+                   const char *shortname, int32_t cluster)
+{
+   int32_t result;
+
+   result = libfat_dirindex_lookup(di, name, shortname, NULL);
+   if (result != cluster) {
+      Log(LOG_ERR, "Lookup of %s: got %d, expected %d",
+          name != NULL ? name : shortname, result, cluster);
+      return true;
+   }
+
+   return false;
+}
+
+/*-- valid_test ----------------------------------------------------------------
+ *
+ *      Index a well-formed directory spanning several sectors, with long
+ *      names crossing sector boundaries.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool valid_test(void)
+{
+   struct libfat_dirindex *di;
+   struct libfat_direntry direntry;
+   unsigned int entry;
+   bool failed = false;
+
+   dir_reset();
+   add_short("ESXBOOT    ", ATTR_VOLUME_ID, 0, 0);
+   add_short("EFI        ", ATTR_DIRECTORY, 3, 4096);
+   add_long("a_very_long_module_name.tgz", "A_VERY~1TGZ", 10);
+   add_long("thirteen_char", "THIRTE~1   ", 11);
+   add_short("BOOT    CFG", ATTR_ARCHIVE, 12, 100);
+   add_short("EMPTY   TXT", ATTR_ARCHIVE, 13, 0);
+   add_short("DUP     B00", ATTR_ARCHIVE, 14, 1);
+   add_short("DUP     B00", ATTR_ARCHIVE, 15, 1);
+   add_long("deleted.b00", "DELETE~1B00", 16);
+   dir.entries[dir.nr - 1].name[0] = DELETED_ENTRY;
+
+   /* A long name whose slots span the first and second sectors */
+   while (dir.nr < 15) {
+      add_short("FILLER  B00", ATTR_ARCHIVE, 17, 1);
+   }
+   add_long("module-across-sectors.v00", "MODULE~1V00", 18);
+
+   /* The last entry of the last sector */
+   while (dir.nr < DIR_ENTRIES - 1) {
+      add_short("FILLER  B01", ATTR_ARCHIVE, 19, 1);
+   }
+   entry = add_short("LAST    B00", ATTR_ARCHIVE, 20, 1);
+
+   di = libfat_dirindex_build(&fs, 2);
+   if (di == NULL) {
+      Log(LOG_ERR, "libfat_dirindex_build() failed");
+      return true;
+   }
+
+   failed |= expect(di, "A_Very_Long_Module_Name.TGZ", NULL, 10);
+   failed |= expect(di, NULL, "A_VERY~1TGZ", 10);
+   failed |= expect(di, "thirteen_char", NULL, 11);
+   failed |= expect(di, "boot.cfg", NULL, -2);
+   failed |= expect(di, NULL, "BOOT    CFG", 12);
+   failed |= expect(di, "unknown", "UNKNOWN    ", -2);
+   failed |= expect(di, "boot.cfg", "BOOT    CFG", 12);
+   failed |= expect(di, NULL, "EFI        ", 3);
+   failed |= expect(di, NULL, "EMPTY   TXT", 0);
+   failed |= expect(di, NULL, "DUP     B00", 14);
+   failed |= expect(di, NULL, "ESXBOOT    ", -2);
+   failed |= expect(di, "deleted.b00", NULL, -2);
+   failed |= expect(di, "module-across-sectors.v00", NULL, 18);
+   failed |= expect(di, "a_very_long_module_name.tg", NULL, -2);
+   failed |= expect(di, "a_very_long_module_name.tgz2", NULL, -2);
+
+   if (libfat_dirindex_lookup(di, "LAST.B00", "LAST    B00",
+                              &direntry) != 20 ||
+       direntry.sector != 1 + entry / (DIR_SECTOR_SIZE / 32) ||
+       direntry.offset != (int)(entry % (DIR_SECTOR_SIZE / 32)) * 32 ||
+       memcmp(direntry.entry, &dir.entries[entry], 32) != 0) {
+      Log(LOG_ERR, "Wrong directory entry for LAST.B00");
+      failed = true;
+   }
+
+   libfat_dirindex_free(di);
+
+   return failed;
+}
+
+/*-- truncated_test ------------------------------------------------------------
+ *
+ *      Index directories that end early, or that cannot be read completely.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool truncated_test(void)
+{
+   struct libfat_dirindex *di;
+   bool failed = false;
+
+   /* Slots, then the end of the directory instead of the short name */
+   dir_reset();
+   add_short("FIRST   B00", ATTR_ARCHIVE, 10, 1);
+   add_slots("orphan_long_name.v00", shortname_csum("ORPHAN~1V00"));
+
+   di = libfat_dirindex_build(&fs, 2);
+   if (di == NULL) {
+      Log(LOG_ERR, "Slots before the end: libfat_dirindex_build() failed");
+      return true;
+   }
+   failed |= expect(di, NULL, "FIRST   B00", 10);
+   failed |= expect(di, "orphan_long_name.v00", NULL, -2);
+   libfat_dirindex_free(di);
+
+   /* Full directory, without an end marker: the FAT chain ends it */
+   dir_reset();
+   while (dir.nr < DIR_ENTRIES - 2) {
+      add_short("FILLER  B00", ATTR_ARCHIVE, 10, 1);
+   }
+   add_long("last_file.b00", "LAST_F~1B00", 11);
+
+   di = libfat_dirindex_build(&fs, 2);
+   if (di == NULL) {
+      Log(LOG_ERR, "Full directory: libfat_dirindex_build() failed");
+      return true;
+   }
+   failed |= expect(di, "last_file.b00", NULL, 11);
+   libfat_dirindex_free(di);
+
+   /* The slots of a long name are cut at the end of the directory */
+   dir_reset();
+   while (dir.nr < DIR_ENTRIES - 3) {
+      add_short("FILLER  B00", ATTR_ARCHIVE, 10, 1);
+   }
+   add_slots("cut_long_name_at_the_end.b00", 0);
+
+   di = libfat_dirindex_build(&fs, 2);
+   if (di == NULL) {
+      Log(LOG_ERR, "Cut slots: libfat_dirindex_build() failed");
+      return true;
+   }
+   failed |= expect(di, NULL, "FILLER  B00", 10);
+   libfat_dirindex_free(di);
+
+   /* Unreadable sector */
+   dir_reset();
+   while (dir.nr < DIR_ENTRIES - 1) {
+      add_short("FILLER  B00", ATTR_ARCHIVE, 10, 1);
+   }
+   dir.bad_sector = 3;
+   if (libfat_dirindex_build(&fs, 2) != NULL) {
+      Log(LOG_ERR, "Unreadable sector: libfat_dirindex_build() succeeded");
+      failed = true;
+   }
+
+   /* Broken FAT chain */
+   dir_reset();
+   while (dir.nr < DIR_ENTRIES) {
+      add_short("FILLER  B00", ATTR_ARCHIVE, 10, 1);
+   }
+   dir.end = (libfat_sector_t)-1;
+   if (libfat_dirindex_build(&fs, 2) != NULL) {
+      Log(LOG_ERR, "Broken FAT chain: libfat_dirindex_build() succeeded");
+      failed = true;
+   }
+
+   /* Bad directory cluster */
+   dir_reset();
+   if (libfat_dirindex_build(&fs, 5) != NULL) {
+      Log(LOG_ERR, "Bad cluster: libfat_dirindex_build() succeeded");
+      failed = true;
+   }
+
+   return failed;
+}
+
+/*-- malformed_test ------------------------------------------------------------
+ *
+ *      Index a directory with inconsistent VFAT slots.  Their long names
+ *      must be dropped, but the short names must still be indexed.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool malformed_test(void)
+{
+   struct libfat_dirindex *di;
+   unsigned int first;
+   bool failed = false;
+
+   dir_reset();
+
+   /* Checksum of the slots does not match the short name */
+   first = add_long("bad_checksum.b00", "BAD_CH~1B00", 10);
+   write8(&slot(first)->alias_csum, read8(&slot(first)->alias_csum) ^ 1);
+   write8(&slot(first + 1)->alias_csum, read8(&slot(first)->alias_csum));
+
+   /* Slots disagreeing on the checksum */
+   first = add_long("mixed_checksum.b00", "MIXED_~1B00", 11);
+   write8(&slot(first + 1)->alias_csum,
+          read8(&slot(first + 1)->alias_csum) ^ 1);
+
+   /* Missing middle slot */
+   first = add_long("missing_middle_slot_of_the_name.b00", "MISSIN~1B00", 12);
+   memmove(&dir.entries[first + 1], &dir.entries[first + 2],
+           2 * sizeof (struct fat_dirent));
+   dir.nr--;
+   memset(&dir.entries[dir.nr], 0, sizeof (struct fat_dirent));
+
+   /* Continuation slot without a first slot */
+   first = add_long("no_first_slot_here.b00", "NO_FIR~1B00", 13);
+   write8(&slot(first)->id, read8(&slot(first)->id) & ~VFAT_LAST_SLOT);
+
+   /* Sequence number 0 */
+   first = add_long("zero.b00", "ZERO    B00", 14);
+   write8(&slot(first)->id, VFAT_LAST_SLOT);
+
+   /* Sequence number too large for a 255-character name */
+   first = add_long("too_long.b00", "TOO_LONGB00", 15);
+   write8(&slot(first)->id, VFAT_LAST_SLOT | 20);
+
+   /* Deleted entry between the slots */
+   first = add_long("interrupted_long_name.b00", "INTERR~1B00", 16);
+   dir.entries[first + 1].name[0] = DELETED_ENTRY;
+
+   /* Volume label right after the slots */
+   add_slots("volume_label", shortname_csum("LABEL      "));
+   add_short("LABEL      ", ATTR_VOLUME_ID, 0, 0);
+
+   /* Well-formed entry after all of the above */
+   add_long("good_name.b00", "GOOD_N~1B00", 17);
+
+   di = libfat_dirindex_build(&fs, 2);
+   if (di == NULL) {
+      Log(LOG_ERR, "libfat_dirindex_build() failed");
+      return true;
+   }
+
+   failed |= expect(di, "bad_checksum.b00", NULL, -2);
+   failed |= expect(di, NULL, "BAD_CH~1B00", 10);
+   failed |= expect(di, "mixed_checksum.b00", NULL, -2);
+   failed |= expect(di, NULL, "MIXED_~1B00", 11);
+   failed |= expect(di, "missing_middle_slot_of_the_name.b00", NULL, -2);
+   failed |= expect(di, NULL, "MISSIN~1B00", 12);
+   failed |= expect(di, "no_first_slot_here.b00", NULL, -2);
+   failed |= expect(di, NULL, "NO_FIR~1B00", 13);
+   failed |= expect(di, "zero.b00", NULL, -2);
+   failed |= expect(di, NULL, "ZERO    B00", 14);
+   failed |= expect(di, "too_long.b00", NULL, -2);
+   failed |= expect(di, NULL, "TOO_LONGB00", 15);
+   failed |= expect(di, "interrupted_long_name.b00", NULL, -2);
+   failed |= expect(di, NULL, "INTERR~1B00", 16);
+   failed |= expect(di, "volume_label", NULL, -2);
+   failed |= expect(di, "good_name.b00", NULL, 17);
+
+   libfat_dirindex_free(di);
+
+   return failed;
+}
+
+#define TEST(x) { #x, x ## _test },
+const unittest_t unittests[] = {
+   TESTS
+};
+#undef TEST
+
+const unsigned int unittests_nr = ARRAYSIZE(unittests);
@@ -0,0 +1,387 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * test_manifest.c -- Unit tests for the signed module manifest
+ *
+ *   mboot/secure.c is included, for its static manifest parser and check.
+ *   The manifest data is given directly to manifest_parse(), as it would be
+ *   once its signature has been verified.  Modules are hashed with the
+ *   mbedtls SHA-256 and SHA-512 code.
+ */
+
+#include "../../mboot/secure.c"
+#include "unittest.h"
+
+#define TESTS            \
+   TEST(hex)             \
+   TEST(valid)           \
+   TEST(truncated)       \
+   TEST(malformed)       \
+   TEST(check)
+
+/* FIPS 180 digests of "abc" */
+#define SHA256_ABC "ba7816bf8f01cfea414140de5dae2223" \
+                   "b00361a396177a9cb410ff61f20015ad"
+#define SHA512_ABC "ddaf35a193617abacc417349ae204131" \
+                   "12e6fa4e89a97ea20a9eeee64b55d39a" \
+                   "2192992a274fc1a836ba3c23a3feebbd" \
+                   "454d4423643ce80e2a9ac94fa54ca49f"
+#define SHA256_ABC_UPPER "BA7816BF8F01CFEA414140DE5DAE2223" \
+                         "B00361A396177A9CB410FF61F20015AD"
+#define SHA256_ZERO "00000000000000000000000000000000" \
+                    "00000000000000000000000000000000"
+
+static VMW_MBEDTLS_PROTOCOL test_mbedtls = {
+   .Sha256Ret = mbedtls_sha256_ret,
+   .Sha512Ret = mbedtls_sha512_ret,
+};
+
+/*-- unhex ---------------------------------------------------------------------
+ *
+ *      Convert a lower case hex string to bytes, independently of the
+ *      hex_value() being tested.
+ *
+ * Parameters
+ *      IN  hex: the string
+ *      OUT buf: the bytes, strlen(hex) / 2 of them
+ *----------------------------------------------------------------------------*/
+static void unhex(const char *hex, unsigned char *buf)
+{
+   static const char digits[] = "0123456789abcdef";
+   size_t i;
+
+   for (i = 0; hex[2 * i] != '\0'; i++) {
+      buf[i] = (unsigned char)(((strchr(digits, hex[2 * i]) - digits) << 4) |
+                               (strchr(digits, hex[2 * i + 1]) - digits));
+   }
+}
+
+/*-- parse ---------------------------------------------------------------------
+ *
+ *      Forget the current manifest, and parse new manifest data.
+ *
+ * Parameters
+ *      IN text: the manifest data
+ *      IN len:  length of the data
+ *
+ * Results
+ *      The manifest_parse() status.
+ *----------------------------------------------------------------------------*/
+static int parse(const char *text, size_t len)
+{
+   manifest_free();
+
+   return manifest_parse(text, len);
+}
+
+/*-- expect_manifest -----------------------------------------------------------
+ *
+ *      Check the result of parsing manifest data.
+ *
+ * Parameters
+ *      IN what:     test case description
+ *      IN text:     the manifest data
+ *      IN len:      length of the data
+ *      IN expected: expected parse status
+ *      IN nr:       expected number of entries, if the parse succeeds
+ *
+ * Results
+ *      True if the result is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect_manifest(const char *what, const char *text, size_t len,
+                            int expected, unsigned nr)
+{
+   int status;
+
+   status = parse(text, len);
+   if (status != expected || (status == ERR_SUCCESS && Manifest.nr != nr)) {
+      Log(LOG_ERR, "%s: got status %d, %u entries; expected %d, %u",
+          what, status, Manifest.nr, expected, nr);
+      return true;
+   }
+
+   return false;
+}
+
+/*-- expect_entry --------------------------------------------------------------
+ *
+ *      Check an entry of the parsed manifest.
+ *
+ * Parameters
+ *      IN i:    entry index
+ *      IN md:   expected digest, in lower case hex
+ *      IN name: expected module basename
+ *
+ * Results
+ *      True if the entry is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect_entry(unsigned i, const char *md, const char *name)
+{
+   unsigned char buf[MAX_DIGEST_LENGTH];
+   const ManifestEntry *entry = &Manifest.entries[i];
+
+   unhex(md, buf);
+
+   if (i >= Manifest.nr || entry->mdLen != strlen(md) / 2 ||
+       memcmp(entry->md, buf, entry->mdLen) != 0 ||
+       entry->nameLen != strlen(name) ||
+       memcmp(entry->name, name, entry->nameLen) != 0) {
+      Log(LOG_ERR, "Entry %u: expected %s %s", i, md, name);
+      return true;
+   }
+
+   return false;
+}
+
+/*-- hex_test ------------------------------------------------------------------
+ *
+ *      Check hex_value() on every char value.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool hex_test(void)
+{
+   static const char digits[] = "0123456789abcdef";
+   bool failed = false;
+   int c, expected;
+
+   for (c = -128; c < 128; c++) {
+      expected = -1;
+      if (c > 0 && strchr(digits, tolower(c)) != NULL) {
+         expected = strchr(digits, tolower(c)) - digits;
+      }
+      if (hex_value((char)c) != expected) {
+         Log(LOG_ERR, "hex_value(%d): got %d, expected %d", c,
+             hex_value((char)c), expected);
+         failed = true;
+      }
+   }
+
+   return failed;
+}
+
+/*-- valid_test ----------------------------------------------------------------
+ *
+ *      Parse well-formed manifests.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool valid_test(void)
+{
+   static const char text[] =
+      SHA256_ABC "  s.v00\n"
+      SHA512_ABC "\tk.b00\r\n"
+      "\n"
+      "\r\n"
+      SHA256_ABC_UPPER " name with spaces.v00 \t\n"
+      SHA256_ZERO " \xe9t\xe9.v00";
+   bool failed = false;
+
+   failed |= expect_manifest("Empty", "", 0, ERR_SUCCESS, 0);
+   failed |= expect_manifest("Blank lines", "\n\r\n\n", 4, ERR_SUCCESS, 0);
+
+   failed |= expect_manifest("Entries", text, sizeof (text) - 1, ERR_SUCCESS,
+                             4);
+   if (!failed) {
+      failed |= expect_entry(0, SHA256_ABC, "s.v00");
+      failed |= expect_entry(1, SHA512_ABC, "k.b00");
+      failed |= expect_entry(2, SHA256_ABC, "name with spaces.v00");
+      failed |= expect_entry(3, SHA256_ZERO, "\xe9t\xe9.v00");
+   }
+
+   manifest_free();
+
+   return failed;
+}
+
+/*-- truncated_test ------------------------------------------------------------
+ *
+ *      Parse manifests whose last line is cut short.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool truncated_test(void)
+{
+   static const char text[] = SHA256_ABC " s.v00\n" SHA512_ABC " k.b00\n";
+   static const size_t cuts[] = {
+      1,                                /* One digit */
+      64,                               /* Digest only */
+      65,                               /* Digest and white space */
+      71 + 64,                          /* SHA-512 digest cut to SHA-256 */
+      71 + 127,                         /* One digit short */
+      71 + 128,                         /* Digest only */
+   };
+   char what[64];
+   bool failed = false;
+   unsigned i;
+
+   for (i = 0; i < ARRAYSIZE(cuts); i++) {
+      snprintf(what, sizeof (what), "Cut at %zu", cuts[i]);
+      failed |= expect_manifest(what, text, cuts[i], ERR_SYNTAX, 0);
+   }
+
+   failed |= expect_manifest("Whole line", text, 71, ERR_SUCCESS, 1);
+   failed |= expect_manifest("Without newline", text, sizeof (text) - 2,
+                             ERR_SUCCESS, 2);
+
+   manifest_free();
+
+   return failed;
+}
+
+/*-- malformed_test ------------------------------------------------------------
+ *
+ *      Parse manifests with a malformed line after a good one.  The whole
+ *      manifest must be rejected.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool malformed_test(void)
+{
+   static const char *bad_lines[] = {
+      " " SHA256_ABC " s.v00",
+      SHA256_ABC "0 s.v00",
+      SHA512_ABC "0 s.v00",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015a "
+         "s.v00",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ag "
+         "s.v00",
+      "0x7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad "
+         "s.v00",
+      "\xff\xfe\xfd\xfc" "16bf8f01cfea414140de5dae2223b00361a396177a9c"
+         "b410ff61f20015ad s.v00",
+      SHA256_ABC SHA256_ABC SHA256_ABC " s.v00",
+      SHA256_ABC ":s.v00",
+      SHA256_ABC "s.v00",
+      "s.v00 " SHA256_ABC,
+      SHA256_ABC " \r",
+   };
+   char text[512];
+   bool failed = false;
+   unsigned i;
+   int len;
+
+   for (i = 0; i < ARRAYSIZE(bad_lines); i++) {
+      len = snprintf(text, sizeof (text), "%s k.b00\n%s\n", SHA512_ABC,
+                     bad_lines[i]);
+      failed |= expect_manifest(bad_lines[i], text, len, ERR_SYNTAX, 0);
+   }
+
+   manifest_free();
+
+   return failed;
+}
+
+/*-- expect_check --------------------------------------------------------------
+ *
+ *      Check a module against the manifest.
+ *
+ * Parameters
+ *      IN filename: the module filename
+ *      IN digest:   MBEDTLS_MD_SHA256 or MBEDTLS_MD_SHA512
+ *      IN data:     the module signed data
+ *      IN md:       digest of the data computed beforehand, or NULL
+ *      IN expected: expected manifest_check() result
+ *
+ * Results
+ *      True if the result is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect_check(const char *filename, mbedtls_md_type_t digest,
+                         const char *data, const char *md, bool expected)
+{
+   RawRSACert cert;
+   SigCheck check;
+
+   memset(&cert, 0, sizeof (cert));
+   memset(&check, 0, sizeof (check));
+   cert.digest = digest;
+   check.cert = &cert;
+   check.needsig = true;
+   check.data = data;
+   check.dataLen = strlen(data);
+   check.mdLen = digest == MBEDTLS_MD_SHA256 ? SHA256_DIGEST_LENGTH :
+                                               SHA512_DIGEST_LENGTH;
+   if (md != NULL) {
+      unhex(md, check.md);
+      check.hashed = true;
+   }
+
+   if (manifest_check(filename, &check) != expected) {
+      Log(LOG_ERR, "Check of %s (\"%s\", SHA-%u): expected %s", filename,
+          data, check.mdLen * 8, expected ? "listed" : "not listed");
+      return true;
+   }
+
+   return false;
+}
+
+/*-- check_test ----------------------------------------------------------------
+ *
+ *      Check modules against a manifest.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool check_test(void)
+{
+   static const char text[] =
+      SHA256_ABC " s.v00\n"
+      SHA512_ABC " k.b00\n"
+      SHA256_ZERO " zero.v00\n";
+   bool failed = false;
+
+   mbedtls = &test_mbedtls;
+
+   if (expect_manifest("Manifest", text, sizeof (text) - 1, ERR_SUCCESS, 3)) {
+      return true;
+   }
+
+   failed |= expect_check("/boot/s.v00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          true);
+   failed |= expect_check("s.v00", MBEDTLS_MD_SHA256, "abc", NULL, true);
+   failed |= expect_check("/k.b00", MBEDTLS_MD_SHA512, "abc", NULL, true);
+   failed |= expect_check("/boot/s.v00", MBEDTLS_MD_SHA256, "xyz",
+                          SHA256_ABC, true);
+
+   failed |= expect_check("/boot/s.v00", MBEDTLS_MD_SHA256, "abd", NULL,
+                          false);
+   failed |= expect_check("/boot/s.v00", MBEDTLS_MD_SHA256, "abc",
+                          SHA256_ZERO, false);
+   failed |= expect_check("/boot/zero.v00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/k.b00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/S.V00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/s.v0", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/s.v000", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/s.v00/", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+   failed |= expect_check("/boot/other.v00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+
+   manifest_free();
+   failed |= expect_check("/boot/s.v00", MBEDTLS_MD_SHA256, "abc", NULL,
+                          false);
+
+   mbedtls = NULL;
+
+   return failed;
+}
+
+#define TEST(x) { #x, x ## _test },
+const unittest_t unittests[] = {
+   TESTS
+};
+#undef TEST
+
+const unsigned int unittests_nr = ARRAYSIZE(unittests);
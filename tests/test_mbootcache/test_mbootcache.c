@@ -0,0 +1,394 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * test_mbootcache.c -- Unit tests for the mboot module cache index
+ *
+ *   mboot/cache.c is included, for its static index parser and writer.
+ *   The index is "saved" to a buffer by the file_save() below.
+ */
+
+#include "../../mboot/cache.c"
+#include "unittest.h"
+
+#define TESTS            \
+   TEST(valid)           \
+   TEST(roundtrip)       \
+   TEST(truncated)       \
+   TEST(malformed)       \
+   TEST(etag)
+
+#define MANIFEST "0123456789abcdef0123456789abcdef" \
+                 "0123456789abcdef0123456789abcdef"
+#define DIGEST1  "3a3d28a7ad1bf0b4e5e8a2f2a5ec4e1c" \
+                 "0a2b4c6d8e0f1a2b3c4d5e6f7a8b9c0d"
+#define DIGEST2  "FEDCBA9876543210FEDCBA9876543210" \
+                 "FEDCBA9876543210FEDCBA9876543210"
+#define HEADER   CACHE_INDEX_MAGIC " " MANIFEST "\n"
+
+boot_info_t boot;
+
+static struct {
+   char *buf;
+   size_t size;
+} saved_index;
+
+int file_save(UNUSED_PARAM(int volid), UNUSED_PARAM(const char *filename),
+              UNUSED_PARAM(int (*callback)(size_t)), void *buffer,
+              size_t size)
+{
+   free(saved_index.buf);
+   saved_index.buf = malloc(size + 1);
+   if (saved_index.buf == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+   memcpy(saved_index.buf, buffer, size);
+   saved_index.buf[size] = '\0';
+   saved_index.size = size;
+
+   return ERR_SUCCESS;
+}
+
+int file_delete(UNUSED_PARAM(int volid), UNUSED_PARAM(const char *filename))
+{
+   return ERR_SUCCESS;
+}
+
+/*-- parse ---------------------------------------------------------------------
+ *
+ *      Forget the current index, and parse a new one for the MANIFEST
+ *      configuration.
+ *
+ * Parameters
+ *      IN text: the index file content
+ *
+ * Results
+ *      The cache_parse_index() status.
+ *----------------------------------------------------------------------------*/
+static int parse(const char *text)
+{
+   char *buf;
+   int status;
+
+   cache_close(false);
+   memcpy(cache.manifest, MANIFEST, SHA256_STRING_LEN);
+
+   buf = strdup(text);
+   if (buf == NULL) {
+      return ERR_OUT_OF_RESOURCES;
+   }
+   status = cache_parse_index(buf);
+   free(buf);
+
+   return status;
+}
+
+/*-- expect_entry --------------------------------------------------------------
+ *
+ *      Check an entry of the parsed index.
+ *
+ * Parameters
+ *      IN i:        entry index
+ *      IN digest:   expected digest
+ *      IN size:     expected size
+ *      IN etag:     expected ETag, or NULL
+ *      IN filepath: expected module path
+ *
+ * Results
+ *      True if the entry is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect_entry(unsigned int i, const char *digest, size_t size,
+                         const char *etag, const char *filepath)
+{
+   const cache_entry_t *e = &cache.index[i];
+
+   if (i >= cache.index_nr ||
+       strcmp(e->digest, digest) != 0 || e->size != size ||
+       (etag == NULL) != (e->etag == NULL) ||
+       (etag != NULL && strcmp(e->etag, etag) != 0) ||
+       strcmp(e->filepath, filepath) != 0) {
+      Log(LOG_ERR, "Entry %u: expected %s %zu %s %s", i, digest, size,
+          etag != NULL ? etag : "-", filepath);
+      return true;
+   }
+
+   return false;
+}
+
+/*-- expect_index --------------------------------------------------------------
+ *
+ *      Check the result of parsing an index.
+ *
+ * Parameters
+ *      IN what:     test case description
+ *      IN text:     the index file content
+ *      IN expected: expected parse status
+ *      IN valid:    whether the index is expected to match the config
+ *      IN nr:       expected number of entries
+ *
+ * Results
+ *      True if the result is not the expected one.
+ *----------------------------------------------------------------------------*/
+static bool expect_index(const char *what, const char *text, int expected,
+                         bool valid, unsigned int nr)
+{
+   int status;
+
+   status = parse(text);
+   if (status != expected || cache.valid != valid || cache.index_nr != nr) {
+      Log(LOG_ERR, "%s: got status %d, valid %d, %u entries; "
+          "expected %d, %d, %u", what, status, cache.valid, cache.index_nr,
+          expected, valid, nr);
+      return true;
+   }
+
+   return false;
+}
+
+/*-- valid_test ----------------------------------------------------------------
+ *
+ *      Parse well-formed indexes.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool valid_test(void)
+{
+   bool failed = false;
+
+   failed |= expect_index("Header only", HEADER, ERR_SUCCESS, true, 0);
+   failed |= expect_index("Header without newline",
+                          CACHE_INDEX_MAGIC " " MANIFEST, ERR_SUCCESS, true,
+                          0);
+   failed |= expect_index("Other configuration",
+                          CACHE_INDEX_MAGIC " " DIGEST1 "\n"
+                          DIGEST2 " 1 - /b.b00\n", ERR_SUCCESS, false, 1);
+
+   failed |= expect_index("Entries", HEADER
+                          DIGEST1 " 123456 \"v1-abc\" /boot/s.v00\n"
+                          DIGEST2 " 0 - /boot/empty.v00\n"
+                          DIGEST1 " 4294967296 W/\"x\" /path with spaces\n",
+                          ERR_SUCCESS, true, 3);
+   if (!failed) {
+      failed |= expect_entry(0, DIGEST1, 123456, "\"v1-abc\"", "/boot/s.v00");
+      failed |= expect_entry(1, DIGEST2, 0, NULL, "/boot/empty.v00");
+      failed |= expect_entry(2, DIGEST1, (size_t)4294967296ULL, "W/\"x\"",
+                             "/path with spaces");
+   }
+
+   cache_close(false);
+
+   return failed;
+}
+
+/*-- roundtrip_test ------------------------------------------------------------
+ *
+ *      Write an index for a boot, and parse it back.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool roundtrip_test(void)
+{
+   module_t modules[3];
+   cache_entry_t entries[3];
+   bool failed = false;
+   int status;
+
+   memset(modules, 0, sizeof (modules));
+   memset(entries, 0, sizeof (entries));
+   modules[0].filename = "/boot/b.b00";
+   modules[1].filename = "/boot/duplicate.b00";
+   modules[2].filename = "/boot/s.v00";
+   memcpy(entries[0].digest, DIGEST1, SHA256_STRING_LEN);
+   entries[0].size = 42;
+   entries[0].etag = "\"5f3e-1a2b\"";
+   memcpy(entries[2].digest, DIGEST2, SHA256_STRING_LEN);
+   entries[2].size = 7;
+
+   cache_close(false);
+   boot.cache_dir = "/cache";
+   boot.modules = modules;
+   boot.modules_nr = 3;
+   cache.modules = entries;
+   cache.modules_nr = 3;
+   memcpy(cache.manifest, MANIFEST, SHA256_STRING_LEN);
+
+   status = cache_write_index();
+
+   cache.modules = NULL;
+   cache.modules_nr = 0;
+   boot.modules = NULL;
+   boot.modules_nr = 0;
+
+   if (status != ERR_SUCCESS || saved_index.buf == NULL) {
+      Log(LOG_ERR, "cache_write_index() failed: %d", status);
+      return true;
+   }
+
+   failed |= expect_index("Written index", saved_index.buf, ERR_SUCCESS,
+                          true, 2);
+   if (!failed) {
+      failed |= expect_entry(0, DIGEST1, 42, "\"5f3e-1a2b\"", "/boot/b.b00");
+      failed |= expect_entry(1, DIGEST2, 7, NULL, "/boot/s.v00");
+   }
+
+   cache_close(false);
+   free(saved_index.buf);
+   saved_index.buf = NULL;
+
+   return failed;
+}
+
+/*-- truncated_test ------------------------------------------------------------
+ *
+ *      Parse indexes cut short.  A cut header invalidates the whole index; a
+ *      cut entry is dropped, and the entries before it are kept.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool truncated_test(void)
+{
+   static const char *cut_entries[] = {
+      "3a3d28a7ad1bf0b4",
+      DIGEST2,
+      DIGEST2 " ",
+      DIGEST2 " 12",
+      DIGEST2 " 12 ",
+      DIGEST2 " 12 \"etag\"",
+      DIGEST2 " 12 \"etag\" ",
+   };
+   char text[512];
+   bool failed = false;
+   unsigned int i;
+
+   failed |= expect_index("Empty", "", ERR_SUCCESS, false, 0);
+   failed |= expect_index("Cut magic", "mboot-ca", ERR_BAD_HEADER, false, 0);
+   failed |= expect_index("Magic only", CACHE_INDEX_MAGIC, ERR_BAD_HEADER,
+                          false, 0);
+   failed |= expect_index("Cut manifest",
+                          CACHE_INDEX_MAGIC " 0123456789abcdef\n"
+                          DIGEST1 " 1 - /a.b00\n", ERR_BAD_HEADER, false, 0);
+
+   for (i = 0; i < ARRAYSIZE(cut_entries); i++) {
+      snprintf(text, sizeof (text), "%s%s 1 - /a.b00\n%s", HEADER, DIGEST1,
+               cut_entries[i]);
+      if (expect_index(cut_entries[i], text, ERR_SUCCESS, true, 1) ||
+          expect_entry(0, DIGEST1, 1, NULL, "/a.b00")) {
+         failed = true;
+      }
+   }
+
+   cache_close(false);
+
+   return failed;
+}
+
+/*-- malformed_test ------------------------------------------------------------
+ *
+ *      Parse indexes with malformed lines.  A bad header invalidates the
+ *      whole index; other bad lines are skipped.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool malformed_test(void)
+{
+   static const char *bad_entries[] = {
+      "",
+      " ",
+      DIGEST2 "0 1 - /a.b00",
+      "3a3d28a7ad1bf0b4e5e8a2f2a5ec4e1c0a2b4c6d8e0f1a2b3c4d5e6f7a8b9c0 "
+         "1 - /a.b00",
+      "../../../../../../../../../../../../../../../../../../../../efi/ "
+         "1 - /a.b00",
+      "3a3d28a7ad1bf0b4e5e8a2f2a5ec4e1c0a2b4c6d8e0f1a2b3c4d5e6f7a8b9c0g "
+         "1 - /a.b00",
+      "\xff\xfe\xfd\xfc" DIGEST2 " 1 - /a.b00",
+      DIGEST2 "  1 - /a.b00",
+      DIGEST2 " -1 - /a.b00",
+      DIGEST2 " +1 - /a.b00",
+      DIGEST2 " 1x - /a.b00",
+      DIGEST2 " x - /a.b00",
+      DIGEST2 " 1  /a.b00",
+      DIGEST2 "\t1 - /a.b00",
+      DIGEST2 " 1 -",
+   };
+   char text[512];
+   bool failed = false;
+   unsigned int i;
+
+   failed |= expect_index("Old version",
+                          "mboot-cache 1 " MANIFEST "\n"
+                          DIGEST1 " 1 /a.b00\n", ERR_BAD_HEADER, false, 0);
+   failed |= expect_index("No manifest separator",
+                          "mboot-cache 2" MANIFEST "\n", ERR_BAD_HEADER,
+                          false, 0);
+   failed |= expect_index("Long manifest",
+                          CACHE_INDEX_MAGIC " " MANIFEST "0\n",
+                          ERR_BAD_HEADER, false, 0);
+   failed |= expect_index("Entry first", DIGEST1 " 1 - /a.b00\n" HEADER,
+                          ERR_BAD_HEADER, false, 0);
+
+   for (i = 0; i < ARRAYSIZE(bad_entries); i++) {
+      snprintf(text, sizeof (text), "%s%s\n%s 1 - /a.b00\n", HEADER,
+               bad_entries[i], DIGEST1);
+      if (expect_index(bad_entries[i], text, ERR_SUCCESS, true, 1) ||
+          expect_entry(0, DIGEST1, 1, NULL, "/a.b00")) {
+         failed = true;
+      }
+   }
+
+   cache_close(false);
+
+   return failed;
+}
+
+/*-- etag_test -----------------------------------------------------------------
+ *
+ *      Check which ETags can be stored in the index.
+ *
+ * Results
+ *      True if failed.
+ *----------------------------------------------------------------------------*/
+static bool etag_test(void)
+{
+   static const struct {
+      const char *etag;
+      bool ok;
+   } etags[] = {
+      { "\"abc\"", true },
+      { "W/\"5f3e-1a2b\"", true },
+      { "\"\xc3\xa9t\xc3\xa9\"", true },
+      { "--", true },
+      { "", false },
+      { "-", false },
+      { "\"a b\"", false },
+      { "\"a\tb\"", false },
+      { "\"ab\"\r", false },
+      { "\"ab\"\n", false },
+   };
+   bool failed = false;
+   unsigned int i;
+
+   for (i = 0; i < ARRAYSIZE(etags); i++) {
+      if (cache_etag_ok(etags[i].etag) != etags[i].ok) {
+         Log(LOG_ERR, "ETag %u (%s): expected %s", i, etags[i].etag,
+             etags[i].ok ? "ok" : "rejected");
+         failed = true;
+      }
+   }
+
+   return failed;
+}
+
+#define TEST(x) { #x, x ## _test },
+const unittest_t unittests[] = {
+   TESTS
+};
+#undef TEST
+
+const unsigned int unittests_nr = ARRAYSIZE(unittests);
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * unittest.c -- Host driver for the boot loader unit tests
+ *
+ *   <unit test> [-t <testname>] [-v]
+ *
+ *      -t <testname>  Run a specific test
+ *      -v             Also print the log messages of the code under test
+ *
+ *   Exits with status 0 if all the tests passed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "unittest.h"
+
+#define UNITTEST_LOG_LEVEL    3  /* LOG_ERR, used by the tests themselves */
+
+static bool verbose;
+
+void unittest_log(int level, const char *msg)
+{
+   size_t len = strlen(msg);
+
+   if (level <= UNITTEST_LOG_LEVEL || verbose) {
+      fprintf(stderr, "%s%s", msg,
+              (len > 0 && msg[len - 1] == '\n') ? "" : "\n");
+   }
+}
+
+static void usage(const char *progname)
+{
+   unsigned int i;
+
+   fprintf(stderr, "Usage: %s [-t <test>] [-v]\n", progname);
+   fprintf(stderr, "Available tests:\n");
+   for (i = 0; i < unittests_nr; i++) {
+      fprintf(stderr, " - %s\n", unittests[i].name);
+   }
+   exit(1);
+}
+
+int main(int argc, char **argv)
+{
+   const char *test = NULL;
+   bool failed, tests_ran;
+   unsigned int i;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "t:v")) != -1) {
+      switch (opt) {
+         case 't':
+            test = optarg;
+            break;
+         case 'v':
+            verbose = true;
+            break;
+         default:
+            usage(argv[0]);
+      }
+   }
+
+   for (i = 0, tests_ran = false, failed = false; i < unittests_nr; i++) {
+      if (test != NULL && strcmp(test, unittests[i].name) != 0) {
+         continue;
+      }
+      fprintf(stderr, "Checking %s\n", unittests[i].name);
+      failed |= unittests[i].fn();
+      tests_ran = true;
+   }
+
+   if (!tests_ran) {
+      fprintf(stderr, "Invalid test specified - no tests ran\n");
+      return 1;
+   }
+
+   if (failed) {
+      fprintf(stderr, "%s: FAILED\n", argv[0]);
+      return 1;
+   }
+
+   fprintf(stderr, "All tests passed\n");
+   return 0;
+}
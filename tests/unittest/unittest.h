@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * unittest.h -- Interface between the host unit test driver and the boot
+ *               loader code it tests
+ *
+ *   Each unit test is built against the boot loader headers, and
+ *   unittest.c against the host C library. Only the plain C types below
+ *   cross between the two.
+ */
+
+#ifndef UNITTEST_H_
+#define UNITTEST_H_
+
+#include <stdbool.h>
+
+typedef struct {
+   const char *name;
+   bool (*fn)(void);            /* Returns true if the test failed */
+} unittest_t;
+
+/*
+ * unittest.c
+ */
+void unittest_log(int level, const char *msg);
+
+/*
+ * The unit test
+ */
+extern const unittest_t unittests[];
+extern const unsigned int unittests_nr;
+
+#endif /* !UNITTEST_H_ */
@@ -0,0 +1,52 @@
+#*******************************************************************************
+# Copyright (c) 2026 VMware, Inc.  All rights reserved.
+# SPDX-License-Identifier: GPL-2.0
+#*******************************************************************************
+
+#
+# Rules for the host unit tests, built with HOST_CC into build/tools.
+#
+# The including Makefile sets BASENAME, BOOT_SRC (the unit test and the boot
+# loader sources it links with), and optionally BOOT_INC, BOOT_CFLAGS and
+# BOOT_DEPS (sources the unit test #includes, to reach their static
+# functions). The boot loader code is built freestanding against the boot
+# loader headers, with one section per function, and the unit test is linked
+# with --gc-sections against the host C library: only the code reached from
+# the tests, and the services it calls, needs to link.
+#
+# "make check" builds and runs the unit test.
+#
+
+UNITTEST_DIR  := $(TOPDIR)/tests/unittest
+
+BUILD_DIR     := $(TOOLS_DIR)
+UNITTEST      := $(TOOLS_DIR)/$(BASENAME)
+UNITTEST_BOOT := $(TOOLS_DIR)/$(BASENAME)_boot.o
+
+UNITTEST_SRC  := $(BOOT_SRC) $(UNITTEST_DIR)/unittest_shim.c
+UNITTEST_INC  := $(TOPDIR)/libc/include $(TOPDIR)/include                    \
+                 $(TOPDIR)/include/x86 $(LIBMD5_INC) $(UNITTEST_DIR) $(BOOT_INC)
+UNITTEST_CFLAGS := -ffreestanding -fno-builtin -ffunction-sections          \
+                   -fdata-sections -Donly_em64t -Donly_x86 -W -Wall          \
+                   $(BOOT_CFLAGS) $(patsubst %,-I%,$(UNITTEST_INC))
+
+.PHONY: all check $(BUILD_DIR)
+
+all: $(BUILD_DIR) $(UNITTEST)
+
+check: all
+	$(UNITTEST)
+
+$(UNITTEST_BOOT): $(UNITTEST_SRC) $(BOOT_DEPS) $(UNITTEST_DIR)/unittest.h
+	$(call print,HOST_CC,$@)
+	$(HOST_CC) $(HOST_CFLAGS) $(UNITTEST_CFLAGS) -O2 -nostdlib -r -o $@ \
+		$(UNITTEST_SRC)
+
+$(UNITTEST): $(UNITTEST_DIR)/unittest.c $(UNITTEST_DIR)/unittest.h \
+	     $(UNITTEST_BOOT)
+	$(call print,HOST_CC,$@)
+	$(HOST_CC) $(HOST_CFLAGS) -W -Wall -O2 -static -Wl,--gc-sections \
+		-o $@ $(UNITTEST_DIR)/unittest.c $(UNITTEST_BOOT)
+
+$(BUILD_DIR):
+	$(call MKDIR,$@)
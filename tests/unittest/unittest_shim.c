@@ -0,0 +1,39 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * unittest_shim.c -- Boot loader services for running code under test on
+ *                    the host
+ *
+ *   Only what the tested functions call is linked in; a unit test that
+ *   needs more provides it itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <bootlib.h>
+#include "unittest.h"
+
+void *sys_malloc(size_t size)
+{
+   return malloc(size);
+}
+
+void sys_free(void *ptr)
+{
+   free(ptr);
+}
+
+void Log(int level, const char *fmt, ...)
+{
+   char msg[512];
+   va_list ap;
+
+   va_start(ap, fmt);
+   vsnprintf(msg, sizeof (msg), fmt, ap);
+   va_end(ap);
+
+   unittest_log(level, msg);
+}
@@ -136,6 +136,9 @@ EFI_STATUS EFIAPI efi_main(EFI_HANDLE Handle, EFI_SYSTEM_TABLE *SystemTable)
 {
    EFI_STATUS Status;
    EFI_LOADED_IMAGE *Image;
+#if SELFTEST_TIMING
+   uint64_t start, self_test_ms, integrity_test_ms;
+#endif
 
    ImageHandle = Handle;
    st = SystemTable;
@@ -154,8 +157,21 @@ EFI_STATUS EFIAPI efi_main(EFI_HANDLE Handle, EFI_SYSTEM_TABLE *SystemTable)
    serial_log_init(DEFAULT_SERIAL_COM, DEFAULT_SERIAL_BAUDRATE);
 #endif
 
+#if SELFTEST_TIMING
+   start = firmware_get_time_ms(false);
+   self_test();
+   self_test_ms = firmware_get_time_ms(false) - start;
+
+   start = firmware_get_time_ms(false);
+   integrity_test();
+   integrity_test_ms = firmware_get_time_ms(false) - start;
+
+   Log(LOG_INFO, "Power-on tests: self test %"PRIu64" ms, "
+       "integrity test %"PRIu64" ms", self_test_ms, integrity_test_ms);
+#else
    self_test();
    integrity_test();
+#endif
 
    Status = bs->InstallProtocolInterface(&ImageHandle,
                                          &MbedTlsProto,
@@ -28,6 +28,11 @@ extern uint8_t _text, _etext, _rodata, _data, _edata, __executable_start;
 
 #define HASH_SIZE MBEDTLS_MD_MAX_SIZE
 
+/*
+ * Size of the copies in which hash_section undoes the relocations.
+ */
+#define HASH_CHUNK_SIZE 1024
+
 /*
  * Space reserved for an internal copy of this modules's .reloc section, used
  * to undo relocations while computing the integrity hash.  Initialized here to
@@ -120,52 +125,77 @@ uint8_t *next_reloc(intptr_t slide)
  *
  *      Add a section to the hash computation.
  *
+ *      Spans that hold no relocation are hashed in place, in one call.  A
+ *      span that does is copied to a local buffer, HASH_CHUNK_SIZE bytes at
+ *      a time, the relocations are undone in the copy, and the copy is
+ *      hashed in one call.  Relocations are usually dense where there are
+ *      any (pointer tables), so this avoids hashing many small fragments.
+ *
  * Parameters
  *      IN/OUT md_ctx: context of ongoing hash computation
  *      IN/OUT nr:     next relocation
  *      IN start:      start address of section
  *      IN end:        end address of section
+ *      IN slide:      load address minus link address
  *
  * Results
- *      EFI_SUCCESS, or an EFI error status.
+ *      Exits with an error upon failure.
  *----------------------------------------------------------------------------*/
 void hash_section(mbedtls_md_context_t *md_ctx, uint8_t **nr,
                   const uint8_t *start, const uint8_t *end, intptr_t slide)
 {
+   uint8_t chunk[HASH_CHUNK_SIZE + sizeof(uintptr_t)];
+   const uint8_t *p, *data;
+   size_t len, offset;
+   uintptr_t ptr;
    int errcode;
-   const uint8_t *p, *q;
 
    if (*nr == NULL) {
       *nr = next_reloc(slide);
    }
-   p = start;
 
-   while (p < end) {
-      // Hash to next reloc, or to end if no reloc in range
-      if (*nr >= start && *nr < end) {
-         q = *nr;
-      } else {
-         q = end;
+   // Skip relocations that fall in a part of the image that is not hashed
+   while (*nr != NULL && *nr < start) {
+      *nr = next_reloc(slide);
+   }
+
+   for (p = start; p < end; p += len) {
+      if (*nr != NULL && *nr < p) {
+         failure("Overlapping relocations");
       }
-      if (q != p) {
-         errcode = mbedtls_md_hmac_update(md_ctx, p, q - p);
-         if (errcode != 0) {
-            failure("mbedtls_md_hmac_update error");
+
+      if (*nr == NULL || *nr >= end) {
+         // No relocation left in this section
+         data = p;
+         len = end - p;
+      } else if (*nr - p >= HASH_CHUNK_SIZE) {
+         // Unrelocated span up to the next relocation
+         data = p;
+         len = *nr - p;
+      } else {
+         // Undo the relocations in a copy of the next chunk
+         data = chunk;
+         len = MIN((size_t)(end - p), HASH_CHUNK_SIZE);
+         memcpy(chunk, p, len);
+
+         while (*nr != NULL && *nr < p + len) {
+            offset = *nr - p;
+            if (offset + sizeof(ptr) > len) {
+               // The pointer straddles the end of the chunk
+               memcpy(chunk + len, p + len, offset + sizeof(ptr) - len);
+               len = offset + sizeof(ptr);
+            }
+
+            memcpy(&ptr, chunk + offset, sizeof(ptr));
+            ptr -= slide;
+            memcpy(chunk + offset, &ptr, sizeof(ptr));
+            *nr = next_reloc(slide);
          }
-         p = q;
       }
 
-      // Hash next reloc if any
-      if (q == *nr) {
-         uintptr_t ptr;
-         memcpy(&ptr, *nr, sizeof(ptr));
-         ptr -= slide;
-         errcode = mbedtls_md_hmac_update(md_ctx, (uint8_t *)&ptr, sizeof(ptr));
-         if (errcode != 0) {
-            failure("mbedtls_md_hmac_update error");
-         }
-         p = *nr + sizeof(ptr);
-         *nr = next_reloc(slide);
+      errcode = mbedtls_md_hmac_update(md_ctx, data, len);
+      if (errcode != 0) {
+         failure("mbedtls_md_hmac_update error");
       }
    }
 }
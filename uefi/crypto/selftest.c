@@ -1,5 +1,5 @@
 /*******************************************************************************
- * Copyright (c) 2020-2021 VMware, Inc.  All rights reserved.
+ * Copyright (c) 2020-2021,2026 VMware, Inc.  All rights reserved.
  * SPDX-License-Identifier: GPL-2.0
  ******************************************************************************/
 
@@ -15,6 +15,7 @@
 
 #include <sha256.h>
 #include <sha512.h>
+#include <sha_accel.h>
 #include <rsa.h>
 #include <protocol/MbedTls.h>
 
@@ -115,6 +116,104 @@ void hmac_test(void)
 }
 
 
+/*
+ * SHA test data. The message is long enough to go through both the
+ * multi-block and the single-block paths of every backend.
+ */
+#define SHA_TEST_MSG_LEN 1000
+
+typedef struct {
+   const char *testid;
+   sha_accel_alg_t alg;
+   const uint8_t *expected_hash;
+   unsigned hash_len;
+} SHATestData;
+
+static const uint8_t sha256_hash1[] = {
+#if FORCE_SHA_FAIL
+   0x42, // incorrect value to force a self-test failure
+#else
+   0x79,
+#endif
+         0x94, 0xe0, 0x09, 0x59, 0xd8, 0x89, 0xb2, 0xed, 0xd1, 0x38, 0x58,
+   0x48, 0x84, 0xb2, 0x6e, 0xcd, 0x04, 0x05, 0x3d, 0x86, 0x77, 0x9c, 0xb8,
+   0x8d, 0x89, 0x20, 0x2d, 0xea, 0x18, 0xe5, 0x99
+};
+
+static const uint8_t sha512_hash1[] = {
+   0xf4, 0xba, 0x19, 0x36, 0x8b, 0x78, 0xc3, 0x7d, 0x6b, 0xe5, 0xc5, 0xad,
+   0xe6, 0xbe, 0xaa, 0x2c, 0xfd, 0x73, 0x29, 0x2e, 0x0c, 0xfc, 0xea, 0x41,
+   0x44, 0x16, 0x5f, 0x39, 0x1e, 0x91, 0xcc, 0x7b, 0x46, 0xff, 0x2b, 0x03,
+   0xc3, 0xba, 0x3d, 0x5b, 0x80, 0xb1, 0xf8, 0x3c, 0xb3, 0x0b, 0x45, 0x4c,
+   0x21, 0x2c, 0x27, 0x58, 0xb4, 0x76, 0x07, 0xe9, 0x7d, 0xf2, 0x51, 0xc4,
+   0x06, 0xff, 0xed, 0xfe
+};
+
+static const SHATestData shaTestData[] = {
+   {
+      "sha256",
+      SHA_ACCEL_SHA256,
+      sha256_hash1,
+      sizeof(sha256_hash1)
+   },
+   {
+      "sha512",
+      SHA_ACCEL_SHA512,
+      sha512_hash1,
+      sizeof(sha512_hash1)
+   },
+};
+
+/*-- sha_test ------------------------------------------------------------------
+ *
+ *     SHA power-on self-test. Hashes a message with every SHA-256 and
+ *     SHA-512 backend the CPU supports and verifies the expected result. The
+ *     fastest backend is selected again afterwards.
+ *
+ * Results
+ *      Exits with an error upon failure.
+ *----------------------------------------------------------------------------*/
+void sha_test(void)
+{
+   uint8_t msg[SHA_TEST_MSG_LEN];
+   uint8_t hash[MAX_DIGEST_LENGTH];
+   sha_backend_t backend;
+   unsigned i;
+
+   for (i = 0; i < sizeof(msg); i++) {
+      msg[i] = (uint8_t)(i * 13 + 5);
+   }
+
+   for (i = 0; i < ARRAYSIZE(shaTestData); i++) {
+      const SHATestData *td = &shaTestData[i];
+      int errcode;
+
+      for (backend = 0; backend < SHA_BACKEND_COUNT; backend++) {
+         if (!sha_accel_select(td->alg, backend)) {
+            continue;
+         }
+
+         if (td->alg == SHA_ACCEL_SHA256) {
+            errcode = mbedtls->Sha256Ret(msg, sizeof(msg), hash, 0);
+         } else {
+            errcode = mbedtls->Sha512Ret(msg, sizeof(msg), hash, 0);
+         }
+         if (errcode != 0) {
+            failure("mbedtls->ShaRet error");
+         }
+
+         if (memcmp(hash, td->expected_hash, td->hash_len) != 0) {
+            Log(LOG_CRIT, "%s backend %s failed", td->testid,
+                sha_accel_name(backend));
+            failure(td->testid);
+         }
+      }
+
+      sha_accel_select(td->alg, sha_accel_best(td->alg));
+   }
+}
+
+
 /*
  * RSA signature verification test data.
  */
@@ -266,6 +365,7 @@ void rsa_sign_verify_test(void)
  *----------------------------------------------------------------------------*/
 void self_test(void)
 {
+   sha_test();
    hmac_test();
    rsa_sign_verify_test();
 }
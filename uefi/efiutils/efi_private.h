@@ -130,6 +130,8 @@ EFI_STATUS tcg2_log_extend_event(uint32_t pcrIndex, const uint8_t *data,
                                  const uint8_t *event, uint64_t eventSize);
 EFI_STATUS tcg2_submit_command(uint8_t *input, uint32_t inputSize,
                                uint8_t *output, uint32_t outputSize);
+uint32_t tcg2_get_digest_size(const TPMT_HA *digest);
+uint32_t tcg2_get_active_banks(void);
 bool tcg2_init(void);
 
 /*
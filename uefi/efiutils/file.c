@@ -12,9 +12,15 @@
  * 3. Simple File Protocol
  * 4. Load File Protocol (NetBoot, or re-export of HTTP)
  * 5. TFTP (PXE boot)
+ *
+ * The method that last succeeded in reading a file is remembered for each
+ * volume and kind of path (see fam_memo_t), and tried first for the next file.
+ * Methods that returned EFI_UNSUPPORTED are not tried again for that volume and
+ * kind of path.
  */
 
 #include <string.h>
+#include <libgen.h>
 #include "efi_private.h"
 
 typedef struct {
@@ -31,6 +37,25 @@ typedef struct {
 
 static file_access_methods *last_fam = NULL;
 
+typedef enum {
+   FAM_SCHEME_PATH,           /* Plain file path */
+   FAM_SCHEME_HTTP,           /* http:// URL */
+   FAM_SCHEME_HTTPS,          /* https:// URL */
+   FAM_SCHEME_URL,            /* Any other URL */
+} fam_scheme_t;
+
+#define FAM_MEMO_SLOTS 8
+
+typedef struct {
+   EFI_HANDLE Volume;         /* Volume, or NULL if the slot is free */
+   fam_scheme_t scheme;       /* Kind of path */
+   int winner;                /* Index of the last successful method, or -1 */
+   unsigned int unsupported;  /* Bitmask of methods returning EFI_UNSUPPORTED */
+} fam_memo_t;
+
+static fam_memo_t fam_memo[FAM_MEMO_SLOTS];
+static unsigned int fam_memo_next = 0;
+
 /*-- unsupported ---------------------------------------------------------------
  *
  *      Placeholder for unsupported methods.
@@ -51,6 +76,81 @@ static file_access_methods fam[] = {
    { tftp_file_load, (void *)unsupported, tftp_file_get_size, "tftp" },
 };
 
+/*-- fam_get_scheme ------------------------------------------------------------
+ *
+ *      Classify a file path for the file access method memo.
+ *
+ * Parameters
+ *      IN filepath: absolute path to the file, or URL
+ *
+ * Results
+ *      The kind of path.
+ *----------------------------------------------------------------------------*/
+static fam_scheme_t fam_get_scheme(const char *filepath)
+{
+   if (strncasecmp(filepath, "http://", 7) == 0) {
+      return FAM_SCHEME_HTTP;
+   }
+   if (strncasecmp(filepath, "https://", 8) == 0) {
+      return FAM_SCHEME_HTTPS;
+   }
+   if (strstr(filepath, "://") != NULL) {
+      return FAM_SCHEME_URL;
+   }
+
+   return FAM_SCHEME_PATH;
+}
+
+/*-- fam_memo_get --------------------------------------------------------------
+ *
+ *      Get the file access method memo for a volume and a kind of path.  A new
+ *      memo is created if needed, replacing the oldest one if all the slots are
+ *      in use.
+ *
+ * Parameters
+ *      IN Volume:   volume handle
+ *      IN filepath: absolute path to the file, or URL
+ *
+ * Results
+ *      The memo.
+ *----------------------------------------------------------------------------*/
+static fam_memo_t *fam_memo_get(EFI_HANDLE Volume, const char *filepath)
+{
+   fam_scheme_t scheme;
+   fam_memo_t *memo;
+   unsigned int i;
+
+   scheme = fam_get_scheme(filepath);
+
+   for (i = 0; i < ARRAYSIZE(fam_memo); i++) {
+      memo = &fam_memo[i];
+      if (memo->Volume == Volume && memo->scheme == scheme) {
+         return memo;
+      }
+   }
+
+   memo = &fam_memo[fam_memo_next];
+   fam_memo_next = (fam_memo_next + 1) % ARRAYSIZE(fam_memo);
+
+   memo->Volume = Volume;
+   memo->scheme = scheme;
+   memo->winner = -1;
+   memo->unsupported = 0;
+
+   return memo;
+}
+
+/*-- file_access_reset ---------------------------------------------------------
+ *
+ *      Forget which file access methods work, e.g. because a setting that
+ *      affects whether a method is supported has changed.
+ *----------------------------------------------------------------------------*/
+void file_access_reset(void)
+{
+   memset(fam_memo, 0, sizeof (fam_memo));
+   fam_memo_next = 0;
+}
+
 /*-- filepath_unix_to_efi ------------------------------------------------------
  *
  *      Convert a UNIX-style path to an equivalent EFI Path Name.
@@ -108,7 +208,10 @@ int firmware_file_read(const char *filepath,
 {
    EFI_STATUS Status;
    EFI_HANDLE Volume;
-   unsigned try;
+   fam_memo_t *memo;
+   uint64_t start, probe_time;
+   unsigned i;
+   int try;
 
    Status = get_boot_volume(&Volume);
    if (EFI_ERROR(Status)) {
@@ -117,33 +220,150 @@ int firmware_file_read(const char *filepath,
 
    *buffer = NULL; // ensure a new buffer is allocated
    Status = EFI_UNSUPPORTED;
+   memo = fam_memo_get(Volume, filepath);
+   probe_time = 0;
 
-   /* Try each known file access method until one succeeds or all fail. */
-   for (try = 0; try < ARRAYSIZE(fam); try++) {
+   /*
+    * Try each known file access method until one succeeds or all fail,
+    * starting with the one that worked last time.
+    */
+   for (i = 0; i <= ARRAYSIZE(fam); i++) {
       EFI_STATUS St;
+      uint64_t elapsed;
+
+      if (i == 0) {
+         try = memo->winner;
+         if (try < 0) {
+            continue;
+         }
+      } else {
+         try = i - 1;
+         if (try == memo->winner) {
+            continue;
+         }
+      }
+
+      if (memo->unsupported & (1 << try)) {
+         continue;
+      }
 
+      start = firmware_get_time_ms(false);
       St = fam[try].load(Volume, filepath, callback, buffer, buflen);
-#if DEBUG
-      Log(LOG_DEBUG, "%s_file_load returns %s", fam[try].name,
-          error_str[error_efi_to_generic(St)]);
-#endif
+      elapsed = firmware_get_time_ms(false) - start;
+
+      if (St == EFI_UNSUPPORTED) {
+         memo->unsupported |= 1 << try;
+      }
       if (St != EFI_UNSUPPORTED && St != EFI_INVALID_PARAMETER) {
          Status = St;
       }
       if (!EFI_ERROR(St) || St == EFI_ABORTED) {
          break;
       }
+
+      Log(LOG_DEBUG, "%s_file_load returns %s after %"PRIu64" ms",
+          fam[try].name, error_str[error_efi_to_generic(St)], elapsed);
+      probe_time += elapsed;
    }
 
    if (!EFI_ERROR(Status)) {
       Log(LOG_DEBUG, "%s loaded via %s_file_load at %p, size %zu",
           filepath, fam[try].name, *buffer, *buflen);
+      if (probe_time > 0) {
+         Log(LOG_DEBUG, "%"PRIu64" ms spent probing other methods",
+             probe_time);
+      }
+      memo->winner = try;
       last_fam = &fam[try];
    }
 
    return error_efi_to_generic(Status);
 }
 
+/*-- firmware_file_prefetch ----------------------------------------------------
+ *
+ *      Start reading a file in the background, if the file access method
+ *      supports it.  A later firmware_file_read of the same file picks up the
+ *      data that has been received in the meantime.
+ *
+ * Parameters
+ *      IN  filepath: absolute path to the file
+ *
+ * Results
+ *      ERR_SUCCESS if the file is being read in the background,
+ *      ERR_OUT_OF_RESOURCES if too many files are already being read,
+ *      ERR_UNSUPPORTED if background reads are not supported for this file,
+ *      or a generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_file_prefetch(const char *filepath)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+
+   Status = get_boot_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   /* Only native UEFI HTTP can have several transfers in flight. */
+   return error_efi_to_generic(http_file_prefetch(Volume, filepath));
+}
+
+/*-- firmware_file_get_etag ----------------------------------------------------
+ *
+ *      Get the entity tag that the server sent with a file that has just been
+ *      read, if the file access method reports it.
+ *
+ * Parameters
+ *      IN  filepath: absolute path to the file
+ *      OUT etag:     the entity tag (to be freed by the caller)
+ *
+ * Results
+ *      ERR_SUCCESS, ERR_NOT_FOUND if the server did not send one,
+ *      ERR_UNSUPPORTED if the file access method does not report it, or a
+ *      generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_file_get_etag(const char *filepath, char **etag)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+
+   Status = get_boot_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   /* Only native UEFI HTTP reports entity tags. */
+   return error_efi_to_generic(http_file_get_etag(Volume, filepath, etag));
+}
+
+/*-- firmware_file_check_etag --------------------------------------------------
+ *
+ *      Ask the server whether a file still has the given entity tag, if the
+ *      file access method supports conditional requests.
+ *
+ * Parameters
+ *      IN  filepath: absolute path to the file
+ *      IN  etag:     entity tag of the copy at hand, or NULL if not known
+ *
+ * Results
+ *      ERR_SUCCESS if the file is unchanged, ERR_NOT_FOUND if it changed or
+ *      etag is NULL, ERR_UNSUPPORTED if conditional requests are not
+ *      supported for this file, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_file_check_etag(const char *filepath, const char *etag)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+
+   Status = get_boot_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   return error_efi_to_generic(http_file_check_etag(Volume, filepath, etag));
+}
+
 /*-- last_file_read_via_http ---------------------------------------------------
  *
  *      Was the last successful file read via native UEFI http?
@@ -195,7 +415,12 @@ int firmware_file_get_size_hint(const char *filepath, size_t *filesize)
       if (St != EFI_UNSUPPORTED && St != EFI_INVALID_PARAMETER) {
          Status = St;
       }
-      if (!EFI_ERROR(St) || St == EFI_ABORTED) {
+      /*
+       * EFI_NOT_READY means that the method handles this file but does not
+       * know its size until the file starts being loaded.  Don't fall back
+       * to a method that would get the size the slow way.
+       */
+      if (!EFI_ERROR(St) || St == EFI_ABORTED || St == EFI_NOT_READY) {
          break;
       }
    }
@@ -493,3 +718,105 @@ int firmware_file_write(const char *filepath, int (*callback)(size_t),
 
    return error_efi_to_generic(Status);
 }
+
+/*-- firmware_local_file_read --------------------------------------------------
+ *
+ *      Read an entire file from the local volume (see get_local_volume()).
+ *
+ * Parameters
+ *      IN  filepath: absolute path to the file
+ *      IN  callback: routine to be called periodically while the file is being
+ *                    loaded
+ *      OUT buffer:   pointer to where the file was loaded
+ *      OUT buflen:   number of bytes that have been written into buffer
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_read(const char *filepath, int (*callback)(size_t),
+                             void **buffer, size_t *buflen)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+
+   Status = get_local_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   *buffer = NULL;
+   Status = simple_file_load(Volume, filepath, callback, buffer, buflen);
+
+   return error_efi_to_generic(Status);
+}
+
+/*-- firmware_local_file_write -------------------------------------------------
+ *
+ *      Write an entire file to the local volume (see get_local_volume()),
+ *      overwriting the file if it exists.  The directory containing the file
+ *      is created if needed, but not its parents.
+ *
+ * Parameters
+ *      IN filepath: absolute path to the file
+ *      IN callback: routine to be called periodically while the file is being
+ *                   written
+ *      IN buffer:   pointer to buffer being written
+ *      IN bufsize:  number of bytes to write
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_write(const char *filepath, int (*callback)(size_t),
+                              void *buffer, size_t bufsize)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+   char *dirpath;
+
+   Status = get_local_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   Status = simple_file_save(Volume, filepath, callback, buffer, bufsize);
+   if (Status == EFI_NOT_FOUND) {
+      dirpath = strdup(filepath);
+      if (dirpath == NULL) {
+         return ERR_OUT_OF_RESOURCES;
+      }
+
+      Status = simple_file_mkdir(Volume, dirname(dirpath));
+      sys_free(dirpath);
+
+      if (!EFI_ERROR(Status)) {
+         Status = simple_file_save(Volume, filepath, callback, buffer, bufsize);
+      }
+   }
+
+   return error_efi_to_generic(Status);
+}
+
+/*-- firmware_local_file_delete ------------------------------------------------
+ *
+ *      Delete a file from the local volume (see get_local_volume()).
+ *
+ * Parameters
+ *      IN filepath: absolute path to the file
+ *
+ * Results
+ *      ERR_SUCCESS, or a generic error status.
+ *----------------------------------------------------------------------------*/
+int firmware_local_file_delete(const char *filepath)
+{
+   EFI_STATUS Status;
+   EFI_HANDLE Volume;
+
+   Status = get_local_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return error_efi_to_generic(Status);
+   }
+
+   Status = simple_file_delete(Volume, filepath);
+
+   return error_efi_to_generic(Status);
+}
@@ -9,6 +9,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
 #include "efi_private.h"
 #include "ServiceBinding.h"
 #include "Http.h"
@@ -26,7 +28,12 @@ static EFI_HANDLE HttpHandle;
 static EFI_HTTP_PROTOCOL *Http;
 static EFI_EVENT HttpEvent;
 static bool HttpDone;
+static EFI_EVENT HttpTimer; // periodic tick to sleep on while idle
+static bool HttpTimerUnavailable;
+static unsigned HttpIdlePolls;
+static size_t HttpRecvSize; // max body bytes per Http->Response; 0 = no limit
 static UINT16 LocalPort;
+static int HttpIpv;
 
 /*
  * Current criteria for using UEFI HTTP, initialized to the default.
@@ -40,6 +47,104 @@ static http_criteria_t httpCriteria = http_if_http_booted;
 #define NUM_HEADERS 2
 #define TIMEOUT_MS 10000
 #define MAX_RETRIES 2
+#define RANGE_HEADER_LEN 48
+#define VALIDATOR_LEN 128
+#define PREFETCH_CONNECTIONS 8 // Http instances besides the primary one
+#define PREFETCH_FILES_MAX 4   // of which may prefetch whole files
+#define SEGMENTS_MAX 4         // of which may fetch segments of one file
+#define SEGMENT_MIN_FILE_SIZE (16 * 1024 * 1024)
+#define RECV_SIZE_MIN 4096
+#define IDLE_POLLS_MAX 32
+#define IDLE_TICK_100NS 10000 // 1 ms
+
+/*
+ * Spinning on Http->Poll while waiting for a token gets data in as soon as it
+ * arrives, but on some firmware it also starves the timer-driven parts of the
+ * network stack and NIC driver, and lowers TCP throughput.  So the instances
+ * are polled for as long as tokens keep completing, and once
+ * IDLE_POLLS_MAX polls in a row have made no progress, the CPU is given back
+ * to the firmware until its next timer tick (see http_idle).
+ */
+
+/*
+ * Additional HTTP instances, created on the same NIC as the primary one, that
+ * download files ahead of time.  Over a long-RTT link the throughput of a
+ * single TCP connection is limited by its window size, so keeping several
+ * GETs outstanding at once makes much better use of the link.  All instances
+ * are driven from a single poll loop (http_prefetch_poll), which also runs
+ * while the primary instance is waiting for its own transfers.
+ *
+ * There are PREFETCH_CONNECTIONS (8) such instances, so up to 9 TCP
+ * connections to the server in all.  Up to PREFETCH_FILES_MAX (4) of them
+ * download whole files ahead of the loader.  The others, up to SEGMENTS_MAX
+ * (4), are used to fetch byte ranges (segments) of a large file that the
+ * primary instance is loading.
+ */
+typedef enum {
+   HTTP_CONN_IDLE,      // no request outstanding
+   HTTP_CONN_REQUEST,   // waiting for the request to be sent
+   HTTP_CONN_HEADERS,   // waiting for the response headers
+   HTTP_CONN_BODY,      // receiving the response body
+   HTTP_CONN_DONE,      // finished, successfully or not (see Status)
+} http_conn_state_t;
+
+typedef struct {
+   http_conn_state_t state;
+   bool segment;        // fetching a byte range into the primary's buffer
+   EFI_HANDLE Handle;
+   EFI_HTTP_PROTOCOL *Http;
+   EFI_EVENT Event;
+   bool Done;
+   EFI_STATUS Status;
+   char *filepath;
+   char *hostname;
+   CHAR16 *Url;
+   EFI_HTTP_TOKEN ReqToken;
+   EFI_HTTP_MESSAGE ReqMessage;
+   EFI_HTTP_REQUEST_DATA ReqData;
+   EFI_HTTP_HEADER ReqHeaders[NUM_HEADERS + 2];
+   char range[RANGE_HEADER_LEN];
+   char validator[VALIDATOR_LEN]; // for If-Range, or "" if none
+   char etag[VALIDATOR_LEN];      // ETag of the file, or "" if none
+   EFI_HTTP_TOKEN RespToken;
+   EFI_HTTP_MESSAGE RespMessage;
+   EFI_HTTP_RESPONSE_DATA RespData;
+   uint8_t *buf;
+   size_t start;        // offset of buf in the file, for segments
+   size_t size;
+   size_t size_recd;
+} http_conn_t;
+
+static struct {
+   EFI_HANDLE Volume;
+   EFI_SERVICE_BINDING_PROTOCOL *ServiceBinding;
+   bool NoRanges;       // server has ignored a range request
+   http_conn_t conns[PREFETCH_CONNECTIONS];
+   http_conn_t *Segments[SEGMENTS_MAX];   // sorted by start offset
+   unsigned SegmentCount;
+} Prefetch;
+
+/*
+ * State of a file transfer on the primary instance, kept across retries so
+ * that an interrupted transfer can be resumed with a range request.
+ */
+typedef struct {
+   uint8_t *buf;        // receive buffer, or NULL
+   size_t bufsize;      // size of buf
+   bool owned;          // buf was allocated by http_file_load_try
+   size_t size;         // size of the file, or (size_t)-1 if not known
+   size_t received;     // number of bytes at the start of buf that are valid
+   char validator[VALIDATOR_LEN]; // ETag or Last-Modified of the file, or ""
+   char etag[VALIDATOR_LEN];      // ETag of the file, or ""
+} http_xfer_t;
+
+/*
+ * ETag of the last file loaded on the primary instance, for http_file_get_etag.
+ */
+static struct {
+   char *filepath;
+   char etag[VALIDATOR_LEN];
+} HttpLast;
 
 static const char *HttpStatusStrings[] = {
    [HTTP_STATUS_UNSUPPORTED_STATUS] = "Unknown",
@@ -104,8 +209,11 @@ EFI_LOAD_FILE_PROTOCOL HttpLoadFile = {
 };
 
 static EFI_STATUS
-http_file_load_try(const CHAR16 *Url, const char *hostname,
-                   int (*callback)(size_t), VOID **Buffer, UINTN *BufSize);
+http_file_load_try(const char *filepath, const CHAR16 *Url,
+                   const char *hostname, int (*callback)(size_t),
+                   bool head, http_xfer_t *xfer);
+static void http_reset(void);
+static void http_prefetch_cleanup(void);
 
 /*-- get_http_nic_info --------------------------------------------------------
  *
@@ -426,6 +534,50 @@ VOID EFIAPI http_callback(UNUSED_PARAM(EFI_EVENT Event), VOID *Context)
    *(bool *)Context = true;
 }
 
+/*-- http_configure ------------------------------------------------------------
+ *
+ *      Configure an Http instance for the IP version in use, with its own
+ *      local port.
+ *
+ * Parameters
+ *      IN  HttpProt: Http instance to configure.
+ *
+ * Results
+ *      EFI_SUCCESS, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_configure(EFI_HTTP_PROTOCOL *HttpProt)
+{
+   EFI_HTTP_CONFIG_DATA HttpConfigData;
+   EFI_HTTPv4_ACCESS_POINT IPv4Node;
+   EFI_HTTPv6_ACCESS_POINT IPv6Node;
+
+   /*
+    * Pick a random-ish range of dynamic local ports.
+    */
+   if (LocalPort == 0) {
+      UINT64 Count;
+      bs->GetNextMonotonicCount(&Count);
+      LocalPort = 49160 + (Count % 1627) * 10;
+   }
+
+   memset(&HttpConfigData, 0, sizeof(HttpConfigData));
+   HttpConfigData.HttpVersion = HttpVersion11;
+   HttpConfigData.TimeOutMillisec = TIMEOUT_MS;
+   HttpConfigData.LocalAddressIsIPv6 = (HttpIpv == 6);
+   if (HttpConfigData.LocalAddressIsIPv6) {
+      memset(&IPv6Node, 0, sizeof(IPv6Node));
+      IPv6Node.LocalPort = LocalPort++;
+      HttpConfigData.AccessPoint.IPv6Node = &IPv6Node;
+   } else {
+      memset(&IPv4Node, 0, sizeof(IPv4Node));
+      IPv4Node.UseDefaultAddress = true;
+      IPv4Node.LocalPort = LocalPort++;
+      HttpConfigData.AccessPoint.IPv4Node = &IPv4Node;
+   }
+
+   return HttpProt->Configure(HttpProt, &HttpConfigData);
+}
+
 /*-- http_init -----------------------------------------------------------------
  *
  *      Initialize for loading files via HTTP.
@@ -441,9 +593,6 @@ static EFI_STATUS http_init(EFI_HANDLE Volume)
    static EFI_STATUS Status; // static to allow caching errors
    EFI_HANDLE NicHandle;
    int ipv = 0;
-   EFI_HTTP_CONFIG_DATA HttpConfigData;
-   EFI_HTTPv4_ACCESS_POINT IPv4Node;
-   EFI_HTTPv6_ACCESS_POINT IPv6Node;
    IPv4_DEVICE_PATH ip4;
 
    if (HttpVolume == Volume) {
@@ -451,7 +600,7 @@ static EFI_STATUS http_init(EFI_HANDLE Volume)
       return Status;
    } else {
       // Clear cached info
-      http_cleanup();
+      http_reset();
    }
 
    /*
@@ -520,33 +669,8 @@ static EFI_STATUS http_init(EFI_HANDLE Volume)
       goto out;
    }
 
-   /*
-    * Pick a random-ish range of dynamic local ports.
-    */
-   if (LocalPort == 0) {
-      UINT64 Count;
-      bs->GetNextMonotonicCount(&Count);
-      LocalPort = 49160 + (Count % 1627) * 10;
-   }
-
-   /*
-    * Configure Http
-    */
-   memset(&HttpConfigData, 0, sizeof(HttpConfigData));
-   HttpConfigData.HttpVersion = HttpVersion11;
-   HttpConfigData.TimeOutMillisec = TIMEOUT_MS;
-   HttpConfigData.LocalAddressIsIPv6 = (ipv == 6);
-   if (HttpConfigData.LocalAddressIsIPv6) {
-      memset(&IPv6Node, 0, sizeof(IPv6Node));
-      IPv6Node.LocalPort = LocalPort++;
-      HttpConfigData.AccessPoint.IPv6Node = &IPv6Node;
-   } else {
-      memset(&IPv4Node, 0, sizeof(IPv4Node));
-      IPv4Node.UseDefaultAddress = true;
-      IPv4Node.LocalPort = LocalPort++;
-      HttpConfigData.AccessPoint.IPv4Node = &IPv4Node;
-   }
-   Status = Http->Configure(Http, &HttpConfigData);
+   HttpIpv = ipv;
+   Status = http_configure(Http);
    if (EFI_ERROR(Status)) {
       Log(LOG_ERR, "Error in Http->Configure: %s",
           error_str[error_efi_to_generic(Status)]);
@@ -560,7 +684,7 @@ static EFI_STATUS http_init(EFI_HANDLE Volume)
 
 out:
    if (EFI_ERROR(Status)) {
-      http_cleanup();
+      http_reset();
    } else {
       HttpVolume = Volume;
    }
@@ -582,7 +706,7 @@ out:
 bool plain_http_allowed(EFI_HANDLE Volume)
 {
    EFI_STATUS Status;
-   UINTN BufSize;
+   http_xfer_t xfer;
    static EFI_HANDLE VolCached = NULL;
    static bool allowed;
 
@@ -594,8 +718,10 @@ bool plain_http_allowed(EFI_HANDLE Volume)
        * or isn't supported.
        */
       Log(LOG_DEBUG, "Probing for plain http:// URL support...");
-      Status = http_file_load_try(L"http://0.0.0.0/probe", "0.0.0.0",
-                                  NULL, NULL, &BufSize);
+      memset(&xfer, 0, sizeof(xfer));
+      Status = http_file_load_try("http://0.0.0.0/probe",
+                                  L"http://0.0.0.0/probe", "0.0.0.0",
+                                  NULL, true, &xfer);
       VolCached = Volume;
       allowed = Status != EFI_ACCESS_DENIED;
       Log(LOG_DEBUG,
@@ -624,6 +750,48 @@ void set_http_criteria(http_criteria_t criteria)
 {
    Log(LOG_DEBUG, "set_http_criteria: %u -> %u", httpCriteria, criteria);
    httpCriteria = criteria;
+
+   /* Native UEFI HTTP may have become usable, or unusable. */
+   file_access_reset();
+}
+
+/*-- set_http_recv_size --------------------------------------------------------
+ *
+ *      Set how much of a response body may be asked for by each call to
+ *      Http->Response.  Smaller sizes give more frequent progress callbacks,
+ *      larger ones fewer round trips through the firmware HTTP stack.
+ *
+ * Parameters
+ *      IN size: size in bytes, or 0 to ask for the whole rest of the body.
+ *----------------------------------------------------------------------------*/
+void set_http_recv_size(size_t size)
+{
+   if (size != 0 && size < RECV_SIZE_MIN) {
+      Log(LOG_WARNING, "Requested HTTP receive size %zu less than %u; "
+          "using %zu", size, RECV_SIZE_MIN, HttpRecvSize);
+      return;
+   }
+   Log(LOG_DEBUG, "Switching HTTP receive size from %zu to %zu",
+       HttpRecvSize, size);
+   HttpRecvSize = size;
+}
+
+/*-- http_recv_length ----------------------------------------------------------
+ *
+ *      Get how much of a response body to ask for next.
+ *
+ * Parameters
+ *      IN remaining: number of body bytes still to be received.
+ *
+ * Results
+ *      The length to pass in the Http->Response message.
+ *----------------------------------------------------------------------------*/
+static size_t http_recv_length(size_t remaining)
+{
+   if (HttpRecvSize == 0) {
+      return remaining;
+   }
+   return MIN(remaining, HttpRecvSize);
 }
 
 /*-- has_http ------------------------------------------------------------------
@@ -652,11 +820,12 @@ bool has_http(EFI_HANDLE Volume)
    return false;
 }
 
-/*-- http_cleanup --------------------------------------------------------------
+/*-- http_reset ----------------------------------------------------------------
  *
- *      Clean up cached Http instance.
+ *      Clean up the cached primary Http instance.  The prefetch connections
+ *      are left alone.
  *----------------------------------------------------------------------------*/
-void http_cleanup(void)
+static void http_reset(void)
 {
    if (Http != NULL) {
       Http->Configure(Http, NULL);
@@ -672,6 +841,24 @@ void http_cleanup(void)
    HttpVolume = NULL;
 }
 
+/*-- http_cleanup --------------------------------------------------------------
+ *
+ *      Clean up cached Http instances.
+ *----------------------------------------------------------------------------*/
+void http_cleanup(void)
+{
+   http_prefetch_cleanup();
+   http_reset();
+
+   sys_free(HttpLast.filepath);
+   HttpLast.filepath = NULL;
+
+   if (HttpTimer != NULL) {
+      bs->CloseEvent(HttpTimer);
+      HttpTimer = NULL;
+   }
+}
+
 /*-- http_status ---------------------------------------------------------------
  *
  *      Translate EFI_HTTP_STATUS_CODE to a human-readable string.
@@ -691,138 +878,1104 @@ static const char *http_status(EFI_HTTP_STATUS_CODE code)
    }
 }
 
-/*-- http_file_load_try --------------------------------------------------------
+/*-- http_get_validator --------------------------------------------------------
  *
- *      Try once to load a file into memory or get its length, using HTTP.
+ *      Get the validator of the file sent in a response, to be sent back in
+ *      the If-Range header of later range requests for the same file.  Only
+ *      a strong ETag can be used with If-Range, so a weak one is ignored in
+ *      favor of Last-Modified.  The ETag itself, weak or not, is also
+ *      returned, for If-None-Match.
  *
  * Parameters
- *      IN     Url:       URL to load.
- *      IN     hostname:  hostname from URL.
- *      IN     callback:  routine to be called periodically while the file
- *                        is being loaded.
- *      IN/OUT Buffer:    buffer where the file is loaded:
- *                           if Buffer=NULL, just get the file's length;
- *                           else if *Buffer=NULL, allocate a buffer;
- *                           else use the given *Buffer (size in *BufSize).
- *      IN/OUT BufSize:   length of Buffer, size of file:
- *                           if Buffer=NULL, OUT only;
- *                           else if *Buffer=NULL, OUT only;
- *                           else IN/OUT.
- *
- * Results
- *      EFI_SUCCESS, or an EFI error status.  EFI_ACCESS_DENIED or
- *      EFI_CONNECTION_FIN indicates that a retry is needed because the
- *      connection was closed.
+ *      IN  Message:   the response, with its headers.
+ *      OUT validator: the validator, or "" if there is no usable one.
+ *      OUT etag:      the ETag, or "" if there is none.
  *----------------------------------------------------------------------------*/
-static EFI_STATUS http_file_load_try(const CHAR16 *Url,
-                                     const char *hostname,
-                                     int (*callback)(size_t),
-                                     VOID **Buffer, UINTN *BufSize)
+static void http_get_validator(const EFI_HTTP_MESSAGE *Message,
+                               char validator[VALIDATOR_LEN],
+                               char etag_out[VALIDATOR_LEN])
 {
-   EFI_STATUS Status;
-   EFI_HTTP_TOKEN ReqToken;
-   EFI_HTTP_MESSAGE ReqMessage;
-   EFI_HTTP_REQUEST_DATA ReqData;
-   EFI_HTTP_HEADER ReqHeaders[NUM_HEADERS];
-   EFI_HTTP_TOKEN RespToken;
-   EFI_HTTP_MESSAGE RespMessage;
-   EFI_HTTP_RESPONSE_DATA RespData;
-   EFI_HTTP_STATUS_CODE HttpStatus = HTTP_STATUS_200_OK;
+   const char *etag = NULL;
+   const char *modified = NULL;
+   const char *value;
+   size_t len;
    unsigned i;
-   uint8_t *buf = NULL;
-   size_t size = (size_t)-1;
-   size_t size_recd;
 
-   /*
-    * Needed early to prep for possible "goto out" on error.
-    */
-   memset(&ReqToken, 0, sizeof(ReqToken));
-   memset(&ReqMessage, 0, sizeof(ReqMessage));
-   memset(&ReqData, 0, sizeof(ReqData));
-   memset(&RespToken, 0, sizeof(RespToken));
-   memset(&RespMessage, 0, sizeof(RespMessage));
-   memset(&RespData, 0, sizeof(RespData));
+   for (i = 0; i < Message->HeaderCount; ++i) {
+      if (strcasecmp(Message->Headers[i].FieldName, "ETag") == 0) {
+         etag = Message->Headers[i].FieldValue;
+      } else if (strcasecmp(Message->Headers[i].FieldName,
+                            "Last-Modified") == 0) {
+         modified = Message->Headers[i].FieldValue;
+      }
+   }
 
-   /*
-    * Send HTTP HEAD or GET request.
-    */
-   ReqToken.Event = HttpEvent;
-   ReqToken.Status = EFI_NOT_READY;
-   ReqToken.Message = &ReqMessage;
-   ReqMessage.Data.Request = &ReqData;
-   ReqMessage.HeaderCount = NUM_HEADERS;
-   ReqMessage.Headers = ReqHeaders;
-   ReqData.Method = (Buffer == NULL) ? HttpMethodHead : HttpMethodGet;
-   ReqData.Url = (CHAR16 *)Url;
-   ReqHeaders[0].FieldName = (CHAR8 *)"User-Agent";
-   ReqHeaders[0].FieldValue = (CHAR8 *)"esx-boot/2.0";
-   ReqHeaders[1].FieldName = (CHAR8 *)"Host";
-   ReqHeaders[1].FieldValue = (CHAR8 *)hostname;
+   etag_out[0] = '\0';
+   if (etag != NULL) {
+      len = strlen(etag);
+      if (len < VALIDATOR_LEN) {
+         memcpy(etag_out, etag, len + 1);
+      }
+   }
 
-   HttpDone = false;
-   Status = Http->Request(Http, &ReqToken);
-   if (EFI_ERROR(Status)) {
-      Log(LOG_DEBUG, "Error in Http->Request: %s",
-          error_str[error_efi_to_generic(Status)]);
-      goto out;
+   value = (etag != NULL && strncmp(etag, "W/", 2) != 0) ? etag : modified;
+   validator[0] = '\0';
+   if (value != NULL) {
+      len = strlen(value);
+      if (len < VALIDATOR_LEN) {
+         memcpy(validator, value, len + 1);
+      }
    }
-   while (!HttpDone) {
-      Http->Poll(Http);
+}
+
+/*-- http_get_content_range ----------------------------------------------------
+ *
+ *      Parse the Content-Range header of a 206 Partial Content response,
+ *      e.g. "bytes 1000-1999/5000".
+ *
+ * Parameters
+ *      IN  Message: the response, with its headers.
+ *      OUT first:   offset of the first byte sent.
+ *      OUT last:    offset of the last byte sent.
+ *      OUT total:   size of the file, or (size_t)-1 if not given.
+ *
+ * Results
+ *      true if the header is present and well formed, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool http_get_content_range(const EFI_HTTP_MESSAGE *Message,
+                                   size_t *first, size_t *last, size_t *total)
+{
+   const char *p;
+   char *end;
+   unsigned i;
+
+   for (i = 0; i < Message->HeaderCount; ++i) {
+      if (strcasecmp(Message->Headers[i].FieldName, "Content-Range") == 0) {
+         break;
+      }
    }
-   if (EFI_ERROR(ReqToken.Status)) {
-      Status = ReqToken.Status;
-      Log(LOG_ERR, "Async error from Http->Request: %s",
-          error_str[error_efi_to_generic(Status)]);
-      goto out;
+   if (i == Message->HeaderCount) {
+      return false;
    }
 
-   /*
-    * Pick up first part of response -- namely, just the headers -- to get the
-    * file length.
-    */
-   RespToken.Event = HttpEvent;
-   RespToken.Status = EFI_SUCCESS;
-   RespToken.Message = &RespMessage;
-   RespMessage.Data.Response = &RespData;
-   RespMessage.BodyLength = 0;
-   RespMessage.Body = NULL;
-   RespData.StatusCode = HTTP_STATUS_UNSUPPORTED_STATUS;
+   p = Message->Headers[i].FieldValue;
+   if (strncasecmp(p, "bytes ", 6) != 0) {
+      return false;
+   }
+   for (p += 6; *p == ' '; p++) {
+      ;
+   }
 
-   HttpDone = false;
-   Status = Http->Response(Http, &RespToken);
-   if (EFI_ERROR(Status)) {
-      Log(LOG_DEBUG, "Error in Http->Response (header): %s",
-          error_str[error_efi_to_generic(Status)]);
-      goto out;
+   if (!isdigit(*p)) {
+      return false;
    }
-   while (!HttpDone) {
-      Http->Poll(Http);
+   *first = strtoul(p, &end, 10);
+   if (*end != '-' || !isdigit(end[1])) {
+      return false;
    }
-   if (EFI_ERROR(RespToken.Status)) {
-      if (RespToken.Status == EFI_HTTP_ERROR) {
-         /*
-          * In this case we still must proceed to read the body, but we'll
-          * throw it away later.  The body will typically be an HTML file
-          * complaining about the error; e.g., a "404 Not Found" page.
-          */
-         HttpStatus = RespData.StatusCode;
-         Log(LOG_DEBUG, "HTTP error from Http->Response: %s",
-             http_status(HttpStatus));
-      } else {
-         Status = RespToken.Status;
-         Log(LOG_ERR, "Async error from Http->Response: %s",
-             error_str[error_efi_to_generic(Status)]);
-         goto out;
-      }
+   *last = strtoul(end + 1, &end, 10);
+   if (*end != '/' || *last < *first) {
+      return false;
    }
-   for (i = 0; i < RespMessage.HeaderCount; ++i) {
-      /* Get the length of the file from the ContentLength header */
-      if (strcasecmp(RespMessage.Headers[i].FieldName, "Content-Length") == 0) {
-         size = strtol(RespMessage.Headers[i].FieldValue, NULL, 10);
-         break;
+
+   p = end + 1;
+   if (*p == '*') {
+      *total = (size_t)-1;
+   } else if (isdigit(*p)) {
+      *total = strtoul(p, &end, 10);
+      if (*total <= *last) {
+         return false;
       }
+   } else {
+      return false;
    }
-   if (RespMessage.Headers != NULL) {
+
+   return true;
+}
+
+/*-- http_conn_close -----------------------------------------------------------
+ *
+ *      Abort any transfer in progress on a prefetch connection and destroy its
+ *      Http instance.
+ *
+ * Parameters
+ *      IN  conn: the connection
+ *----------------------------------------------------------------------------*/
+static void http_conn_close(http_conn_t *conn)
+{
+   if (conn->Http != NULL) {
+      if (conn->state != HTTP_CONN_IDLE && conn->state != HTTP_CONN_DONE) {
+         conn->Http->Cancel(conn->Http, NULL);
+      }
+      conn->Http->Configure(conn->Http, NULL);
+      conn->Http = NULL;
+   }
+
+   if (conn->Handle != NULL) {
+      Prefetch.ServiceBinding->DestroyChild(Prefetch.ServiceBinding,
+                                            conn->Handle);
+      conn->Handle = NULL;
+   }
+
+   if (conn->Event != NULL) {
+      bs->CloseEvent(conn->Event);
+      conn->Event = NULL;
+   }
+
+   if (conn->RespMessage.Headers != NULL) {
+      sys_free(conn->RespMessage.Headers);
+      conn->RespMessage.Headers = NULL;
+   }
+
+   if (!conn->segment) {
+      sys_free(conn->buf);
+   }
+   sys_free(conn->filepath);
+   sys_free(conn->hostname);
+   sys_free(conn->Url);
+   conn->buf = NULL;
+   conn->filepath = NULL;
+   conn->hostname = NULL;
+   conn->Url = NULL;
+   conn->segment = false;
+   conn->state = HTTP_CONN_IDLE;
+}
+
+/*-- http_prefetch_cleanup -----------------------------------------------------
+ *
+ *      Abort all prefetches and destroy the prefetch Http instances.
+ *----------------------------------------------------------------------------*/
+static void http_prefetch_cleanup(void)
+{
+   unsigned i;
+
+   for (i = 0; i < PREFETCH_CONNECTIONS; i++) {
+      http_conn_close(&Prefetch.conns[i]);
+   }
+
+   Prefetch.ServiceBinding = NULL;
+   Prefetch.Volume = NULL;
+   Prefetch.NoRanges = false;
+   Prefetch.SegmentCount = 0;
+}
+
+/*-- http_conn_open ------------------------------------------------------------
+ *
+ *      Create and configure the Http instance of a prefetch connection.
+ *
+ * Parameters
+ *      IN  conn: the connection
+ *
+ * Results
+ *      EFI_SUCCESS, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_conn_open(http_conn_t *conn)
+{
+   EFI_STATUS Status;
+
+   Status = Prefetch.ServiceBinding->CreateChild(Prefetch.ServiceBinding,
+                                                 &conn->Handle);
+   if (EFI_ERROR(Status)) {
+      conn->Handle = NULL;
+      Log(LOG_DEBUG, "Error creating prefetch Http child handle: %s",
+          error_str[error_efi_to_generic(Status)]);
+      return Status;
+   }
+
+   Status = get_protocol_interface(conn->Handle, &HttpProto,
+                                   (void **)&conn->Http);
+   if (!EFI_ERROR(Status)) {
+      Status = http_configure(conn->Http);
+   }
+   if (!EFI_ERROR(Status)) {
+      Status = bs->CreateEvent(EVT_NOTIFY_SIGNAL, TPL_CALLBACK, http_callback,
+                               &conn->Done, &conn->Event);
+   }
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error setting up prefetch Http instance: %s",
+          error_str[error_efi_to_generic(Status)]);
+      http_conn_close(conn);
+   }
+
+   return Status;
+}
+
+/*-- http_conn_fail ------------------------------------------------------------
+ *
+ *      Terminate a prefetch with an error.  The Http instance is destroyed, so
+ *      that whatever is left of the response cannot confuse a later request;
+ *      the file itself will be loaded again through the primary instance.
+ *
+ * Parameters
+ *      IN  conn:   the connection
+ *      IN  Status: the error
+ *----------------------------------------------------------------------------*/
+static void http_conn_fail(http_conn_t *conn, EFI_STATUS Status)
+{
+   Log(LOG_DEBUG, "Prefetch of %s%s failed: %s", conn->filepath,
+       conn->segment ? conn->range : "",
+       error_str[error_efi_to_generic(Status)]);
+
+   if (conn->Http != NULL) {
+      conn->Http->Cancel(conn->Http, NULL);
+      conn->Http->Configure(conn->Http, NULL);
+      conn->Http = NULL;
+   }
+   if (conn->Handle != NULL) {
+      Prefetch.ServiceBinding->DestroyChild(Prefetch.ServiceBinding,
+                                            conn->Handle);
+      conn->Handle = NULL;
+   }
+
+   conn->Status = Status;
+   conn->state = HTTP_CONN_DONE;
+}
+
+/*-- http_conn_response --------------------------------------------------------
+ *
+ *      Ask for the next part of the response on a prefetch connection: the
+ *      headers if Body is NULL, or else up to Length bytes of the body.
+ *
+ * Parameters
+ *      IN  conn:   the connection
+ *      IN  Body:   where to store the body data
+ *      IN  Length: size of Body
+ *
+ * Results
+ *      EFI_SUCCESS, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_conn_response(http_conn_t *conn, uint8_t *Body,
+                                     size_t Length)
+{
+   memset(&conn->RespMessage, 0, sizeof(conn->RespMessage));
+   conn->RespToken.Event = conn->Event;
+   conn->RespToken.Status = EFI_SUCCESS;
+   conn->RespToken.Message = &conn->RespMessage;
+   conn->RespMessage.Body = Body;
+   conn->RespMessage.BodyLength = Length;
+   if (Body == NULL) {
+      conn->RespMessage.Data.Response = &conn->RespData;
+      conn->RespData.StatusCode = HTTP_STATUS_UNSUPPORTED_STATUS;
+   }
+
+   conn->Done = false;
+   return conn->Http->Response(conn->Http, &conn->RespToken);
+}
+
+/*-- http_conn_advance ---------------------------------------------------------
+ *
+ *      Move a prefetch connection to its next state, once the token it was
+ *      waiting for has completed.
+ *
+ * Parameters
+ *      IN  conn: the connection
+ *----------------------------------------------------------------------------*/
+static void http_conn_advance(http_conn_t *conn)
+{
+   EFI_STATUS Status = EFI_SUCCESS;
+   size_t size, first, last, total;
+   bool range_ok = false;
+   unsigned i;
+
+   switch (conn->state) {
+   case HTTP_CONN_REQUEST:
+      if (EFI_ERROR(conn->ReqToken.Status)) {
+         http_conn_fail(conn, conn->ReqToken.Status);
+         return;
+      }
+      Status = http_conn_response(conn, NULL, 0);
+      conn->state = HTTP_CONN_HEADERS;
+      break;
+
+   case HTTP_CONN_HEADERS:
+      if (EFI_ERROR(conn->RespToken.Status)) {
+         if (conn->RespToken.Status == EFI_HTTP_ERROR) {
+            Log(LOG_DEBUG, "HTTP error prefetching %s: %s", conn->filepath,
+                http_status(conn->RespData.StatusCode));
+         }
+         http_conn_fail(conn, conn->RespToken.Status);
+         return;
+      }
+
+      size = (size_t)-1;
+      for (i = 0; i < conn->RespMessage.HeaderCount; ++i) {
+         if (strcasecmp(conn->RespMessage.Headers[i].FieldName,
+                        "Content-Length") == 0) {
+            size = strtol(conn->RespMessage.Headers[i].FieldValue, NULL, 10);
+            break;
+         }
+      }
+      if (conn->segment) {
+         range_ok = http_get_content_range(&conn->RespMessage, &first, &last,
+                                           &total);
+      } else {
+         http_get_validator(&conn->RespMessage, conn->validator, conn->etag);
+      }
+      if (conn->RespMessage.Headers != NULL) {
+         sys_free(conn->RespMessage.Headers);
+         conn->RespMessage.Headers = NULL;
+      }
+      if (size == (size_t)-1) {
+         http_conn_fail(conn, EFI_PROTOCOL_ERROR);
+         return;
+      }
+
+      if (conn->segment) {
+         /*
+          * The segment is written straight into the primary instance's
+          * buffer, so it must be exactly the range that was asked for.  A
+          * 200 response means that the server ignored the range, or that
+          * the file changed and If-Range no longer matches.
+          */
+         if (conn->RespData.StatusCode != HTTP_STATUS_206_PARTIAL_CONTENT) {
+            Log(LOG_DEBUG, "Server ignored range request (%s)",
+                http_status(conn->RespData.StatusCode));
+            Prefetch.NoRanges = true;
+            http_conn_fail(conn, EFI_UNSUPPORTED);
+            return;
+         }
+         if (!range_ok || first != conn->start ||
+             last != conn->start + conn->size - 1 || size != conn->size) {
+            Log(LOG_DEBUG, "Unexpected Content-Range for %s", conn->range);
+            Prefetch.NoRanges = true;
+            http_conn_fail(conn, EFI_PROTOCOL_ERROR);
+            return;
+         }
+      } else {
+         conn->size = size;
+         conn->buf = sys_malloc(size > 0 ? size : 1);
+         if (conn->buf == NULL) {
+            http_conn_fail(conn, EFI_OUT_OF_RESOURCES);
+            return;
+         }
+      }
+
+      conn->size_recd = 0;
+      conn->state = HTTP_CONN_BODY;
+      if (conn->size == 0) {
+         conn->Status = EFI_SUCCESS;
+         conn->state = HTTP_CONN_DONE;
+         return;
+      }
+      Status = http_conn_response(conn, conn->buf,
+                                  http_recv_length(conn->size));
+      break;
+
+   case HTTP_CONN_BODY:
+      if (EFI_ERROR(conn->RespToken.Status)) {
+         http_conn_fail(conn, conn->RespToken.Status);
+         return;
+      }
+      conn->size_recd += conn->RespMessage.BodyLength;
+      if (conn->size_recd >= conn->size) {
+         conn->Status = EFI_SUCCESS;
+         conn->state = HTTP_CONN_DONE;
+         return;
+      }
+      Status = http_conn_response(conn, &conn->buf[conn->size_recd],
+                                  http_recv_length(conn->size -
+                                                   conn->size_recd));
+      break;
+
+   default:
+      return;
+   }
+
+   if (EFI_ERROR(Status)) {
+      http_conn_fail(conn, Status);
+   }
+}
+
+/*-- http_prefetch_poll --------------------------------------------------------
+ *
+ *      Make progress on all outstanding prefetches.
+ *
+ * Results
+ *      True if any of the prefetch connections had a token complete.
+ *----------------------------------------------------------------------------*/
+static bool http_prefetch_poll(void)
+{
+   http_conn_t *conn;
+   bool progress = false;
+   unsigned i;
+
+   for (i = 0; i < PREFETCH_CONNECTIONS; i++) {
+      conn = &Prefetch.conns[i];
+      if (conn->state == HTTP_CONN_IDLE || conn->state == HTTP_CONN_DONE) {
+         continue;
+      }
+      if (!conn->Done) {
+         conn->Http->Poll(conn->Http);
+      }
+      if (conn->Done) {
+         http_conn_advance(conn);
+         progress = true;
+      }
+   }
+
+   return progress;
+}
+
+/*-- http_idle -----------------------------------------------------------------
+ *
+ *      Account for one round of polling, and if too many rounds in a row have
+ *      made no progress, wait for the next firmware timer tick.  Falls back
+ *      to plain polling if the timer cannot be set up.
+ *
+ * Parameters
+ *      IN  progress: whether a token completed during this round.
+ *----------------------------------------------------------------------------*/
+static void http_idle(bool progress)
+{
+   EFI_STATUS Status;
+   UINTN Index;
+
+   if (progress) {
+      HttpIdlePolls = 0;
+      return;
+   }
+   if (++HttpIdlePolls < IDLE_POLLS_MAX) {
+      return;
+   }
+   HttpIdlePolls = 0;
+
+   if (HttpTimer == NULL && !HttpTimerUnavailable) {
+      Status = bs->CreateEvent(EVT_TIMER, 0, NULL, NULL, &HttpTimer);
+      if (!EFI_ERROR(Status)) {
+         Status = bs->SetTimer(HttpTimer, TimerPeriodic, IDLE_TICK_100NS);
+         if (EFI_ERROR(Status)) {
+            bs->CloseEvent(HttpTimer);
+            HttpTimer = NULL;
+         }
+      }
+      if (EFI_ERROR(Status)) {
+         Log(LOG_DEBUG, "No HTTP idle timer: %s",
+             error_str[error_efi_to_generic(Status)]);
+         HttpTimerUnavailable = true;
+      }
+   }
+   if (HttpTimer != NULL) {
+      bs->WaitForEvent(1, &HttpTimer, &Index);
+   }
+}
+
+/*-- http_wait -----------------------------------------------------------------
+ *
+ *      Wait for a token of the primary Http instance to complete, while also
+ *      making progress on the prefetch connections.
+ *----------------------------------------------------------------------------*/
+static void http_wait(void)
+{
+   bool progress;
+
+   while (!HttpDone) {
+      Http->Poll(Http);
+      progress = http_prefetch_poll();
+      http_idle(progress || HttpDone);
+   }
+}
+
+/*-- http_prefetch_find --------------------------------------------------------
+ *
+ *      Look up the prefetch connection for a file.
+ *
+ * Parameters
+ *      IN  filepath: the URL of the file.
+ *
+ * Results
+ *      The connection, or NULL if the file is not being prefetched.
+ *----------------------------------------------------------------------------*/
+static http_conn_t *http_prefetch_find(const char *filepath)
+{
+   unsigned i;
+
+   for (i = 0; i < PREFETCH_CONNECTIONS; i++) {
+      if (Prefetch.conns[i].state != HTTP_CONN_IDLE &&
+          !Prefetch.conns[i].segment &&
+          strcmp(Prefetch.conns[i].filepath, filepath) == 0) {
+         return &Prefetch.conns[i];
+      }
+   }
+
+   return NULL;
+}
+
+/*-- http_conn_request ---------------------------------------------------------
+ *
+ *      Send a GET request on a prefetch connection, creating its Http instance
+ *      if needed.  For a segment, conn->start and conn->size give the byte
+ *      range to ask for, conn->buf where to store it, and conn->validator
+ *      the version of the file that it must come from.
+ *
+ * Parameters
+ *      IN  conn:     an idle connection.
+ *      IN  filepath: the URL of the file.
+ *      IN  hostname: hostname from the URL.
+ *
+ * Results
+ *      EFI_SUCCESS, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_conn_request(http_conn_t *conn, const char *filepath,
+                                    const char *hostname)
+{
+   EFI_STATUS Status;
+
+   if (conn->Http == NULL) {
+      Status = http_conn_open(conn);
+      if (EFI_ERROR(Status)) {
+         conn->segment = false;
+         return Status;
+      }
+   }
+
+   conn->filepath = strdup(filepath);
+   conn->hostname = strdup(hostname);
+   if (conn->filepath == NULL || conn->hostname == NULL ||
+       EFI_ERROR(ascii_to_ucs2(filepath, &conn->Url))) {
+      http_conn_close(conn);
+      return EFI_OUT_OF_RESOURCES;
+   }
+
+   memset(&conn->ReqToken, 0, sizeof(conn->ReqToken));
+   memset(&conn->ReqMessage, 0, sizeof(conn->ReqMessage));
+   memset(&conn->ReqData, 0, sizeof(conn->ReqData));
+   memset(&conn->RespToken, 0, sizeof(conn->RespToken));
+   memset(&conn->RespMessage, 0, sizeof(conn->RespMessage));
+   memset(&conn->RespData, 0, sizeof(conn->RespData));
+
+   conn->ReqToken.Event = conn->Event;
+   conn->ReqToken.Status = EFI_NOT_READY;
+   conn->ReqToken.Message = &conn->ReqMessage;
+   conn->ReqMessage.Data.Request = &conn->ReqData;
+   conn->ReqMessage.HeaderCount = NUM_HEADERS;
+   conn->ReqMessage.Headers = conn->ReqHeaders;
+   conn->ReqData.Method = HttpMethodGet;
+   conn->ReqData.Url = conn->Url;
+   conn->ReqHeaders[0].FieldName = (CHAR8 *)"User-Agent";
+   conn->ReqHeaders[0].FieldValue = (CHAR8 *)"esx-boot/2.0";
+   conn->ReqHeaders[1].FieldName = (CHAR8 *)"Host";
+   conn->ReqHeaders[1].FieldValue = (CHAR8 *)conn->hostname;
+
+   if (conn->segment) {
+      snprintf(conn->range, sizeof(conn->range), "bytes=%zu-%zu",
+               conn->start, conn->start + conn->size - 1);
+      conn->ReqHeaders[NUM_HEADERS].FieldName = (CHAR8 *)"Range";
+      conn->ReqHeaders[NUM_HEADERS].FieldValue = (CHAR8 *)conn->range;
+      conn->ReqHeaders[NUM_HEADERS + 1].FieldName = (CHAR8 *)"If-Range";
+      conn->ReqHeaders[NUM_HEADERS + 1].FieldValue = (CHAR8 *)conn->validator;
+      conn->ReqMessage.HeaderCount += 2;
+   } else {
+      conn->buf = NULL;
+      conn->size = 0;
+      conn->validator[0] = '\0';
+      conn->etag[0] = '\0';
+   }
+
+   conn->size_recd = 0;
+   conn->Status = EFI_NOT_READY;
+   conn->Done = false;
+   conn->state = HTTP_CONN_REQUEST;
+
+   Status = conn->Http->Request(conn->Http, &conn->ReqToken);
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error in prefetch Http->Request: %s",
+          error_str[error_efi_to_generic(Status)]);
+      http_conn_close(conn);
+      return Status;
+   }
+
+   return EFI_SUCCESS;
+}
+
+/*-- http_prefetch_idle --------------------------------------------------------
+ *
+ *      Find an idle prefetch connection.
+ *
+ * Results
+ *      The connection, or NULL if they are all busy.
+ *----------------------------------------------------------------------------*/
+static http_conn_t *http_prefetch_idle(void)
+{
+   unsigned i;
+
+   for (i = 0; i < PREFETCH_CONNECTIONS; i++) {
+      if (Prefetch.conns[i].state == HTTP_CONN_IDLE) {
+         return &Prefetch.conns[i];
+      }
+   }
+
+   return NULL;
+}
+
+/*-- http_prefetch_start -------------------------------------------------------
+ *
+ *      Start downloading a file on an idle prefetch connection.
+ *
+ * Parameters
+ *      IN  Volume:   handle implying the NIC and IP version to use.
+ *      IN  filepath: the URL of the file.
+ *      IN  hostname: hostname from the URL.
+ *
+ * Results
+ *      EFI_SUCCESS, EFI_OUT_OF_RESOURCES if too many files are already being
+ *      prefetched, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_prefetch_start(EFI_HANDLE Volume, const char *filepath,
+                                      const char *hostname)
+{
+   EFI_STATUS Status;
+   http_conn_t *conn;
+   unsigned i, busy;
+
+   if (Prefetch.Volume != Volume) {
+      http_prefetch_cleanup();
+      Prefetch.Volume = Volume;
+      Prefetch.ServiceBinding = HttpServiceBinding;
+   }
+
+   busy = 0;
+   for (i = 0; i < PREFETCH_CONNECTIONS; i++) {
+      if (Prefetch.conns[i].state != HTTP_CONN_IDLE &&
+          !Prefetch.conns[i].segment) {
+         busy++;
+      }
+   }
+
+   conn = http_prefetch_idle();
+   if (conn == NULL || busy >= PREFETCH_FILES_MAX) {
+      return EFI_OUT_OF_RESOURCES;
+   }
+
+   Status = http_conn_request(conn, filepath, hostname);
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+
+   Log(LOG_DEBUG, "Prefetching %s", filepath);
+   return EFI_SUCCESS;
+}
+
+/*-- http_segments_start -------------------------------------------------------
+ *
+ *      Split a large file that the primary instance is about to receive into
+ *      segments, and fetch all but the first one with range requests on idle
+ *      prefetch connections.  The segments are received directly into the
+ *      primary instance's buffer.
+ *
+ *      The primary instance keeps receiving the file from the start, up to
+ *      the first segment that has not failed (see http_segments_limit), so
+ *      it receives the segments that fail before it gets there itself.  It
+ *      then drops its connection and waits for the segments; should one of
+ *      them fail after that, the transfer is resumed from there with a range
+ *      request.  A file without a validator is not split, as its segments
+ *      could come from different versions of it.
+ *
+ * Parameters
+ *      IN  filepath:  the URL of the file.
+ *      IN  hostname:  hostname from the URL.
+ *      IN  buf:       buffer for the whole file.
+ *      IN  size:      size of the file.
+ *      IN  validator: ETag or Last-Modified of the file, sent with If-Range
+ *                     so that no segment comes from another version of it.
+ *----------------------------------------------------------------------------*/
+static void http_segments_start(const char *filepath, const char *hostname,
+                                uint8_t *buf, size_t size,
+                                const char *validator)
+{
+   http_conn_t *conn;
+   unsigned i, count;
+   size_t seg_size;
+
+   Prefetch.SegmentCount = 0;
+
+   if (Prefetch.Volume != HttpVolume || Prefetch.NoRanges ||
+       size < SEGMENT_MIN_FILE_SIZE || validator[0] == '\0') {
+      return;
+   }
+
+   count = 0;
+   for (i = 0; i < PREFETCH_CONNECTIONS && count < SEGMENTS_MAX; i++) {
+      if (Prefetch.conns[i].state == HTTP_CONN_IDLE) {
+         count++;
+      }
+   }
+   if (count == 0) {
+      return;
+   }
+
+   /* The primary instance gets the first segment. */
+   seg_size = size / (count + 1);
+
+   for (i = 1; i <= count; i++) {
+      conn = http_prefetch_idle();
+      conn->segment = true;
+      conn->start = i * seg_size;
+      conn->size = (i == count) ? size - conn->start : seg_size;
+      conn->buf = buf + conn->start;
+      memcpy(conn->validator, validator, strlen(validator) + 1);
+      if (EFI_ERROR(http_conn_request(conn, filepath, hostname))) {
+         break;
+      }
+      Prefetch.Segments[Prefetch.SegmentCount++] = conn;
+   }
+
+   Log(LOG_DEBUG, "Loading %s in %u segments", filepath,
+       Prefetch.SegmentCount + 1);
+}
+
+/*-- http_segments_limit -------------------------------------------------------
+ *
+ *      Find where the primary instance must stop receiving the file: at the
+ *      start of the first segment after its position that has not failed.
+ *
+ * Parameters
+ *      IN  offset: position of the primary instance in the file.
+ *      IN  size:   size of the file.
+ *
+ * Results
+ *      The offset at which to stop, or size if no segment is left.
+ *----------------------------------------------------------------------------*/
+static size_t http_segments_limit(size_t offset, size_t size)
+{
+   http_conn_t *conn;
+   unsigned i;
+
+   for (i = 0; i < Prefetch.SegmentCount; i++) {
+      conn = Prefetch.Segments[i];
+      if (conn->start >= offset &&
+          (conn->state != HTTP_CONN_DONE || !EFI_ERROR(conn->Status))) {
+         return conn->start;
+      }
+   }
+
+   return size;
+}
+
+/*-- http_segments_wait --------------------------------------------------------
+ *
+ *      Wait for the segments to be received, once the primary instance has
+ *      reached the first of them, and account for the contiguous part of the
+ *      file that they received.
+ *
+ * Parameters
+ *      IN     callback: routine to be called with the amount of data received.
+ *      IN/OUT xfer:     transfer state; xfer->received is advanced over the
+ *                       segments that were received.
+ *----------------------------------------------------------------------------*/
+static void http_segments_wait(int (*callback)(size_t), http_xfer_t *xfer)
+{
+   http_conn_t *conn;
+   unsigned i;
+   bool busy;
+
+   do {
+      busy = false;
+      for (i = 0; i < Prefetch.SegmentCount; i++) {
+         if (Prefetch.Segments[i]->state != HTTP_CONN_DONE) {
+            busy = true;
+         }
+      }
+      if (busy) {
+         http_idle(http_prefetch_poll());
+      }
+   } while (busy);
+
+   for (i = 0; i < Prefetch.SegmentCount; i++) {
+      conn = Prefetch.Segments[i];
+      if (conn->start < xfer->received) {
+         continue;
+      }
+      if (conn->start != xfer->received || EFI_ERROR(conn->Status)) {
+         break;
+      }
+      if (callback != NULL) {
+         callback(conn->size);
+      }
+      xfer->received += conn->size;
+   }
+}
+
+/*-- http_segments_end ---------------------------------------------------------
+ *
+ *      Release the segment connections once the primary instance is done
+ *      with the file.  Connections that are still receiving are closed, since
+ *      they write into a buffer that is about to be handed over.
+ *----------------------------------------------------------------------------*/
+static void http_segments_end(void)
+{
+   http_conn_t *conn;
+   unsigned i;
+
+   for (i = 0; i < Prefetch.SegmentCount; i++) {
+      conn = Prefetch.Segments[i];
+      if (conn->state == HTTP_CONN_DONE && !EFI_ERROR(conn->Status)) {
+         /* Keep the Http instance for later use. */
+         sys_free(conn->filepath);
+         sys_free(conn->hostname);
+         sys_free(conn->Url);
+         conn->filepath = NULL;
+         conn->hostname = NULL;
+         conn->Url = NULL;
+         conn->buf = NULL;
+         conn->segment = false;
+         conn->state = HTTP_CONN_IDLE;
+      } else {
+         http_conn_close(conn);
+      }
+   }
+
+   Prefetch.SegmentCount = 0;
+}
+
+/*-- http_prefetch_take --------------------------------------------------------
+ *
+ *      Wait for a prefetched file to be fully received, and hand it over.
+ *
+ *      If the prefetch failed part way through the body, the data received so
+ *      far is handed over anyway, so that the primary instance can resume the
+ *      transfer from there instead of starting over.
+ *
+ * Parameters
+ *      IN     filepath:  the URL of the file.
+ *      IN     callback:  routine to be called as the file data is handed over.
+ *      IN/OUT xfer:      transfer state; if xfer->buf is not NULL the file is
+ *                        copied there, else the prefetch buffer is handed
+ *                        over.
+ *
+ * Results
+ *      EFI_SUCCESS, EFI_NOT_FOUND if the file was not prefetched or the
+ *      prefetch failed, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_prefetch_take(const char *filepath,
+                                     int (*callback)(size_t),
+                                     http_xfer_t *xfer)
+{
+   http_conn_t *conn;
+
+   conn = http_prefetch_find(filepath);
+   if (conn == NULL) {
+      return EFI_NOT_FOUND;
+   }
+
+   while (conn->state != HTTP_CONN_DONE) {
+      http_idle(http_prefetch_poll());
+   }
+
+   if (EFI_ERROR(conn->Status)) {
+      if (conn->buf != NULL && conn->size_recd > 0 && xfer->buf == NULL) {
+         xfer->buf = conn->buf;
+         xfer->bufsize = conn->size;
+         xfer->owned = true;
+         xfer->size = conn->size;
+         xfer->received = conn->size_recd;
+         memcpy(xfer->validator, conn->validator, sizeof(xfer->validator));
+         memcpy(xfer->etag, conn->etag, sizeof(xfer->etag));
+         conn->buf = NULL;
+         if (callback != NULL) {
+            callback(xfer->received);
+         }
+      }
+      http_conn_close(conn);
+      return EFI_NOT_FOUND;
+   }
+
+   if (xfer->buf != NULL) {
+      if (xfer->bufsize < conn->size) {
+         xfer->size = conn->size;
+         http_conn_close(conn);
+         return EFI_BUFFER_TOO_SMALL;
+      }
+      memcpy(xfer->buf, conn->buf, conn->size);
+      sys_free(conn->buf);
+   } else {
+      xfer->buf = conn->buf;
+      xfer->bufsize = conn->size;
+      xfer->owned = true;
+   }
+   xfer->size = conn->size;
+   xfer->received = conn->size;
+   memcpy(xfer->etag, conn->etag, sizeof(xfer->etag));
+   conn->buf = NULL;
+
+   if (callback != NULL) {
+      callback(conn->size);
+   }
+
+   /*
+    * Keep the Http instance, and its open TCP connection, for the next
+    * prefetch.
+    */
+   sys_free(conn->filepath);
+   sys_free(conn->hostname);
+   sys_free(conn->Url);
+   conn->filepath = NULL;
+   conn->hostname = NULL;
+   conn->Url = NULL;
+   conn->state = HTTP_CONN_IDLE;
+
+   return EFI_SUCCESS;
+}
+
+/*-- http_file_load_try --------------------------------------------------------
+ *
+ *      Try once to load a file into memory or get its length, using HTTP.
+ *
+ *      If part of the file has already been received (xfer->received > 0),
+ *      only the rest of it is requested, with a Range header and an If-Range
+ *      header holding the validator of the first response.  Should the
+ *      server ignore the range, or the file have changed, the server sends
+ *      the whole file and the transfer starts over from the beginning.  A
+ *      transfer without a validator is never resumed.
+ *
+ * Parameters
+ *      IN     filepath:  the ASCII URL to load.
+ *      IN     Url:       URL to load.
+ *      IN     hostname:  hostname from URL.
+ *      IN     callback:  routine to be called periodically while the file
+ *                        is being loaded.
+ *      IN     head:      just get the file's length (in xfer->size).
+ *      IN/OUT xfer:      transfer state:
+ *                           if xfer->buf=NULL, allocate a buffer;
+ *                           else use xfer->buf (size in xfer->bufsize).
+ *                        On error, xfer->received tells how much of the file
+ *                        was received, for a later attempt to resume from.
+ *
+ * Results
+ *      EFI_SUCCESS, or an EFI error status.  EFI_ACCESS_DENIED or
+ *      EFI_CONNECTION_FIN indicates that a retry is needed because the
+ *      connection was closed.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_file_load_try(const char *filepath,
+                                     const CHAR16 *Url,
+                                     const char *hostname,
+                                     int (*callback)(size_t),
+                                     bool head, http_xfer_t *xfer)
+{
+   EFI_STATUS Status;
+   EFI_HTTP_TOKEN ReqToken;
+   EFI_HTTP_MESSAGE ReqMessage;
+   EFI_HTTP_REQUEST_DATA ReqData;
+   EFI_HTTP_HEADER ReqHeaders[NUM_HEADERS + 2];
+   EFI_HTTP_TOKEN RespToken;
+   EFI_HTTP_MESSAGE RespMessage;
+   EFI_HTTP_RESPONSE_DATA RespData;
+   EFI_HTTP_STATUS_CODE HttpStatus = HTTP_STATUS_200_OK;
+   char range[RANGE_HEADER_LEN];
+   char validator[VALIDATOR_LEN];
+   char etag[VALIDATOR_LEN];
+   unsigned i;
+   size_t size = (size_t)-1;
+   size_t offset, first, last, total, limit;
+   bool accept_ranges = false;
+   bool range_ok;
+
+   offset = head ? 0 : xfer->received;
+   if (offset > 0 && xfer->validator[0] == '\0') {
+      Log(LOG_DEBUG, "No ETag or Last-Modified to resume %s, restarting",
+          filepath);
+      offset = 0;
+      xfer->received = 0;
+   }
+
+   /*
+    * Needed early to prep for possible "goto out" on error.
+    */
+   memset(&ReqToken, 0, sizeof(ReqToken));
+   memset(&ReqMessage, 0, sizeof(ReqMessage));
+   memset(&ReqData, 0, sizeof(ReqData));
+   memset(&RespToken, 0, sizeof(RespToken));
+   memset(&RespMessage, 0, sizeof(RespMessage));
+   memset(&RespData, 0, sizeof(RespData));
+
+   /*
+    * Send HTTP HEAD or GET request.
+    */
+   ReqToken.Event = HttpEvent;
+   ReqToken.Status = EFI_NOT_READY;
+   ReqToken.Message = &ReqMessage;
+   ReqMessage.Data.Request = &ReqData;
+   ReqMessage.HeaderCount = NUM_HEADERS;
+   ReqMessage.Headers = ReqHeaders;
+   ReqData.Method = head ? HttpMethodHead : HttpMethodGet;
+   ReqData.Url = (CHAR16 *)Url;
+   ReqHeaders[0].FieldName = (CHAR8 *)"User-Agent";
+   ReqHeaders[0].FieldValue = (CHAR8 *)"esx-boot/2.0";
+   ReqHeaders[1].FieldName = (CHAR8 *)"Host";
+   ReqHeaders[1].FieldValue = (CHAR8 *)hostname;
+   if (offset > 0) {
+      snprintf(range, sizeof(range), "bytes=%zu-", offset);
+      ReqHeaders[NUM_HEADERS].FieldName = (CHAR8 *)"Range";
+      ReqHeaders[NUM_HEADERS].FieldValue = (CHAR8 *)range;
+      ReqHeaders[NUM_HEADERS + 1].FieldName = (CHAR8 *)"If-Range";
+      ReqHeaders[NUM_HEADERS + 1].FieldValue = (CHAR8 *)xfer->validator;
+      ReqMessage.HeaderCount += 2;
+   }
+
+   HttpDone = false;
+   Status = Http->Request(Http, &ReqToken);
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error in Http->Request: %s",
+          error_str[error_efi_to_generic(Status)]);
+      goto out;
+   }
+   http_wait();
+   if (EFI_ERROR(ReqToken.Status)) {
+      Status = ReqToken.Status;
+      Log(LOG_ERR, "Async error from Http->Request: %s",
+          error_str[error_efi_to_generic(Status)]);
+      goto out;
+   }
+
+   /*
+    * Pick up first part of response -- namely, just the headers -- to get the
+    * file length.
+    */
+   RespToken.Event = HttpEvent;
+   RespToken.Status = EFI_SUCCESS;
+   RespToken.Message = &RespMessage;
+   RespMessage.Data.Response = &RespData;
+   RespMessage.BodyLength = 0;
+   RespMessage.Body = NULL;
+   RespData.StatusCode = HTTP_STATUS_UNSUPPORTED_STATUS;
+
+   HttpDone = false;
+   Status = Http->Response(Http, &RespToken);
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error in Http->Response (header): %s",
+          error_str[error_efi_to_generic(Status)]);
+      goto out;
+   }
+   http_wait();
+   if (EFI_ERROR(RespToken.Status)) {
+      if (RespToken.Status == EFI_HTTP_ERROR) {
+         /*
+          * In this case we still must proceed to read the body, but we'll
+          * throw it away later.  The body will typically be an HTML file
+          * complaining about the error; e.g., a "404 Not Found" page.
+          */
+         HttpStatus = RespData.StatusCode;
+         Log(LOG_DEBUG, "HTTP error from Http->Response: %s",
+             http_status(HttpStatus));
+      } else {
+         Status = RespToken.Status;
+         Log(LOG_ERR, "Async error from Http->Response: %s",
+             error_str[error_efi_to_generic(Status)]);
+         goto out;
+      }
+   }
+   for (i = 0; i < RespMessage.HeaderCount; ++i) {
+      if (strcasecmp(RespMessage.Headers[i].FieldName, "Content-Length") == 0) {
+         /* Get the length of the file from the ContentLength header */
+         size = strtol(RespMessage.Headers[i].FieldValue, NULL, 10);
+      } else if (strcasecmp(RespMessage.Headers[i].FieldName,
+                            "Accept-Ranges") == 0) {
+         accept_ranges =
+            strcasecmp(RespMessage.Headers[i].FieldValue, "bytes") == 0;
+      }
+   }
+   range_ok = http_get_content_range(&RespMessage, &first, &last, &total);
+   http_get_validator(&RespMessage, validator, etag);
+   if (RespMessage.Headers != NULL) {
       sys_free(RespMessage.Headers);
       RespMessage.Headers = NULL;
    }
@@ -835,39 +1988,126 @@ static EFI_STATUS http_file_load_try(const CHAR16 *Url,
    /*
     * If just getting the file length, we are done now.
     */
-   if (Buffer == NULL) {
+   if (head) {
+      xfer->size = size;
       goto out;
    }
 
+   if (HttpStatus != HTTP_STATUS_200_OK) {
+      /*
+       * Error page; don't touch the buffer, it may hold data to resume from.
+       */
+      offset = 0;
+   } else if (offset > 0) {
+      if (RespData.StatusCode == HTTP_STATUS_206_PARTIAL_CONTENT) {
+         /*
+          * The body goes straight after the data already received, so it
+          * must start exactly there and run to the end of the file.
+          */
+         if (!range_ok || first != offset || last != xfer->size - 1 ||
+             offset + size != xfer->size ||
+             (total != (size_t)-1 && total != xfer->size)) {
+            Log(LOG_DEBUG, "Unexpected Content-Range resuming %s", filepath);
+            xfer->received = 0;
+            Status = EFI_PROTOCOL_ERROR;
+            goto out;
+         }
+         Log(LOG_DEBUG, "Resuming http transfer at %zu/%zu",
+             offset, xfer->size);
+         size = xfer->size;
+      } else {
+         Log(LOG_DEBUG, "Server ignored range request (%s), restarting",
+             http_status(RespData.StatusCode));
+         offset = 0;
+         xfer->received = 0;
+      }
+   }
+
    /*
     * Allocate buffer to store the file contents if needed.
     */
-   if (*Buffer != NULL) {
-      if (*BufSize < size) {
-         Log(LOG_DEBUG, "Buffer for http file too small (%zu < %zu)",
-             *BufSize, size);
-         *BufSize = size;
-         Status = EFI_BUFFER_TOO_SMALL;
-         goto out;
-      }
-      buf = *Buffer;
+   if (HttpStatus != HTTP_STATUS_200_OK) {
+      // Body is discarded below
+   } else if (xfer->buf != NULL && xfer->bufsize >= size) {
+      // Use the given buffer
+   } else if (xfer->buf != NULL && !xfer->owned) {
+      Log(LOG_DEBUG, "Buffer for http file too small (%zu < %zu)",
+          xfer->bufsize, size);
+      xfer->size = size;
+      Status = EFI_BUFFER_TOO_SMALL;
+      goto out;
    } else {
-      buf = sys_malloc(size);
-      if (buf == NULL) {
+      if (xfer->owned) {
+         sys_free(xfer->buf);
+      }
+      xfer->owned = false;
+      xfer->buf = sys_malloc(size);
+      if (xfer->buf == NULL) {
          Status = EFI_OUT_OF_RESOURCES;
          Log(LOG_ERR, "Out of memory to receive http file");
          goto out;
       }
+      xfer->bufsize = size;
+      xfer->owned = true;
+      xfer->received = 0;
+   }
+
+   if (HttpStatus != HTTP_STATUS_200_OK) {
+      /*
+       * Read and drop the error page, so that the connection can be reused.
+       */
+      uint8_t discard[256];
+
+      while (size > 0) {
+         memset(&RespMessage, 0, sizeof(RespMessage));
+         RespMessage.Body = discard;
+         RespMessage.BodyLength = MIN(size, sizeof(discard));
+
+         HttpDone = false;
+         Status = Http->Response(Http, &RespToken);
+         if (EFI_ERROR(Status)) {
+            goto out;
+         }
+         http_wait();
+         size -= MIN(size, RespMessage.BodyLength);
+      }
+      goto out;
+   }
+
+   xfer->size = size;
+   if (offset == 0) {
+      memcpy(xfer->validator, validator, sizeof(xfer->validator));
+      memcpy(xfer->etag, etag, sizeof(xfer->etag));
+      if (accept_ranges) {
+         http_segments_start(filepath, hostname, xfer->buf, size,
+                             xfer->validator);
+      }
    }
 
    /*
     * Loop reading the body into the buffer.
     */
-   size_recd = 0;
-   while (size_recd < size) {
+   while (xfer->received < size) {
+      limit = http_segments_limit(xfer->received, size);
+      if (xfer->received >= limit) {
+         /*
+          * The segments fetch the rest of the file.  Drop the connection
+          * rather than receiving the same data twice.  Should a segment
+          * fail, the transfer is resumed from there on a new connection.
+          */
+         Http->Cancel(Http, NULL);
+         http_reset();
+         http_segments_wait(callback, xfer);
+         if (xfer->received < size) {
+            Log(LOG_DEBUG, "Segment at %zu failed, resuming", xfer->received);
+            Status = EFI_PROTOCOL_ERROR;
+         }
+         goto out;
+      }
+
       memset(&RespMessage, 0, sizeof(RespMessage));
-      RespMessage.Body = &buf[size_recd];
-      RespMessage.BodyLength = size - size_recd;
+      RespMessage.Body = &xfer->buf[xfer->received];
+      RespMessage.BodyLength = http_recv_length(limit - xfer->received);
 
       HttpDone = false;
       Status = Http->Response(Http, &RespToken);
@@ -876,34 +2116,29 @@ static EFI_STATUS http_file_load_try(const CHAR16 *Url,
              error_str[error_efi_to_generic(Status)]);
          goto out;
       }
-      while (!HttpDone) {
-         Http->Poll(Http);
+      http_wait();
+      if (EFI_ERROR(RespToken.Status)) {
+         Status = RespToken.Status;
+         Log(LOG_DEBUG, "Async error from Http->Response (body): %s",
+             error_str[error_efi_to_generic(Status)]);
+         goto out;
       }
       if (callback != NULL) {
          callback(RespMessage.BodyLength);
       }
-      size_recd += RespMessage.BodyLength;
+      xfer->received += RespMessage.BodyLength;
    }
 
  out:
+   http_segments_end();
    if (RespMessage.Headers != NULL) {
       sys_free(RespMessage.Headers);
    }
    if (!EFI_ERROR(Status) && HttpStatus != HTTP_STATUS_200_OK) {
       Status = EFI_HTTP_ERROR;
    }
-   if (EFI_ERROR(Status)) {
-      if (Http != NULL) {
-         Http->Cancel(Http, NULL);
-      }
-      if (buf != NULL && buf != *Buffer) {
-         sys_free(buf);
-      }
-   } else {
-      if (Buffer != NULL) {
-         *Buffer = buf;
-      }
-      *BufSize = (UINTN)size;
+   if (EFI_ERROR(Status) && Http != NULL) {
+      Http->Cancel(Http, NULL);
    }
    return Status;
 }
@@ -937,8 +2172,17 @@ EFI_STATUS http_file_load(EFI_HANDLE Volume, const char *filepath,
    EFI_STATUS Status;
    char *hostname = NULL;
    CHAR16 *Url = NULL;
+   http_xfer_t xfer;
+   size_t received;
    unsigned try;
 
+   memset(&xfer, 0, sizeof(xfer));
+   xfer.size = (size_t)-1;
+   if (Buffer != NULL && *Buffer != NULL) {
+      xfer.buf = *Buffer;
+      xfer.bufsize = *BufSize;
+   }
+
    Status = get_url_hostname(filepath, &hostname);
    if (EFI_ERROR(Status)) {
       /*
@@ -960,16 +2204,36 @@ EFI_STATUS http_file_load(EFI_HANDLE Volume, const char *filepath,
       goto out;
    }
 
-   ascii_to_ucs2(filepath, &Url);
    efi_set_watchdog_timer(WATCHDOG_DISABLE);
 
+   if (Buffer != NULL && Prefetch.Volume == Volume) {
+      Status = http_prefetch_take(filepath, callback, &xfer);
+      if (Status != EFI_NOT_FOUND) {
+         goto out;
+      }
+   }
+
+   ascii_to_ucs2(filepath, &Url);
+
    for (try = 0; try <= MAX_RETRIES; try++) {
       Status = http_init(Volume);
       if (EFI_ERROR(Status)) {
          break;
       }
-      Status = http_file_load_try(Url, hostname, callback, Buffer, BufSize);
-      if (EFI_ERROR(Status) && Status != EFI_HTTP_ERROR) {
+      received = xfer.received;
+      Status = http_file_load_try(filepath, Url, hostname, callback,
+                                  Buffer == NULL, &xfer);
+      if (Status == EFI_HTTP_ERROR && received > 0) {
+         /*
+          * The server refused the range request (e.g. 416 Range Not
+          * Satisfiable because the file changed).  Start over.
+          */
+         Log(LOG_DEBUG, "Range request failed, restarting transfer");
+         xfer.received = 0;
+         continue;
+      }
+      if (EFI_ERROR(Status) && Status != EFI_HTTP_ERROR &&
+          Status != EFI_BUFFER_TOO_SMALL && Status != EFI_OUT_OF_RESOURCES) {
          /*
           * The HTTP 1.1 connection may need to be reopened.  The UEFI spec
           * says: "If the HTTP driver does not have an open underlying TCP
@@ -994,25 +2258,96 @@ EFI_STATUS http_file_load(EFI_HANDLE Volume, const char *filepath,
           * errors other than EFI_HTTP_ERROR.  If the final retry fails with
           * EFI_ACCESS_DENIED (when filepath is a plain http:// URL), we can
           * assume that the UEFI implementation disallows plain http.
+          *
+          * The retry resumes from the last byte received.  A transfer that
+          * keeps making progress is not limited to MAX_RETRIES attempts.
           */
-         http_cleanup();
-         Log(LOG_DEBUG, "%d retries left", MAX_RETRIES - try);
+         http_reset();
+         if (xfer.received > received) {
+            try = 0;
+         }
+         Log(LOG_DEBUG, "%d retries left, %zu bytes received",
+             MAX_RETRIES - try, xfer.received);
          continue;
       }
       break;
    }
 
  out:
+   if (!EFI_ERROR(Status)) {
+      if (Buffer != NULL) {
+         *Buffer = xfer.buf;
+         sys_free(HttpLast.filepath);
+         HttpLast.filepath = strdup(filepath);
+         memcpy(HttpLast.etag, xfer.etag, sizeof(HttpLast.etag));
+      }
+      *BufSize = (UINTN)xfer.size;
+   } else {
+      if (xfer.owned) {
+         sys_free(xfer.buf);
+      }
+      if (Status == EFI_BUFFER_TOO_SMALL) {
+         *BufSize = (UINTN)xfer.size;
+      }
+   }
    efi_set_watchdog_timer(WATCHDOG_DEFAULT_TIMEOUT);
    sys_free(Url);
    sys_free(hostname);
    return Status;
 }
 
+/*-- http_file_prefetch --------------------------------------------------------
+ *
+ *      Start downloading a file in the background, on one of several
+ *      additional HTTP connections, so that a later http_file_load of the
+ *      same file can complete without waiting for the whole transfer.
+ *
+ * Parameters
+ *      IN  Volume:    handle to the "volume" from which to load the file.
+ *      IN  filepath:  the ASCII absolute path of the file to retrieve;
+ *                     must be in URL format.
+ *
+ * Results
+ *      EFI_SUCCESS if the file is being prefetched,
+ *      EFI_OUT_OF_RESOURCES if all the prefetch connections are busy,
+ *      EFI_UNSUPPORTED if HTTP cannot be used for this file,
+ *      or an EFI error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS http_file_prefetch(EFI_HANDLE Volume, const char *filepath)
+{
+   EFI_STATUS Status;
+   char *hostname = NULL;
+
+   Status = get_url_hostname(filepath, &hostname);
+   if (EFI_ERROR(Status)) {
+      return EFI_UNSUPPORTED;
+   }
+
+   if (!has_http(Volume) ||
+       (strncasecmp(filepath, "http:", 5) == 0 &&
+        !plain_http_allowed(Volume))) {
+      Status = EFI_UNSUPPORTED;
+   } else if (Prefetch.Volume == Volume && http_prefetch_find(filepath)) {
+      Status = EFI_SUCCESS;
+   } else {
+      Status = http_prefetch_start(Volume, filepath, hostname);
+   }
+
+   http_prefetch_poll();
+
+   sys_free(hostname);
+   return Status;
+}
+
 /*-- http_file_get_size --------------------------------------------------------
  *
  *      Get the size of a file using HTTP.
  *
+ *      A HEAD request would cost a full network round trip per file before
+ *      any data moves, so the size is only reported if it is already known
+ *      from the headers of a GET that is in progress (see
+ *      http_file_prefetch).
+ *
  * Parameters
  *      IN  Volume:    handle to the volume from which to load the file
  *      IN  filepath:  the ASCII absolute path of the file; must be in URL
@@ -1020,12 +2355,247 @@ EFI_STATUS http_file_load(EFI_HANDLE Volume, const char *filepath,
  *      OUT FileSize:  the 64-bit file size, in bytes.
  *
  * Results
- *      EFI_SUCCESS, or an EFI error status.
+ *      EFI_SUCCESS, EFI_NOT_READY if the size is not known yet, or an EFI
+ *      error status.
  *----------------------------------------------------------------------------*/
 EFI_STATUS http_file_get_size(EFI_HANDLE Volume, const char *filepath,
                               UINTN *FileSize)
 {
-   return http_file_load(Volume, filepath, NULL, NULL, FileSize);
+   EFI_STATUS Status;
+   char *hostname = NULL;
+   http_conn_t *conn;
+
+   Status = get_url_hostname(filepath, &hostname);
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+   sys_free(hostname);
+
+   if (!has_http(Volume) ||
+       (strncasecmp(filepath, "http:", 5) == 0 &&
+        !plain_http_allowed(Volume))) {
+      return EFI_UNSUPPORTED;
+   }
+
+   if (Prefetch.Volume == Volume) {
+      http_prefetch_poll();
+      conn = http_prefetch_find(filepath);
+      if (conn != NULL && (conn->state == HTTP_CONN_BODY ||
+                           (conn->state == HTTP_CONN_DONE &&
+                            !EFI_ERROR(conn->Status)))) {
+         *FileSize = conn->size;
+         return EFI_SUCCESS;
+      }
+   }
+
+   return EFI_NOT_READY;
+}
+
+/*-- http_file_get_etag --------------------------------------------------------
+ *
+ *      Get the ETag that the server sent with a file, if it is the last file
+ *      that http_file_load has loaded.
+ *
+ * Parameters
+ *      IN  Volume:   handle to the volume from which the file was loaded
+ *      IN  filepath: the ASCII absolute path of the file; must be in URL
+ *                    format.
+ *      OUT etag:     the ETag (to be freed by the caller).
+ *
+ * Results
+ *      EFI_SUCCESS, EFI_NOT_FOUND if the ETag is not known, EFI_UNSUPPORTED
+ *      if HTTP is not used for this file, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS http_file_get_etag(EFI_HANDLE Volume, const char *filepath,
+                              char **etag)
+{
+   EFI_STATUS Status;
+   char *hostname = NULL;
+
+   Status = get_url_hostname(filepath, &hostname);
+   if (EFI_ERROR(Status)) {
+      return EFI_UNSUPPORTED;
+   }
+   sys_free(hostname);
+
+   if (!has_http(Volume)) {
+      return EFI_UNSUPPORTED;
+   }
+
+   if (HttpLast.filepath == NULL || strcmp(HttpLast.filepath, filepath) != 0 ||
+       HttpLast.etag[0] == '\0') {
+      return EFI_NOT_FOUND;
+   }
+
+   *etag = strdup(HttpLast.etag);
+
+   return *etag != NULL ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+/*-- http_file_check_etag_try --------------------------------------------------
+ *
+ *      Try once to find out whether a file still has the given ETag, with a
+ *      HEAD request carrying an If-None-Match header.
+ *
+ * Parameters
+ *      IN  Url:      URL of the file.
+ *      IN  hostname: hostname from URL.
+ *      IN  etag:     the ETag.
+ *
+ * Results
+ *      EFI_SUCCESS if the server answered 304 Not Modified, EFI_NOT_FOUND if
+ *      it answered 200 OK, EFI_HTTP_ERROR for any other answer, or an EFI
+ *      error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS http_file_check_etag_try(const CHAR16 *Url,
+                                           const char *hostname,
+                                           const char *etag)
+{
+   EFI_STATUS Status;
+   EFI_HTTP_TOKEN ReqToken;
+   EFI_HTTP_MESSAGE ReqMessage;
+   EFI_HTTP_REQUEST_DATA ReqData;
+   EFI_HTTP_HEADER ReqHeaders[NUM_HEADERS + 1];
+   EFI_HTTP_TOKEN RespToken;
+   EFI_HTTP_MESSAGE RespMessage;
+   EFI_HTTP_RESPONSE_DATA RespData;
+
+   memset(&ReqToken, 0, sizeof(ReqToken));
+   memset(&ReqMessage, 0, sizeof(ReqMessage));
+   memset(&ReqData, 0, sizeof(ReqData));
+   memset(&RespToken, 0, sizeof(RespToken));
+   memset(&RespMessage, 0, sizeof(RespMessage));
+   memset(&RespData, 0, sizeof(RespData));
+
+   ReqToken.Event = HttpEvent;
+   ReqToken.Status = EFI_NOT_READY;
+   ReqToken.Message = &ReqMessage;
+   ReqMessage.Data.Request = &ReqData;
+   ReqMessage.HeaderCount = NUM_HEADERS + 1;
+   ReqMessage.Headers = ReqHeaders;
+   ReqData.Method = HttpMethodHead;
+   ReqData.Url = (CHAR16 *)Url;
+   ReqHeaders[0].FieldName = (CHAR8 *)"User-Agent";
+   ReqHeaders[0].FieldValue = (CHAR8 *)"esx-boot/2.0";
+   ReqHeaders[1].FieldName = (CHAR8 *)"Host";
+   ReqHeaders[1].FieldValue = (CHAR8 *)hostname;
+   ReqHeaders[NUM_HEADERS].FieldName = (CHAR8 *)"If-None-Match";
+   ReqHeaders[NUM_HEADERS].FieldValue = (CHAR8 *)etag;
+
+   HttpDone = false;
+   Status = Http->Request(Http, &ReqToken);
+   if (EFI_ERROR(Status)) {
+      goto out;
+   }
+   http_wait();
+   if (EFI_ERROR(ReqToken.Status)) {
+      Status = ReqToken.Status;
+      goto out;
+   }
+
+   RespToken.Event = HttpEvent;
+   RespToken.Status = EFI_SUCCESS;
+   RespToken.Message = &RespMessage;
+   RespMessage.Data.Response = &RespData;
+   RespData.StatusCode = HTTP_STATUS_UNSUPPORTED_STATUS;
+
+   HttpDone = false;
+   Status = Http->Response(Http, &RespToken);
+   if (EFI_ERROR(Status)) {
+      goto out;
+   }
+   http_wait();
+   if (EFI_ERROR(RespToken.Status) && RespToken.Status != EFI_HTTP_ERROR) {
+      Status = RespToken.Status;
+      goto out;
+   }
+
+   /* Some firmware reports a 304 as an HTTP error, so look at the code. */
+   if (RespData.StatusCode == HTTP_STATUS_304_NOT_MODIFIED) {
+      Status = EFI_SUCCESS;
+   } else if (RespData.StatusCode == HTTP_STATUS_200_OK) {
+      Status = EFI_NOT_FOUND;
+   } else {
+      Log(LOG_DEBUG, "HTTP error checking ETag: %s",
+          http_status(RespData.StatusCode));
+      Status = EFI_HTTP_ERROR;
+   }
+
+ out:
+   if (RespMessage.Headers != NULL) {
+      sys_free(RespMessage.Headers);
+   }
+   if (EFI_ERROR(Status) && Status != EFI_NOT_FOUND &&
+       Status != EFI_HTTP_ERROR) {
+      Http->Cancel(Http, NULL);
+   }
+   return Status;
+}
+
+/*-- http_file_check_etag ------------------------------------------------------
+ *
+ *      Find out whether a file on the server still has the given ETag,
+ *      without transferring it.
+ *
+ * Parameters
+ *      IN  Volume:   handle to the volume from which to load the file
+ *      IN  filepath: the ASCII absolute path of the file; must be in URL
+ *                    format.
+ *      IN  etag:     the ETag of the copy at hand, or NULL if not known.
+ *
+ * Results
+ *      EFI_SUCCESS if the file is unchanged, EFI_NOT_FOUND if it changed or
+ *      there is no ETag to check, EFI_UNSUPPORTED if HTTP is not used for this
+ *      file, or an EFI error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS http_file_check_etag(EFI_HANDLE Volume, const char *filepath,
+                                const char *etag)
+{
+   EFI_STATUS Status;
+   char *hostname = NULL;
+   CHAR16 *Url = NULL;
+   unsigned try;
+
+   Status = get_url_hostname(filepath, &hostname);
+   if (EFI_ERROR(Status)) {
+      return EFI_UNSUPPORTED;
+   }
+
+   if (!has_http(Volume) ||
+       (strncasecmp(filepath, "http:", 5) == 0 &&
+        !plain_http_allowed(Volume))) {
+      Status = EFI_UNSUPPORTED;
+      goto out;
+   }
+
+   if (etag == NULL || etag[0] == '\0') {
+      Status = EFI_NOT_FOUND;
+      goto out;
+   }
+
+   Status = ascii_to_ucs2(filepath, &Url);
+   if (EFI_ERROR(Status)) {
+      goto out;
+   }
+
+   for (try = 0; try <= MAX_RETRIES; try++) {
+      Status = http_init(Volume);
+      if (EFI_ERROR(Status)) {
+         break;
+      }
+      Status = http_file_check_etag_try(Url, hostname, etag);
+      if (!EFI_ERROR(Status) || Status == EFI_NOT_FOUND ||
+          Status == EFI_HTTP_ERROR) {
+         break;
+      }
+      /* The connection may need to be reopened, see http_file_load. */
+      http_reset();
+   }
+
+ out:
+   sys_free(Url);
+   sys_free(hostname);
+   return Status;
 }
 
 /*-- http_efi_load_file --------------------------------------------------------
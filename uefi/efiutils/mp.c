@@ -0,0 +1,134 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * mp.c -- Running jobs on the application processors
+ *
+ *      A batch of independent jobs is shared between the BSP and the enabled
+ *      APs: each processor repeatedly takes the next job that nobody took
+ *      yet, until there is none left.  Whenever the MP Services protocol is
+ *      missing or fails, the BSP runs the remaining jobs by itself.
+ *
+ *      Jobs may run on an AP, where boot services must not be called: a job
+ *      must not allocate memory, log messages or otherwise call into the
+ *      firmware, and must only touch memory that is not shared with the
+ *      other jobs of the batch.
+ */
+
+#include "efi_private.h"
+#include <Protocol/MpService.h>
+
+static EFI_GUID MpServicesProto = EFI_MP_SERVICES_PROTOCOL_GUID;
+
+typedef struct {
+   mp_job_t job;
+   void *arg;
+   unsigned int count;
+   unsigned int next;         /* Next job to be taken, updated atomically */
+} mp_batch_t;
+
+/*-- mp_run_batch --------------------------------------------------------------
+ *
+ *      Run jobs from the batch until there is none left.
+ *
+ * Parameters
+ *      IN batch: the batch
+ *----------------------------------------------------------------------------*/
+static void mp_run_batch(mp_batch_t *batch)
+{
+   unsigned int i;
+
+   for (;;) {
+      i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_SEQ_CST);
+      if (i >= batch->count) {
+         break;
+      }
+      batch->job(batch->arg, i);
+   }
+}
+
+/*-- mp_ap_procedure -----------------------------------------------------------
+ *
+ *      Entry point of the APs (see EFI_AP_PROCEDURE).
+ *
+ * Parameters
+ *      IN Buffer: the batch
+ *----------------------------------------------------------------------------*/
+static VOID EFIAPI mp_ap_procedure(VOID *Buffer)
+{
+   mp_run_batch(Buffer);
+}
+
+/*-- mp_run_jobs ---------------------------------------------------------------
+ *
+ *      Run a batch of independent jobs on the BSP and on the enabled APs, and
+ *      wait for all of them to complete.  See the restrictions on jobs at the
+ *      top of this file.
+ *
+ * Parameters
+ *      IN job:   function called once for each index in [0, count)
+ *      IN arg:   argument passed to every job
+ *      IN count: number of jobs
+ *
+ * Results
+ *      The number of processors that took part, including the BSP.
+ *----------------------------------------------------------------------------*/
+unsigned int mp_run_jobs(mp_job_t job, void *arg, unsigned int count)
+{
+   EFI_MP_SERVICES_PROTOCOL *Mp;
+   UINTN Processors, EnabledProcessors, Index;
+   EFI_EVENT Event;
+   EFI_STATUS Status;
+   mp_batch_t batch;
+
+   batch.job = job;
+   batch.arg = arg;
+   batch.count = count;
+   batch.next = 0;
+
+   EnabledProcessors = 1;
+
+   if (count > 1) {
+      Status = LocateProtocol(&MpServicesProto, (void **)&Mp);
+      if (!EFI_ERROR(Status)) {
+         Status = Mp->GetNumberOfProcessors(Mp, &Processors,
+                                            &EnabledProcessors);
+      }
+      if (EFI_ERROR(Status) || EnabledProcessors < 2) {
+         EnabledProcessors = 1;
+      }
+   }
+
+   if (EnabledProcessors > 1) {
+      /*
+       * Non-blocking mode, so that the BSP takes its share of the jobs while
+       * the APs run.
+       */
+      Status = bs->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &Event);
+      if (!EFI_ERROR(Status)) {
+         Status = Mp->StartupAllAPs(Mp, mp_ap_procedure, FALSE, Event, 0,
+                                    &batch, NULL);
+         if (!EFI_ERROR(Status)) {
+            mp_run_batch(&batch);
+            bs->WaitForEvent(1, &Event, &Index);
+         }
+         bs->CloseEvent(Event);
+      }
+
+      if (Status == EFI_UNSUPPORTED) {
+         Status = Mp->StartupAllAPs(Mp, mp_ap_procedure, FALSE, NULL, 0,
+                                    &batch, NULL);
+      }
+
+      if (EFI_ERROR(Status)) {
+         EnabledProcessors = 1;
+      }
+   }
+
+   /* Jobs left over if the APs could not be started */
+   mp_run_batch(&batch);
+
+   return (unsigned int)EnabledProcessors;
+}
@@ -360,3 +360,75 @@ EFI_STATUS simple_file_save(EFI_HANDLE Volume, const char *filepath,
    File->Close(File);
    return Status;
 }
+
+/*-- simple_file_delete --------------------------------------------------------
+ *
+ *      Delete a file using the Simple File Protocol.
+ *
+ * Parameters
+ *      IN Volume:   handle to the volume on which the file is located
+ *      IN filepath: absolute path to the file
+ *
+ * Results
+ *      EFI_SUCCESS, or an UEFI error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS simple_file_delete(EFI_HANDLE Volume, const char *filepath)
+{
+   EFI_FILE *File;
+   EFI_STATUS Status;
+
+   Status = simple_file_open(Volume, filepath, EFI_FILE_MODE_READ |
+                             EFI_FILE_MODE_WRITE, &File);
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+
+   /* Delete() closes the file, even on failure */
+   Status = File->Delete(File);
+
+   /* EFI_WARN_DELETE_FAILURE is a warning, not an error */
+   return (Status == EFI_SUCCESS) ? EFI_SUCCESS : EFI_ACCESS_DENIED;
+}
+
+/*-- simple_file_mkdir ---------------------------------------------------------
+ *
+ *      Create a directory using the Simple File Protocol.  The parent
+ *      directory must exist.  It is not an error for the directory to exist
+ *      already.
+ *
+ * Parameters
+ *      IN Volume:  handle to the volume on which to create the directory
+ *      IN dirpath: absolute path to the directory
+ *
+ * Results
+ *      EFI_SUCCESS, or an UEFI error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS simple_file_mkdir(EFI_HANDLE Volume, const char *dirpath)
+{
+   CHAR16 *DirPath;
+   EFI_FILE *vol = NULL, *fd = NULL;
+   EFI_STATUS Status;
+
+   Status = simple_file_volume_open(Volume, &vol);
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+
+   Status = filepath_unix_to_efi(dirpath, &DirPath);
+   if (EFI_ERROR(Status)) {
+      vol->Close(vol);
+      return Status;
+   }
+
+   Status = vol->Open(vol, &fd, DirPath, EFI_FILE_MODE_READ |
+                      EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+                      EFI_FILE_DIRECTORY);
+   vol->Close(vol);
+   sys_free(DirPath);
+
+   if (!EFI_ERROR(Status) && fd != NULL) {
+      fd->Close(fd);
+   }
+
+   return Status;
+}
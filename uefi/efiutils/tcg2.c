@@ -10,6 +10,7 @@
 #include "efi_private.h"
 
 static EFI_TCG2_PROTOCOL *tcg2 = NULL;
+static EFI_TCG2_EVENT_ALGORITHM_BITMAP activePcrBanks = 0;
 
 
 /*-- tcg2_get_digest_size ------------------------------------------------------
@@ -28,7 +29,7 @@ static EFI_TCG2_PROTOCOL *tcg2 = NULL;
  * Results
  *      The size of the digest
  *----------------------------------------------------------------------------*/
-static uint32_t tcg2_get_digest_size(const TPMT_HA *digest)
+uint32_t tcg2_get_digest_size(const TPMT_HA *digest)
 {
    switch (digest->hashAlg) {
    case TPM_ALG_SHA1:
@@ -319,9 +320,8 @@ EFI_STATUS tcg2_get_event_log(const uint8_t **address,
  *      but the log entry may be missing. For example, if the log has
  *      run out of space.
  *
- *      XXX HashLogExtendEvent may be too slow for measuring all
- *      modules. If that the case we may need to run the hash algorithm
- *      ourselves using crypto64.
+ *      HashLogExtendEvent may be slow at hashing large data, see
+ *      tpm2_pcr_extend for extending a PCR with precomputed digests.
  *
  *      See TCG EFI Protocol Specification, Family “2.0”, Level 00
  *      Revision 00.13, March 30, 2016, Section 6.6:
@@ -412,6 +412,19 @@ EFI_STATUS tcg2_submit_command(uint8_t *input,
    return tcg2->SubmitCommand(tcg2, inputSize, input, outputSize, output);
 }
 
+/*-- tcg2_get_active_banks -----------------------------------------------------
+ *
+ *      Return the PCR banks that are active in the TPM.
+ *
+ * Results
+ *      A bitmap of EFI_TCG2_BOOT_HASH_ALG_* values, or 0 if the TCG2
+ *      protocol is not available.
+ *----------------------------------------------------------------------------*/
+uint32_t tcg2_get_active_banks(void)
+{
+   return tcg2 == NULL ? 0 : activePcrBanks;
+}
+
 /*-- tcg2_init -----------------------------------------------------------------
  *
  *      Initialize the TCG2 protocol.
@@ -460,6 +473,7 @@ bool tcg2_init(void)
    }
 
    tcg2 = tcg2Local;
+   activePcrBanks = capability.ActivePcrBanks;
 
    Log(LOG_DEBUG, "TCG2 protocol %u.%u initialized",
        capability.ProtocolVersion.Major,
@@ -24,8 +24,20 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <arpa/inet.h>
 #include "efi_private.h"
+#include "ServiceBinding.h"
+#include "Mtftp4.h"
+#include "PxeBaseCodeCallBack.h"
+#include "Protocol/SimpleNetwork.h"
+
+static EFI_GUID Mtftp4ServiceBindingProto =
+   EFI_MTFTP4_SERVICE_BINDING_PROTOCOL_GUID;
+static EFI_GUID Mtftp4Proto = EFI_MTFTP4_PROTOCOL_GUID;
+static EFI_GUID SimpleNetworkProto = EFI_SIMPLE_NETWORK_PROTOCOL_GUID;
+static EFI_GUID PxeCallbackProto = EFI_PXE_BASE_CODE_CALLBACK_PROTOCOL_GUID;
 
 /*
  * Standard DHCPv4 options
@@ -79,7 +91,10 @@
  * network is lossy, that increases the probability of the block needing to be
  * retransmitted because a fragment was lost.
  *
- * The default value set here can be overridden by calling tftp_set_block_size.
+ * Unless overridden by calling tftp_set_block_size, the block size is derived
+ * from the MTU of the boot NIC, so that each block fills exactly one
+ * unfragmented IPv4 datagram.  The default value set here is only used when
+ * the MTU cannot be determined.
  *
  * Contrary to the EFI spec, the EDK implementation of Mtftp() will not
  * negotiate the largest block size with the server if the BlockSize argument
@@ -89,9 +104,51 @@
  */
 #define TFTP_BLKSIZE_MIN 512   // defined by UEFI standard
 #define TFTP_BLKSIZE_MAX 65464 // defined by RFC 2348
+#define TFTP_HEADERS_SIZE 32   // IPv4 (20) + UDP (8) + TFTP DATA (4) headers
 static UINTN tftp_block_size = 1468; // default; fits in 1500 byte MTU
+static bool tftp_block_size_set = false;
+
+/*
+ * TFTP window size to request (RFC 7440).  The server sends this many blocks
+ * before waiting for an ack, instead of one block per round trip.  Only the
+ * MTFTP4 protocol lets us negotiate it; the PXE BC Mtftp() interface does not
+ * take arbitrary options.
+ */
+#define TFTP_WINDOWSIZE 16
+
+#define TFTP_SERVER_PORT 69
+#define TFTP_TRY_COUNT 6       // same as the EDK2 PXE BC driver
+#define TFTP_TIMEOUT 4         // seconds
+#define TFTP_OPTION_LEN 8      // "65464" + NUL, rounded up
+
+/*
+ * State of an MTFTP4 download, updated from the CheckPacket callback.
+ */
+typedef struct {
+   char *buffer;
+   size_t size;       // allocated size of buffer
+   size_t received;   // file size so far (end of the highest block)
+   size_t blksize;    // block size acknowledged by the server
+   UINT64 next;       // next expected block number, never wrapping
+   int (*callback)(size_t);
+   int error;         // error returned by callback
+} tftp_xfer_t;
+
+/*
+ * Progress of a PXE BC Mtftp() download, updated from the PXE BC Callback
+ * Protocol.  The protocol interface must come first.
+ */
+typedef struct {
+   EFI_PXE_BASE_CODE_CALLBACK Interface;
+   int (*callback)(size_t);
+   int error;         // error returned by callback
+   size_t received;   // bytes reported to callback so far
+   UINT16 block;      // last block number received
+} pxe_xfer_t;
 
 static bool isIPv6 = false;
+static bool mtftp4_unavailable = false;
+static bool mtftp4_no_windowsize = false;
 
 /*-- tftp_set_block_size  ------------------------------------------------------
  *
@@ -111,6 +168,58 @@ void tftp_set_block_size(size_t blksize)
    Log(LOG_DEBUG, "Switching TFTP blksize from %zu to %zu",
        tftp_block_size, blksize);
    tftp_block_size = blksize;
+   tftp_block_size_set = true;
+}
+
+/*-- tftp_get_block_size -------------------------------------------------------
+ *
+ *      Get the blksize option value to be used in TFTP requests.  Unless the
+ *      block size was set explicitly, it is the largest size that does not
+ *      cause IP fragmentation on the boot NIC.
+ *
+ * Parameters
+ *      IN Volume: handle to the boot volume
+ *
+ * Results
+ *      The TFTP block size.
+ *----------------------------------------------------------------------------*/
+static UINTN tftp_get_block_size(EFI_HANDLE Volume)
+{
+   static bool probed = false;
+   EFI_SIMPLE_NETWORK *Network;
+   EFI_DEVICE_PATH *DevPath;
+   EFI_HANDLE Nic;
+   EFI_STATUS Status;
+   UINTN blksize;
+
+   if (tftp_block_size_set || probed) {
+      return tftp_block_size;
+   }
+   probed = true;
+
+   Status = devpath_get(Volume, &DevPath);
+   if (!EFI_ERROR(Status)) {
+      Status = bs->LocateDevicePath(&SimpleNetworkProto, &DevPath, &Nic);
+   }
+   if (!EFI_ERROR(Status)) {
+      Status = get_protocol_interface(Nic, &SimpleNetworkProto,
+                                      (void **)&Network);
+   }
+   if (EFI_ERROR(Status) || Network->Mode->MaxPacketSize <= TFTP_HEADERS_SIZE) {
+      Log(LOG_DEBUG, "NIC MTU unknown; using TFTP blksize %zu",
+          tftp_block_size);
+      return tftp_block_size;
+   }
+
+   blksize = Network->Mode->MaxPacketSize - TFTP_HEADERS_SIZE;
+   blksize = MAX(blksize, TFTP_BLKSIZE_MIN);
+   blksize = MIN(blksize, TFTP_BLKSIZE_MAX);
+
+   Log(LOG_DEBUG, "NIC MTU %u; using TFTP blksize %zu",
+       Network->Mode->MaxPacketSize, blksize);
+   tftp_block_size = blksize;
+
+   return tftp_block_size;
 }
 
 
@@ -453,6 +562,428 @@ EFI_STATUS get_pxe_boot_file(EFI_PXE_BASE_CODE *Pxe, CHAR16 **BootFile)
    }
 }
 
+/*-- mtftp4_buffer_grow --------------------------------------------------------
+ *
+ *      Make sure the download buffer can hold at least the given number of
+ *      bytes.  When the server did not tell the file size, the buffer is grown
+ *      geometrically.
+ *
+ * Parameters
+ *      IN xfer: the download state
+ *      IN size: minimum buffer size in bytes
+ *
+ * Results
+ *      EFI_SUCCESS, or EFI_OUT_OF_RESOURCES.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS mtftp4_buffer_grow(tftp_xfer_t *xfer, size_t size)
+{
+   size_t newsize;
+   char *tmp;
+
+   if (size <= xfer->size) {
+      return EFI_SUCCESS;
+   }
+
+   newsize = MAX(size, 2 * xfer->size);
+   tmp = sys_realloc(xfer->buffer, xfer->size, newsize);
+   if (tmp == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+   }
+
+   xfer->buffer = tmp;
+   xfer->size = newsize;
+
+   return EFI_SUCCESS;
+}
+
+/*-- mtftp4_check_packet -------------------------------------------------------
+ *
+ *      MTFTP4 CheckPacket callback.  The option ack gives the file size and the
+ *      negotiated block size; the data blocks are copied into the download
+ *      buffer at the offset implied by their 64-bit block number, so that
+ *      block number wraparound and out-of-order windowed delivery are
+ *      harmless.  The progress callback is called for each new block.
+ *
+ * Parameters
+ *      IN This:      the MTFTP4 instance
+ *      IN Token:     the read token; Context points to the download state
+ *      IN PacketLen: packet length in bytes
+ *      IN Packet:    the received packet
+ *
+ * Results
+ *      EFI_SUCCESS, or an UEFI error status to abort the transfer.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS EFIAPI mtftp4_check_packet(EFI_MTFTP4_PROTOCOL *This,
+                                             EFI_MTFTP4_TOKEN *Token,
+                                             UINT16 PacketLen,
+                                             EFI_MTFTP4_PACKET *Packet)
+{
+   tftp_xfer_t *xfer = Token->Context;
+   EFI_MTFTP4_OPTION *Options;
+   UINT32 i, OptionCount;
+   UINT64 block;
+   size_t offset, len, tsize;
+   EFI_STATUS Status;
+
+   if (PacketLen < sizeof (Packet->OpCode)) {
+      return EFI_SUCCESS;
+   }
+
+   switch (ntohs(Packet->OpCode)) {
+      case EFI_MTFTP4_OPCODE_OACK:
+         Status = This->ParseOptions(This, PacketLen, Packet, &OptionCount,
+                                     &Options);
+         if (EFI_ERROR(Status)) {
+            return EFI_SUCCESS;
+         }
+
+         tsize = 0;
+         for (i = 0; i < OptionCount; i++) {
+            const char *name = (const char *)Options[i].OptionStr;
+            const char *value = (const char *)Options[i].ValueStr;
+
+            Log(LOG_DEBUG, "TFTP option %s=%s", name, value);
+            if (strcasecmp(name, "tsize") == 0) {
+               tsize = strtoul(value, NULL, 10);
+            } else if (strcasecmp(name, "blksize") == 0) {
+               xfer->blksize = strtoul(value, NULL, 10);
+            }
+         }
+         efi_free(Options);
+
+         return mtftp4_buffer_grow(xfer, tsize);
+
+      case EFI_MTFTP4_OPCODE_DATA:
+         if (PacketLen < sizeof (Packet->Data) - 1) {
+            return EFI_SUCCESS;
+         }
+
+         block = xfer->next + (INT16)(ntohs(Packet->Data.Block) -
+                                      (UINT16)xfer->next);
+         if (block == 0) {
+            return EFI_SUCCESS;
+         }
+
+         len = PacketLen - (sizeof (Packet->Data) - 1);
+         offset = (block - 1) * xfer->blksize;
+
+         Status = mtftp4_buffer_grow(xfer, offset + len);
+         if (EFI_ERROR(Status)) {
+            return Status;
+         }
+
+         memcpy(xfer->buffer + offset, Packet->Data.Data, len);
+         xfer->next = MAX(xfer->next, block + 1);
+
+         if (offset + len > xfer->received) {
+            len = offset + len - xfer->received;
+            xfer->received += len;
+            if (xfer->callback != NULL) {
+               xfer->error = xfer->callback(len);
+               if (xfer->error != 0) {
+                  return EFI_ABORTED;
+               }
+            }
+         }
+         return EFI_SUCCESS;
+
+      case EFI_MTFTP4_OPCODE_ERROR:
+         Log(LOG_DEBUG, "TFTP error %u: %.*s", ntohs(Packet->Error.ErrorCode),
+             (int)(PacketLen - (sizeof (Packet->Error) - 1)),
+             Packet->Error.ErrorMessage);
+         return EFI_SUCCESS;
+
+      default:
+         return EFI_SUCCESS;
+   }
+}
+
+/*-- mtftp4_file_load ----------------------------------------------------------
+ *
+ *      Load a file into memory using the MTFTP4 protocol of the boot NIC.
+ *
+ *      Unlike the PXE BC Mtftp() interface, MTFTP4 lets us request the RFC 7440
+ *      windowsize option, and hands us the option ack, so that the file size
+ *      comes with the read itself instead of a separate tsize request.
+ *
+ *      IPv6 is not handled here; MTFTP6 boots keep using PXE BC.
+ *
+ * Parameters
+ *      IN  filepath: the ASCII absolute path of the file to retrieve
+ *      IN  callback: routine to be called as each block is received
+ *      OUT Buffer:   pointer to the allocated file buffer
+ *      OUT BufSize:  file size in bytes
+ *
+ * Results
+ *      EFI_SUCCESS, EFI_UNSUPPORTED if MTFTP4 cannot be used, or an UEFI error
+ *      status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS mtftp4_file_load(const char *filepath,
+                                   int (*callback)(size_t), VOID **Buffer,
+                                   UINTN *BufSize)
+{
+   char blksize[TFTP_OPTION_LEN], windowsize[TFTP_OPTION_LEN];
+   EFI_SERVICE_BINDING_PROTOCOL *ServiceBinding;
+   EFI_MTFTP4_OPTION Options[3];
+   EFI_MTFTP4_CONFIG_DATA Config;
+   EFI_MTFTP4_PROTOCOL *Mtftp4;
+   EFI_MTFTP4_TOKEN Token;
+   EFI_PXE_BASE_CODE *Pxe;
+   EFI_IP_ADDRESS ServerIp;
+   EFI_DEVICE_PATH *DevPath;
+   EFI_HANDLE Volume, Nic, Child;
+   EFI_STATUS Status;
+   tftp_xfer_t xfer;
+
+   if (mtftp4_unavailable) {
+      return EFI_UNSUPPORTED;
+   }
+
+   Status = get_pxe_info(&Pxe, &ServerIp);
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+
+   if (isIPv6) {
+      return EFI_UNSUPPORTED;
+   }
+
+   Status = get_boot_volume(&Volume);
+   if (!EFI_ERROR(Status)) {
+      Status = devpath_get(Volume, &DevPath);
+   }
+   if (!EFI_ERROR(Status)) {
+      Status = bs->LocateDevicePath(&Mtftp4ServiceBindingProto, &DevPath, &Nic);
+   }
+   if (!EFI_ERROR(Status)) {
+      Status = get_protocol_interface(Nic, &Mtftp4ServiceBindingProto,
+                                      (void **)&ServiceBinding);
+   }
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "No MTFTP4 on boot NIC; using PXE BC");
+      mtftp4_unavailable = true;
+      return EFI_UNSUPPORTED;
+   }
+
+   Child = NULL;
+   Status = ServiceBinding->CreateChild(ServiceBinding, &Child);
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error creating MTFTP4 child: %s",
+          error_str[error_efi_to_generic(Status)]);
+      mtftp4_unavailable = true;
+      return EFI_UNSUPPORTED;
+   }
+
+   Status = get_protocol_interface(Child, &Mtftp4Proto, (void **)&Mtftp4);
+   if (!EFI_ERROR(Status)) {
+      memset(&Config, 0, sizeof (Config));
+      Config.UseDefaultSetting = FALSE;
+      Config.StationIp = Pxe->Mode->StationIp.v4;
+      Config.SubnetMask = Pxe->Mode->SubnetMask.v4;
+      if (Pxe->Mode->RouteTableEntries > 0) {
+         Config.GatewayIp = Pxe->Mode->RouteTable[0].GwAddr.v4;
+      }
+      Config.ServerIp = ServerIp.v4;
+      Config.InitialServerPort = TFTP_SERVER_PORT;
+      Config.TryCount = TFTP_TRY_COUNT;
+      Config.TimeoutValue = TFTP_TIMEOUT;
+
+      Status = Mtftp4->Configure(Mtftp4, &Config);
+   }
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "Error configuring MTFTP4: %s",
+          error_str[error_efi_to_generic(Status)]);
+      ServiceBinding->DestroyChild(ServiceBinding, Child);
+      mtftp4_unavailable = true;
+      return EFI_UNSUPPORTED;
+   }
+
+   snprintf(blksize, sizeof (blksize), "%zu", tftp_get_block_size(Volume));
+   snprintf(windowsize, sizeof (windowsize), "%u", TFTP_WINDOWSIZE);
+
+   Options[0].OptionStr = (UINT8 *)"tsize";
+   Options[0].ValueStr = (UINT8 *)"0";
+   Options[1].OptionStr = (UINT8 *)"blksize";
+   Options[1].ValueStr = (UINT8 *)blksize;
+   Options[2].OptionStr = (UINT8 *)"windowsize";
+   Options[2].ValueStr = (UINT8 *)windowsize;
+
+   memset(&Token, 0, sizeof (Token));
+   Token.Filename = (UINT8 *)filepath;
+   Token.OptionCount = ARRAYSIZE(Options) - (mtftp4_no_windowsize ? 1 : 0);
+   Token.OptionList = Options;
+   Token.Context = &xfer;
+   Token.CheckPacket = mtftp4_check_packet;
+
+   efi_set_watchdog_timer(WATCHDOG_DISABLE);
+
+   while (true) {
+      memset(&xfer, 0, sizeof (xfer));
+      xfer.blksize = TFTP_BLKSIZE_MIN;
+      xfer.next = 1;
+      xfer.callback = callback;
+
+      Status = Mtftp4->ReadFile(Mtftp4, &Token);
+      if (!EFI_ERROR(Status)) {
+         /* Empty files still get a (1-byte) buffer */
+         Status = mtftp4_buffer_grow(&xfer, 1);
+      }
+      if (EFI_ERROR(Status)) {
+         sys_free(xfer.buffer);
+         xfer.buffer = NULL;
+      }
+
+      /*
+       * Older MTFTP4 drivers reject the windowsize option, which they do not
+       * know about.  Retry in lock-step mode.
+       */
+      if (Status != EFI_UNSUPPORTED || Token.OptionCount < ARRAYSIZE(Options)) {
+         break;
+      }
+      Log(LOG_DEBUG, "MTFTP4 does not support windowsize");
+      mtftp4_no_windowsize = true;
+      Token.OptionCount--;
+   }
+
+   efi_set_watchdog_timer(WATCHDOG_DEFAULT_TIMEOUT);
+
+   Mtftp4->Configure(Mtftp4, NULL);
+   ServiceBinding->DestroyChild(ServiceBinding, Child);
+
+   if (xfer.error != 0) {
+      return error_generic_to_efi(xfer.error);
+   }
+   if (EFI_ERROR(Status)) {
+      return Status;
+   }
+
+   *Buffer = xfer.buffer;
+   *BufSize = (UINTN)xfer.received;
+
+   return EFI_SUCCESS;
+}
+
+/*-- pxe_callback --------------------------------------------------------------
+ *
+ *      PXE BC Callback Protocol function.  Calls the progress callback for
+ *      each TFTP data block received by Mtftp().
+ *
+ * Parameters
+ *      IN This:      the callback protocol interface, within a pxe_xfer_t
+ *      IN Function:  the PXE BC function in progress
+ *      IN Received:  TRUE if Packet was just received
+ *      IN PacketLen: packet length in bytes
+ *      IN Packet:    the packet, starting at its TFTP header for Mtftp()
+ *
+ * Results
+ *      EFI_PXE_BASE_CODE_CALLBACK_STATUS_CONTINUE, or
+ *      EFI_PXE_BASE_CODE_CALLBACK_STATUS_ABORT if the progress callback
+ *      failed.
+ *----------------------------------------------------------------------------*/
+static EFI_PXE_BASE_CODE_CALLBACK_STATUS EFIAPI
+pxe_callback(EFI_PXE_BASE_CODE_CALLBACK *This,
+             EFI_PXE_BASE_CODE_FUNCTION Function, BOOLEAN Received,
+             UINT32 PacketLen, EFI_PXE_BASE_CODE_PACKET *Packet)
+{
+   pxe_xfer_t *xfer = (pxe_xfer_t *)This;
+   EFI_MTFTP4_PACKET *Tftp = (EFI_MTFTP4_PACKET *)Packet;
+   size_t len;
+
+   if (Function != EFI_PXE_BASE_CODE_FUNCTION_MTFTP || !Received ||
+       Packet == NULL || PacketLen < sizeof (Tftp->Data) - 1 ||
+       ntohs(Tftp->OpCode) != EFI_MTFTP4_OPCODE_DATA) {
+      return EFI_PXE_BASE_CODE_CALLBACK_STATUS_CONTINUE;
+   }
+
+   /* Some firmware also passes retransmitted blocks */
+   if (ntohs(Tftp->Data.Block) == xfer->block) {
+      return EFI_PXE_BASE_CODE_CALLBACK_STATUS_CONTINUE;
+   }
+   xfer->block = ntohs(Tftp->Data.Block);
+
+   len = PacketLen - (sizeof (Tftp->Data) - 1);
+   if (len > 0) {
+      xfer->error = xfer->callback(len);
+      if (xfer->error != 0) {
+         return EFI_PXE_BASE_CODE_CALLBACK_STATUS_ABORT;
+      }
+      xfer->received += len;
+   }
+
+   return EFI_PXE_BASE_CODE_CALLBACK_STATUS_CONTINUE;
+}
+
+/*-- pxe_callback_enable -------------------------------------------------------
+ *
+ *      Install the PXE BC Callback Protocol on the PXE BC handle, and have
+ *      PXE BC call it.  Without callbacks, the whole progress is reported once
+ *      Mtftp() returns.
+ *
+ * Parameters
+ *      IN Pxe:  pointer to the PXE BC interface
+ *      IN xfer: the download progress state
+ *
+ * Results
+ *      True if callbacks are enabled, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool pxe_callback_enable(EFI_PXE_BASE_CODE *Pxe, pxe_xfer_t *xfer)
+{
+   EFI_HANDLE Volume;
+   EFI_STATUS Status;
+   BOOLEAN MakeCallbacks = TRUE;
+
+   if (Pxe->Mode->MakeCallbacks) {
+      return false;     // someone else's callback is in use
+   }
+
+   Status = get_boot_volume(&Volume);
+   if (EFI_ERROR(Status)) {
+      return false;
+   }
+
+   xfer->Interface.Revision = EFI_PXE_BASE_CODE_CALLBACK_PROTOCOL_REVISION;
+   xfer->Interface.Callback = pxe_callback;
+
+   Status = bs->InstallProtocolInterface(&Volume, &PxeCallbackProto,
+                                         EFI_NATIVE_INTERFACE,
+                                         &xfer->Interface);
+   if (EFI_ERROR(Status)) {
+      return false;
+   }
+
+   Status = Pxe->SetParameters(Pxe, NULL, NULL, NULL, NULL, &MakeCallbacks);
+   if (EFI_ERROR(Status)) {
+      Log(LOG_DEBUG, "PXE BC callbacks not supported: %s",
+          error_str[error_efi_to_generic(Status)]);
+      bs->UninstallProtocolInterface(Volume, &PxeCallbackProto,
+                                     &xfer->Interface);
+      return false;
+   }
+
+   return true;
+}
+
+/*-- pxe_callback_disable ------------------------------------------------------
+ *
+ *      Undo pxe_callback_enable().
+ *
+ * Parameters
+ *      IN Pxe:  pointer to the PXE BC interface
+ *      IN xfer: the download progress state
+ *----------------------------------------------------------------------------*/
+static void pxe_callback_disable(EFI_PXE_BASE_CODE *Pxe, pxe_xfer_t *xfer)
+{
+   EFI_HANDLE Volume;
+   BOOLEAN MakeCallbacks = FALSE;
+
+   Pxe->SetParameters(Pxe, NULL, NULL, NULL, NULL, &MakeCallbacks);
+
+   if (!EFI_ERROR(get_boot_volume(&Volume))) {
+      bs->UninstallProtocolInterface(Volume, &PxeCallbackProto,
+                                     &xfer->Interface);
+   }
+}
+
 /*-- tftp_file_get_size --------------------------------------------------------
  *
  *      Get the size of a file using TFTP.
@@ -469,14 +1000,15 @@ EFI_STATUS get_pxe_boot_file(EFI_PXE_BASE_CODE *Pxe, CHAR16 **BootFile)
  * Results
  *      EFI_SUCCESS, or an UEFI error status.
  *----------------------------------------------------------------------------*/
-EFI_STATUS tftp_file_get_size(UNUSED_PARAM(EFI_HANDLE Volume),
-                              const char *filepath, UINTN *FileSize)
+EFI_STATUS tftp_file_get_size(EFI_HANDLE Volume, const char *filepath,
+                              UINTN *FileSize)
 {
    EFI_PXE_BASE_CODE *Pxe;
    EFI_IP_ADDRESS ServerIp;
    /* Some firmware doesn't like a NULL BufferPtr in the call to Mtftp(). */
    UINT8 DummyBuf;
    UINT64 Size = 0;
+   UINTN BlockSize;
    EFI_STATUS Status;
 
    EFI_ASSERT_PARAM(filepath != NULL);
@@ -487,10 +1019,11 @@ EFI_STATUS tftp_file_get_size(UNUSED_PARAM(EFI_HANDLE Volume),
       return Status;
    }
 
+   BlockSize = tftp_get_block_size(Volume);
    efi_set_watchdog_timer(WATCHDOG_DISABLE);
 
    Status = Pxe->Mtftp(Pxe, EFI_PXE_BASE_CODE_TFTP_GET_FILE_SIZE,
-                       &DummyBuf, FALSE, &Size, &tftp_block_size,
+                       &DummyBuf, FALSE, &Size, &BlockSize,
                        &ServerIp, (UINT8 *)filepath, NULL, TRUE);
 
    efi_set_watchdog_timer(WATCHDOG_DEFAULT_TIMEOUT);
@@ -514,6 +1047,11 @@ EFI_STATUS tftp_file_get_size(UNUSED_PARAM(EFI_HANDLE Volume),
  *      during the Mtftp() operation, so it does not trigger and reboot the
  *      platform during large/slow file transfers.
  *
+ *      The MTFTP4 protocol is preferred, as it supports windowed transfers.
+ *      The PXE BC Mtftp() interface is used when MTFTP4 is not available.
+ *      Either way, the progress callback is called as each block arrives,
+ *      when the firmware lets us see the blocks.
+ *
  * Parameters
  *      IN  Volume:   handle to the volume from which to load the file
  *      IN  filepath: the ASCII absolute path of the file to retrieve
@@ -533,15 +1071,22 @@ EFI_STATUS tftp_file_load(EFI_HANDLE Volume, const char *filepath,
    EFI_PXE_BASE_CODE *Pxe;
    EFI_IP_ADDRESS ServerIp;
    VOID *Data;
-   UINTN Size;
+   UINTN Size, BlockSize;
    UINT64 Size64;
    EFI_STATUS Status;
+   pxe_xfer_t xfer;
+   bool callbacks;
    int error;
 
    EFI_ASSERT_PARAM(filepath != NULL);
    EFI_ASSERT_PARAM(Buffer != NULL);
    EFI_ASSERT_PARAM(BufSize != NULL);
 
+   Status = mtftp4_file_load(filepath, callback, Buffer, BufSize);
+   if (Status != EFI_UNSUPPORTED) {
+      return Status;
+   }
+
    Status = tftp_file_get_size(Volume, filepath, &Size);
    if (EFI_ERROR(Status)) {
       return Status;
@@ -557,26 +1102,38 @@ EFI_STATUS tftp_file_load(EFI_HANDLE Volume, const char *filepath,
       return EFI_OUT_OF_RESOURCES;
    }
 
+   memset(&xfer, 0, sizeof (xfer));
+   xfer.callback = callback;
+   callbacks = callback != NULL && pxe_callback_enable(Pxe, &xfer);
+
    Size64 = Size;
+   BlockSize = tftp_get_block_size(Volume);
    efi_set_watchdog_timer(WATCHDOG_DISABLE);
 
    Status = Pxe->Mtftp(Pxe, EFI_PXE_BASE_CODE_TFTP_READ_FILE,
-                       Data, FALSE, &Size64, &tftp_block_size,
+                       Data, FALSE, &Size64, &BlockSize,
                        &ServerIp, (UINT8 *)filepath, NULL, FALSE);
 
   efi_set_watchdog_timer(WATCHDOG_DEFAULT_TIMEOUT);
 
+   if (callbacks) {
+      pxe_callback_disable(Pxe, &xfer);
+   }
+
+   if (xfer.error != 0) {
+      Status = error_generic_to_efi(xfer.error);
+   }
    if (EFI_ERROR(Status)) {
       sys_free(Data);
       return Status;
    }
 
    /*
-    * XXX: Use EFI_PXE_BASE_CODE_CALLBACK to call the progress callback each
-    * time a packet is received.
+    * Report whatever the PXE BC callbacks did not see; that is the whole file
+    * if the firmware does not make callbacks.
     */
-   if (callback != NULL) {
-      error = callback((size_t)Size64);
+   if (callback != NULL && xfer.received < Size64) {
+      error = callback((size_t)Size64 - xfer.received);
       if (error != 0) {
          sys_free(Data);
          return error_generic_to_efi(error);
@@ -21,8 +21,26 @@ typedef struct tpm_event {
    uint32_t eventType;
    const uint8_t *eventData;
    uint64_t eventDataSize;
+   const tpm_digests_t *digests;  // Digests of data, or NULL
+   bool persistent;  // data stays valid until the event is submitted
+   bool required;    // Failing to extend the event must fail the boot
 } tpm_event_t;
 
+typedef struct tpm_pending_event {
+   struct tpm_pending_event *next;
+   tpm_event_t event;
+   tpm_digests_t digests;
+   TCG_PCClientTaggedEvent *tEvent;
+   uint32_t tEventSize;
+   uint8_t buffer[];  // Tagged event, followed by a copy of the data
+} tpm_pending_event_t;
+
+typedef struct tpm_bank {
+   EFI_TCG2_EVENT_ALGORITHM_BITMAP bootHashAlg;
+   TPMI_ALG_HASH hashAlg;
+   uint16_t digestSize;
+} tpm_bank_t;
+
 typedef struct system_module {
    const char *name;
    uint32_t pcrIndex;
@@ -70,8 +88,38 @@ static system_module_t systemModules [] = {
    { NULL, 0, 0, false, false }
 };
 
+/*
+ * PCR banks that can be extended with digests computed by the boot loader,
+ * indexed by tpm_hash_alg_t.
+ */
+static const tpm_bank_t tpmBanks[TPM_HASH_COUNT] = {
+   { EFI_TCG2_BOOT_HASH_ALG_SHA1,   TPM_ALG_SHA1,   SHA1_DIGEST_SIZE   },
+   { EFI_TCG2_BOOT_HASH_ALG_SHA256, TPM_ALG_SHA256, SHA256_DIGEST_SIZE },
+   { EFI_TCG2_BOOT_HASH_ALG_SHA384, TPM_ALG_SHA384, SHA384_DIGEST_SIZE },
+   { EFI_TCG2_BOOT_HASH_ALG_SHA512, TPM_ALG_SHA512, SHA512_DIGEST_SIZE },
+};
+
 static bool useTpm = false;
 
+/*
+ * When a hash provider is set, measurements are hashed by the boot loader
+ * and extended with TPM2_PCR_Extend, and their events are logged in
+ * eventLog instead of the firmware event log.
+ */
+static tpm_hash_provider_t hashProvider = NULL;
+static uint32_t activeAlgs = 0;      // (1 << tpm_hash_alg_t) bitmap
+static uint8_t *eventLog = NULL;     // TCG_PCR_EVENT2 records
+static uint32_t eventLogSize = 0;
+static uint8_t *fullEventLog = NULL; // Firmware event log + eventLog
+
+/*
+ * Events that have been measured, but not submitted to the TPM yet, in
+ * submission order.
+ */
+static tpm_pending_event_t *pendingEvents = NULL;
+static tpm_pending_event_t **pendingTail = &pendingEvents;
+static int pendingError = ERR_SUCCESS;
+
 
 /*-- tpm_get_event_log --------------------------------------------------------
  *
@@ -82,6 +130,10 @@ static bool useTpm = false;
  *      See TCG EFI Protocol Specification, Family “2.0”, Level 00
  *      Revision 00.13, March 30, 2016, Section 5: Event Log Structure
  *
+ *      Events that were measured with precomputed digests are not in
+ *      the firmware log. They are appended to a copy of it, which stays
+ *      valid until the next call.
+ *
  * Parameters
  *      IN log:  The TPM event log details.
  *
@@ -99,6 +151,9 @@ int tpm_get_event_log(tpm_event_log_t *log)
       return ERR_NOT_FOUND;
    }
 
+   // Normally a no-op: the caller flushes the queue and checks for errors.
+   tpm_flush();
+
    status = tcg2_get_event_log(&address, &size, &truncated);
    if (status != EFI_SUCCESS) {
       int error = error_efi_to_generic(status);
@@ -106,6 +161,23 @@ int tpm_get_event_log(tpm_event_log_t *log)
       return error;
    }
 
+   if (eventLogSize > 0) {
+      if (size > UINT32_MAX - eventLogSize) {
+         return ERR_BUFFER_TOO_SMALL;
+      }
+
+      sys_free(fullEventLog);
+      fullEventLog = sys_malloc(size + eventLogSize);
+      if (fullEventLog == NULL) {
+         return ERR_OUT_OF_RESOURCES;
+      }
+
+      memcpy(fullEventLog, address, size);
+      memcpy(fullEventLog + size, eventLog, eventLogSize);
+      address = fullEventLog;
+      size += eventLogSize;
+   }
+
    log->address = address;
    log->size = size;
    log->truncated = truncated;
@@ -114,11 +186,176 @@ int tpm_get_event_log(tpm_event_log_t *log)
    return ERR_SUCCESS;
 }
 
+/*-- tpm_log_event -------------------------------------------------------------
+ *
+ *      Append a TCG_PCR_EVENT2 record to the boot loader event log.
+ *
+ * Parameters
+ *      IN pcrIndex:       Index of the PCR that was extended.
+ *      IN eventType:      Identifier of the type of event.
+ *      IN digests:        The digests the PCR was extended with.
+ *      IN eventData:      Data included in the event log.
+ *      IN eventDataSize:  Size in bytes of eventData.
+ *
+ * Results
+ *      EFI_SUCCESS, or an error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS tpm_log_event(uint32_t pcrIndex,
+                                uint32_t eventType,
+                                const TPML_DIGEST_VALUES *digests,
+                                const uint8_t *eventData,
+                                uint32_t eventDataSize)
+{
+   uint64_t recordSize;
+   uint8_t *record;
+   uint8_t *next;
+   uint32_t i;
+
+   recordSize = sizeof(pcrIndex) + sizeof(eventType) +
+                sizeof(digests->count) + sizeof(eventDataSize) + eventDataSize;
+   for (i = 0; i < digests->count; i++) {
+      recordSize += sizeof(digests->digests[i].hashAlg) +
+                    tcg2_get_digest_size(&digests->digests[i]);
+   }
+   if (recordSize > UINT32_MAX - eventLogSize) {
+      return EFI_OUT_OF_RESOURCES;
+   }
+
+   record = sys_realloc(eventLog, eventLogSize, eventLogSize + recordSize);
+   if (record == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+   }
+   eventLog = record;
+   next = record + eventLogSize;
+
+   // The TCG_PCR_EVENT2 structure is packed, with variable-size digests.
+   memcpy(next, &pcrIndex, sizeof(pcrIndex));
+   next += sizeof(pcrIndex);
+   memcpy(next, &eventType, sizeof(eventType));
+   next += sizeof(eventType);
+   memcpy(next, &digests->count, sizeof(digests->count));
+   next += sizeof(digests->count);
+   for (i = 0; i < digests->count; i++) {
+      const TPMT_HA *digest = &digests->digests[i];
+      uint32_t digestSize = tcg2_get_digest_size(digest);
+
+      memcpy(next, &digest->hashAlg, sizeof(digest->hashAlg));
+      next += sizeof(digest->hashAlg);
+      memcpy(next, &digest->digest, digestSize);
+      next += digestSize;
+   }
+   memcpy(next, &eventDataSize, sizeof(eventDataSize));
+   next += sizeof(eventDataSize);
+   memcpy(next, eventData, eventDataSize);
+
+   eventLogSize += recordSize;
+   return EFI_SUCCESS;
+}
+
+/*-- tpm_log_extend_digests ----------------------------------------------------
+ *
+ *      Extend the TPM with the digests of an event, and log it. This is
+ *      the equivalent of tcg2_log_extend_event, but the hashing has been
+ *      done by the boot loader hash provider, and the event is logged in
+ *      the boot loader event log.
+ *
+ * Parameters
+ *      IN event:          The event to be extended, with its digests.
+ *      IN eventType:      Identifier of the type of event.
+ *      IN eventData:      Data included in the event log.
+ *      IN eventDataSize:  Size in bytes of eventData.
+ *
+ * Results
+ *      EFI_SUCCESS, or an error status.
+ *----------------------------------------------------------------------------*/
+static EFI_STATUS tpm_log_extend_digests(const tpm_event_t *event,
+                                         uint32_t eventType,
+                                         const uint8_t *eventData,
+                                         uint32_t eventDataSize)
+{
+   const tpm_digests_t *digests = event->digests;
+   TPML_DIGEST_VALUES values;
+   EFI_STATUS status;
+   unsigned int i;
+
+   EFI_ASSERT(digests != NULL && (digests->algs & activeAlgs) == activeAlgs);
+
+   memset(&values, 0, sizeof values);
+   for (i = 0; i < TPM_HASH_COUNT; i++) {
+      if ((activeAlgs & (1 << i)) != 0) {
+         TPMT_HA *digest = &values.digests[values.count++];
+
+         digest->hashAlg = tpmBanks[i].hashAlg;
+         memcpy(&digest->digest, digests->digest[i], tpmBanks[i].digestSize);
+      }
+   }
+
+   status = tpm2_pcr_extend(event->pcrIndex, &values);
+   if (status != EFI_SUCCESS) {
+      return status;
+   }
+
+   return tpm_log_event(event->pcrIndex, eventType, &values, eventData,
+                        eventDataSize);
+}
+
+/*-- tpm_submit_event ----------------------------------------------------------
+ *
+ *      Extend the TPM with a queued tagged event. This function will both
+ *      extend the event data into the specified TPM PCR and also add an
+ *      entry into the event log.
+ *
+ * Parameters
+ *      IN pending: The queued event.
+ *
+ * Results
+ *      ERR_SUCCESS, or an error status.
+ *----------------------------------------------------------------------------*/
+static int tpm_submit_event(const tpm_pending_event_t *pending)
+{
+   const tpm_event_t *event = &pending->event;
+   EFI_STATUS status;
+
+   /*
+    * The spec referenced in tpm_extend_tagged_event states that "Tagged
+    * Event Data MUST be measured and logged using the TCG_PCR_EVENT2
+    * structure". Note that tcg2_log_extend_event only logs when the
+    * EFI_TCG2_EVENT_LOG_FORMAT_TCG_2 format is in use, but we don't know
+    * if the older TCG_1_2 is also in use. That should be OK because we
+    * never use the older log format anyway.
+    */
+
+   if (hashProvider != NULL) {
+      status = tpm_log_extend_digests(event, EV_EVENT_TAG,
+                                      (uint8_t *)pending->tEvent,
+                                      pending->tEventSize);
+   } else {
+      status = tcg2_log_extend_event(event->pcrIndex, event->data,
+                                     event->dataSize, EV_EVENT_TAG,
+                                     (uint8_t *)pending->tEvent,
+                                     pending->tEventSize);
+   }
+   if (status != EFI_SUCCESS) {
+      int error = error_efi_to_generic(status);
+      Log(event->required ? LOG_ERR : LOG_WARNING,
+          "TPM log extend failed for ID %u: %s", event->eventType,
+          error_str[error]);
+      return error;
+   }
+
+   return ERR_SUCCESS;
+}
+
 /*-- tpm_extend_tagged_event ---------------------------------------------------
  *
- *      Extend the TPM with a tagged event. This function will both
- *      extend the event data into the specified TPM PCR and also add
- *      an entry into the event log.
+ *      Extend the TPM with a tagged event.
+ *
+ *      TPM commands take milliseconds each, so the event is only queued
+ *      here: it is submitted later on by tpm_poll or tpm_flush, in the
+ *      order of the calls to this function. When the boot loader does
+ *      the hashing, the digests are computed right away, and the event
+ *      data does not need to be kept. Otherwise, the data is copied
+ *      unless event->persistent is set.
  *
  *      See TCG PC Client Platform Firmware Profile Specification,
  *      Family “2.0”, Level 00 Revision 1.04, June 3, 2019, Section
@@ -132,46 +369,68 @@ int tpm_get_event_log(tpm_event_log_t *log)
  *----------------------------------------------------------------------------*/
 static int tpm_extend_tagged_event(const tpm_event_t *event)
 {
+   tpm_pending_event_t *pending;
    TCG_PCClientTaggedEvent *tEvent;
    uint32_t tEventHeaderSize;
    uint32_t tEventSize;
    uint8_t *tEventData;
-   EFI_STATUS status;
+   uint64_t dataCopySize;
+   tpm_event_t *queued;
 
    EFI_ASSERT(useTpm);
 
    tEventHeaderSize = sizeof(tEvent->taggedEventID) +
                       sizeof(tEvent->taggedEventDataSize);
    tEventSize = tEventHeaderSize + event->eventDataSize;
-   tEvent = sys_malloc(tEventSize);
-   if (tEvent == NULL) {
+
+   dataCopySize = 0;
+   if (hashProvider == NULL && !event->persistent) {
+      dataCopySize = event->dataSize;
+   }
+
+   pending = sys_malloc(sizeof *pending + tEventSize + dataCopySize);
+   if (pending == NULL) {
       return ERR_OUT_OF_RESOURCES;
    }
-   tEventData = (uint8_t *)(UINTN)tEvent + tEventHeaderSize;
+
+   tEvent = (TCG_PCClientTaggedEvent *)pending->buffer;
+   tEventData = pending->buffer + tEventHeaderSize;
 
    tEvent->taggedEventID = event->eventType;
    tEvent->taggedEventDataSize = event->eventDataSize;
    memcpy(tEventData, event->eventData, event->eventDataSize);
 
-   /*
-    * The spec referenced above states that "Tagged Event Data MUST be
-    * measured and logged using the TCG_PCR_EVENT2 structure". Note that
-    * tcg2_log_extend_event only logs when the EFI_TCG2_EVENT_LOG_FORMAT_TCG_2
-    * format is in use, but we don't know if the older TCG_1_2 is also in
-    * use. That should be OK because we never use the older  log format
-    * anyway.
-    */
-
-   status = tcg2_log_extend_event(event->pcrIndex, event->data, event->dataSize,
-                                  EV_EVENT_TAG, (uint8_t *)tEvent, tEventSize);
-   sys_free(tEvent);
-   if (status != EFI_SUCCESS) {
-      int error = error_efi_to_generic(status);
-      Log(LOG_ERR, "TPM log extend failed for ID %u: %s", event->eventType,
-          error_str[error]);
-      return error;
+   pending->next = NULL;
+   pending->tEvent = tEvent;
+   pending->tEventSize = tEventSize;
+   queued = &pending->event;
+   *queued = *event;
+   queued->eventData = tEventData;
+
+   if (hashProvider != NULL) {
+      if (event->digests != NULL &&
+          (event->digests->algs & activeAlgs) == activeAlgs) {
+         pending->digests = *event->digests;
+      } else {
+         int error = hashProvider(activeAlgs, event->data, event->dataSize,
+                                  &pending->digests);
+         if (error != ERR_SUCCESS) {
+            Log(LOG_ERR, "TPM event hashing failed for ID %u: %s",
+                event->eventType, error_str[error]);
+            sys_free(pending);
+            return error;
+         }
+      }
+      queued->data = NULL;
+      queued->digests = &pending->digests;
+   } else if (dataCopySize > 0) {
+      memcpy(pending->buffer + tEventSize, event->data, dataCopySize);
+      queued->data = pending->buffer + tEventSize;
    }
 
+   *pendingTail = pending;
+   pendingTail = &pending->next;
+
    return ERR_SUCCESS;
 }
 
@@ -307,6 +566,9 @@ static int tpm_extend_version(const char *filename,
    event.eventType = TPM_VMK_EVENT_VERSION;
    event.eventData = eventData;
    event.eventDataSize = eventDataSize;
+   event.digests = NULL;
+   event.persistent = false;
+   event.required = false;
 
    /*
     * We don't validate the record offsets and lengths. These will need
@@ -331,17 +593,26 @@ static int tpm_extend_version(const char *filename,
  *
  *      Extend the TPM with a loaded module.
  *
+ *      When the boot loader computes the measurement digests, they are
+ *      kept in the optional digests cache. A module that is measured
+ *      again with the same cache (e.g. a duplicate module sharing the
+ *      same image) is then not hashed again.
+ *
+ *      The module must stay in memory until tpm_flush is called.
+ *
  * Parameters
  *      IN filename: The name of the module.
  *      IN addr: The address of the module.
  *      IN size: The size of the module in memory.
+ *      IN/OUT digests: Digests of the module contents, or NULL.
  *
  * Results
  *      ERR_SUCCESS, or an error status.
  *----------------------------------------------------------------------------*/
 int tpm_extend_module(const char *filename,
                       const void *addr,
-                      size_t size)
+                      size_t size,
+                      tpm_digests_t *digests)
 {
    static const uint8_t zeroByte = 0;
 
@@ -441,12 +712,24 @@ int tpm_extend_module(const char *filename,
    }
 
  done:
+   if (hashProvider == NULL) {
+      digests = NULL;
+   } else if (digests != NULL && (digests->algs & activeAlgs) != activeAlgs) {
+      int error = hashProvider(activeAlgs, addr, size, digests);
+      if (error != ERR_SUCCESS) {
+         return error;
+      }
+   }
+
    event.pcrIndex = pcrIndex;
    event.data = (uint8_t *)addr;
    event.dataSize = (uint32_t)size;
    event.eventType = eventType;
    event.eventData = (uint8_t *)basename;
    event.eventDataSize = strlen(basename) + 1;
+   event.digests = digests;
+   event.persistent = true;
+   event.required = true;
 
    return tpm_extend_tagged_event(&event);
 }
@@ -478,6 +761,9 @@ int tpm_extend_signer(const unsigned char *certData,
    event.eventType = TPM_VMK_EVENT_SIGNER;
    event.eventData = (uint8_t *)certData;
    event.eventDataSize = certLength;
+   event.digests = NULL;
+   event.persistent = false;
+   event.required = true;
 
    return tpm_extend_tagged_event(&event);
 }
@@ -527,6 +813,9 @@ int tpm_extend_cmdline(const char *filename,
    event.eventType = TPM_VMK_EVENT_CMD_OPT;
    event.eventData = (uint8_t *)cmdline;
    event.eventDataSize = strlen(cmdline);
+   event.digests = NULL;
+   event.persistent = false;
+   event.required = false;
 
    result = tpm_extend_tagged_event(&event);
 
@@ -588,10 +877,133 @@ int tpm_extend_asset_tag(void)
    event.eventType = TPM_VMK_EVENT_TAG;
    event.eventData = tag;
    event.eventDataSize = tagSize;
+   event.digests = NULL;
+   event.persistent = false;
+   event.required = false;
 
    return tpm_extend_tagged_event(&event);
 }
 
+/*-- tpm_poll ------------------------------------------------------------------
+ *
+ *      Submit the oldest queued event to the TPM, if any. This is meant
+ *      to be called between module loads, while background transfers go
+ *      on, so that the TPM commands overlap with them. It must not be
+ *      called from a network receive path or wait loop: a firmware-hashed
+ *      event can take seconds.
+ *
+ * Results
+ *      True if an event was submitted, false if the queue was empty.
+ *----------------------------------------------------------------------------*/
+bool tpm_poll(void)
+{
+   tpm_pending_event_t *pending = pendingEvents;
+   int error;
+
+   if (pending == NULL) {
+      return false;
+   }
+
+   pendingEvents = pending->next;
+   if (pendingEvents == NULL) {
+      pendingTail = &pendingEvents;
+   }
+
+   error = tpm_submit_event(pending);
+   if (error != ERR_SUCCESS && pending->event.required &&
+       pendingError == ERR_SUCCESS) {
+      pendingError = error;
+   }
+
+   sys_free(pending);
+   return true;
+}
+
+/*-- tpm_flush -----------------------------------------------------------------
+ *
+ *      Submit all the queued events to the TPM. This must be done before
+ *      the TPM event log is captured, and before any measured data is
+ *      freed.
+ *
+ *      A failed required event leaves a PCR without one of its extends, which
+ *      cannot be undone, so its error is kept and returned by every later
+ *      call as well.
+ *
+ * Results
+ *      ERR_SUCCESS, or the error status of the first required event that
+ *      failed.
+ *----------------------------------------------------------------------------*/
+int tpm_flush(void)
+{
+   while (tpm_poll()) {
+      ;
+   }
+
+   return pendingError;
+}
+
+/*-- tpm_set_hash_provider -----------------------------------------------------
+ *
+ *      Let the boot loader compute the digests of the TPM measurements.
+ *
+ *      The firmware HashLogExtendEvent service can be very slow at
+ *      hashing large modules. With a hash provider, the digests are
+ *      computed by the boot loader, extended directly into the PCRs
+ *      with TPM2_PCR_Extend, and the matching events are appended to
+ *      the event log returned by tpm_get_event_log.
+ *
+ *      This is only possible if the hash provider implements the
+ *      algorithm of every active PCR bank. Otherwise, measurements keep
+ *      on being hashed by the firmware.
+ *
+ *      Must be called before anything is measured.
+ *
+ * Parameters
+ *      IN hash: The hash provider, or NULL to let the firmware hash.
+ *----------------------------------------------------------------------------*/
+void tpm_set_hash_provider(tpm_hash_provider_t hash)
+{
+   static const uint8_t emptyData = 0;
+   tpm_digests_t digests;
+   uint32_t banks;
+   uint32_t algs;
+   unsigned int i;
+
+   EFI_ASSERT(eventLogSize == 0 && pendingEvents == NULL);
+
+   hashProvider = NULL;
+   activeAlgs = 0;
+
+   if (!useTpm || hash == NULL) {
+      return;
+   }
+
+   banks = tcg2_get_active_banks();
+   algs = 0;
+   for (i = 0; i < TPM_HASH_COUNT; i++) {
+      if ((banks & tpmBanks[i].bootHashAlg) != 0) {
+         banks &= ~tpmBanks[i].bootHashAlg;
+         algs |= 1 << i;
+      }
+   }
+
+   if (banks != 0) {
+      Log(LOG_DEBUG, "Unsupported TPM PCR banks %#x, firmware hashing used",
+          banks);
+      return;
+   }
+
+   if (hash(algs, &emptyData, 0, &digests) != ERR_SUCCESS) {
+      Log(LOG_DEBUG, "TPM PCR banks %#x not hashable, firmware hashing used",
+          tcg2_get_active_banks());
+      return;
+   }
+
+   hashProvider = hash;
+   activeAlgs = algs;
+   Log(LOG_DEBUG, "TPM measurements hashed by the boot loader");
+}
+
 /*-- tpm_init ------------------------------------------------------------------
  *
  *      Initialize TPM services.
@@ -20,6 +20,20 @@
  * Level 00 Revision 01.38, September 29, 2016.
  */
 
+// Section 22.2: TPM2_PCR_Extend
+
+typedef struct {
+   TPM2_COMMAND_HEADER hdr;
+   TPMI_DH_PCR pcrHandle;
+   UINT32 authSize;
+   TPMS_AUTH_COMMAND auth;
+   TPML_DIGEST_VALUES digests;
+} TPM2_PCR_EXTEND_COMMAND;
+
+typedef struct {
+   TPM2_RESPONSE_HEADER hdr;
+} TPM2_PCR_EXTEND_RESPONSE;
+
 // 31.6 TPM2_NV_ReadPublic
 
 typedef struct {
@@ -61,6 +75,14 @@ uint32_t tpm2_marshal_nv_readpublic(const TPM2_NV_READPUBLIC_COMMAND *nvRead,
 uint32_t tpm2_unmarshal_nv_readpublic(const uint8_t *buffer, uint32_t size,
                                       TPM2_NV_READPUBLIC_RESPONSE *nvRead);
 
+uint32_t tpm2_marshal_pcr_extend(const TPM2_PCR_EXTEND_COMMAND *pcrExtend,
+                                 uint8_t *buffer, uint32_t size);
+uint32_t tpm2_unmarshal_pcr_extend(const uint8_t *buffer, uint32_t size,
+                                   TPM2_PCR_EXTEND_RESPONSE *pcrExtend);
+
+EFI_STATUS tpm2_pcr_extend(uint32_t pcrIndex,
+                           const TPML_DIGEST_VALUES *digests);
+
 EFI_STATUS tpm2_nv_read(uint32_t index, uint16_t size, uint8_t *buffer);
 EFI_STATUS tpm2_nv_read_size(uint32_t index, uint16_t *size);
 
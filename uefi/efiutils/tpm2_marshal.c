@@ -456,6 +456,131 @@ static bool marshal_TPMS_AUTH_COMMAND(uint8_t *buffer,
    return marshal_UINT32(buffer, size, &authSizeNext, authSize);
 }
 
+/*-- marshal_TPMT_HA -----------------------------------------------------------
+ *
+ *      Marshal a TPMT_HA object.
+ *
+ *      Only the bytes of the digest that are used by the hash algorithm
+ *      are marshalled, not the whole TPMU_HA union.
+ *
+ * Parameters
+ *      IN buffer:    The command buffer start.
+ *      IN size:      The command buffer total size.
+ *      IN/OUT next:  The next used location in the command buffer.
+ *      IN digest:    The TPMT_HA to add at next.
+ *
+ * Results
+ *      True on success, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool marshal_TPMT_HA(uint8_t *buffer,
+                            uint32_t size,
+                            uint8_t **next,
+                            const TPMT_HA *digest)
+{
+   uint32_t digestSize = tcg2_get_digest_size(digest);
+
+   if (digestSize == 0 ||
+       !marshal_UINT16(buffer, size, next, digest->hashAlg)) {
+      return false;
+   }
+
+   CHECK_OVERFLOW(buffer, size, *next, digestSize);
+
+   memcpy(*next, &digest->digest, digestSize);
+   *next += digestSize;
+   return true;
+}
+
+/*-- marshal_TPML_DIGEST_VALUES ------------------------------------------------
+ *
+ *      Marshal a TPML_DIGEST_VALUES object.
+ *
+ * Parameters
+ *      IN buffer:    The command buffer start.
+ *      IN size:      The command buffer total size.
+ *      IN/OUT next:  The next used location in the command buffer.
+ *      IN digests:   The TPML_DIGEST_VALUES to add at next.
+ *
+ * Results
+ *      True on success, false otherwise.
+ *----------------------------------------------------------------------------*/
+static bool marshal_TPML_DIGEST_VALUES(uint8_t *buffer,
+                                       uint32_t size,
+                                       uint8_t **next,
+                                       const TPML_DIGEST_VALUES *digests)
+{
+   uint32_t i;
+
+   if (digests->count > ARRAYSIZE(digests->digests) ||
+       !marshal_UINT32(buffer, size, next, digests->count)) {
+      return false;
+   }
+
+   for (i = 0; i < digests->count; i++) {
+      if (!marshal_TPMT_HA(buffer, size, next, &digests->digests[i])) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/*-- tpm2_marshal_pcr_extend ---------------------------------------------------
+ *
+ *      Marshal the PCR extend command.
+ *
+ * Parameters
+ *      IN pcrExtend:  The extend command.
+ *      OUT buffer:    The command buffer start.
+ *      IN size:       The command buffer total size.
+ *
+ * Results
+ *      The size of the marshalled data, or 0 on failure.
+ *----------------------------------------------------------------------------*/
+uint32_t tpm2_marshal_pcr_extend(const TPM2_PCR_EXTEND_COMMAND *pcrExtend,
+                                 uint8_t *buffer,
+                                 uint32_t size)
+{
+   bool result;
+   uint8_t *next = buffer;
+
+   result = marshal_TPM2_COMMAND_HEADER(buffer, size, &next,
+                                        &pcrExtend->hdr) &&
+            marshal_UINT32(buffer, size, &next, pcrExtend->pcrHandle) &&
+            marshal_TPMS_AUTH_COMMAND(buffer, size, &next, &pcrExtend->auth) &&
+            marshal_TPML_DIGEST_VALUES(buffer, size, &next,
+                                       &pcrExtend->digests) &&
+            marshal_TPM2_COMMAND_HEADER_done(buffer, size, next);
+   return result ? next - buffer : 0;
+}
+
+/*-- tpm2_unmarshal_pcr_extend -------------------------------------------------
+ *
+ *      Unmarshal the PCR extend response.
+ *
+ *      The response has no parameters. Only the header is returned, the
+ *      session data that may follow it is ignored.
+ *
+ * Parameters
+ *      IN buffer:      The command buffer start.
+ *      IN size:        The command buffer total size.
+ *      OUT pcrExtend:  The extend response.
+ *
+ * Results
+ *      The size of the unmarshalled data, or 0 on failure.
+ *----------------------------------------------------------------------------*/
+uint32_t tpm2_unmarshal_pcr_extend(const uint8_t *buffer,
+                                   uint32_t size,
+                                   TPM2_PCR_EXTEND_RESPONSE *pcrExtend)
+{
+   bool result;
+   const uint8_t *next = buffer;
+
+   result = unmarshal_TPM2_RESPONSE_HEADER(buffer, size, &next,
+                                           &pcrExtend->hdr);
+   return result ? next - buffer : 0;
+}
+
 /*-- tpm2_marshal_nv_read ------------------------------------------------------
  *
  *      Marshal the NV read command.
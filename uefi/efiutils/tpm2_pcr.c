@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Copyright (c) 2026 VMware, Inc.  All rights reserved.
+ * SPDX-License-Identifier: GPL-2.0
+ ******************************************************************************/
+
+/*
+ * tpm2_pcr.c -- TPM 2 PCR access.
+ */
+
+#include "efi_private.h"
+#include "tpm2_int.h"
+
+/*
+ * See Trusted Platform Module Library Part 3: Commands, Family "2.0",
+ * Level 00 Revision 01.38, September 29, 2016, Section 4.4 Return Code
+ * Alias
+ */
+#define RC_PCR_Extend_pcrHandle     (TPM_RC_H + TPM_RC_1)
+
+
+/*-- tpm2_pcr_extend -----------------------------------------------------------
+ *
+ *      Extend a PCR with precomputed digests.
+ *
+ *      Unlike tcg2_log_extend_event, nothing is hashed by the firmware
+ *      and no event is logged: the caller provides one digest for each
+ *      active PCR bank, and is responsible for logging the event.
+ *
+ *      See Trusted Platform Module Library Part 3: Commands, Family
+ *      "2.0", Level 00 Revision 01.38, September 29, 2016, 22.2
+ *      TPM2_PCR_Extend
+ *
+ * Parameters
+ *      IN pcrIndex:  The PCR to extend.
+ *      IN digests:   The digests to extend the PCR with.
+ *
+ * Results
+ *      EFI_SUCCESS, or an error status.
+ *----------------------------------------------------------------------------*/
+EFI_STATUS tpm2_pcr_extend(uint32_t pcrIndex,
+                           const TPML_DIGEST_VALUES *digests)
+{
+   TPM2_PCR_EXTEND_COMMAND in = {};
+   TPM2_PCR_EXTEND_RESPONSE out = {};
+   uint8_t data[MAX(sizeof in, sizeof out)] = {};
+   uint32_t dataSize;
+   EFI_STATUS status;
+
+   in.hdr.tag = TPM_ST_SESSIONS;
+   in.hdr.commandCode = TPM_CC_PCR_Extend;
+   in.pcrHandle = pcrIndex;
+   in.auth.sessionHandle = TPM_RS_PW;
+   memcpy(&in.digests, digests, sizeof in.digests);
+
+   dataSize = tpm2_marshal_pcr_extend(&in, data, sizeof data);
+   if (dataSize == 0) {
+      return EFI_BUFFER_TOO_SMALL;
+   }
+
+   status = tcg2_submit_command(data, dataSize, data, sizeof data);
+   if (status != EFI_SUCCESS) {
+      return status;
+   }
+
+   dataSize = tpm2_unmarshal_pcr_extend(data, sizeof data, &out);
+   if (dataSize == 0) {
+      return EFI_BUFFER_TOO_SMALL;
+   }
+
+   if (out.hdr.responseCode != TPM_RC_SUCCESS) {
+      switch (out.hdr.responseCode) {
+      case TPM_RC_VALUE + RC_PCR_Extend_pcrHandle:
+         return EFI_INVALID_PARAMETER;
+      case TPM_RC_LOCALITY:
+         return EFI_ACCESS_DENIED;
+      default:
+         Log(LOG_ERR, "TPM PCR extend failure: %x", out.hdr.responseCode);
+         return EFI_DEVICE_ERROR;
+      }
+   }
+
+   return EFI_SUCCESS;
+}
@@ -28,6 +28,18 @@
 #include <libgen.h>
 #include "efi_private.h"
 
+/*
+ * The partition driver installs this GUID, with no interface, on the handle
+ * of every EFI System Partition.
+ */
+#ifndef EFI_PART_TYPE_EFI_SYSTEM_PART_GUID
+#define EFI_PART_TYPE_EFI_SYSTEM_PART_GUID \
+   { 0xc12a7328, 0xf81f, 0x11d2, \
+     { 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b } }
+#endif
+
+static EFI_GUID EspPartTypeGuid = EFI_PART_TYPE_EFI_SYSTEM_PART_GUID;
+
 /*-- get_boot_file ------------------------------------------------------------
  *
  *      Get the pathname of the boot file.
@@ -192,6 +204,85 @@ EFI_STATUS get_boot_volume(EFI_HANDLE *Volume)
    return EFI_SUCCESS;
 }
 
+/*-- get_local_volume ----------------------------------------------------------
+ *
+ *      Get a handle to a local file system volume, for data that must persist
+ *      across network boots.  This is the first EFI System Partition, as
+ *      tagged by the firmware partition driver, that has a file system the
+ *      firmware can access.  Other FAT partitions (such as ESXi bootbanks)
+ *      are never used.  Ramdisks and volumes behind a network device are
+ *      skipped.
+ *
+ * Parameters
+ *      OUT Volume: the local volume handle
+ *
+ * Results
+ *      EFI_SUCCESS, or an UEFI error status (EFI_NO_MEDIA if there is no
+ *      usable EFI System Partition).
+ *----------------------------------------------------------------------------*/
+EFI_STATUS get_local_volume(EFI_HANDLE *Volume)
+{
+   static EFI_HANDLE LocalVolume = NULL;
+   EFI_DEVICE_PATH *node, *DevPath;
+   EFI_HANDLE *Handles;
+   EFI_STATUS Status;
+   UINTN i, Count;
+   void *Fs;
+   bool disk, remote;
+
+   if (LocalVolume == NULL) {
+      Status = LocateHandleByProtocol(&EspPartTypeGuid, &Count, &Handles);
+      if (Status == EFI_NOT_FOUND) {
+         return EFI_NO_MEDIA;
+      } else if (EFI_ERROR(Status)) {
+         return Status;
+      }
+
+      for (i = 0; i < Count && LocalVolume == NULL; i++) {
+         Status = get_protocol_interface(Handles[i], &SimpleFileSystemProto,
+                                         &Fs);
+         if (EFI_ERROR(Status)) {
+            continue;
+         }
+
+         Status = devpath_get(Handles[i], &DevPath);
+         if (EFI_ERROR(Status)) {
+            continue;
+         }
+
+         disk = false;
+         remote = false;
+         FOREACH_DEVPATH_NODE(DevPath, node) {
+            if (node->Type == MEDIA_DEVICE_PATH) {
+               if (node->SubType == MEDIA_HARDDRIVE_DP) {
+                  disk = true;
+               } else if (node->SubType == MEDIA_RAM_DISK_DP) {
+                  remote = true;
+               }
+            } else if (node->Type == MESSAGING_DEVICE_PATH &&
+                       node->SubType == MSG_MAC_ADDR_DP) {
+               remote = true;
+            }
+         }
+
+         if (disk && !remote) {
+            LocalVolume = Handles[i];
+            log_devpath(LOG_DEBUG, "local volume", DevPath);
+         }
+      }
+
+      sys_free(Handles);
+
+      if (LocalVolume == NULL) {
+         return EFI_NO_MEDIA;
+      }
+   }
+
+   *Volume = LocalVolume;
+
+   return EFI_SUCCESS;
+}
+
 /*-- get_boot_device -----------------------------------------------------------
  *
  *      Get a handle for the hardware device or virtual hardware device (hard